@@ -4,6 +4,7 @@
 #include <mutex>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 
@@ -36,15 +37,15 @@ public:
     if (use_ws) {
       ws_client_ = std::make_unique<chirp::network::WebSocketClient>(io_);
       ws_client_->SetCallbacks(
-          [this](std::shared_ptr<chirp::network::Session>, std::string&& data) {
-            HandleRawFrame(std::move(data));
+          [this](std::shared_ptr<chirp::network::Session>, std::string_view data) {
+            HandleRawFrame(data);
           },
           [this](std::shared_ptr<chirp::network::Session>) { NotifyDisconnected(); });
     } else {
       tcp_client_ = std::make_unique<chirp::network::TcpClient>(io_);
       tcp_client_->SetCallbacks(
-          [this](std::shared_ptr<chirp::network::Session>, std::string&& data) {
-            HandleRawFrame(std::move(data));
+          [this](std::shared_ptr<chirp::network::Session>, std::string_view data) {
+            HandleRawFrame(data);
           },
           [this](std::shared_ptr<chirp::network::Session>) { NotifyDisconnected(); });
     }
@@ -149,7 +150,7 @@ private:
     return true;
   }
 
-  void HandleRawFrame(std::string&& data) {
+  void HandleRawFrame(std::string_view data) {
     chirp::gateway::Packet pkt;
     if (!pkt.ParseFromArray(data.data(), static_cast<int>(data.size()))) {
       return;
@@ -0,0 +1,300 @@
+#include "database/mysql_connection.h"
+
+#include <cstring>
+
+namespace chirp::database {
+namespace {
+
+// Initial buffer offered to each string result column; grows to the longest value seen.
+constexpr unsigned long kInitialStringCapacity = 64;
+
+} // namespace
+
+// MySQLStatement implementation
+MySQLStatement::MySQLStatement(MYSQL_STMT* stmt) : stmt_(stmt) {
+  const size_t params = mysql_stmt_param_count(stmt_);
+  params_.resize(params);
+  param_lengths_.resize(params);
+
+  size_t columns = 0;
+  if (MYSQL_RES* meta = mysql_stmt_result_metadata(stmt_)) {
+    columns = mysql_num_fields(meta);
+    mysql_free_result(meta);
+  }
+  results_.resize(columns);
+  result_lengths_.resize(columns);
+  result_nulls_ = std::make_unique<MySQLBool[]>(columns);
+  result_strings_.resize(columns, nullptr);
+  result_capacity_.resize(columns, kInitialStringCapacity);
+  for (size_t i = 0; i < columns; ++i) {
+    results_[i].length = &result_lengths_[i];
+    results_[i].is_null = &result_nulls_[i];
+  }
+}
+
+MySQLStatement::~MySQLStatement() {
+  mysql_stmt_close(stmt_);
+}
+
+void MySQLStatement::BindParam(size_t index, const std::string& value) {
+  MYSQL_BIND& b = params_[index];
+  b.buffer_type = MYSQL_TYPE_STRING;
+  b.buffer = const_cast<char*>(value.data());
+  b.buffer_length = static_cast<unsigned long>(value.size());
+  param_lengths_[index] = static_cast<unsigned long>(value.size());
+  b.length = &param_lengths_[index];
+}
+
+void MySQLStatement::BindParam(size_t index, const int64_t& value) {
+  MYSQL_BIND& b = params_[index];
+  b.buffer_type = MYSQL_TYPE_LONGLONG;
+  b.buffer = const_cast<int64_t*>(&value);
+  b.length = nullptr;
+}
+
+void MySQLStatement::BindParam(size_t index, const int32_t& value) {
+  MYSQL_BIND& b = params_[index];
+  b.buffer_type = MYSQL_TYPE_LONG;
+  b.buffer = const_cast<int32_t*>(&value);
+  b.length = nullptr;
+}
+
+bool MySQLStatement::Execute() {
+  mysql_stmt_free_result(stmt_); // a previous, not fully fetched result set
+  if (!params_.empty() && mysql_stmt_bind_param(stmt_, params_.data())) {
+    return false;
+  }
+  if (mysql_stmt_execute(stmt_) != 0) {
+    return false;
+  }
+  return results_.empty() || mysql_stmt_store_result(stmt_) == 0;
+}
+
+void MySQLStatement::BindResult(size_t index, std::string* out) {
+  results_[index].buffer_type = MYSQL_TYPE_STRING;
+  result_strings_[index] = out;
+}
+
+void MySQLStatement::BindResult(size_t index, int64_t* out) {
+  results_[index].buffer_type = MYSQL_TYPE_LONGLONG;
+  results_[index].buffer = out;
+  results_[index].buffer_length = sizeof(int64_t);
+  result_strings_[index] = nullptr;
+}
+
+void MySQLStatement::BindResult(size_t index, int32_t* out) {
+  results_[index].buffer_type = MYSQL_TYPE_LONG;
+  results_[index].buffer = out;
+  results_[index].buffer_length = sizeof(int32_t);
+  result_strings_[index] = nullptr;
+}
+
+bool MySQLStatement::Fetch() {
+  // String columns read straight into their std::string, sized to the largest value seen so far;
+  // a longer value is fetched again at its full length.
+  for (size_t i = 0; i < results_.size(); ++i) {
+    if (std::string* out = result_strings_[i]) {
+      out->resize(result_capacity_[i]);
+      results_[i].buffer = out->data();
+      results_[i].buffer_length = result_capacity_[i];
+    }
+  }
+  if (mysql_stmt_bind_result(stmt_, results_.data())) {
+    return false;
+  }
+  const int rc = mysql_stmt_fetch(stmt_);
+  if (rc != 0 && rc != MYSQL_DATA_TRUNCATED) {
+    return false;
+  }
+  for (size_t i = 0; i < results_.size(); ++i) {
+    std::string* out = result_strings_[i];
+    if (result_nulls_[i]) {
+      if (out) {
+        out->clear();
+      } else if (results_[i].buffer_type == MYSQL_TYPE_LONGLONG) {
+        *static_cast<int64_t*>(results_[i].buffer) = 0;
+      } else {
+        *static_cast<int32_t*>(results_[i].buffer) = 0;
+      }
+      continue;
+    }
+    if (!out) {
+      continue;
+    }
+    const unsigned long len = result_lengths_[i];
+    if (len > result_capacity_[i]) {
+      out->resize(len);
+      MYSQL_BIND column = results_[i];
+      column.buffer = out->data();
+      column.buffer_length = len;
+      if (mysql_stmt_fetch_column(stmt_, &column, static_cast<unsigned int>(i), 0) != 0) {
+        return false;
+      }
+      result_capacity_[i] = len;
+    } else {
+      out->resize(len);
+    }
+  }
+  return true;
+}
+
+uint64_t MySQLStatement::AffectedRows() {
+  return mysql_stmt_affected_rows(stmt_);
+}
+
+unsigned int MySQLStatement::Errno() {
+  return mysql_stmt_errno(stmt_);
+}
+
+std::string MySQLStatement::Error() {
+  return mysql_stmt_error(stmt_);
+}
+
+
+// MySQLConnection implementation
+MySQLConnection::MySQLConnection(const std::string& host, uint16_t port,
+                                const std::string& database, const std::string& user,
+                                const std::string& password)
+    : host_(host), port_(port), database_(database), user_(user), password_(password),
+      mysql_(nullptr), result_(nullptr), connected_(false) {
+  mysql_ = mysql_init(nullptr);
+}
+
+MySQLConnection::~MySQLConnection() {
+  Disconnect();
+  statements_.clear(); // before the handle they belong to
+  if (mysql_) {
+    mysql_close(mysql_);
+  }
+}
+
+bool MySQLConnection::Connect() {
+  if (connected_) {
+    return true;
+  }
+
+  if (!mysql_) {
+    return false;
+  }
+
+  const MySQLBool reconnect = 1;
+  mysql_options(mysql_, MYSQL_OPT_RECONNECT, &reconnect);
+
+  if (!mysql_real_connect(mysql_, host_.c_str(), user_.c_str(), password_.c_str(),
+                         database_.c_str(), port_, nullptr, CLIENT_MULTI_STATEMENTS)) {
+    return false;
+  }
+
+  connected_ = true;
+  return true;
+}
+
+void MySQLConnection::Disconnect() {
+  if (result_) {
+    mysql_free_result(result_);
+    result_ = nullptr;
+  }
+  connected_ = false;
+}
+
+bool MySQLConnection::Ping() {
+  if (!connected_) {
+    return false;
+  }
+  const unsigned long thread_id = mysql_thread_id(mysql_);
+  if (mysql_ping(mysql_) != 0) {
+    connected_ = false;
+    return false;
+  }
+  if (mysql_thread_id(mysql_) != thread_id) {
+    statements_.clear();
+  }
+  return true;
+}
+
+bool MySQLConnection::Query(const std::string& query) {
+  if (!connected_) {
+    return false;
+  }
+
+  if (result_) {
+    mysql_free_result(result_);
+    result_ = nullptr;
+  }
+
+  if (mysql_query(mysql_, query.c_str()) != 0) {
+    return false;
+  }
+
+  result_ = mysql_store_result(mysql_);
+  return true;
+}
+
+bool MySQLConnection::Execute(const std::string& query) {
+  if (!connected_) {
+    return false;
+  }
+
+  return mysql_query(mysql_, query.c_str()) == 0;
+}
+
+std::vector<std::vector<std::string>> MySQLConnection::FetchResults() {
+  std::vector<std::vector<std::string>> rows;
+
+  if (!result_) {
+    return rows;
+  }
+
+  MYSQL_ROW row;
+  while ((row = mysql_fetch_row(result_))) {
+    std::vector<std::string> cols;
+    unsigned int num_fields = mysql_num_fields(result_);
+    for (unsigned int i = 0; i < num_fields; i++) {
+      cols.push_back(row[i] ? row[i] : "NULL");
+    }
+    rows.push_back(std::move(cols));
+  }
+
+  return rows;
+}
+
+uint64_t MySQLConnection::LastInsertId() {
+  return mysql_insert_id(mysql_);
+}
+
+uint64_t MySQLConnection::AffectedRows() {
+  return mysql_affected_rows(mysql_);
+}
+
+std::string MySQLConnection::Escape(const std::string& str) {
+  std::vector<char> escaped(str.size() * 2 + 1);
+  mysql_real_escape_string(mysql_, escaped.data(), str.c_str(), str.size());
+  return std::string(escaped.data());
+}
+
+MySQLStatement* MySQLConnection::Prepare(const std::string& sql) {
+  if (!connected_) {
+    return nullptr;
+  }
+  auto it = statements_.find(sql);
+  if (it != statements_.end()) {
+    return it->second.get();
+  }
+  MYSQL_STMT* stmt = mysql_stmt_init(mysql_);
+  if (!stmt) {
+    return nullptr;
+  }
+  if (mysql_stmt_prepare(stmt, sql.data(), static_cast<unsigned long>(sql.size())) != 0) {
+    mysql_stmt_close(stmt);
+    return nullptr;
+  }
+  auto& cached = statements_[sql];
+  cached = std::make_unique<MySQLStatement>(stmt);
+  return cached.get();
+}
+
+void MySQLConnection::Forget(const std::string& sql) {
+  statements_.erase(sql);
+}
+
+} // namespace chirp::database
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <mysql/mysql.h>
+
+namespace chirp::database {
+
+// The client library's boolean: bool in MySQL 8, my_bool (char) in MariaDB and older libmysqlclient.
+using MySQLBool = std::remove_pointer_t<decltype(MYSQL_BIND::is_null)>;
+
+// Server-side prepared statement (binary protocol). Parameters are bound by pointer and read by
+// Execute(), so bound values must outlive it; result columns are bound to typed fields once and
+// each Fetch() writes the next row straight into them, with no escaping or text re-parsing.
+// Owned and cached by its MySQLConnection.
+class MySQLStatement {
+public:
+  explicit MySQLStatement(MYSQL_STMT* stmt);
+  ~MySQLStatement();
+
+  MySQLStatement(const MySQLStatement&) = delete;
+  MySQLStatement& operator=(const MySQLStatement&) = delete;
+
+  // `index` is the 0-based placeholder position.
+  void BindParam(size_t index, const std::string& value);
+  void BindParam(size_t index, const int64_t& value);
+  void BindParam(size_t index, const int32_t& value);
+
+  // Runs the statement; a result set is buffered client-side for Fetch().
+  bool Execute();
+
+  // `index` is the 0-based result column. NULL reads as "" / 0.
+  void BindResult(size_t index, std::string* out);
+  void BindResult(size_t index, int64_t* out);
+  void BindResult(size_t index, int32_t* out);
+
+  // Next row into the bound fields; false once the rows are exhausted (or on error).
+  bool Fetch();
+
+  uint64_t AffectedRows();
+  unsigned int Errno();
+  std::string Error();
+
+private:
+  MYSQL_STMT* stmt_;
+  std::vector<MYSQL_BIND> params_;
+  std::vector<unsigned long> param_lengths_;
+  std::vector<MYSQL_BIND> results_;
+  std::vector<unsigned long> result_lengths_;
+  std::unique_ptr<MySQLBool[]> result_nulls_;
+  std::vector<std::string*> result_strings_;   // per column; null for numeric columns
+  std::vector<unsigned long> result_capacity_; // buffer offered to string columns, grows to fit
+};
+
+// MySQL connection wrapper
+class MySQLConnection {
+public:
+  MySQLConnection(const std::string& host, uint16_t port,
+                 const std::string& database, const std::string& user,
+                 const std::string& password);
+  ~MySQLConnection();
+
+  bool Connect();
+  void Disconnect();
+  bool IsConnected() const { return connected_; }
+
+  // Round trip to the server (reconnecting if it had gone away); false if it is unreachable.
+  // A reconnect loses the server-side statements, so the statement cache is dropped with it.
+  bool Ping();
+
+  // Execute query (SELECT)
+  bool Query(const std::string& query);
+
+  // Execute statement (INSERT, UPDATE, DELETE)
+  bool Execute(const std::string& query);
+
+  // Get result set
+  std::vector<std::vector<std::string>> FetchResults();
+
+  // Get last insert ID
+  uint64_t LastInsertId();
+
+  // Get affected rows
+  uint64_t AffectedRows();
+
+  // Escape string
+  std::string Escape(const std::string& str);
+
+  // Prepared statement for `sql`, prepared on first use and cached for this connection; nullptr
+  // if the server rejects it.
+  MySQLStatement* Prepare(const std::string& sql);
+
+  // Drops the cached statement, e.g. after a reconnect lost it on the server.
+  void Forget(const std::string& sql);
+
+  MYSQL* GetMySQL() { return mysql_; }
+
+private:
+  std::string host_;
+  uint16_t port_;
+  std::string database_;
+  std::string user_;
+  std::string password_;
+
+  MYSQL* mysql_;
+  MYSQL_RES* result_;
+  bool connected_;
+  std::unordered_map<std::string, std::unique_ptr<MySQLStatement>> statements_; // by SQL text
+};
+
+} // namespace chirp::database
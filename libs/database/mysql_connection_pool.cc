@@ -0,0 +1,266 @@
+#include "database/mysql_connection_pool.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace chirp::database {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+} // namespace
+
+// Lease implementation
+MySQLConnectionPool::Lease::Lease(MySQLConnectionPool* pool, std::unique_ptr<MySQLConnection> conn)
+    : pool_(pool), conn_(std::move(conn)) {}
+
+MySQLConnectionPool::Lease::Lease(Lease&& other) noexcept
+    : pool_(other.pool_), conn_(std::move(other.conn_)) {
+  other.pool_ = nullptr;
+}
+
+MySQLConnectionPool::Lease& MySQLConnectionPool::Lease::operator=(Lease&& other) noexcept {
+  if (this != &other) {
+    Release();
+    pool_ = other.pool_;
+    conn_ = std::move(other.conn_);
+    other.pool_ = nullptr;
+  }
+  return *this;
+}
+
+MySQLConnectionPool::Lease::~Lease() {
+  Release();
+}
+
+void MySQLConnectionPool::Lease::Release() {
+  if (pool_ && conn_) {
+    pool_->Return(std::move(conn_), false);
+  }
+  pool_ = nullptr;
+}
+
+void MySQLConnectionPool::Lease::Discard() {
+  if (pool_ && conn_) {
+    pool_->Return(std::move(conn_), true);
+  }
+  pool_ = nullptr;
+}
+
+// MySQLConnectionPool implementation
+MySQLConnectionPool::MySQLConnectionPool(const MySQLPoolOptions& options)
+    : options_(options), executor_(std::max<size_t>(1, options.executor_threads)) {
+  const size_t initial = std::min(options_.min_size, options_.max_size);
+  for (size_t i = 0; i < initial; ++i) {
+    auto conn = Open();
+    if (!conn) {
+      break;  // the maintenance thread keeps trying
+    }
+    const auto now = Clock::now();
+    std::lock_guard<std::mutex> lock(mu_);
+    ++total_;
+    idle_.push_back(Idle{std::move(conn), now, now});
+  }
+  maintenance_ = std::thread([this]() { Maintain(); });
+}
+
+MySQLConnectionPool::~MySQLConnectionPool() {
+  Stop();  // queued Run() work still needs connections
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stopping_ = true;
+  }
+  available_.notify_all();
+  maintenance_cv_.notify_all();
+  maintenance_.join();
+}
+
+void MySQLConnectionPool::Stop() {
+  executor_.join();
+}
+
+std::unique_ptr<MySQLConnection> MySQLConnectionPool::Open() {
+  auto conn = std::make_unique<MySQLConnection>(options_.host, options_.port, options_.database,
+                                                options_.user, options_.password);
+  const bool connected = conn->Connect();
+  std::lock_guard<std::mutex> lock(mu_);
+  if (!connected) {
+    ++stats_.connect_failures;
+    return nullptr;
+  }
+  ++stats_.created;
+  return conn;
+}
+
+MySQLConnectionPool::Lease MySQLConnectionPool::Acquire() {
+  return Acquire(options_.acquire_timeout);
+}
+
+MySQLConnectionPool::Lease MySQLConnectionPool::Acquire(std::chrono::milliseconds timeout) {
+  const auto start = Clock::now();
+  const auto deadline = start + timeout;
+  std::unique_ptr<MySQLConnection> conn;
+  bool waited = false;
+
+  std::unique_lock<std::mutex> lock(mu_);
+  while (!stopping_) {
+    if (!idle_.empty()) {
+      Idle entry = std::move(idle_.back());
+      idle_.pop_back();
+      if (start - entry.pinged >= options_.ping_interval) {
+        // Still counted in total_ while it is checked outside the lock.
+        lock.unlock();
+        const bool alive = entry.conn->Ping();
+        if (!alive) {
+          entry.conn.reset();
+        }
+        lock.lock();
+        if (!alive) {
+          --total_;
+          ++stats_.closed_dead;
+          available_.notify_one();
+          continue;
+        }
+      }
+      conn = std::move(entry.conn);
+      break;
+    }
+
+    if (total_ < options_.max_size) {
+      ++total_;
+      lock.unlock();
+      conn = Open();
+      lock.lock();
+      if (!conn) {
+        --total_;
+        available_.notify_one();
+      }
+      break;  // an unreachable server fails the caller now rather than at the deadline
+    }
+
+    if (!waited) {
+      waited = true;
+      ++stats_.waits;
+    }
+    ++stats_.waiting;
+    const bool timed_out = available_.wait_until(lock, deadline) == std::cv_status::timeout;
+    --stats_.waiting;
+    if (timed_out && idle_.empty() && total_ >= options_.max_size) {
+      ++stats_.timeouts;
+      break;
+    }
+  }
+
+  const int64_t wait_us =
+      std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+  stats_.total_wait_us += wait_us;
+  stats_.max_wait_us = std::max(stats_.max_wait_us, wait_us);
+  if (!conn) {
+    return Lease();
+  }
+  ++stats_.acquired;
+  ++stats_.in_use;
+  stats_.max_in_use = std::max(stats_.max_in_use, stats_.in_use);
+  return Lease(this, std::move(conn));
+}
+
+void MySQLConnectionPool::Return(std::unique_ptr<MySQLConnection> conn, bool discard) {
+  if (discard || !conn->IsConnected()) {
+    conn.reset();
+    std::lock_guard<std::mutex> lock(mu_);
+    --total_;
+    --stats_.in_use;
+    ++stats_.closed_dead;
+    available_.notify_one();
+    return;
+  }
+
+  const auto now = Clock::now();
+  std::lock_guard<std::mutex> lock(mu_);
+  --stats_.in_use;
+  idle_.push_back(Idle{std::move(conn), now, now});
+  available_.notify_one();
+}
+
+void MySQLConnectionPool::Maintain() {
+  const auto tick = std::max(std::chrono::milliseconds(100),
+                             std::min(options_.ping_interval, options_.idle_timeout));
+  std::unique_lock<std::mutex> lock(mu_);
+  while (!stopping_) {
+    maintenance_cv_.wait_for(lock, tick, [this]() { return stopping_; });
+    if (stopping_) {
+      break;
+    }
+    const auto now = Clock::now();
+
+    // Oldest at the front: trim those idle past idle_timeout, keeping min_size open.
+    std::vector<std::unique_ptr<MySQLConnection>> closing;
+    while (total_ > options_.min_size && !idle_.empty() && now - idle_.front().since >= options_.idle_timeout) {
+      closing.push_back(std::move(idle_.front().conn));
+      idle_.pop_front();
+      --total_;
+      ++stats_.closed_idle;
+    }
+
+    // Take the connections due for a ping out of idle_ so nobody is handed one mid-ping.
+    std::vector<Idle> due;
+    for (auto it = idle_.begin(); it != idle_.end();) {
+      if (now - it->pinged >= options_.ping_interval) {
+        due.push_back(std::move(*it));
+        it = idle_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    lock.unlock();
+    closing.clear();
+    std::vector<bool> alive(due.size());
+    for (size_t i = 0; i < due.size(); ++i) {
+      alive[i] = due[i].conn->Ping();
+      if (!alive[i]) {
+        due[i].conn.reset();
+      }
+    }
+    lock.lock();
+
+    const auto pinged = Clock::now();
+    for (size_t i = 0; i < due.size(); ++i) {
+      if (alive[i]) {
+        // Back at its place in the `since` order, which idle trimming (front first) relies on
+        due[i].pinged = pinged;
+        auto pos = std::upper_bound(idle_.begin(), idle_.end(), due[i].since,
+                                    [](Clock::time_point since, const Idle& idle) { return since < idle.since; });
+        idle_.insert(pos, std::move(due[i]));
+      } else {
+        --total_;
+        ++stats_.closed_dead;
+      }
+      available_.notify_one();
+    }
+
+    // Reopen up to min_size, e.g. after the server came back.
+    while (!stopping_ && total_ < options_.min_size) {
+      ++total_;
+      lock.unlock();
+      auto conn = Open();
+      lock.lock();
+      if (!conn) {
+        --total_;
+        break;
+      }
+      const auto opened = Clock::now();
+      idle_.push_back(Idle{std::move(conn), opened, opened});
+      available_.notify_one();
+    }
+  }
+}
+
+MySQLPoolStats MySQLConnectionPool::GetStats() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  MySQLPoolStats stats = stats_;
+  stats.idle = idle_.size();
+  return stats;
+}
+
+} // namespace chirp::database
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include <asio.hpp>
+
+#include "database/mysql_connection.h"
+
+namespace chirp::database {
+
+struct MySQLPoolOptions {
+  std::string host = "127.0.0.1";
+  uint16_t port = 3306;
+  std::string database = "chirp";
+  std::string user = "chirp";
+  std::string password = "chirp_password";
+
+  size_t min_size{2};                                 // opened up front and kept through idle trimming
+  size_t max_size{10};                                // Acquire() waits once this many are checked out
+  std::chrono::milliseconds acquire_timeout{2000};    // default wait in Acquire() and Run()
+  std::chrono::milliseconds ping_interval{30000};     // idle connections are pinged this often, and one
+                                                      // idle for longer is pinged before it is handed out
+  std::chrono::milliseconds idle_timeout{300000};     // idle connections above min_size are closed after this
+  size_t executor_threads{4};                         // threads running Run() work
+};
+
+struct MySQLPoolStats {
+  uint64_t acquired{0};
+  uint64_t timeouts{0};          // Acquire() calls that gave up waiting
+  uint64_t waits{0};             // Acquire() calls that found nothing idle and had to wait
+  int64_t total_wait_us{0};      // time spent in Acquire(), over all calls
+  int64_t max_wait_us{0};
+  uint64_t created{0};
+  uint64_t connect_failures{0};
+  uint64_t closed_dead{0};       // failed a ping or came back disconnected
+  uint64_t closed_idle{0};       // trimmed after idle_timeout
+  uint64_t in_use{0};
+  uint64_t max_in_use{0};
+  uint64_t idle{0};
+  uint64_t waiting{0};           // callers blocked in Acquire() right now
+};
+
+// Bounded pool of MySQLConnections.
+//
+// Between min_size and max_size connections are open at any time. Acquire() hands out an idle
+// connection (pinging it first if it sat unused for longer than ping_interval), opens a new one
+// while fewer than max_size exist, and otherwise waits for a Lease to be returned, up to a
+// deadline. A maintenance thread pings idle connections, drops dead ones, trims those idle past
+// idle_timeout down to min_size and reopens connections up to min_size.
+//
+// Run() is for io threads: the query runs on the pool's own executor and only the result is
+// posted back, so MySQL round trips and waits for a free connection never block an io_context.
+class MySQLConnectionPool {
+public:
+  // Checked-out connection; returns it to the pool when destroyed.
+  class Lease {
+  public:
+    Lease() = default;
+    Lease(Lease&& other) noexcept;
+    Lease& operator=(Lease&& other) noexcept;
+    ~Lease();
+
+    Lease(const Lease&) = delete;
+    Lease& operator=(const Lease&) = delete;
+
+    explicit operator bool() const { return conn_ != nullptr; }
+    MySQLConnection* get() const { return conn_.get(); }
+    MySQLConnection* operator->() const { return conn_.get(); }
+    MySQLConnection& operator*() const { return *conn_; }
+
+    // Closes the connection instead of returning it, e.g. when its session state is unknown.
+    void Discard();
+
+  private:
+    friend class MySQLConnectionPool;
+    Lease(MySQLConnectionPool* pool, std::unique_ptr<MySQLConnection> conn);
+    void Release();
+
+    MySQLConnectionPool* pool_{nullptr};
+    std::unique_ptr<MySQLConnection> conn_;
+  };
+
+  explicit MySQLConnectionPool(const MySQLPoolOptions& options);
+
+  // Stops the executor (running queued work first) and the maintenance thread. Every Lease must
+  // be gone by then.
+  ~MySQLConnectionPool();
+
+  // Runs the work already queued on the executor and joins its threads; later Run() work is
+  // dropped. Lets owners release what that work captured before the pool itself goes away.
+  void Stop();
+
+  MySQLConnectionPool(const MySQLConnectionPool&) = delete;
+  MySQLConnectionPool& operator=(const MySQLConnectionPool&) = delete;
+
+  // Empty Lease if none could be had within options.acquire_timeout / `timeout`.
+  Lease Acquire();
+  Lease Acquire(std::chrono::milliseconds timeout);
+
+  // Runs `work(MySQLConnection&)` on the pool's executor with a leased connection and posts
+  // `handler(std::optional<R>)` to `ex`, R being what `work` returns; nullopt when no connection
+  // freed up within acquire_timeout. The Lease is returned before `handler` runs.
+  template <typename Work, typename Handler>
+  void Run(asio::any_io_executor ex, Work work, Handler handler) {
+    using Result = std::invoke_result_t<Work&, MySQLConnection&>;
+    asio::post(executor_, [this, ex = std::move(ex), work = std::move(work),
+                           handler = std::move(handler)]() mutable {
+      std::optional<Result> result;
+      if (Lease conn = Acquire()) {
+        result.emplace(work(*conn));
+      }
+      asio::post(ex, [handler = std::move(handler), result = std::move(result)]() mutable {
+        handler(std::move(result));
+      });
+    });
+  }
+
+  // Executor behind Run(), for blocking work that leases connections itself (e.g. a store
+  // method that calls Acquire()).
+  asio::thread_pool::executor_type GetExecutor() { return executor_.get_executor(); }
+
+  const MySQLPoolOptions& GetOptions() const { return options_; }
+
+  MySQLPoolStats GetStats() const;
+
+private:
+  struct Idle {
+    std::unique_ptr<MySQLConnection> conn;
+    std::chrono::steady_clock::time_point since;  // returned to the pool at
+    std::chrono::steady_clock::time_point pinged; // last used or pinged at
+  };
+
+  std::unique_ptr<MySQLConnection> Open();
+  void Return(std::unique_ptr<MySQLConnection> conn, bool discard);
+  void Maintain();
+
+  const MySQLPoolOptions options_;
+
+  mutable std::mutex mu_;
+  std::condition_variable available_;
+  std::deque<Idle> idle_;  // ordered by `since`: most recently returned at the back
+  size_t total_{0};        // idle + checked out + being opened
+  bool stopping_{false};
+  MySQLPoolStats stats_;
+
+  std::condition_variable maintenance_cv_;
+  std::thread maintenance_;
+  asio::thread_pool executor_;
+};
+
+} // namespace chirp::database
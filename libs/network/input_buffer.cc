@@ -0,0 +1,46 @@
+#include "network/input_buffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace chirp::network {
+
+InputBuffer::InputBuffer(size_t initial_capacity) : buf_(initial_capacity) {}
+
+std::span<uint8_t> InputBuffer::PrepareWrite(size_t min_bytes) {
+  if (buf_.size() - write_ < min_bytes) {
+    const size_t readable = ReadableBytes();
+    if (read_ > 0 && buf_.size() - readable >= min_bytes) {
+      // Enough room once the consumed prefix is reclaimed.
+      std::memmove(buf_.data(), buf_.data() + read_, readable);
+    } else {
+      std::vector<uint8_t> grown(std::max(buf_.size() * 2, readable + min_bytes));
+      std::memcpy(grown.data(), buf_.data() + read_, readable);
+      buf_.swap(grown);
+    }
+    read_ = 0;
+    write_ = readable;
+  }
+  return std::span<uint8_t>(buf_.data() + write_, buf_.size() - write_);
+}
+
+void InputBuffer::CommitWrite(size_t n) { write_ = std::min(write_ + n, buf_.size()); }
+
+void InputBuffer::Append(const uint8_t* data, size_t len) {
+  if (len == 0) {
+    return;
+  }
+  auto dst = PrepareWrite(len);
+  std::memcpy(dst.data(), data, len);
+  CommitWrite(len);
+}
+
+void InputBuffer::Consume(size_t n) {
+  read_ += std::min(n, ReadableBytes());
+  if (read_ == write_) {
+    // Fully drained: rewind for free instead of compacting later.
+    read_ = write_ = 0;
+  }
+}
+
+} // namespace chirp::network
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace chirp::network {
+
+// Contiguous receive buffer with independent read/write cursors:
+//   [consumed ... | readable ... | writable ...]
+//                 ^read_         ^write_
+//
+// Socket reads land directly in the writable tail (PrepareWrite + CommitWrite) and consumers
+// take views of the readable region, then Consume() what they used. Consuming only moves the
+// read cursor; the consumed prefix is reclaimed by one compaction when the tail runs out of
+// room, so draining N frames costs O(N) instead of one memmove of the residual per frame.
+class InputBuffer {
+public:
+  explicit InputBuffer(size_t initial_capacity = 4096);
+
+  // Returns a writable region of at least `min_bytes` (compacting or growing if needed).
+  // The region stays valid until the next non-const call.
+  std::span<uint8_t> PrepareWrite(size_t min_bytes);
+
+  // Marks `n` bytes of the region returned by PrepareWrite as readable.
+  void CommitWrite(size_t n);
+
+  // Copies `len` bytes to the tail.
+  void Append(const uint8_t* data, size_t len);
+
+  const uint8_t* ReadPtr() const { return buf_.data() + read_; }
+  size_t ReadableBytes() const { return write_ - read_; }
+  std::string_view Readable() const {
+    return std::string_view(reinterpret_cast<const char*>(ReadPtr()), ReadableBytes());
+  }
+
+  // Drops `n` readable bytes from the front.
+  void Consume(size_t n);
+
+  void Clear() { read_ = write_ = 0; }
+  size_t Capacity() const { return buf_.size(); }
+
+private:
+  std::vector<uint8_t> buf_;
+  size_t read_{0};
+  size_t write_{0};
+};
+
+} // namespace chirp::network
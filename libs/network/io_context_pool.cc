@@ -0,0 +1,60 @@
+#include "network/io_context_pool.h"
+
+namespace chirp::network {
+
+IoContextPool::IoContextPool(asio::io_context& main_io, size_t threads) : main_io_(main_io) {
+  const size_t extra = threads > 1 ? threads - 1 : 0;
+  workers_.reserve(extra);
+  for (size_t i = 0; i < extra; ++i) {
+    workers_.push_back(std::make_unique<asio::io_context>(1));
+  }
+}
+
+IoContextPool::~IoContextPool() { Stop(); }
+
+void IoContextPool::Start() {
+  if (!threads_.empty()) {
+    return;
+  }
+  guards_.reserve(workers_.size());
+  threads_.reserve(workers_.size());
+  for (auto& io : workers_) {
+    guards_.push_back(asio::make_work_guard(*io));
+    threads_.emplace_back([ctx = io.get()] { ctx->run(); });
+  }
+}
+
+void IoContextPool::Stop() {
+  for (auto& guard : guards_) {
+    guard.reset();
+  }
+  for (auto& io : workers_) {
+    io->stop();
+  }
+  for (auto& t : threads_) {
+    if (t.joinable()) {
+      t.join();
+    }
+  }
+  guards_.clear();
+  threads_.clear();
+}
+
+asio::io_context& IoContextPool::GetNextIoContext() {
+  const size_t n = Size();
+  if (n == 1) {
+    return main_io_;
+  }
+  const size_t idx = next_.fetch_add(1, std::memory_order_relaxed) % n;
+  return idx == 0 ? main_io_ : *workers_[idx - 1];
+}
+
+size_t ResolveIoThreads(int requested) {
+  if (requested > 0) {
+    return static_cast<size_t>(requested);
+  }
+  const unsigned hw = std::thread::hardware_concurrency();
+  return hw > 0 ? hw : 1;
+}
+
+} // namespace chirp::network
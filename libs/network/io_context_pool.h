@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <asio.hpp>
+
+namespace chirp::network {
+
+// A pool of io_contexts, one per I/O thread.
+//
+// The caller's io_context is slot 0 and keeps being run by the caller (main thread); the pool
+// owns the remaining `threads - 1` contexts and runs each on a dedicated thread. Servers hand
+// accepted sockets to contexts in round-robin order, so every session (and its strand) is pinned
+// to a single thread for its whole lifetime.
+class IoContextPool {
+public:
+  IoContextPool(asio::io_context& main_io, size_t threads);
+  ~IoContextPool();
+
+  IoContextPool(const IoContextPool&) = delete;
+  IoContextPool& operator=(const IoContextPool&) = delete;
+
+  // Spawns the worker threads. The main io_context is still run by the caller.
+  void Start();
+
+  // Stops the worker contexts and joins their threads. Does not stop the main io_context.
+  void Stop();
+
+  // Returns the next io_context in round-robin order. Thread-safe.
+  asio::io_context& GetNextIoContext();
+
+  asio::io_context& MainIoContext() { return main_io_; }
+  size_t Size() const { return workers_.size() + 1; }
+
+private:
+  using WorkGuard = asio::executor_work_guard<asio::io_context::executor_type>;
+
+  asio::io_context& main_io_;
+  std::vector<std::unique_ptr<asio::io_context>> workers_;
+  std::vector<WorkGuard> guards_;
+  std::vector<std::thread> threads_;
+  std::atomic<size_t> next_{0};
+};
+
+// Resolves an `--io_threads` value: 0 (or negative) means one thread per hardware core.
+size_t ResolveIoThreads(int requested);
+
+} // namespace chirp::network
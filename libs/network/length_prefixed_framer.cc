@@ -3,25 +3,40 @@
 #include "network/byte_order.h"
 
 namespace chirp::network {
+namespace {
 
-void LengthPrefixedFramer::Append(const uint8_t* data, size_t len) {
-  buf_.append(reinterpret_cast<const char*>(data), len);
-}
+constexpr size_t kLenBytes = 4;
 
-std::optional<std::string> LengthPrefixedFramer::PopFrame() {
-  constexpr size_t kLenBytes = 4;
-  if (buf_.size() < kLenBytes) {
+} // namespace
+
+void LengthPrefixedFramer::Append(const uint8_t* data, size_t len) { buf_.Append(data, len); }
+
+std::optional<std::string_view> LengthPrefixedFramer::PeekFrame() const {
+  if (buf_.ReadableBytes() < kLenBytes) {
     return std::nullopt;
   }
-  const auto* p = reinterpret_cast<const uint8_t*>(buf_.data());
-  uint32_t n = ReadU32BE(p);
-  if (buf_.size() < kLenBytes + n) {
+  const uint32_t n = ReadU32BE(buf_.ReadPtr());
+  if (buf_.ReadableBytes() - kLenBytes < n) {
     return std::nullopt;
   }
-  std::string payload = buf_.substr(kLenBytes, n);
-  buf_.erase(0, kLenBytes + n);
+  return buf_.Readable().substr(kLenBytes, n);
+}
+
+void LengthPrefixedFramer::ConsumeFrame() {
+  auto frame = PeekFrame();
+  if (frame) {
+    buf_.Consume(kLenBytes + frame->size());
+  }
+}
+
+std::optional<std::string> LengthPrefixedFramer::PopFrame() {
+  auto frame = PeekFrame();
+  if (!frame) {
+    return std::nullopt;
+  }
+  std::string payload(*frame);
+  buf_.Consume(kLenBytes + frame->size());
   return payload;
 }
 
 } // namespace chirp::network
-
@@ -3,7 +3,11 @@
 #include <cstddef>
 #include <cstdint>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+
+#include "network/input_buffer.h"
 
 namespace chirp::network {
 
@@ -14,15 +18,28 @@ public:
   // Appends raw bytes into the internal buffer.
   void Append(const uint8_t* data, size_t len);
 
+  // Zero-copy receive path: read straight into the framer's buffer, then commit what arrived.
+  std::span<uint8_t> PrepareWrite(size_t min_bytes) { return buf_.PrepareWrite(min_bytes); }
+  void CommitWrite(size_t n) { buf_.CommitWrite(n); }
+
+  // For producers that write in several steps (e.g. an inflater) rather than one copy.
+  InputBuffer& MutableBuffer() { return buf_; }
+
+  // Returns a view of the next full payload (without length prefix), or nullopt if incomplete.
+  // The view points into the internal buffer and is valid until ConsumeFrame() or the next write.
+  std::optional<std::string_view> PeekFrame() const;
+
+  // Drops the frame returned by PeekFrame(). No-op if no full frame is buffered.
+  void ConsumeFrame();
+
   // Pops the next full payload (without length prefix). Returns nullopt if incomplete.
   std::optional<std::string> PopFrame();
 
-  void Clear() { buf_.clear(); }
-  size_t BufferedBytes() const { return buf_.size(); }
+  void Clear() { buf_.Clear(); }
+  size_t BufferedBytes() const { return buf_.ReadableBytes(); }
 
 private:
-  std::string buf_;
+  InputBuffer buf_;
 };
 
 } // namespace chirp::network
-
@@ -1,26 +1,68 @@
 #include "message_router.h"
 
-#include <chrono>
-#include <condition_variable>
-#include <deque>
+#include <algorithm>
 #include <mutex>
-#include <thread>
-#include <vector>
-#include <set>
+#include <optional>
+#include <string_view>
+#include <unordered_set>
 #include <asio.hpp>
 
 #include "common/logger.h"
+#include "redis_scripts.h"
 
 namespace chirp::network {
-
 namespace {
 
-constexpr int kConnectRetryIntervalMs = 5000;
-constexpr int kSubscribeTimeoutMs = 5000;
+// 实例批次编码：若干条 [u32 用户 ID 长度][用户 ID][u32 消息长度][消息]，长度为大端序
+void AppendU32(std::string* out, size_t v) {
+  const char bytes[4] = {static_cast<char>((v >> 24) & 0xFF), static_cast<char>((v >> 16) & 0xFF),
+                         static_cast<char>((v >> 8) & 0xFF), static_cast<char>(v & 0xFF)};
+  out->append(bytes, 4);
+}
+
+void AppendRecord(std::string* out, const std::string& user_id, const std::string& message) {
+  AppendU32(out, user_id.size());
+  out->append(user_id);
+  AppendU32(out, message.size());
+  out->append(message);
+}
+
+bool ReadField(std::string_view* in, std::string* field) {
+  if (in->size() < 4) {
+    return false;
+  }
+  const auto* p = reinterpret_cast<const uint8_t*>(in->data());
+  const size_t len = (static_cast<size_t>(p[0]) << 24) | (static_cast<size_t>(p[1]) << 16) |
+                     (static_cast<size_t>(p[2]) << 8) | static_cast<size_t>(p[3]);
+  if (in->size() - 4 < len) {
+    return false;
+  }
+  field->assign(in->data() + 4, len);
+  in->remove_prefix(4 + len);
+  return true;
+}
+
+// 逐条回调；遇到截断的记录即停止
+template <typename Fn>
+void ForEachRecord(std::string_view batch, Fn&& fn) {
+  std::string user_id;
+  std::string message;
+  while (!batch.empty()) {
+    if (!ReadField(&batch, &user_id) || !ReadField(&batch, &message)) {
+      chirp::common::Logger::Instance().Warn("MessageRouter: malformed instance batch");
+      return;
+    }
+    fn(user_id, message);
+  }
+}
+
+constexpr const char* kInstanceStreamGroup = "chirp-chat";
+constexpr const char* kInstanceStreamField = "b";
 
 } // namespace
 
-struct MessageRouter::Impl {
+// 异步回调只持有 weak_ptr：路由器析构后，仍在途的 Redis 回复与投递的任务不再访问它
+struct MessageRouter::Impl : std::enable_shared_from_this<Impl> {
   asio::io_context& io;
   std::string host;
   uint16_t port;
@@ -28,35 +70,84 @@ struct MessageRouter::Impl {
   // Redis 客户端（用于发布）
   std::unique_ptr<RedisClient> publisher;
 
-  // Redis 订阅者
+  // Redis 订阅者（运行在主 io_context 上；断线重连后自动重新订阅）
   std::unique_ptr<RedisSubscriber> subscriber;
 
-  // 订阅的频道集合
-  std::set<std::string> subscribed_channels;
+  // 保护 subscriptions / pattern_subscriptions（订阅 strand 与多个 io 线程并发访问）
+  std::mutex mu;
 
   // 订阅回调映射
   std::unordered_map<std::string, SubscribeCallback> subscriptions;
+  std::unordered_map<std::string, MessageCallback> pattern_subscriptions;
 
   // 运行状态
   std::atomic<bool> running{false};
   std::atomic<bool> connected{false};
 
-  Impl(asio::io_context& io, std::string redis_host, uint16_t redis_port)
-      : io(io), host(std::move(redis_host)), port(redis_port) {
-    publisher = std::make_unique<RedisClient>(host, port);
-    subscriber = std::make_unique<RedisSubscriber>(host, port);
-
-    // 设置订阅者回调
-    subscriber->SetMessageCallback([this, &io](const std::string& channel, const std::string& message) {
-      auto it = subscriptions.find(channel);
-      if (it != subscriptions.end() && it->second) {
-        // 将回调投递到主 io_context
-        asio::post(io, [cb = it->second, msg = message]() {
-          cb(msg);
-        });
+  // 实例寻址路由（EnableInstanceRouting 之后启用）
+  struct CachedLocation {
+    std::string instance_id;
+    std::chrono::steady_clock::time_point expires;
+  };
+  struct PendingBatch {
+    std::string payload;
+    size_t count{0};
+  };
+  std::string instance_id;
+  InstanceRoutingOptions routing_options;
+  DeliverCallback on_deliver;
+  UndeliveredCallback on_undelivered;
+
+  // Streams 传输时读取本实例的流（与订阅者一样运行在主 io_context 上）
+  std::unique_ptr<RedisStreamConsumer> stream_consumer;
+
+  // 保护 local_users / locations / pending / flush_posted
+  std::mutex route_mu;
+  std::unordered_set<std::string> local_users;
+  std::unordered_map<std::string, CachedLocation> locations;
+  std::unordered_map<std::string, PendingBatch> pending; // 按目标实例聚合
+  bool flush_posted{false};
+
+  // 定期续期 local_users 的位置注册项（Streams 传输时连同本实例的存活键）
+  asio::steady_timer refresh_timer;
+  // Streams 传输：定期查找已下线实例遗留的流
+  asio::steady_timer adopt_timer;
+
+  Impl(asio::io_context& io, std::string redis_host, uint16_t redis_port, RedisClientOptions redis_options)
+      : io(io), host(std::move(redis_host)), port(redis_port), refresh_timer(io), adopt_timer(io) {
+    publisher = std::make_unique<RedisClient>(host, port, redis_options);
+    subscriber = std::make_unique<RedisSubscriber>(io.get_executor(), host, port);
+
+    // 设置订阅者回调（已在主 io_context 上执行，无需再投递）
+    subscriber->SetMessageCallback([this](const std::string& channel, const std::string& message) {
+      SubscribeCallback cb;
+      {
+        std::lock_guard<std::mutex> lock(mu);
+        auto it = subscriptions.find(channel);
+        if (it != subscriptions.end()) {
+          cb = it->second;
+        }
+      }
+      if (cb) {
+        cb(message);
       }
     });
 
+    subscriber->SetPatternMessageCallback(
+        [this](const std::string& pattern, const std::string& channel, const std::string& message) {
+          MessageCallback cb;
+          {
+            std::lock_guard<std::mutex> lock(mu);
+            auto it = pattern_subscriptions.find(pattern);
+            if (it != pattern_subscriptions.end()) {
+              cb = it->second;
+            }
+          }
+          if (cb) {
+            cb(channel, message);
+          }
+        });
+
     subscriber->SetErrorCallback([this](const std::string& error) {
       chirp::common::Logger::Instance().Warn("MessageRouter Redis error: " + error);
       connected = false;
@@ -65,40 +156,364 @@ struct MessageRouter::Impl {
     subscriber->SetConnectCallback([this]() {
       chirp::common::Logger::Instance().Info("MessageRouter Redis connected");
       connected = true;
-
-      // 重新订阅之前的频道
-      for (const auto& channel : subscribed_channels) {
-        subscriber->Subscribe(channel);
-      }
     });
   }
 
   bool Start() {
-    try {
-      subscriber->Start();
-      running = true;
-      return true;
-    } catch (const std::exception& e) {
-      chirp::common::Logger::Instance().Error("Failed to start MessageRouter: " + std::string(e.what()));
-      return false;
+    subscriber->Start();
+    if (stream_consumer) {
+      stream_consumer->Start();
+    }
+    running = true;
+    if (!instance_id.empty()) {
+      ScheduleRefresh();
     }
+    if (stream_consumer) {
+      Heartbeat();
+      ScheduleAdoptScan();
+    }
+    return true;
   }
 
+  // 下线时不删除存活键：在其过期前以同一 ID 重启的实例继续读取自己的流，不被接管
   void Stop() {
     running = false;
+    refresh_timer.cancel();
+    adopt_timer.cancel();
+    FlushBatches();
     if (subscriber) {
       subscriber->Stop();
     }
-    subscribed_channels.clear();
+    if (stream_consumer) {
+      stream_consumer->Stop();
+    }
+    std::lock_guard<std::mutex> lock(mu);
     subscriptions.clear();
+    pattern_subscriptions.clear();
+  }
+
+  bool IsLocal(const std::string& user_id) {
+    std::lock_guard<std::mutex> lock(route_mu);
+    return local_users.count(user_id) > 0;
+  }
+
+  void ScheduleRefresh() {
+    refresh_timer.expires_after(routing_options.location_refresh_interval);
+    refresh_timer.async_wait([weak = weak_from_this()](std::error_code ec) {
+      auto self = weak.lock();
+      if (ec || !self || !self->running) {
+        return;
+      }
+      self->RefreshLocations();
+      if (self->stream_consumer) {
+        self->Heartbeat();
+      }
+      self->ScheduleRefresh();
+    });
+  }
+
+  // 续期本实例在线用户的位置：EXPIRE 按批流水线发送；注册项已丢失（如 Redis 重启）的用户用
+  // SET NX 补回，不覆盖已在别处登录的用户
+  void RefreshLocations() {
+    constexpr size_t kRefreshBatch = 512;
+    std::vector<std::string> users;
+    {
+      std::lock_guard<std::mutex> lock(route_mu);
+      users.assign(local_users.begin(), local_users.end());
+    }
+    const std::string ttl = std::to_string(routing_options.location_ttl_seconds);
+    for (size_t begin = 0; begin < users.size(); begin += kRefreshBatch) {
+      auto chunk = std::make_shared<std::vector<std::string>>(
+          users.begin() + begin, users.begin() + std::min(users.size(), begin + kRefreshBatch));
+      auto batch = publisher->Batch();
+      for (const auto& user_id : *chunk) {
+        batch.Add({"EXPIRE", RouterChannels::UserLocation(user_id), ttl});
+      }
+      // 回复在发布客户端的 I/O 线程上到达；补注册交回 io 执行，那里可以安全地持有 Impl
+      batch.ExecuteAsync([io = &io, weak = weak_from_this(), chunk, ttl](RedisBatch::Replies replies) {
+        if (!replies) {
+          chirp::common::Logger::Instance().Warn("MessageRouter: refreshing user locations failed");
+          return;
+        }
+        std::vector<std::string> lost;
+        for (size_t i = 0; i < chunk->size() && i < replies->size(); ++i) {
+          const RedisReply& r = (*replies)[i];
+          if (r.type == RedisReply::Type::kInteger && r.integer == 0) {
+            lost.push_back((*chunk)[i]);
+          }
+        }
+        if (lost.empty()) {
+          return;
+        }
+        asio::post(*io, [weak, lost = std::move(lost), ttl] {
+          auto self = weak.lock();
+          if (!self) {
+            return;
+          }
+          for (const auto& user_id : lost) {
+            if (self->IsLocal(user_id)) {
+              self->publisher->ExecuteAsync(
+                  {"SET", RouterChannels::UserLocation(user_id), self->instance_id, "EX", ttl, "NX"});
+            }
+          }
+        });
+      });
+    }
+  }
+
+  void Heartbeat() {
+    publisher->ExecuteAsync({"SADD", RouterChannels::StreamInstances(), instance_id});
+    publisher->ExecuteAsync({"SET", RouterChannels::InstanceHeartbeat(instance_id), instance_id, "EX",
+                             std::to_string(routing_options.location_ttl_seconds)});
+  }
+
+  void ScheduleAdoptScan() {
+    adopt_timer.expires_after(routing_options.orphan_scan_interval);
+    adopt_timer.async_wait([weak = weak_from_this()](std::error_code ec) {
+      auto self = weak.lock();
+      if (ec || !self || !self->running) {
+        return;
+      }
+      self->AdoptOrphanedStreams();
+      self->ScheduleAdoptScan();
+    });
+  }
+
+  // 存活键已过期的实例视为下线（崩溃后未以同一 ID 重启）；抢到接管锁的实例负责清空它的流
+  void AdoptOrphanedStreams() {
+    auto members = publisher->Execute({"SMEMBERS", RouterChannels::StreamInstances()});
+    if (!members || members->type == RedisReply::Type::kError) {
+      return;
+    }
+    const std::string ttl = std::to_string(routing_options.location_ttl_seconds);
+    for (const auto& member : members->elements) {
+      const std::string dead(member.str);
+      if (dead == instance_id) {
+        continue;
+      }
+      auto alive = publisher->Execute({"EXISTS", RouterChannels::InstanceHeartbeat(dead)});
+      if (!alive || alive->type != RedisReply::Type::kInteger || alive->integer != 0) {
+        continue;
+      }
+      auto lock = publisher->Execute({"SET", RouterChannels::InstanceStreamAdopter(dead), instance_id, "NX", "EX", ttl});
+      if (!lock || lock->type != RedisReply::Type::kSimpleString) {
+        continue; // 另一个实例正在接管
+      }
+      chirp::common::Logger::Instance().Info("MessageRouter: instance " + dead + " is gone, adopting its stream");
+      ForgetInstance(dead);
+      PostAdoptStep(dead);
+    }
+  }
+
+  void PostAdoptStep(const std::string& dead) {
+    asio::post(io, [weak = weak_from_this(), dead] {
+      if (auto self = weak.lock()) {
+        self->AdoptStep(dead);
+      }
+    });
+  }
+
+  // 每步处理一批：先认领原实例读取后未确认的条目，没有则读取从未投递的条目，逐条重新路由后确认。
+  // 读空后删除该流并将其移出实例集合；原实例恢复或 Redis 失败时放弃，下一轮扫描再试
+  void AdoptStep(const std::string& dead) {
+    const std::string stream = RouterChannels::InstanceStream(dead);
+    const std::string heartbeat = RouterChannels::InstanceHeartbeat(dead);
+    const std::string adopter = RouterChannels::InstanceStreamAdopter(dead);
+    const std::string count = std::to_string(routing_options.stream.count);
+    auto alive = running ? publisher->Execute({"EXISTS", heartbeat}) : std::nullopt;
+    if (!alive || alive->type != RedisReply::Type::kInteger || alive->integer != 0) {
+      ReleaseSession(*publisher, adopter, instance_id);
+      return;
+    }
+    publisher->Expire(adopter, routing_options.location_ttl_seconds);
+
+    std::vector<RedisStreamEntry> entries;
+    auto claimed = publisher->Execute(
+        {"XAUTOCLAIM", stream, kInstanceStreamGroup, instance_id, "0", "0-0", "COUNT", count});
+    if (claimed && claimed->type == RedisReply::Type::kArray && claimed->elements.size() >= 2) {
+      AppendRedisStreamEntries(claimed->elements[1], &entries);
+    } else if (claimed && claimed->type == RedisReply::Type::kError &&
+               claimed->str.find("NOGROUP") != std::string_view::npos) {
+      // 原实例没来得及建组：从流的开头读起
+      publisher->Execute({"XGROUP", "CREATE", stream, kInstanceStreamGroup, "0", "MKSTREAM"});
+    } else {
+      ReleaseSession(*publisher, adopter, instance_id);
+      return;
+    }
+    if (entries.empty()) {
+      auto read = publisher->Execute(
+          {"XREADGROUP", "GROUP", kInstanceStreamGroup, instance_id, "COUNT", count, "STREAMS", stream, ">"});
+      if (!read || read->type == RedisReply::Type::kError) {
+        ReleaseSession(*publisher, adopter, instance_id);
+        return;
+      }
+      entries = ParseRedisStreamRead(*read);
+    }
+
+    if (entries.empty()) {
+      if (DeleteDrainedStream(*publisher, stream, kInstanceStreamGroup, heartbeat)) {
+        publisher->Execute({"SREM", RouterChannels::StreamInstances(), dead});
+        chirp::common::Logger::Instance().Info("MessageRouter: adopted the stream of instance " + dead);
+      }
+      ReleaseSession(*publisher, adopter, instance_id);
+      return;
+    }
+    std::vector<std::string> ack = {"XACK", stream, kInstanceStreamGroup};
+    ack.reserve(entries.size() + 3);
+    for (const auto& entry : entries) {
+      for (size_t i = 0; i + 1 < entry.fields.size(); i += 2) {
+        if (entry.fields[i] == kInstanceStreamField) {
+          ForEachRecord(entry.fields[i + 1], [this, &dead](const std::string& user_id, const std::string& message) {
+            Reroute(dead, user_id, message);
+          });
+        }
+      }
+      ack.push_back(entry.id);
+    }
+    publisher->Execute(ack);
+    PostAdoptStep(dead);
+  }
+
+  // 接管来的消息：用户在本实例则直接投递，已在其他实例上线则转发，否则交给 on_undelivered
+  void Reroute(const std::string& dead, const std::string& user_id, const std::string& message) {
+    if (IsLocal(user_id) && on_deliver && on_deliver(user_id, message)) {
+      return;
+    }
+    const auto owner = Locate(user_id);
+    if (owner && *owner != instance_id && *owner != dead) {
+      Enqueue(*owner, user_id, message);
+      return;
+    }
+    if (on_undelivered) {
+      on_undelivered(user_id, message);
+    }
+  }
+
+  void AddSubscription(const std::string& channel, SubscribeCallback cb) {
+    std::lock_guard<std::mutex> lock(mu);
+    subscriptions[channel] = std::move(cb);
+  }
+
+  // 本地缓存命中则不访问 Redis；只缓存在线用户，离线用户每次都查注册表
+  std::optional<std::string> Locate(const std::string& user_id) {
+    const auto now = std::chrono::steady_clock::now();
+    {
+      std::lock_guard<std::mutex> lock(route_mu);
+      auto it = locations.find(user_id);
+      if (it != locations.end() && it->second.expires > now) {
+        return it->second.instance_id;
+      }
+    }
+    auto owner = publisher->Get(RouterChannels::UserLocation(user_id));
+    if (!owner) {
+      return std::nullopt;
+    }
+    std::lock_guard<std::mutex> lock(route_mu);
+    if (locations.size() >= routing_options.max_cached_locations) {
+      locations.clear();
+    }
+    locations[user_id] = CachedLocation{*owner, now + routing_options.cache_ttl};
+    return owner;
+  }
+
+  void Enqueue(const std::string& target, const std::string& user_id, const std::string& message) {
+    PendingBatch full;
+    bool post = false;
+    {
+      std::lock_guard<std::mutex> lock(route_mu);
+      auto& batch = pending[target];
+      AppendRecord(&batch.payload, user_id, message);
+      if (++batch.count >= routing_options.max_batch_messages) {
+        full = std::move(batch);
+        pending.erase(target);
+      } else if (!flush_posted) {
+        flush_posted = post = true;
+      }
+    }
+    if (full.count > 0) {
+      PublishBatch(target, std::move(full.payload));
+    }
+    if (post) {
+      asio::post(io, [weak = weak_from_this()] {
+        if (auto self = weak.lock()) {
+          self->FlushBatches();
+        }
+      });
+    }
+  }
+
+  void FlushBatches() {
+    std::unordered_map<std::string, PendingBatch> batches;
+    {
+      std::lock_guard<std::mutex> lock(route_mu);
+      batches.swap(pending);
+      flush_posted = false;
+    }
+    for (auto& [target, batch] : batches) {
+      PublishBatch(target, std::move(batch.payload));
+    }
+  }
+
+  // 无人订阅（目标实例已下线）或 Redis 失败时，整批交给 on_undelivered 并清除指向该实例的缓存。
+  // Streams 传输下目标实例离线时批次留在其流中，重启后再投递，只有 XADD 失败才算未送达
+  void PublishBatch(const std::string& target, std::string payload) {
+    auto batch = std::make_shared<std::string>(std::move(payload));
+    const bool streams = routing_options.transport == InstanceTransport::kStreams;
+    std::vector<std::string> args;
+    if (streams) {
+      args = {"XADD", RouterChannels::InstanceStream(target), "MAXLEN", "~",
+              std::to_string(routing_options.stream_max_len), "*", kInstanceStreamField, *batch};
+    } else {
+      args = {"PUBLISH", RouterChannels::Instance(target), *batch};
+    }
+    publisher->ExecuteAsync(args, [io = &io, weak = weak_from_this(), target, batch,
+                                   streams](std::optional<RedisReply> reply) {
+      if (streams ? reply && reply->type != RedisReply::Type::kError
+                  : reply && reply->type == RedisReply::Type::kInteger && reply->integer > 0) {
+        return;
+      }
+      // ~RedisClient 也会以失败结束在途命令，此时 Impl 可能已经析构
+      asio::post(*io, [weak, target, batch] {
+        auto self = weak.lock();
+        if (!self) {
+          return;
+        }
+        self->ForgetInstance(target);
+        ForEachRecord(*batch, [&self](const std::string& user_id, const std::string& message) {
+          if (self->on_undelivered) {
+            self->on_undelivered(user_id, message);
+          }
+        });
+      });
+    });
+  }
+
+  void ForgetInstance(const std::string& target) {
+    std::lock_guard<std::mutex> lock(route_mu);
+    for (auto it = locations.begin(); it != locations.end();) {
+      it = it->second.instance_id == target ? locations.erase(it) : std::next(it);
+    }
+  }
+
+  // 收到发往本实例的批次：逐条投递，用户已不在本实例则交给 on_undelivered
+  void DeliverBatch(const std::string& payload) {
+    ForEachRecord(payload, [this](const std::string& user_id, const std::string& message) {
+      if (on_deliver && on_deliver(user_id, message)) {
+        return;
+      }
+      if (on_undelivered) {
+        on_undelivered(user_id, message);
+      }
+    });
   }
 };
 
 MessageRouter::MessageRouter(asio::io_context& io,
                              std::string redis_host,
-                             uint16_t redis_port)
+                             uint16_t redis_port,
+                             RedisClientOptions redis_options)
     : io_(io), redis_host_(std::move(redis_host)), redis_port_(redis_port) {
-  impl_ = std::make_unique<Impl>(io_, redis_host_, redis_port_);
+  impl_ = std::make_shared<Impl>(io_, redis_host_, redis_port_, redis_options);
 }
 
 MessageRouter::~MessageRouter() {
@@ -128,8 +543,7 @@ bool MessageRouter::Publish(const std::string& channel, const std::string& messa
 
 bool MessageRouter::SubscribeUserChat(const std::string& user_id, SubscribeCallback cb) {
   std::string channel = RouterChannels::UserChat(user_id);
-  impl_->subscriptions[channel] = std::move(cb);
-  impl_->subscribed_channels.insert(channel);
+  impl_->AddSubscription(channel, std::move(cb));
 
   if (impl_->subscriber) {
     return impl_->subscriber->Subscribe(channel);
@@ -139,8 +553,7 @@ bool MessageRouter::SubscribeUserChat(const std::string& user_id, SubscribeCallb
 
 bool MessageRouter::SubscribeGroupChat(const std::string& group_id, SubscribeCallback cb) {
   std::string channel = RouterChannels::GroupChat(group_id);
-  impl_->subscriptions[channel] = std::move(cb);
-  impl_->subscribed_channels.insert(channel);
+  impl_->AddSubscription(channel, std::move(cb));
 
   if (impl_->subscriber) {
     return impl_->subscriber->Subscribe(channel);
@@ -150,8 +563,7 @@ bool MessageRouter::SubscribeGroupChat(const std::string& group_id, SubscribeCal
 
 bool MessageRouter::SubscribeUserSocial(const std::string& user_id, SubscribeCallback cb) {
   std::string channel = RouterChannels::UserSocial(user_id);
-  impl_->subscriptions[channel] = std::move(cb);
-  impl_->subscribed_channels.insert(channel);
+  impl_->AddSubscription(channel, std::move(cb));
 
   if (impl_->subscriber) {
     return impl_->subscriber->Subscribe(channel);
@@ -161,8 +573,7 @@ bool MessageRouter::SubscribeUserSocial(const std::string& user_id, SubscribeCal
 
 bool MessageRouter::SubscribeKickNotification(const std::string& instance_id, SubscribeCallback cb) {
   std::string channel = RouterChannels::KickNotification(instance_id);
-  impl_->subscriptions[channel] = std::move(cb);
-  impl_->subscribed_channels.insert(channel);
+  impl_->AddSubscription(channel, std::move(cb));
 
   if (impl_->subscriber) {
     return impl_->subscriber->Subscribe(channel);
@@ -171,14 +582,108 @@ bool MessageRouter::SubscribeKickNotification(const std::string& instance_id, Su
 }
 
 void MessageRouter::Unsubscribe(const std::string& channel) {
-  impl_->subscriptions.erase(channel);
-  impl_->subscribed_channels.erase(channel);
+  {
+    std::lock_guard<std::mutex> lock(impl_->mu);
+    impl_->subscriptions.erase(channel);
+  }
 
   if (impl_->subscriber) {
     impl_->subscriber->Unsubscribe(channel);
   }
 }
 
+bool MessageRouter::SubscribePattern(const std::string& pattern, MessageCallback cb) {
+  {
+    std::lock_guard<std::mutex> lock(impl_->mu);
+    impl_->pattern_subscriptions[pattern] = std::move(cb);
+  }
+
+  if (impl_->subscriber) {
+    return impl_->subscriber->PSubscribe(pattern);
+  }
+  return true;
+}
+
+void MessageRouter::UnsubscribePattern(const std::string& pattern) {
+  {
+    std::lock_guard<std::mutex> lock(impl_->mu);
+    impl_->pattern_subscriptions.erase(pattern);
+  }
+
+  if (impl_->subscriber) {
+    impl_->subscriber->PUnsubscribe(pattern);
+  }
+}
+
+void MessageRouter::EnableInstanceRouting(const std::string& instance_id,
+                                          DeliverCallback on_deliver,
+                                          UndeliveredCallback on_undelivered,
+                                          InstanceRoutingOptions options) {
+  impl_->instance_id = instance_id;
+  impl_->routing_options = options;
+  impl_->on_deliver = std::move(on_deliver);
+  impl_->on_undelivered = std::move(on_undelivered);
+
+  if (options.transport == InstanceTransport::kStreams) {
+    impl_->stream_consumer = std::make_unique<RedisStreamConsumer>(
+        io_.get_executor(), redis_host_, redis_port_, RouterChannels::InstanceStream(instance_id),
+        kInstanceStreamGroup, instance_id, options.stream);
+    impl_->stream_consumer->SetHandler([impl = impl_.get()](const std::vector<RedisStreamEntry>& entries) {
+      for (const auto& entry : entries) {
+        for (size_t i = 0; i + 1 < entry.fields.size(); i += 2) {
+          if (entry.fields[i] == kInstanceStreamField) {
+            impl->DeliverBatch(entry.fields[i + 1]);
+          }
+        }
+      }
+    });
+    return;
+  }
+
+  const std::string channel = RouterChannels::Instance(instance_id);
+  impl_->AddSubscription(channel, [impl = impl_.get()](const std::string& payload) { impl->DeliverBatch(payload); });
+  if (impl_->subscriber) {
+    impl_->subscriber->Subscribe(channel);
+  }
+}
+
+void MessageRouter::RegisterLocalUser(const std::string& user_id) {
+  {
+    std::lock_guard<std::mutex> lock(impl_->route_mu);
+    impl_->local_users.insert(user_id);
+    impl_->locations.erase(user_id);
+  }
+  impl_->publisher->SetEx(RouterChannels::UserLocation(user_id), impl_->instance_id,
+                          impl_->routing_options.location_ttl_seconds);
+}
+
+void MessageRouter::UnregisterLocalUser(const std::string& user_id) {
+  {
+    std::lock_guard<std::mutex> lock(impl_->route_mu);
+    impl_->local_users.erase(user_id);
+  }
+  // 只删除仍指向本实例的注册项，用户可能已在别处重新登录
+  ReleaseSession(*impl_->publisher, RouterChannels::UserLocation(user_id), impl_->instance_id);
+}
+
+bool MessageRouter::RouteToUser(const std::string& user_id, const std::string& message) {
+  bool local = false;
+  {
+    std::lock_guard<std::mutex> lock(impl_->route_mu);
+    local = impl_->local_users.count(user_id) > 0;
+  }
+  if (local && impl_->on_deliver && impl_->on_deliver(user_id, message)) {
+    return true;
+  }
+
+  const auto owner = impl_->Locate(user_id);
+  if (!owner || *owner == impl_->instance_id) {
+    return false; // 不在线，或注册表仍指向本实例但会话已断开
+  }
+  impl_->Enqueue(*owner, user_id, message);
+  return true;
+}
+
 bool MessageRouter::SendChatMessage(const std::string& user_id,
                                     const std::string& message,
                                     std::function<bool(const std::string&)> local_send) {
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <memory>
@@ -9,9 +11,30 @@
 #include <asio.hpp>
 
 #include "redis_client.h"
+#include "redis_stream_consumer.h"
+#include "redis_subscriber.h"
 
 namespace chirp::network {
 
+/// @brief How batches travel between instances under instance routing.
+enum class InstanceTransport {
+  kPubSub,  // PUBLISH to chirp:instance:{<id>}; fire-and-forget, lost while the target is down
+  kStreams, // XADD to chirp:stream:instance:{<id>}, read by a consumer group; survives restarts
+};
+
+/// @brief Tuning for instance-addressed routing (MessageRouter::EnableInstanceRouting).
+struct InstanceRoutingOptions {
+  int location_ttl_seconds{90};              // lifetime of a user's location entry in Redis...
+  std::chrono::milliseconds location_refresh_interval{30000}; // ...renewed this often while they stay connected
+  std::chrono::milliseconds cache_ttl{5000}; // how long a looked-up location is trusted locally
+  size_t max_cached_locations{100000};       // the cache is dropped wholesale past this size
+  size_t max_batch_messages{256};            // a batch for one instance is published once this big
+  InstanceTransport transport{InstanceTransport::kPubSub};
+  size_t stream_max_len{100000};             // streams: approximate cap on each instance's stream
+  RedisStreamConsumerOptions stream;         // streams: how this instance reads its own stream
+  std::chrono::milliseconds orphan_scan_interval{30000}; // streams: how often to look for dead instances' streams
+};
+
 /// @brief Redis Pub/Sub message router.
 /// Routes messages between distributed service instances.
 class MessageRouter {
@@ -22,9 +45,19 @@ public:
   /// @brief Subscription callback type.
   using SubscribeCallback = std::function<void(const std::string& message)>;
 
+  /// @brief Instance routing: hands a message to a user connected here. False if they are not.
+  using DeliverCallback = std::function<bool(const std::string& user_id, const std::string& message)>;
+
+  /// @brief Instance routing: a message that reached no connected user (store it offline).
+  using UndeliveredCallback = std::function<void(const std::string& user_id, const std::string& message)>;
+
+  /// `redis_options` configure the client used for publishing and the location registry (set
+  /// `cluster` when redis_host:redis_port is a Redis Cluster seed node). Subscriptions and the
+  /// stream consumer always use redis_host:redis_port itself.
   MessageRouter(asio::io_context& io,
                 std::string redis_host,
-                uint16_t redis_port);
+                uint16_t redis_port,
+                RedisClientOptions redis_options = {});
   ~MessageRouter();
 
   /// @brief Start the router.
@@ -48,6 +81,12 @@ public:
   /// @brief Subscribe to a kick-notification channel.
   bool SubscribeKickNotification(const std::string& instance_id, SubscribeCallback cb);
 
+  /// @brief Subscribe to every channel matching a glob pattern (PSUBSCRIBE).
+  bool SubscribePattern(const std::string& pattern, MessageCallback cb);
+
+  /// @brief Unsubscribe from a pattern.
+  void UnsubscribePattern(const std::string& pattern);
+
   /// @brief Unsubscribe from a channel.
   void Unsubscribe(const std::string& channel);
 
@@ -57,42 +96,104 @@ public:
   /// @brief Broadcast a message to a group.
   bool BroadcastToGroup(const std::string& group_id, const std::string& message);
 
+  /// @brief Switch one-to-one delivery to instance-addressed routing. Call before Start().
+  ///
+  /// Instead of one channel per user, this instance subscribes to chirp:instance:{<instance_id>}
+  /// only. Users register where they are connected (RegisterLocalUser); senders resolve the
+  /// owning instance through a short-lived local cache in front of that registry and queue the
+  /// message for it. Messages queued for the same instance before the flush runs on the router's
+  /// io_context go out as one PUBLISH. Callbacks run on that io_context.
+  ///
+  /// With InstanceTransport::kStreams batches are appended to chirp:stream:instance:{<id>} instead
+  /// and read back through the consumer group "chirp-chat" (consumer name: the instance id), so
+  /// batches sent while the target was restarting are delivered once it is back, and a batch is
+  /// only acknowledged after it has been handed to the deliver / undelivered callbacks.
+  ///
+  /// Each streams instance lists itself in chirp:stream:instances and keeps a heartbeat key alive
+  /// on the location refresh cycle (same TTL). An instance that does not come back under its id
+  /// before the heartbeat expires has its stream adopted by a survivor (checked every
+  /// orphan_scan_interval): its pending and unread entries are re-routed message by message (the
+  /// users have usually reconnected elsewhere) or handed to the undelivered callback, and the
+  /// drained stream is deleted.
+  void EnableInstanceRouting(const std::string& instance_id,
+                             DeliverCallback on_deliver,
+                             UndeliveredCallback on_undelivered,
+                             InstanceRoutingOptions options = {});
+
+  /// @brief Instance routing: record that a user is connected to / has left this instance.
+  /// Entries of users still connected are renewed every location_refresh_interval, so they
+  /// only expire once this instance stops refreshing them (crash, network split).
+  void RegisterLocalUser(const std::string& user_id);
+  void UnregisterLocalUser(const std::string& user_id);
+
+  /// @brief Instance routing: deliver locally or queue for the instance the user is on. False
+  /// when the user is not online anywhere. Batches whose instance turns out to be gone are
+  /// handed to the undelivered callback.
+  bool RouteToUser(const std::string& user_id, const std::string& message);
+
   const std::string& RedisHost() const { return redis_host_; }
   uint16_t RedisPort() const { return redis_port_; }
 
 private:
   struct Impl;
-  std::unique_ptr<Impl> impl_;
+  // Shared so that Redis replies and posted handlers still outstanding when the router is
+  // destroyed can tell it is gone (they hold weak references).
+  std::shared_ptr<Impl> impl_;
 
   asio::io_context& io_;
   std::string redis_host_;
   uint16_t redis_port_;
 };
 
-/// @brief Channel naming helpers.
+/// @brief Channel and key naming helpers. The id is a Redis Cluster hash tag, so a user's
+/// location entry shares a slot with the rest of that user's keys.
 struct RouterChannels {
   static std::string UserChat(const std::string& user_id) {
-    return "chirp:chat:user:" + user_id;
+    return "chirp:chat:user:" + RedisHashTag(user_id);
   }
 
   static std::string GroupChat(const std::string& group_id) {
-    return "chirp:chat:group:" + group_id;
+    return "chirp:chat:group:" + RedisHashTag(group_id);
   }
 
   static std::string UserSocial(const std::string& user_id) {
-    return "chirp:social:user:" + user_id;
+    return "chirp:social:user:" + RedisHashTag(user_id);
   }
 
   static std::string UserPresence(const std::string& user_id) {
-    return "chirp:presence:user:" + user_id;
+    return "chirp:presence:user:" + RedisHashTag(user_id);
+  }
+
+  static std::string Instance(const std::string& instance_id) {
+    return "chirp:instance:" + RedisHashTag(instance_id);
+  }
+
+  static std::string InstanceStream(const std::string& instance_id) {
+    return "chirp:stream:instance:" + RedisHashTag(instance_id);
+  }
+
+  // Instances using the streams transport (a set of ids).
+  static std::string StreamInstances() { return "chirp:stream:instances"; }
+
+  static std::string InstanceHeartbeat(const std::string& instance_id) {
+    return "chirp:instance:alive:" + RedisHashTag(instance_id);
+  }
+
+  // Held by the instance draining a dead instance's stream.
+  static std::string InstanceStreamAdopter(const std::string& instance_id) {
+    return "chirp:stream:adopter:" + RedisHashTag(instance_id);
+  }
+
+  static std::string UserLocation(const std::string& user_id) {
+    return "chirp:chat:loc:" + RedisHashTag(user_id);
   }
 
   static std::string KickNotification(const std::string& instance_id) {
-    return "chirp:kick:instance:" + instance_id;
+    return "chirp:kick:instance:" + RedisHashTag(instance_id);
   }
 
   static std::string ServiceRegister(const std::string& service, const std::string& instance_id) {
-    return "chirp:service:" + service + ":" + instance_id;
+    return "chirp:service:" + service + ":" + RedisHashTag(instance_id);
   }
 };
 
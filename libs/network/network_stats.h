@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace chirp::network {
+
+// Process-wide counters for the session I/O paths. Relaxed atomics: these are for dashboards
+// and benchmarks, not for synchronization.
+struct NetworkStats {
+  // Write path: one write call may carry many queued frames (scatter/gather).
+  std::atomic<uint64_t> write_calls{0};
+  std::atomic<uint64_t> frames_written{0};
+  std::atomic<uint64_t> bytes_written{0};
+
+  // Backpressure: bytes sitting in session write queues right now, frames shed by the
+  // drop-oldest policy, and sessions closed for exceeding their high watermark.
+  std::atomic<uint64_t> queued_bytes{0};
+  std::atomic<uint64_t> frames_dropped{0};
+  std::atomic<uint64_t> slow_consumer_disconnects{0};
+
+  // Sessions closed because nothing was read from them within the idle timeout.
+  std::atomic<uint64_t> idle_timeouts{0};
+
+  // WebSocket upgrades: completed, answered with an HTTP error, and dropped for taking too long.
+  std::atomic<uint64_t> ws_handshakes{0};
+  std::atomic<uint64_t> ws_handshake_rejects{0};
+  std::atomic<uint64_t> ws_handshake_timeouts{0};
+
+  // permessage-deflate: bytes into/out of zlib and time spent there, per direction.
+  std::atomic<uint64_t> deflate_in_bytes{0};
+  std::atomic<uint64_t> deflate_out_bytes{0};
+  std::atomic<uint64_t> deflate_ns{0};
+  std::atomic<uint64_t> inflate_in_bytes{0};
+  std::atomic<uint64_t> inflate_out_bytes{0};
+  std::atomic<uint64_t> inflate_ns{0};
+
+  static NetworkStats& Instance() {
+    static NetworkStats stats;
+    return stats;
+  }
+
+  void RecordWrite(uint64_t frames, uint64_t bytes) {
+    write_calls.fetch_add(1, std::memory_order_relaxed);
+    frames_written.fetch_add(frames, std::memory_order_relaxed);
+    bytes_written.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  double FramesPerWrite() const {
+    const uint64_t calls = write_calls.load(std::memory_order_relaxed);
+    return calls == 0 ? 0.0 : static_cast<double>(frames_written.load(std::memory_order_relaxed)) / calls;
+  }
+
+  // Compressed size over original size for outgoing messages (1.0 when nothing was compressed).
+  double DeflateRatio() const {
+    const uint64_t in = deflate_in_bytes.load(std::memory_order_relaxed);
+    return in == 0 ? 1.0 : static_cast<double>(deflate_out_bytes.load(std::memory_order_relaxed)) / in;
+  }
+};
+
+} // namespace chirp::network
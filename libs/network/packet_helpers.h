@@ -1,7 +1,10 @@
 #pragma once
 
+#include <memory>
 #include <string>
+#include <vector>
 #include "session.h"
+#include "shared_frame.h"
 #include "protobuf_framing.h"
 #include "proto/gateway.pb.h"
 
@@ -42,4 +45,49 @@ inline void SendMessage(
   SendProtobufPacket(session, msg_id, sequence, message.SerializeAsString());
 }
 
+/// Encodes a gateway packet once into a frame that can be queued on many sessions
+/// @param msg_id The gateway message ID
+/// @param sequence The packet sequence number
+/// @param body The serialized protobuf body
+inline SharedFrame EncodePacketFrame(
+    gateway::MsgID msg_id,
+    int64_t sequence,
+    const std::string& body) {
+
+  gateway::Packet pkt;
+  pkt.set_msg_id(msg_id);
+  pkt.set_sequence(sequence);
+  pkt.set_body(body);
+  return SharedFrame(ProtobufFraming::EncodeToString(pkt));
+}
+
+/// Sends the same packet to every session, serializing and framing it only once
+/// @param sessions The recipients (null entries are skipped)
+/// @param msg_id The gateway message ID
+/// @param body The serialized protobuf body
+/// @param sequence The packet sequence number (0 for server pushes)
+/// @param droppable Presence/typing style traffic that slow consumers may miss (SendDroppable)
+inline void BroadcastPacket(
+    const std::vector<std::shared_ptr<Session>>& sessions,
+    gateway::MsgID msg_id,
+    const std::string& body,
+    int64_t sequence = 0,
+    bool droppable = false) {
+
+  if (sessions.empty()) {
+    return;
+  }
+  const SharedFrame frame = EncodePacketFrame(msg_id, sequence, body);
+  for (const auto& session : sessions) {
+    if (!session) {
+      continue;
+    }
+    if (droppable) {
+      session->SendDroppable(frame);
+    } else {
+      session->Send(frame);
+    }
+  }
+}
+
 } // namespace chirp::network
@@ -22,7 +22,23 @@ std::vector<uint8_t> ProtobufFraming::Encode(const google::protobuf::Message& ms
   return out;
 }
 
-bool ProtobufFraming::Decode(const std::string& payload, google::protobuf::Message* out) {
+std::string ProtobufFraming::EncodeToString(const google::protobuf::Message& msg) {
+  const size_t payload_size = msg.ByteSizeLong();
+  if (payload_size > static_cast<size_t>(std::numeric_limits<uint32_t>::max()) ||
+      payload_size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+    return {};
+  }
+
+  std::string out(4 + payload_size, '\0');
+  auto* data = reinterpret_cast<uint8_t*>(out.data());
+  WriteU32BE(data, static_cast<uint32_t>(payload_size));
+  if (!msg.SerializeToArray(data + 4, static_cast<int>(payload_size))) {
+    return {};
+  }
+  return out;
+}
+
+bool ProtobufFraming::Decode(std::string_view payload, google::protobuf::Message* out) {
   if (!out) {
     return false;
   }
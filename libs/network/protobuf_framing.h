@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <google/protobuf/message.h>
@@ -12,7 +13,9 @@ namespace chirp::network {
 class ProtobufFraming {
 public:
   static std::vector<uint8_t> Encode(const google::protobuf::Message& msg);
-  static bool Decode(const std::string& payload, google::protobuf::Message* out);
+  // Same wire format, serialized straight into a string (e.g. to build a SharedFrame).
+  static std::string EncodeToString(const google::protobuf::Message& msg);
+  static bool Decode(std::string_view payload, google::protobuf::Message* out);
 };
 
 } // namespace chirp::network
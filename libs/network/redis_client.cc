@@ -1,318 +1,662 @@
 #include "network/redis_client.h"
 
-#include <array>
 #include <atomic>
 #include <cstdint>
+#include <functional>
+#include <future>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <asio.hpp>
 
-#include "network/redis_protocol.h"
-#include "common/logger.h"
+#include "network/redis_reply.h"
 
 namespace chirp::network {
 namespace {
 
-std::optional<RedisResp> SendAndReadOne(asio::ip::tcp::socket& sock, const std::string& cmd) {
-  asio::write(sock, asio::buffer(cmd));
+// Redirects followed for one command before its last reply is handed back as is.
+constexpr int kMaxRedirects = 5;
+
+using RawReplies = RedisBatch::Replies;
+
+// Sends `count` encoded commands in one write and hands back every reply in order (nullopt if
+// the connection failed before all of them arrived). `cb` runs on the connection strand.
+void SendPipeline(RedisConnectionPool& pool, std::string wire, size_t count, std::function<void(RawReplies)> cb) {
+  // Every reply lands on the same connection strand, so this needs no locking.
+  struct Collector {
+    size_t expected{0};
+    size_t received{0};
+    bool failed{false};
+    std::vector<RedisReply> replies;
+    std::function<void(RawReplies)> cb;
+  };
+  auto state = std::make_shared<Collector>();
+  state->expected = count;
+  state->replies.reserve(count);
+  state->cb = std::move(cb);
+  pool.Execute(
+      std::move(wire),
+      [state](std::optional<RedisReply> r) {
+        if (r) {
+          state->replies.push_back(std::move(*r));
+        } else {
+          state->failed = true;
+        }
+        if (++state->received < state->expected) {
+          return;
+        }
+        state->cb(state->failed ? std::nullopt : RawReplies(std::move(state->replies)));
+      },
+      count);
+}
 
-  RedisRespParser parser;
-  std::array<uint8_t, 4096> buf{};
-  while (true) {
-    auto v = parser.Pop();
-    if (v) {
-      return v;
-    }
-    asio::error_code ec;
-    const size_t n = sock.read_some(asio::buffer(buf), ec);
-    if (ec) {
-      return std::nullopt;
-    }
-    parser.Append(buf.data(), n);
-  }
+std::string WrapTransaction(std::string_view commands) {
+  std::string wire;
+  wire.reserve(commands.size() + 32);
+  wire += BuildRedisCommand({"MULTI"});
+  wire += commands;
+  wire += BuildRedisCommand({"EXEC"});
+  return wire;
 }
 
-std::optional<RedisResp> SendCmd(const std::string& host, uint16_t port, const std::vector<std::string>& args) {
-  try {
-    asio::io_context io;
-    asio::ip::tcp::resolver resolver(io);
-    asio::ip::tcp::socket sock(io);
-    auto endpoints = resolver.resolve(host, std::to_string(port));
-    asio::connect(sock, endpoints);
-    const std::string cmd = BuildRedisCommand(args);
-    return SendAndReadOne(sock, cmd);
-  } catch (...) {
+// MULTI's +OK and the +QUEUED acks are dropped; EXEC carries the real replies. nullopt when the
+// transaction was aborted.
+RawReplies TransactionResults(const std::vector<RedisReply>& raw) {
+  const RedisReply& exec = raw.back();
+  if (exec.type != RedisReply::Type::kArray) {
     return std::nullopt;
   }
+  std::vector<RedisReply> results;
+  results.reserve(exec.elements.size());
+  for (size_t i = 0; i < exec.elements.size(); ++i) {
+    results.push_back(exec.Element(i));
+  }
+  return results;
+}
+
+// Commands that never modify their first key; any other command drops that key from the near cache.
+bool IsReadOnly(const std::string& cmd) {
+  static const std::unordered_set<std::string_view> kReadOnly = {
+      "GET",   "MGET",      "EXISTS",  "TTL",       "PTTL",      "TYPE",    "STRLEN",        "GETRANGE",
+      "LRANGE", "LLEN",     "LINDEX",  "HGET",      "HMGET",     "HGETALL", "HLEN",          "HEXISTS",
+      "HSCAN", "SMEMBERS",  "SISMEMBER", "SCARD",   "SSCAN",     "ZRANGE",  "ZRANGEBYSCORE", "ZREVRANGE",
+      "ZREVRANGEBYSCORE", "ZSCORE", "ZCARD", "ZSCAN", "XRANGE",  "XREVRANGE", "XLEN",        "PUBLISH",
+      "EVAL_RO", "EVALSHA_RO"};
+  return kReadOnly.count(cmd) > 0;
 }
 
 } // namespace
 
-RedisClient::RedisClient(std::string host, uint16_t port) : host_(std::move(host)), port_(port) {}
+RedisClient::RedisClient(std::string host, uint16_t port, RedisClientOptions options)
+    : host_(std::move(host)),
+      port_(port),
+      options_(options),
+      work_(asio::make_work_guard(io_)),
+      pool_(std::make_unique<RedisConnectionPool>(io_.get_executor(), host_, port_, options_.pool_size,
+                                                  options_.timeout)) {
+  if (options_.near_cache_bytes > 0 && !options_.cluster) {
+    near_cache_ = std::make_unique<RedisNearCache>(options_.near_cache_bytes);
+    tracking_ = std::make_shared<RedisConnection>(io_.get_executor(), host_, port_);
+    tracking_->SetReplyTimeout(options_.timeout);
+    tracking_->SetPushCallback([this](const RedisReply& push) { OnTrackingPush(push); });
+    // HELLO 3 answers with a map and CLIENT TRACKING with +OK; the cache only fills once both
+    // succeeded on the current socket.
+    tracking_->SetHandshake(BuildRedisCommand({"HELLO", "3"}) + BuildRedisCommand({"CLIENT", "TRACKING", "ON"}), 2,
+                            [this](std::optional<RedisReply> r) {
+                              if (r && r->type == RedisReply::Type::kMap) {
+                                tracking_resp3_ = true;
+                              } else if (r && r->type == RedisReply::Type::kSimpleString && r->str == "OK") {
+                                tracking_on_.store(tracking_resp3_);
+                              } else {
+                                tracking_resp3_ = false;
+                                tracking_on_.store(false);
+                              }
+                            });
+    tracking_->SetDisconnectCallback([this] {
+      // Invalidations sent while we were away are lost.
+      tracking_resp3_ = false;
+      tracking_on_.store(false);
+      near_cache_->Clear();
+    });
+  }
+  th_ = std::thread([this] { io_.run(); });
+  if (options_.cluster) {
+    RefreshSlots();
+  }
+}
 
-std::optional<std::string> RedisClient::Get(const std::string& key) {
-  auto r = SendCmd(host_, port_, {"GET", key});
-  if (!r) {
-    return std::nullopt;
+RedisClient::~RedisClient() {
+  stopping_.store(true);
+  pool_->Close(); // fails anything still in flight
+  if (tracking_) {
+    tracking_->Close();
   }
-  if (r->type == RedisResp::Type::kBulkString) {
-    return r->str;
+  {
+    std::lock_guard<std::mutex> lock(pools_mu_);
+    for (auto& [name, pool] : node_pools_) {
+      pool->Close();
+    }
   }
-  if (r->type == RedisResp::Type::kNull) {
-    return std::nullopt;
+  work_.reset();
+  if (th_.joinable()) {
+    th_.join();
   }
-  return std::nullopt;
 }
 
-bool RedisClient::SetEx(const std::string& key, const std::string& value, int ttl_seconds) {
-  auto r = SendCmd(host_, port_, {"SET", key, value, "EX", std::to_string(ttl_seconds)});
-  return r && r->type == RedisResp::Type::kSimpleString && r->str == "OK";
+void RedisClient::ExecuteAsync(const std::vector<std::string>& args, ReplyCallback cb) {
+  if (stopping_.load()) {
+    if (cb) {
+      cb(std::nullopt);
+    }
+    return;
+  }
+  if (options_.cluster) {
+    SendRouted(std::make_shared<const std::string>(BuildRedisCommand(args)), RedisCommandSlot(args), std::nullopt,
+               false, std::move(cb), kMaxRedirects);
+    return;
+  }
+  InvalidateNearCache(args);
+  pool_->Execute(BuildRedisCommand(args), std::move(cb));
 }
 
-bool RedisClient::Del(const std::string& key) {
-  auto r = SendCmd(host_, port_, {"DEL", key});
-  return r && r->type == RedisResp::Type::kInteger;
+void RedisClient::InvalidateNearCache(const std::vector<std::string>& args) {
+  if (!near_cache_ || args.empty() || IsReadOnly(args[0])) {
+    return;
+  }
+  for (const std::string* key : RedisCommandKeys(args)) {
+    near_cache_->Invalidate(*key);
+  }
 }
 
-bool RedisClient::Publish(const std::string& channel, const std::string& message) {
-  auto r = SendCmd(host_, port_, {"PUBLISH", channel, message});
-  return r && r->type == RedisResp::Type::kInteger;
+// RESP3: >2 "invalidate" [key...], or a null key list when the server flushed its keyspace.
+void RedisClient::OnTrackingPush(const RedisReply& push) {
+  if (push.elements.size() != 2 || push.elements[0].str != "invalidate") {
+    return;
+  }
+  const RedisNode& keys = push.elements[1];
+  if (keys.type == RedisReply::Type::kNull) {
+    near_cache_->Clear();
+    return;
+  }
+  for (const auto& key : keys.elements) {
+    near_cache_->Invalidate(key.str);
+  }
 }
 
-bool RedisClient::RPush(const std::string& key, const std::string& value) {
-  auto r = SendCmd(host_, port_, {"RPUSH", key, value});
-  return r && r->type == RedisResp::Type::kInteger;
+RedisNearCacheStats RedisClient::NearCacheStats() const {
+  return near_cache_ ? near_cache_->Stats() : RedisNearCacheStats{};
 }
 
-bool RedisClient::Expire(const std::string& key, int ttl_seconds) {
-  auto r = SendCmd(host_, port_, {"EXPIRE", key, std::to_string(ttl_seconds)});
-  return r && r->type == RedisResp::Type::kInteger && r->integer > 0;
+template <typename Send>
+std::optional<RedisReply> RedisClient::Wait(Send send) {
+  auto done = std::make_shared<std::promise<std::optional<RedisReply>>>();
+  auto result = done->get_future();
+  send([done](std::optional<RedisReply> r) { done->set_value(std::move(r)); });
+  if (result.wait_for(options_.timeout) != std::future_status::ready) {
+    return std::nullopt; // the reply is still owed and will be discarded when it arrives
+  }
+  return result.get();
 }
 
-std::vector<std::string> RedisClient::LRange(const std::string& key, int64_t start, int64_t stop) {
-  std::vector<std::string> out;
-  auto r = SendCmd(host_, port_, {"LRANGE", key, std::to_string(start), std::to_string(stop)});
-  if (!r || r->type != RedisResp::Type::kArray) {
-    return out;
-  }
-  out.reserve(r->array.size());
-  for (const auto& e : r->array) {
-    if (e.type == RedisResp::Type::kBulkString || e.type == RedisResp::Type::kSimpleString) {
-      out.push_back(e.str);
+std::optional<RedisReply> RedisClient::Execute(const std::vector<std::string>& args) {
+  return Wait([&](ReplyCallback cb) { ExecuteAsync(args, std::move(cb)); });
+}
+
+std::optional<RedisReply> RedisClient::ExecuteOn(const RedisNodeAddress& node, const std::vector<std::string>& args) {
+  return Wait([&](ReplyCallback cb) {
+    if (stopping_.load()) {
+      cb(std::nullopt);
+      return;
+    }
+    NodePool(node).Execute(BuildRedisCommand(args), std::move(cb));
+  });
+}
+
+void RedisClient::SendRouted(std::shared_ptr<const std::string> wire, std::optional<uint16_t> slot,
+                             std::optional<RedisNodeAddress> node, bool asking, ReplyCallback cb, int hops) {
+  if (stopping_.load()) {
+    if (cb) {
+      cb(std::nullopt);
     }
+    return;
   }
-  return out;
+  RedisConnectionPool& pool = node ? NodePool(*node) : PoolFor(slot);
+  std::string bytes = asking ? BuildRedisCommand({"ASKING"}) + *wire : *wire;
+  // ASK grants access for the next command only, so ASKING travels in the same write.
+  auto skip = std::make_shared<bool>(asking);
+  pool.Execute(
+      std::move(bytes),
+      [this, wire, slot, skip, cb = std::move(cb), hops](std::optional<RedisReply> r) mutable {
+        if (*skip) {
+          *skip = false; // ASKING's +OK
+          return;
+        }
+        if (r && hops > 0) {
+          if (auto redirect = ParseRedisRedirect(*r)) {
+            if (redirect->node.host.empty()) {
+              redirect->node.host = host_;
+            }
+            if (!redirect->ask) {
+              slots_.Assign(redirect->slot, redirect->node);
+              RefreshSlots(); // one slot moved; others likely did too
+            }
+            SendRouted(wire, slot, redirect->node, redirect->ask, std::move(cb), hops - 1);
+            return;
+          }
+        }
+        if (cb) {
+          cb(std::move(r));
+        }
+      },
+      asking ? 2 : 1);
 }
 
-std::vector<std::string> RedisClient::Keys(const std::string& pattern) {
-  std::vector<std::string> out;
-  auto r = SendCmd(host_, port_, {"KEYS", pattern});
-  if (!r || r->type != RedisResp::Type::kArray) {
-    return out;
-  }
-  out.reserve(r->array.size());
-  for (const auto& e : r->array) {
-    if (e.type == RedisResp::Type::kBulkString || e.type == RedisResp::Type::kSimpleString) {
-      out.push_back(e.str);
+RedisConnectionPool& RedisClient::PoolFor(std::optional<uint16_t> slot) {
+  if (slot) {
+    if (auto node = slots_.NodeFor(*slot)) {
+      return NodePool(*node);
     }
   }
-  return out;
+  return *pool_; // keyless commands, and slots not known yet (the seed redirects them)
 }
 
-// ============================================================================
-// RedisSubscriber - Enhanced version with multi-channel support
-// ============================================================================
+RedisConnectionPool& RedisClient::NodePool(const RedisNodeAddress& node) {
+  if (node.port == port_ && node.host == host_) {
+    return *pool_;
+  }
+  std::lock_guard<std::mutex> lock(pools_mu_);
+  auto& pool = node_pools_[node.ToString()];
+  if (!pool) {
+    pool = std::make_unique<RedisConnectionPool>(io_.get_executor(), node.host, node.port, options_.pool_size,
+                                                 options_.timeout);
+    if (stopping_.load()) {
+      pool->Close(); // created after the destructor closed the others
+    }
+  }
+  return *pool;
+}
 
-namespace {
+void RedisClient::RefreshSlots() {
+  if (stopping_.load() || refreshing_.exchange(true)) {
+    return;
+  }
+  pool_->Execute(BuildRedisCommand({"CLUSTER", "SLOTS"}), [this](std::optional<RedisReply> r) {
+    if (r) {
+      slots_.Load(*r, host_);
+    }
+    refreshing_.store(false);
+  });
+}
+
+std::vector<RedisNodeAddress> RedisClient::ClusterMasters() {
+  auto masters = slots_.Masters();
+  if (masters.empty()) {
+    // The background load has not landed yet.
+    if (auto r = ExecuteOn({host_, port_}, {"CLUSTER", "SLOTS"})) {
+      slots_.Load(*r, host_);
+    }
+    masters = slots_.Masters();
+  }
+  if (masters.empty()) {
+    masters.push_back({host_, port_});
+  }
+  return masters;
+}
 
-class SubscribeParser {
-public:
-  void Append(const char* data, size_t size) {
-    buffer_.append(data, size);
-    Process();
+void RedisClient::ExecuteClusterBatch(const RedisBatch& batch, RedisBatch::Callback cb) {
+  // Groups: by slot for transactions (MULTI/EXEC cannot span slots), by node for pipelines.
+  // Keyless commands (e.g. SCRIPT LOAD) travel with the batch's first keyed command.
+  struct Group {
+    std::optional<uint16_t> slot;
+    std::string wire;
+    std::vector<size_t> index;
+  };
+  std::optional<uint16_t> first_slot;
+  for (const auto& slot : batch.slots_) {
+    if (slot) {
+      first_slot = slot;
+      break;
+    }
+  }
+  std::vector<Group> groups;
+  std::unordered_map<std::string, size_t> group_of;
+  auto wire = std::make_shared<const std::string>(batch.wire_);
+  auto ends = std::make_shared<const std::vector<size_t>>(batch.ends_);
+  auto command = [wire, ends](size_t i) {
+    const size_t begin = i == 0 ? 0 : (*ends)[i - 1];
+    return std::string_view(*wire).substr(begin, (*ends)[i] - begin);
+  };
+  for (size_t i = 0; i < batch.count_; ++i) {
+    const auto slot = batch.slots_[i] ? batch.slots_[i] : first_slot;
+    std::string name;
+    if (batch.transaction_) {
+      name = slot ? std::to_string(*slot) : std::string();
+    } else {
+      const auto node = slot ? slots_.NodeFor(*slot) : std::nullopt;
+      name = node ? node->ToString() : std::string();
+    }
+    auto [it, added] = group_of.emplace(name, groups.size());
+    if (added) {
+      groups.push_back(Group{slot, {}, {}});
+    }
+    groups[it->second].wire += command(i);
+    groups[it->second].index.push_back(i);
   }
 
-  void Process() {
-    while (!buffer_.empty()) {
-      // Find \r\n
-      size_t pos = buffer_.find("\r\n");
-      if (pos == std::string::npos) {
-        return;  // Incomplete line
+  // Groups complete on different connection strands.
+  struct State {
+    std::mutex mu;
+    size_t remaining{0};
+    bool failed{false};
+    std::vector<RedisReply> replies;
+    RedisBatch::Callback cb;
+  };
+  auto state = std::make_shared<State>();
+  state->remaining = groups.size();
+  state->replies.resize(batch.count_);
+  state->cb = std::move(cb);
+  auto finish = [state](bool failed) {
+    std::unique_lock<std::mutex> lock(state->mu);
+    state->failed = state->failed || failed;
+    if (--state->remaining > 0) {
+      return;
+    }
+    lock.unlock();
+    if (state->cb) {
+      state->cb(state->failed ? std::nullopt : RawReplies(std::move(state->replies)));
+    }
+  };
+  auto place = [state](size_t i, RedisReply r) {
+    std::lock_guard<std::mutex> lock(state->mu);
+    state->replies[i] = std::move(r);
+  };
+
+  const bool transaction = batch.transaction_;
+  for (auto& group : groups) {
+    auto g = std::make_shared<const Group>(std::move(group));
+    // Sends the group to `node` (or its slot's master); a transaction aborted by MOVED is resent
+    // whole to the new owner, a pipelined command answered by a redirect is resent on its own.
+    auto send = std::make_shared<std::function<void(std::optional<RedisNodeAddress>, int)>>();
+    *send = [this, g, transaction, command, finish, place, weak = std::weak_ptr(send)](
+                std::optional<RedisNodeAddress> node, int hops) {
+      if (stopping_.load()) {
+        finish(true);
+        return;
       }
+      RedisConnectionPool& pool = node ? NodePool(*node) : PoolFor(g->slot);
+      const size_t count = g->index.size() + (transaction ? 2 : 0);
+      SendPipeline(pool, transaction ? WrapTransaction(g->wire) : g->wire, count,
+                   [this, g, transaction, command, finish, place, send = weak.lock(), hops](RawReplies raw) {
+                     if (!raw) {
+                       finish(true);
+                       return;
+                     }
+                     if (transaction) {
+                       auto results = TransactionResults(*raw);
+                       if (!results) {
+                         for (const auto& r : *raw) {
+                           auto redirect = ParseRedisRedirect(r);
+                           if (redirect && !redirect->ask && hops > 0) {
+                             if (redirect->node.host.empty()) {
+                               redirect->node.host = host_;
+                             }
+                             slots_.Assign(redirect->slot, redirect->node);
+                             RefreshSlots();
+                             (*send)(redirect->node, hops - 1);
+                             return;
+                           }
+                         }
+                         finish(true);
+                         return;
+                       }
+                       for (size_t j = 0; j < g->index.size() && j < results->size(); ++j) {
+                         place(g->index[j], std::move((*results)[j]));
+                       }
+                       finish(false);
+                       return;
+                     }
+                     // One more completion owed per command that has to be resent.
+                     std::vector<size_t> resend;
+                     for (size_t j = 0; j < raw->size(); ++j) {
+                       if (hops > 0 && ParseRedisRedirect((*raw)[j])) {
+                         resend.push_back(j);
+                       } else {
+                         place(g->index[j], std::move((*raw)[j]));
+                       }
+                     }
+                     if (resend.empty()) {
+                       finish(false);
+                       return;
+                     }
+                     auto left = std::make_shared<std::atomic<size_t>>(resend.size());
+                     auto failed = std::make_shared<std::atomic<bool>>(false);
+                     for (size_t j : resend) {
+                       auto redirect = ParseRedisRedirect((*raw)[j]);
+                       if (redirect->node.host.empty()) {
+                         redirect->node.host = host_;
+                       }
+                       if (!redirect->ask) {
+                         slots_.Assign(redirect->slot, redirect->node);
+                         RefreshSlots();
+                       }
+                       const size_t i = g->index[j];
+                       SendRouted(std::make_shared<const std::string>(command(i)), redirect->slot, redirect->node,
+                                  redirect->ask,
+                                  [i, left, failed, finish, place](std::optional<RedisReply> r) {
+                                    if (r) {
+                                      place(i, std::move(*r));
+                                    } else {
+                                      failed->store(true);
+                                    }
+                                    if (left->fetch_sub(1) == 1) {
+                                      finish(failed->load());
+                                    }
+                                  },
+                                  hops - 1);
+                     }
+                   });
+    };
+    (*send)(std::nullopt, kMaxRedirects);
+  }
+}
 
-      std::string line = buffer_.substr(0, pos);
-      buffer_.erase(0, pos + 2);
+RedisBatch::RedisBatch(RedisClient* client, bool transaction) : client_(client), transaction_(transaction) {}
 
-      if (line.empty() || line[0] != '$') {
-        continue;
-      }
+RedisBatch& RedisBatch::Add(const std::vector<std::string>& args) {
+  client_->InvalidateNearCache(args);
+  wire_ += BuildRedisCommand(args);
+  ++count_;
+  if (client_->options_.cluster) {
+    ends_.push_back(wire_.size());
+    slots_.push_back(RedisCommandSlot(args));
+  }
+  return *this;
+}
 
-      // Parse bulk string size: $<size>\r\n<data>\r\n
-      size_t size;
-      try {
-        size = std::stoul(line.substr(1));
-      } catch (...) {
-        continue;
-      }
+void RedisBatch::ExecuteAsync(Callback cb) const {
+  if (count_ == 0 || client_->stopping_.load()) {
+    if (cb) {
+      cb(count_ == 0 ? Replies(std::vector<RedisReply>{}) : std::nullopt);
+    }
+    return;
+  }
+  if (client_->options_.cluster) {
+    client_->ExecuteClusterBatch(*this, std::move(cb));
+    return;
+  }
 
-      if (size == static_cast<size_t>(-1)) {
-        // Null bulk string
-        current_array_.emplace_back();
-        current_array_.back().type = RedisResp::Type::kNull;
-        continue;
-      }
+  const bool transaction = transaction_;
+  SendPipeline(*client_->pool_, transaction ? WrapTransaction(wire_) : wire_, transaction ? count_ + 2 : count_,
+               [transaction, cb = std::move(cb)](RawReplies raw) {
+                 if (!cb) {
+                   return;
+                 }
+                 if (!raw || !transaction) {
+                   cb(std::move(raw));
+                 } else {
+                   cb(TransactionResults(*raw));
+                 }
+               });
+}
 
-      // Read the data
-      if (buffer_.size() < size + 2) {
-        return;  // Incomplete data
-      }
+RedisBatch::Replies RedisBatch::Execute() const {
+  auto done = std::make_shared<std::promise<Replies>>();
+  auto result = done->get_future();
+  ExecuteAsync([done](Replies r) { done->set_value(std::move(r)); });
+  if (result.wait_for(client_->options_.timeout) != std::future_status::ready) {
+    return std::nullopt;
+  }
+  return result.get();
+}
 
-      std::string data = buffer_.substr(0, size);
-      buffer_.erase(0, size + 2);  // +2 for \r\n
-
-      RedisResp resp;
-      resp.type = RedisResp::Type::kBulkString;
-      resp.str = data;
-      current_array_.push_back(resp);
-
-      // Subscribe messages come in arrays of 3: ["message", "channel", "payload"]
-      if (current_array_.size() == 3) {
-        // We have a complete subscribe message
-        if (current_array_[0].type == RedisResp::Type::kBulkString &&
-            current_array_[0].str == "message") {
-          // Valid subscribe message
-          pending_messages_.push_back({
-            current_array_[1].str,  // channel
-            current_array_[2].str   // payload
-          });
-        }
-        current_array_.clear();
-      }
+std::optional<std::string> RedisClient::Get(const std::string& key) {
+  std::optional<RedisReply> r;
+  if (near_cache_) {
+    uint64_t token = 0;
+    if (auto hit = near_cache_->Lookup(key, &token)) {
+      return *hit;
     }
+    r = Wait([&](ReplyCallback cb) {
+      tracking_->Execute(BuildRedisCommand({"GET", key}), [this, key, token, cb](std::optional<RedisReply> reply) {
+        // Runs on the tracking connection's strand, so it lands before any later invalidation.
+        if (reply && tracking_on_.load() &&
+            (reply->type == RedisReply::Type::kBulkString || reply->type == RedisReply::Type::kNull)) {
+          near_cache_->Fill(key, token,
+                            reply->type == RedisReply::Type::kNull ? std::nullopt
+                                                                   : std::optional<std::string>(reply->str));
+        } else {
+          near_cache_->Cancel(key, token);
+        }
+        cb(std::move(reply));
+      });
+    });
+  } else {
+    r = Execute({"GET", key});
   }
-
-  std::vector<std::pair<std::string, std::string>> PopMessages() {
-    std::vector<std::pair<std::string, std::string>> result;
-    result.swap(pending_messages_);
-    return result;
+  if (!r) {
+    return std::nullopt;
+  }
+  if (r->type == RedisReply::Type::kBulkString) {
+    return std::string(r->str);
   }
+  if (r->type == RedisReply::Type::kNull) {
+    return std::nullopt;
+  }
+  return std::nullopt;
+}
 
-private:
-  std::string buffer_;
-  std::vector<RedisResp> current_array_;
-  std::vector<std::pair<std::string, std::string>> pending_messages_;
-};
+bool RedisClient::SetEx(const std::string& key, const std::string& value, int ttl_seconds) {
+  auto r = Execute({"SET", key, value, "EX", std::to_string(ttl_seconds)});
+  return r && r->type == RedisReply::Type::kSimpleString && r->str == "OK";
+}
 
-}  // namespace
+bool RedisClient::Del(const std::string& key) {
+  auto r = Execute({"DEL", key});
+  return r && r->type == RedisReply::Type::kInteger;
+}
 
-RedisSubscriber::RedisSubscriber(std::string host, uint16_t port)
-    : host_(std::move(host)),
-      port_(port),
-      io_(std::make_unique<asio::io_context>()),
-      socket_(std::make_unique<asio::ip::tcp::socket>(*io_)) {
-  socket_ptr_ = socket_.get();
+bool RedisClient::Publish(const std::string& channel, const std::string& message) {
+  auto r = Execute({"PUBLISH", channel, message});
+  return r && r->type == RedisReply::Type::kInteger;
 }
 
-RedisSubscriber::~RedisSubscriber() {
-  Stop();
+bool RedisClient::RPush(const std::string& key, const std::string& value) {
+  auto r = Execute({"RPUSH", key, value});
+  return r && r->type == RedisReply::Type::kInteger;
 }
 
-bool RedisSubscriber::Subscribe(const std::string& channel) {
-  std::string cmd = BuildRedisCommand({"SUBSCRIBE", channel});
-  return SendCommand(cmd);
+bool RedisClient::Expire(const std::string& key, int ttl_seconds) {
+  auto r = Execute({"EXPIRE", key, std::to_string(ttl_seconds)});
+  return r && r->type == RedisReply::Type::kInteger && r->integer > 0;
 }
 
-bool RedisSubscriber::Unsubscribe(const std::string& channel) {
-  std::string cmd = BuildRedisCommand({"UNSUBSCRIBE", channel});
-  return SendCommand(cmd);
+std::vector<std::string> RedisClient::LRange(const std::string& key, int64_t start, int64_t stop) {
+  auto r = LRangeReply(key, start, stop);
+  return r ? RedisStringArray(*r) : std::vector<std::string>{};
 }
 
-bool RedisSubscriber::SendCommand(const std::string& cmd) {
-  std::lock_guard<std::mutex> lock(sock_mu_);
-  if (!socket_ || !socket_->is_open()) {
-    return false;
+std::optional<RedisReply> RedisClient::LRangeReply(const std::string& key, int64_t start, int64_t stop) {
+  auto r = Execute({"LRANGE", key, std::to_string(start), std::to_string(stop)});
+  if (!r || r->type != RedisReply::Type::kArray) {
+    return std::nullopt;
   }
-  try {
-    asio::write(*socket_, asio::buffer(cmd));
-    return true;
-  } catch (const std::exception& e) {
-    if (error_cb_) {
-      error_cb_(std::string("SendCommand failed: ") + e.what());
-    }
-    return false;
+  return r;
+}
+
+std::optional<RedisReply> RedisClient::ZRevRangeByScoreReply(const std::string& key, const std::string& max,
+                                                           const std::string& min, int64_t offset, int64_t count) {
+  auto r = Execute({"ZREVRANGEBYSCORE", key, max, min, "LIMIT", std::to_string(offset), std::to_string(count)});
+  if (!r || r->type != RedisReply::Type::kArray) {
+    return std::nullopt;
   }
+  return r;
 }
 
-void RedisSubscriber::Start() {
-  Stop();
-  stop_.store(false);
-  connected_.store(false);
-  th_ = std::thread([this] { Run(); });
+std::vector<std::string> RedisClient::Keys(const std::string& pattern) {
+  auto r = Execute({"KEYS", pattern});
+  return r ? RedisStringArray(*r) : std::vector<std::string>{};
 }
 
-void RedisSubscriber::Stop() {
-  stop_.store(true);
-  {
-    std::lock_guard<std::mutex> lock(sock_mu_);
-    if (socket_ && socket_->is_open()) {
-      asio::error_code ec;
-      socket_->close(ec);
-    }
-  }
-  if (io_) {
-    io_->stop();
-  }
-  if (th_.joinable()) {
-    th_.join();
+RedisScanner RedisClient::Scan(const std::string& pattern, size_t count) {
+  RedisScanner scanner(this, {"SCAN"}, pattern, count);
+  if (options_.cluster) {
+    scanner.nodes_ = ClusterMasters();
   }
+  return scanner;
 }
 
-void RedisSubscriber::Run() {
-  using chirp::common::Logger;
-
-  try {
-    asio::ip::tcp::resolver resolver(*io_);
-    auto endpoints = resolver.resolve(host_, std::to_string(port_));
-    asio::connect(*socket_, endpoints);
-
-    connected_.store(true);
-    if (connect_cb_) {
-      connect_cb_();
-    }
-
-    SubscribeParser parser;
-    std::array<uint8_t, 8192> buf{};
+RedisScanner RedisClient::HScan(const std::string& key, const std::string& pattern, size_t count) {
+  return RedisScanner(this, {"HSCAN", key}, pattern, count);
+}
 
-    while (!stop_.load()) {
-      asio::error_code ec;
-      const size_t n = socket_->read_some(asio::buffer(buf), ec);
+RedisScanner RedisClient::SScan(const std::string& key, const std::string& pattern, size_t count) {
+  return RedisScanner(this, {"SSCAN", key}, pattern, count);
+}
 
-      if (ec) {
-        if (error_cb_ && ec != asio::error::eof) {
-          error_cb_("Read error: " + ec.message());
-        }
-        break;
-      }
+RedisScanner RedisClient::ZScan(const std::string& key, const std::string& pattern, size_t count) {
+  return RedisScanner(this, {"ZSCAN", key}, pattern, count);
+}
 
-      parser.Append(reinterpret_cast<const char*>(buf.data()), n);
+RedisScanner::RedisScanner(RedisClient* client, std::vector<std::string> command, std::string pattern, size_t count)
+    : client_(client),
+      command_(std::move(command)),
+      pattern_(std::move(pattern)),
+      count_(std::to_string(count > 0 ? count : 1)) {}
 
-      // Process all pending messages
-      auto messages = parser.PopMessages();
-      for (const auto& [channel, payload] : messages) {
-        if (msg_cb_) {
-          msg_cb_(channel, payload);
-        }
-      }
-    }
-  } catch (const std::exception& e) {
-    if (error_cb_) {
-      error_cb_(std::string("Subscriber exception: ") + e.what());
+bool RedisScanner::Next(std::vector<std::string>* batch) {
+  batch->clear();
+  if (done_) {
+    return false;
+  }
+  // The cursor comes back as "0" when the iteration is complete; the first call also sends "0".
+  if (started_ && cursor_ == "0") {
+    if (node_ + 1 >= nodes_.size()) {
+      done_ = true;
+      return false;
     }
+    ++node_; // cluster: on to the next master's keys
   }
-
-  connected_.store(false);
+  started_ = true;
+
+  std::vector<std::string> args = command_;
+  args.push_back(cursor_);
+  args.insert(args.end(), {"MATCH", pattern_, "COUNT", count_});
+  auto r = nodes_.empty() ? client_->Execute(args) : client_->ExecuteOn(nodes_[node_], args);
+  // Reply: [next cursor, [elements...]]
+  if (!r || r->type != RedisReply::Type::kArray || r->elements.size() != 2 ||
+      r->elements[0].type != RedisReply::Type::kBulkString) {
+    done_ = true;
+    failed_ = true;
+    return false;
+  }
+  cursor_ = std::string(r->elements[0].str);
+  *batch = RedisStringArray(r->elements[1]);
+  return true;
 }
 
 } // namespace chirp::network
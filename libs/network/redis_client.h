@@ -1,6 +1,7 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <memory>
@@ -12,12 +13,133 @@
 #include <unordered_map>
 #include <asio.hpp>
 
+#include "network/redis_cluster.h"
+#include "network/redis_connection.h"
+#include "network/redis_near_cache.h"
+#include "network/redis_reply.h"
+
 namespace chirp::network {
 
-/// @brief Synchronous Redis client for command operations.
+struct RedisClientOptions {
+  size_t pool_size{2};                      // persistent connections to the server (per node in a cluster)
+  std::chrono::milliseconds timeout{2000};  // how long the blocking calls wait for a reply
+  bool cluster{false};                      // host:port is a seed node of a Redis Cluster
+  // > 0: Get() results are kept in a local cache of this many bytes, invalidated through RESP3
+  // client tracking (Redis 6+). Ignored in cluster mode.
+  size_t near_cache_bytes{0};
+};
+
+class RedisClient;
+
+/// @brief Several commands sent to Redis in one write, answered in one round trip.
+///
+/// Built with RedisClient::Batch() (pipelined: each command runs on its own, replies in order)
+/// or RedisClient::Transaction() (wrapped in MULTI/EXEC: all or nothing, nothing interleaved).
+///
+/// Against a cluster the commands are split by node (pipelines) or by hash slot (transactions),
+/// sent concurrently and the replies put back in order; a transaction is then only atomic per
+/// slot, so keys that must change together need a common hash tag.
+///
+///   auto replies = redis->Transaction().Add({"LRANGE", key, "0", "-1"}).Add({"DEL", key}).Execute();
+class RedisBatch {
+public:
+  // One reply per command added, in order. nullopt on connection failure or timeout, and for a
+  // transaction that was aborted (EXECABORT, WATCH); individual Redis errors come back as kError.
+  using Replies = std::optional<std::vector<RedisReply>>;
+  using Callback = std::function<void(Replies)>;
+
+  RedisBatch& Add(const std::vector<std::string>& args);
+
+  size_t Size() const { return count_; }
+  bool Empty() const { return count_ == 0; }
+
+  // Blocks like RedisClient::Execute().
+  Replies Execute() const;
+  // Completes on the client's I/O thread.
+  void ExecuteAsync(Callback cb) const;
+
+private:
+  friend class RedisClient;
+  RedisBatch(RedisClient* client, bool transaction);
+
+  RedisClient* client_;
+  bool transaction_;
+  std::string wire_; // encoded commands, MULTI/EXEC excluded
+  size_t count_{0};
+  // Cluster mode only: where each command ends in wire_, and the slot of its first key.
+  std::vector<size_t> ends_;
+  std::vector<std::optional<uint16_t>> slots_;
+};
+
+/// @brief Incremental SCAN/HSCAN/SSCAN/ZSCAN iteration.
+///
+/// Each Next() is one cursor step, so the server only ever does O(count) work per call instead
+/// of walking the whole keyspace like KEYS. As with SCAN itself, an element may be returned more
+/// than once, and elements added or removed during the iteration may or may not be seen. Against
+/// a cluster Scan() walks every master in turn.
+///
+///   auto it = redis->Scan("chirp:chat:history:*", 200);
+///   std::vector<std::string> keys;
+///   while (it.Next(&keys)) { ... }
+class RedisScanner {
+public:
+  // Replaces *batch with the next step's elements (possibly empty; HSCAN/ZSCAN yield flat
+  // field/value pairs). False once the cursor is exhausted or a command failed.
+  bool Next(std::vector<std::string>* batch);
+
+  bool Done() const { return done_; }
+  // True when the iteration stopped on an error rather than reaching the end.
+  bool Failed() const { return failed_; }
+
+private:
+  friend class RedisClient;
+  RedisScanner(RedisClient* client, std::vector<std::string> command, std::string pattern, size_t count);
+
+  RedisClient* client_;
+  std::vector<std::string> command_; // e.g. {"SCAN"} or {"HSCAN", key}
+  std::vector<RedisNodeAddress> nodes_; // cluster SCAN: the masters still to walk
+  size_t node_{0};
+  std::string pattern_;
+  std::string count_;
+  std::string cursor_{"0"};
+  bool started_{false};
+  bool done_{false};
+  bool failed_{false};
+};
+
+/// @brief Redis client over a pool of persistent, pipelined connections.
+///
+/// The typed commands block until the reply arrives (or the timeout passes); ExecuteAsync()
+/// returns immediately and completes on the client's I/O thread, so any number of commands can
+/// be in flight. Blocking calls must not be made from an ExecuteAsync() callback.
+///
+/// With RedisClientOptions::cluster the client loads the slot table (CLUSTER SLOTS) from the
+/// seed node, sends each command to the master serving its first key's slot over a pool of that
+/// node's own, and follows MOVED (updating the table and reloading it in the background) and
+/// ASK (one ASKING-prefixed retry) redirects.
+///
+/// With RedisClientOptions::near_cache_bytes, Get() is served from a local LRU cache when it can.
+/// Misses are read over a dedicated RESP3 connection with CLIENT TRACKING on, so Redis pushes an
+/// invalidation for every cached key that changes; the client's own writes drop their key at
+/// once, and the cache is flushed whenever the tracking connection is lost. Until tracking is
+/// confirmed (e.g. on a server without RESP3) nothing is cached.
 class RedisClient {
 public:
-  RedisClient(std::string host, uint16_t port);
+  using ReplyCallback = RedisConnection::ReplyCallback;
+
+  RedisClient(std::string host, uint16_t port, RedisClientOptions options = {});
+  ~RedisClient();
+
+  RedisClient(const RedisClient&) = delete;
+  RedisClient& operator=(const RedisClient&) = delete;
+
+  // Any command. nullopt on connection failure or timeout; Redis errors come back as kError.
+  std::optional<RedisReply> Execute(const std::vector<std::string>& args);
+  void ExecuteAsync(const std::vector<std::string>& args, ReplyCallback cb = nullptr);
+
+  // Multi-command builders; see RedisBatch.
+  RedisBatch Batch() { return RedisBatch(this, false); }
+  RedisBatch Transaction() { return RedisBatch(this, true); }
 
   // Basic commands
   std::optional<std::string> Get(const std::string& key);
@@ -30,74 +152,74 @@ public:
   // List commands
   bool RPush(const std::string& key, const std::string& value);
   std::vector<std::string> LRange(const std::string& key, int64_t start, int64_t stop);
+  // Same without copying each element out: the elements' `str` view the reply's arena.
+  std::optional<RedisReply> LRangeReply(const std::string& key, int64_t start, int64_t stop);
+
+  // Sorted-set commands. Members scored within [min, max] (Redis range syntax: "(1700000000000"
+  // is exclusive, "-inf"/"+inf" unbounded), highest first, skipping `offset` and returning at
+  // most `count`: O(log N + count) on the server. Elements view the reply's arena.
+  std::optional<RedisReply> ZRevRangeByScoreReply(const std::string& key, const std::string& max,
+                                                  const std::string& min, int64_t offset, int64_t count);
 
   // Expiration commands
   bool Expire(const std::string& key, int ttl_seconds);
 
-  // Keys command
+  // Keys command. Blocks the server for a full keyspace walk; prefer Scan().
   std::vector<std::string> Keys(const std::string& pattern);
 
-private:
-  std::string host_;
-  uint16_t port_;
-};
-
-/// @brief Redis subscriber with multi-channel support.
-class RedisSubscriber {
-public:
-  using MessageCallback = std::function<void(const std::string& channel, const std::string& payload)>;
-  using ErrorCallback = std::function<void(const std::string& error)>;
-  using ConnectCallback = std::function<void()>;
-
-  RedisSubscriber(std::string host, uint16_t port);
-  ~RedisSubscriber();
-
-  RedisSubscriber(const RedisSubscriber&) = delete;
-  RedisSubscriber& operator=(const RedisSubscriber&) = delete;
+  // Cursor iteration; `count` is the per-step hint passed to Redis.
+  RedisScanner Scan(const std::string& pattern, size_t count = 100);
+  RedisScanner HScan(const std::string& key, const std::string& pattern = "*", size_t count = 100);
+  RedisScanner SScan(const std::string& key, const std::string& pattern = "*", size_t count = 100);
+  RedisScanner ZScan(const std::string& key, const std::string& pattern = "*", size_t count = 100);
 
-  /// @brief Set the message callback.
-  void SetMessageCallback(MessageCallback cb) { msg_cb_ = std::move(cb); }
+  bool IsCluster() const { return options_.cluster; }
 
-  /// @brief Set the error callback.
-  void SetErrorCallback(ErrorCallback cb) { error_cb_ = std::move(cb); }
-
-  /// @brief Set the connect callback.
-  void SetConnectCallback(ConnectCallback cb) { connect_cb_ = std::move(cb); }
-
-  /// @brief Subscribe to a channel.
-  bool Subscribe(const std::string& channel);
-
-  /// @brief Unsubscribe from a channel.
-  bool Unsubscribe(const std::string& channel);
-
-  /// @brief Start the subscriber.
-  void Start();
-
-  /// @brief Stop the subscriber.
-  void Stop();
-
-  /// @brief Check whether the subscriber is connected.
-  bool IsConnected() const { return connected_; }
+  // All zero unless the near cache is enabled.
+  RedisNearCacheStats NearCacheStats() const;
 
 private:
-  void Run();
-  bool SendCommand(const std::string& cmd);
-  void ProcessLine(const std::string& line);
+  friend class RedisBatch;
+  friend class RedisScanner;
+
+  // Cluster mode. `wire` holds one command; it goes to `node` (or, when unset, the master of
+  // `slot`), following up to `hops` redirects.
+  void SendRouted(std::shared_ptr<const std::string> wire, std::optional<uint16_t> slot,
+                  std::optional<RedisNodeAddress> node, bool asking, ReplyCallback cb, int hops);
+  void ExecuteClusterBatch(const RedisBatch& batch, RedisBatch::Callback cb);
+  RedisConnectionPool& PoolFor(std::optional<uint16_t> slot);
+  RedisConnectionPool& NodePool(const RedisNodeAddress& node);
+  // Reloads the slot table from the seed node; at most one reload in flight.
+  void RefreshSlots();
+  std::vector<RedisNodeAddress> ClusterMasters();
+  std::optional<RedisReply> ExecuteOn(const RedisNodeAddress& node, const std::vector<std::string>& args);
+  template <typename Send>
+  std::optional<RedisReply> Wait(Send send);
+
+  // Near cache. Drops the key `args` may modify before it is sent.
+  void InvalidateNearCache(const std::vector<std::string>& args);
+  void OnTrackingPush(const RedisReply& push);
 
   std::string host_;
   uint16_t port_;
-
-  MessageCallback msg_cb_;
-  ErrorCallback error_cb_;
-  ConnectCallback connect_cb_;
-
-  std::atomic<bool> stop_{false};
-  std::atomic<bool> connected_{false};
-
-  std::mutex sock_mu_;
-  std::unique_ptr<asio::io_context> io_;
-  asio::ip::tcp::socket* socket_ptr_{nullptr};
-  std::unique_ptr<asio::ip::tcp::socket> socket_;
+  RedisClientOptions options_;
+
+  // Set once destruction starts; commands issued from then on (e.g. retries from callbacks) fail
+  // immediately instead of reconnecting.
+  std::atomic<bool> stopping_{false};
+  asio::io_context io_;
+  asio::executor_work_guard<asio::io_context::executor_type> work_;
+  std::unique_ptr<RedisConnectionPool> pool_; // the server, or the cluster's seed node
+
+  RedisSlotMap slots_;
+  std::atomic<bool> refreshing_{false};
+  std::mutex pools_mu_;
+  std::unordered_map<std::string, std::unique_ptr<RedisConnectionPool>> node_pools_; // by "host:port"
+
+  std::unique_ptr<RedisNearCache> near_cache_;
+  std::shared_ptr<RedisConnection> tracking_; // near-cache reads; receives the invalidations
+  bool tracking_resp3_{false};                // tracking_ strand only
+  std::atomic<bool> tracking_on_{false};
   std::thread th_;
 };
 
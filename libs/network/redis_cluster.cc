@@ -0,0 +1,254 @@
+#include "network/redis_cluster.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+
+namespace chirp::network {
+namespace {
+
+constexpr std::array<uint16_t, 256> MakeCrc16Table() {
+  std::array<uint16_t, 256> table{};
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint16_t crc = static_cast<uint16_t>(i << 8);
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = static_cast<uint16_t>((crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1);
+    }
+    table[i] = crc;
+  }
+  return table;
+}
+
+constexpr std::array<uint16_t, 256> kCrc16Table = MakeCrc16Table();
+
+uint16_t Crc16(std::string_view data) {
+  uint16_t crc = 0;
+  for (char ch : data) {
+    crc = static_cast<uint16_t>((crc << 8) ^ kCrc16Table[((crc >> 8) ^ static_cast<uint8_t>(ch)) & 0xFF]);
+  }
+  return crc;
+}
+
+bool IsCommand(std::string_view name, std::string_view upper) {
+  return name.size() == upper.size() &&
+         std::equal(name.begin(), name.end(), upper.begin(),
+                    [](char a, char b) { return std::toupper(static_cast<unsigned char>(a)) == b; });
+}
+
+std::optional<int64_t> ToInt(std::string_view s) {
+  int64_t v = 0;
+  auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+  if (ec != std::errc() || end != s.data() + s.size()) {
+    return std::nullopt;
+  }
+  return v;
+}
+
+} // namespace
+
+uint16_t RedisKeySlot(std::string_view key) {
+  const size_t open = key.find('{');
+  if (open != std::string_view::npos) {
+    const size_t close = key.find('}', open + 1);
+    if (close != std::string_view::npos && close > open + 1) {
+      key = key.substr(open + 1, close - open - 1);
+    }
+  }
+  return static_cast<uint16_t>(Crc16(key) % kRedisClusterSlots);
+}
+
+const std::string* RedisCommandKey(const std::vector<std::string>& args) {
+  if (args.size() < 2) {
+    return nullptr;
+  }
+  const std::string& cmd = args[0];
+  static constexpr std::string_view kKeyless[] = {"PING",    "ECHO",   "SCRIPT", "MULTI",   "EXEC",   "DISCARD",
+                                                  "SCAN",    "KEYS",   "INFO",   "CLUSTER", "ASKING", "SELECT",
+                                                  "AUTH",    "HELLO",  "CLIENT", "CONFIG",  "DBSIZE", "FLUSHDB",
+                                                  "FLUSHALL", "TIME",  "SUBSCRIBE", "PSUBSCRIBE", "WAIT"};
+  for (auto name : kKeyless) {
+    if (IsCommand(cmd, name)) {
+      return nullptr;
+    }
+  }
+  // EVAL script numkeys key...
+  if (IsCommand(cmd, "EVAL") || IsCommand(cmd, "EVALSHA") || IsCommand(cmd, "EVAL_RO") ||
+      IsCommand(cmd, "EVALSHA_RO") || IsCommand(cmd, "FCALL")) {
+    const auto numkeys = args.size() > 3 ? ToInt(args[2]) : std::nullopt;
+    return numkeys && *numkeys > 0 ? &args[3] : nullptr;
+  }
+  // XREAD / XREADGROUP ... STREAMS key... id...
+  if (IsCommand(cmd, "XREAD") || IsCommand(cmd, "XREADGROUP")) {
+    for (size_t i = 1; i + 1 < args.size(); ++i) {
+      if (IsCommand(args[i], "STREAMS")) {
+        return &args[i + 1];
+      }
+    }
+    return nullptr;
+  }
+  // XGROUP CREATE key ..., and the like
+  if (IsCommand(cmd, "XGROUP") || IsCommand(cmd, "XINFO") || IsCommand(cmd, "OBJECT")) {
+    return args.size() > 2 ? &args[2] : nullptr;
+  }
+  return &args[1];
+}
+
+std::vector<const std::string*> RedisCommandKeys(const std::vector<std::string>& args) {
+  std::vector<const std::string*> keys;
+  const std::string* first = RedisCommandKey(args);
+  if (!first) {
+    return keys;
+  }
+  const std::string& cmd = args[0];
+  // Every argument is a key.
+  static constexpr std::string_view kAllKeys[] = {"DEL",         "UNLINK",      "EXISTS",      "TOUCH",
+                                                  "MGET",        "WATCH",       "SDIFFSTORE",  "SINTERSTORE",
+                                                  "SUNIONSTORE", "PFMERGE",     "PFCOUNT"};
+  for (auto name : kAllKeys) {
+    if (IsCommand(cmd, name)) {
+      for (size_t i = 1; i < args.size(); ++i) {
+        keys.push_back(&args[i]);
+      }
+      return keys;
+    }
+  }
+  // MSET key value [key value ...]
+  if (IsCommand(cmd, "MSET") || IsCommand(cmd, "MSETNX")) {
+    for (size_t i = 1; i < args.size(); i += 2) {
+      keys.push_back(&args[i]);
+    }
+    return keys;
+  }
+  // EVAL script numkeys key... arg...
+  if (IsCommand(cmd, "EVAL") || IsCommand(cmd, "EVALSHA") || IsCommand(cmd, "EVAL_RO") ||
+      IsCommand(cmd, "EVALSHA_RO") || IsCommand(cmd, "FCALL")) {
+    const size_t numkeys = static_cast<size_t>(*ToInt(args[2])); // > 0, or there would be no first key
+    for (size_t i = 3; i < args.size() && i < 3 + numkeys; ++i) {
+      keys.push_back(&args[i]);
+    }
+    return keys;
+  }
+  // RENAME source destination, COPY source destination [DB n] [REPLACE], and the like
+  if ((IsCommand(cmd, "RENAME") || IsCommand(cmd, "RENAMENX") || IsCommand(cmd, "COPY") ||
+       IsCommand(cmd, "LMOVE") || IsCommand(cmd, "SMOVE")) &&
+      args.size() > 2) {
+    keys.push_back(&args[1]);
+    keys.push_back(&args[2]);
+    return keys;
+  }
+  keys.push_back(first);
+  return keys;
+}
+
+std::optional<uint16_t> RedisCommandSlot(const std::vector<std::string>& args) {
+  const std::string* key = RedisCommandKey(args);
+  return key ? std::optional<uint16_t>(RedisKeySlot(*key)) : std::nullopt;
+}
+
+std::optional<RedisRedirect> ParseRedisRedirect(const RedisNode& reply) {
+  if (reply.type != RedisNode::Type::kError) {
+    return std::nullopt;
+  }
+  std::string_view s = reply.str;
+  RedisRedirect redirect;
+  if (s.starts_with("MOVED ")) {
+    s.remove_prefix(6);
+  } else if (s.starts_with("ASK ")) {
+    redirect.ask = true;
+    s.remove_prefix(4);
+  } else {
+    return std::nullopt;
+  }
+  const size_t space = s.find(' ');
+  const size_t colon = s.rfind(':');
+  if (space == std::string_view::npos || colon == std::string_view::npos || colon < space) {
+    return std::nullopt;
+  }
+  const auto slot = ToInt(s.substr(0, space));
+  const auto port = ToInt(s.substr(colon + 1));
+  if (!slot || *slot < 0 || *slot >= static_cast<int64_t>(kRedisClusterSlots) || !port || *port <= 0 ||
+      *port > 65535) {
+    return std::nullopt;
+  }
+  redirect.slot = static_cast<uint16_t>(*slot);
+  redirect.node.host = std::string(s.substr(space + 1, colon - space - 1));
+  redirect.node.port = static_cast<uint16_t>(*port);
+  return redirect;
+}
+
+RedisSlotMap::RedisSlotMap() : owner_(kRedisClusterSlots, -1) {}
+
+int32_t RedisSlotMap::IndexOf(const RedisNodeAddress& node) {
+  auto it = std::find(nodes_.begin(), nodes_.end(), node);
+  if (it != nodes_.end()) {
+    return static_cast<int32_t>(it - nodes_.begin());
+  }
+  nodes_.push_back(node);
+  return static_cast<int32_t>(nodes_.size() - 1);
+}
+
+bool RedisSlotMap::Load(const RedisNode& reply, const std::string& default_host) {
+  // [[start, end, [host, port, id, ...], replica...], ...]
+  if (reply.type != RedisNode::Type::kArray) {
+    return false;
+  }
+  std::vector<std::pair<std::pair<int64_t, int64_t>, RedisNodeAddress>> ranges;
+  for (const auto& range : reply.elements) {
+    if (range.elements.size() < 3 || range.elements[2].elements.size() < 2) {
+      return false;
+    }
+    const auto& master = range.elements[2];
+    RedisNodeAddress node;
+    node.host = master.elements[0].str.empty() ? default_host : std::string(master.elements[0].str);
+    node.port = static_cast<uint16_t>(master.elements[1].integer);
+    const int64_t start = range.elements[0].integer;
+    const int64_t end = range.elements[1].integer;
+    if (start < 0 || end >= static_cast<int64_t>(kRedisClusterSlots) || start > end) {
+      return false;
+    }
+    ranges.push_back({{start, end}, std::move(node)});
+  }
+
+  std::lock_guard<std::mutex> lock(mu_);
+  nodes_.clear();
+  std::fill(owner_.begin(), owner_.end(), -1);
+  for (const auto& [range, node] : ranges) {
+    const int32_t index = IndexOf(node);
+    std::fill(owner_.begin() + range.first, owner_.begin() + range.second + 1, index);
+  }
+  return true;
+}
+
+void RedisSlotMap::Assign(uint16_t slot, const RedisNodeAddress& node) {
+  std::lock_guard<std::mutex> lock(mu_);
+  owner_[slot] = IndexOf(node);
+}
+
+std::optional<RedisNodeAddress> RedisSlotMap::NodeFor(uint16_t slot) const {
+  std::lock_guard<std::mutex> lock(mu_);
+  const int32_t index = owner_[slot];
+  if (index < 0) {
+    return std::nullopt;
+  }
+  return nodes_[static_cast<size_t>(index)];
+}
+
+std::vector<RedisNodeAddress> RedisSlotMap::Masters() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  std::vector<bool> used(nodes_.size(), false);
+  for (int32_t index : owner_) {
+    if (index >= 0) {
+      used[static_cast<size_t>(index)] = true;
+    }
+  }
+  std::vector<RedisNodeAddress> masters;
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    if (used[i]) {
+      masters.push_back(nodes_[i]);
+    }
+  }
+  return masters;
+}
+
+} // namespace chirp::network
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "network/redis_reply.h"
+
+namespace chirp::network {
+
+constexpr size_t kRedisClusterSlots = 16384;
+
+// CRC16 (XMODEM) of the key modulo 16384. When the key contains a non-empty "{...}" section only
+// that part is hashed, so "chirp:{u1}:a" and "chirp:{u1}:b" always live in the same slot.
+uint16_t RedisKeySlot(std::string_view key);
+
+// Wraps `id` in a hash tag ("{id}").
+inline std::string RedisHashTag(std::string_view id) {
+  std::string tag;
+  tag.reserve(id.size() + 2);
+  tag += '{';
+  tag += id;
+  tag += '}';
+  return tag;
+}
+
+// The command's first key (an element of `args`); null for commands without keys (PING, SCRIPT,
+// SCAN, ...).
+const std::string* RedisCommandKey(const std::vector<std::string>& args);
+
+// Every key of the command: all of them for the multi-key forms (DEL k1 k2, MSET k1 v1 k2 v2,
+// EVAL's numkeys keys, RENAME src dst, ...), otherwise just RedisCommandKey(). Empty for commands
+// without keys.
+std::vector<const std::string*> RedisCommandKeys(const std::vector<std::string>& args);
+
+// Slot of the command's first key; nullopt for commands without keys.
+std::optional<uint16_t> RedisCommandSlot(const std::vector<std::string>& args);
+
+struct RedisNodeAddress {
+  std::string host;
+  uint16_t port{0};
+
+  std::string ToString() const { return host + ":" + std::to_string(port); }
+  bool operator==(const RedisNodeAddress& other) const { return port == other.port && host == other.host; }
+};
+
+// "-MOVED <slot> <host>:<port>" / "-ASK <slot> <host>:<port>".
+struct RedisRedirect {
+  bool ask{false};
+  uint16_t slot{0};
+  RedisNodeAddress node;
+};
+
+// nullopt unless `reply` is a MOVED or ASK error. An empty host (Redis 7 "unknown endpoint")
+// is left empty for the caller to fill in.
+std::optional<RedisRedirect> ParseRedisRedirect(const RedisNode& reply);
+
+// Which master serves each slot, learned from CLUSTER SLOTS and patched by MOVED redirects.
+// Thread-safe.
+class RedisSlotMap {
+public:
+  RedisSlotMap();
+
+  // Replaces the table with a CLUSTER SLOTS reply. Masters announced without a host get
+  // `default_host`. False (table unchanged) if the reply is not a slot table.
+  bool Load(const RedisNode& reply, const std::string& default_host);
+
+  void Assign(uint16_t slot, const RedisNodeAddress& node);
+
+  std::optional<RedisNodeAddress> NodeFor(uint16_t slot) const;
+
+  // Every master that serves at least one slot.
+  std::vector<RedisNodeAddress> Masters() const;
+
+private:
+  int32_t IndexOf(const RedisNodeAddress& node); // mu_ held
+
+  mutable std::mutex mu_;
+  std::vector<RedisNodeAddress> nodes_;
+  std::vector<int32_t> owner_; // index into nodes_ per slot; -1 while unknown
+};
+
+} // namespace chirp::network
@@ -0,0 +1,232 @@
+#include "network/redis_connection.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace chirp::network {
+namespace {
+
+constexpr size_t kReadChunk = 16 * 1024;
+
+} // namespace
+
+RedisConnection::RedisConnection(asio::any_io_executor ex, std::string host, uint16_t port)
+    : strand_(asio::make_strand(ex)),
+      resolver_(strand_),
+      socket_(strand_),
+      deadline_timer_(strand_),
+      host_(std::move(host)),
+      port_(port) {}
+
+void RedisConnection::Execute(std::string command, ReplyCallback cb, size_t replies) {
+  in_flight_.fetch_add(replies, std::memory_order_relaxed);
+  asio::post(strand_, [self = shared_from_this(), command = std::move(command), cb = std::move(cb), replies]() mutable {
+    if (self->closed_) {
+      self->in_flight_.fetch_sub(replies, std::memory_order_relaxed);
+      for (size_t i = 0; i < replies && cb; ++i) {
+        cb(std::nullopt);
+      }
+      return;
+    }
+    self->out_ += command;
+    const auto deadline = std::chrono::steady_clock::now() + self->reply_timeout_;
+    for (size_t i = 0; i < replies; ++i) {
+      self->awaiting_.push_back(Owed{cb, deadline});
+    }
+    self->ArmDeadline();
+    if (self->state_ == State::kDisconnected) {
+      self->Connect();
+    } else if (self->state_ == State::kConnected && !self->write_in_flight_) {
+      self->DoWrite();
+    }
+  });
+}
+
+void RedisConnection::Close() {
+  asio::post(strand_, [self = shared_from_this()] {
+    self->closed_ = true;
+    self->deadline_timer_.cancel();
+    self->Fail();
+  });
+}
+
+void RedisConnection::Connect() {
+  state_ = State::kConnecting;
+  auto self = shared_from_this();
+  const uint64_t gen = generation_;
+  resolver_.async_resolve(host_, std::to_string(port_), [self, gen](std::error_code ec, auto results) {
+    if (gen != self->generation_) {
+      return;
+    }
+    if (ec) {
+      self->Fail();
+      return;
+    }
+    asio::async_connect(self->socket_, results, [self, gen](std::error_code ec, const auto& /*endpoint*/) {
+      if (gen != self->generation_) {
+        return;
+      }
+      if (ec) {
+        self->Fail();
+        return;
+      }
+      asio::error_code opt_ec;
+      self->socket_.set_option(asio::ip::tcp::no_delay(true), opt_ec);
+      self->state_ = State::kConnected;
+      if (!self->handshake_.empty()) {
+        self->out_.insert(0, self->handshake_);
+        const auto deadline = std::chrono::steady_clock::now() + self->reply_timeout_;
+        for (size_t i = 0; i < self->handshake_replies_; ++i) {
+          self->awaiting_.push_front(Owed{self->on_handshake_, deadline});
+        }
+        self->in_flight_.fetch_add(self->handshake_replies_, std::memory_order_relaxed);
+        self->ArmDeadline();
+      }
+      self->DoRead();
+      if (!self->out_.empty()) {
+        self->DoWrite();
+      }
+    });
+  });
+}
+
+void RedisConnection::DoWrite() {
+  // Everything queued so far goes out in one write; later commands wait for the next one.
+  write_in_flight_ = true;
+  writing_.swap(out_);
+  out_.clear();
+  auto self = shared_from_this();
+  asio::async_write(socket_, asio::buffer(writing_), [self, gen = generation_](std::error_code ec, std::size_t /*n*/) {
+    if (gen != self->generation_) {
+      return;
+    }
+    self->write_in_flight_ = false;
+    if (ec) {
+      self->Fail();
+      return;
+    }
+    if (self->state_ == State::kConnected && !self->out_.empty()) {
+      self->DoWrite();
+    }
+  });
+}
+
+void RedisConnection::DoRead() {
+  auto self = shared_from_this();
+  auto buf = parser_.PrepareWrite(kReadChunk);
+  socket_.async_read_some(asio::buffer(buf.data(), buf.size()), [self, gen = generation_](std::error_code ec,
+                                                                                        std::size_t n) {
+    if (gen != self->generation_) {
+      return;
+    }
+    if (ec) {
+      self->Fail();
+      return;
+    }
+    self->parser_.CommitWrite(n);
+    while (auto reply = self->parser_.Pop()) {
+      if (reply->type == RedisReply::Type::kPush) {
+        if (self->on_push_) {
+          self->on_push_(*reply);
+        }
+        continue;
+      }
+      if (self->awaiting_.empty()) {
+        self->Fail(); // a reply nobody asked for: the stream is out of sync
+        return;
+      }
+      ReplyCallback cb = std::move(self->awaiting_.front().cb);
+      self->awaiting_.pop_front();
+      self->in_flight_.fetch_sub(1, std::memory_order_relaxed);
+      if (cb) {
+        cb(std::move(reply));
+      }
+    }
+    if (self->parser_.Failed()) {
+      self->Fail(); // garbage on the wire: replies can no longer be matched to commands
+      return;
+    }
+    self->DoRead();
+  });
+}
+
+void RedisConnection::ArmDeadline() {
+  // One wait at a time, for the oldest owed reply; replies that arrive in time just move it on.
+  if (reply_timeout_.count() <= 0 || deadline_armed_ || awaiting_.empty()) {
+    return;
+  }
+  deadline_armed_ = true;
+  deadline_timer_.expires_at(awaiting_.front().deadline);
+  deadline_timer_.async_wait([self = shared_from_this()](std::error_code /*ec*/) {
+    self->deadline_armed_ = false;
+    if (self->closed_ || self->awaiting_.empty()) {
+      return;
+    }
+    if (self->awaiting_.front().deadline <= std::chrono::steady_clock::now()) {
+      self->Fail(); // the server stopped answering; nothing behind the overdue reply can arrive first
+      return;
+    }
+    self->ArmDeadline();
+  });
+}
+
+void RedisConnection::Fail() {
+  if (state_ == State::kDisconnected && awaiting_.empty()) {
+    return;
+  }
+  state_ = State::kDisconnected;
+  ++generation_; // handlers still pending on the old socket become no-ops
+  write_in_flight_ = false;
+  asio::error_code ec;
+  resolver_.cancel();
+  socket_.close(ec);
+  out_.clear();
+  parser_.Clear();
+
+  // Callbacks may queue new commands (and reconnect), so detach the failed ones first.
+  std::deque<Owed> failed;
+  failed.swap(awaiting_);
+  in_flight_.fetch_sub(failed.size(), std::memory_order_relaxed);
+  for (auto& owed : failed) {
+    if (owed.cb) {
+      owed.cb(std::nullopt);
+    }
+  }
+  if (on_disconnect_) {
+    on_disconnect_();
+  }
+}
+
+RedisConnectionPool::RedisConnectionPool(asio::any_io_executor ex, const std::string& host, uint16_t port,
+                                         size_t size, std::chrono::milliseconds reply_timeout) {
+  connections_.reserve(std::max<size_t>(size, 1));
+  for (size_t i = 0; i < std::max<size_t>(size, 1); ++i) {
+    auto conn = std::make_shared<RedisConnection>(ex, host, port);
+    conn->SetReplyTimeout(reply_timeout);
+    connections_.push_back(std::move(conn));
+  }
+}
+
+RedisConnectionPool::~RedisConnectionPool() { Close(); }
+
+void RedisConnectionPool::Close() {
+  for (auto& conn : connections_) {
+    conn->Close();
+  }
+}
+
+void RedisConnectionPool::Execute(std::string command, RedisConnection::ReplyCallback cb, size_t replies) {
+  // Least outstanding replies, scanning from a rotating start so ties spread out.
+  const size_t n = connections_.size();
+  const size_t start = next_.fetch_add(1, std::memory_order_relaxed);
+  RedisConnection* best = connections_[start % n].get();
+  for (size_t i = 1; i < n && best->InFlight() > 0; ++i) {
+    RedisConnection* candidate = connections_[(start + i) % n].get();
+    if (candidate->InFlight() < best->InFlight()) {
+      best = candidate;
+    }
+  }
+  best->Execute(std::move(command), std::move(cb), replies);
+}
+
+} // namespace chirp::network
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <asio.hpp>
+
+#include "network/redis_reply.h"
+
+namespace chirp::network {
+
+// One long-lived Redis connection with request pipelining.
+//
+// Commands are appended to an output buffer and written as soon as the socket is free, so any
+// number of them can be in flight at once; Redis answers in order, and replies are matched to
+// callbacks FIFO. The connection is opened lazily on the first command and re-opened on the next
+// command after a failure. Callbacks run on the connection's strand and must not block.
+class RedisConnection : public std::enable_shared_from_this<RedisConnection> {
+public:
+  // nullopt when the connection failed before the reply arrived.
+  using ReplyCallback = std::function<void(std::optional<RedisReply>)>;
+  // RESP3 out-of-band pushes (not replies to any command). Runs on the connection's strand.
+  using PushCallback = std::function<void(const RedisReply&)>;
+
+  RedisConnection(asio::any_io_executor ex, std::string host, uint16_t port);
+
+  // Call before the first command.
+  void SetPushCallback(PushCallback cb) { on_push_ = std::move(cb); }
+
+  // Sent ahead of anything queued each time the connection is (re)established, e.g. HELLO 3 and
+  // CLIENT TRACKING; `cb` gets each of its `replies` replies. Call before the first command.
+  void SetHandshake(std::string command, size_t replies, ReplyCallback cb) {
+    handshake_ = std::move(command);
+    handshake_replies_ = replies;
+    on_handshake_ = std::move(cb);
+  }
+
+  // Fails the connection, and everything in flight on it, once the oldest owed reply is this
+  // overdue, so a stalled server cannot keep collecting callbacks until the socket gives up.
+  // Zero (the default) waits forever, as a connection parked in a blocking command must.
+  // Call before the first command.
+  void SetReplyTimeout(std::chrono::milliseconds timeout) { reply_timeout_ = timeout; }
+
+  // Runs on the strand whenever the connection is lost (state tied to the socket, such as
+  // tracking, is gone with it). Call before the first command.
+  void SetDisconnectCallback(std::function<void()> cb) { on_disconnect_ = std::move(cb); }
+
+  // Queues RESP-encoded bytes carrying `replies` commands; `cb` runs once per reply. Thread-safe.
+  void Execute(std::string command, ReplyCallback cb, size_t replies = 1);
+
+  // Fails everything in flight and closes the socket for good; later commands fail at once.
+  // Thread-safe.
+  void Close();
+
+  // Replies still owed to callers (queued or on the wire). Thread-safe.
+  size_t InFlight() const { return in_flight_.load(std::memory_order_relaxed); }
+
+private:
+  enum class State { kDisconnected, kConnecting, kConnected };
+
+  void Connect();
+  void DoWrite();
+  void DoRead();
+  void ArmDeadline();
+  void Fail();
+
+  struct Owed {
+    ReplyCallback cb;
+    std::chrono::steady_clock::time_point deadline;
+  };
+
+  asio::strand<asio::any_io_executor> strand_;
+  asio::ip::tcp::resolver resolver_;
+  asio::ip::tcp::socket socket_;
+  asio::steady_timer deadline_timer_; // armed for awaiting_.front() while a reply timeout is set
+  std::string host_;
+  uint16_t port_;
+
+  State state_{State::kDisconnected};
+  uint64_t generation_{0}; // bumped on every failure; completions from older sockets are ignored
+  bool closed_{false};
+  std::string out_;      // encoded commands waiting for the socket
+  std::string writing_;  // the write currently in flight
+  bool write_in_flight_{false};
+  std::deque<Owed> awaiting_;          // one entry per expected reply, in send order
+  RedisReplyParser parser_;            // socket reads land directly in its buffer
+  PushCallback on_push_;
+  std::string handshake_;
+  size_t handshake_replies_{0};
+  ReplyCallback on_handshake_;
+  std::function<void()> on_disconnect_;
+  std::chrono::milliseconds reply_timeout_{0};
+  bool deadline_armed_{false};
+  std::atomic<size_t> in_flight_{0};
+};
+
+// A fixed set of pipelined connections to one Redis server. Each command goes to the connection
+// with the fewest replies outstanding.
+class RedisConnectionPool {
+public:
+  // `reply_timeout` is applied to every connection (see RedisConnection::SetReplyTimeout).
+  RedisConnectionPool(asio::any_io_executor ex, const std::string& host, uint16_t port, size_t size,
+                      std::chrono::milliseconds reply_timeout = std::chrono::milliseconds(0));
+  ~RedisConnectionPool();
+
+  RedisConnectionPool(const RedisConnectionPool&) = delete;
+  RedisConnectionPool& operator=(const RedisConnectionPool&) = delete;
+
+  // Thread-safe. Commands submitted in one call share a connection, so they run in order.
+  void Execute(std::string command, RedisConnection::ReplyCallback cb, size_t replies = 1);
+
+  // Closes every connection, failing whatever is in flight. Thread-safe.
+  void Close();
+
+  size_t Size() const { return connections_.size(); }
+
+private:
+  std::vector<std::shared_ptr<RedisConnection>> connections_;
+  std::atomic<size_t> next_{0};
+};
+
+} // namespace chirp::network
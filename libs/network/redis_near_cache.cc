@@ -0,0 +1,87 @@
+#include "network/redis_near_cache.h"
+
+#include <iterator>
+#include <utility>
+
+namespace chirp::network {
+
+std::optional<std::optional<std::string>> RedisNearCache::Lookup(const std::string& key, uint64_t* fill_token) {
+  std::lock_guard<std::mutex> lock(mu_);
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    ++stats_.misses;
+    *fill_token = ++next_token_;
+    filling_[key] = *fill_token; // a concurrent miss on the same key takes over the fill
+    return std::nullopt;
+  }
+  ++stats_.hits;
+  lru_.splice(lru_.begin(), lru_, it->second);
+  return it->second->value;
+}
+
+void RedisNearCache::Fill(const std::string& key, uint64_t fill_token, std::optional<std::string> value) {
+  const size_t bytes = key.size() + (value ? value->size() : 0) + kEntryOverhead;
+  std::lock_guard<std::mutex> lock(mu_);
+  auto filling = filling_.find(key);
+  if (filling == filling_.end() || filling->second != fill_token) {
+    return;
+  }
+  filling_.erase(filling);
+  if (bytes > max_bytes_) {
+    return;
+  }
+  if (auto it = index_.find(key); it != index_.end()) {
+    Erase(it->second);
+  }
+  while (!lru_.empty() && stats_.bytes + bytes > max_bytes_) {
+    Erase(std::prev(lru_.end()));
+    ++stats_.evictions;
+  }
+  lru_.push_front(Entry{key, std::move(value), bytes});
+  index_.emplace(key, lru_.begin());
+  stats_.bytes += bytes;
+  stats_.entries = lru_.size();
+}
+
+void RedisNearCache::Cancel(const std::string& key, uint64_t fill_token) {
+  std::lock_guard<std::mutex> lock(mu_);
+  auto filling = filling_.find(key);
+  if (filling != filling_.end() && filling->second == fill_token) {
+    filling_.erase(filling);
+  }
+}
+
+void RedisNearCache::Invalidate(std::string_view key) {
+  const std::string k(key);
+  std::lock_guard<std::mutex> lock(mu_);
+  filling_.erase(k);
+  auto it = index_.find(k);
+  if (it != index_.end()) {
+    Erase(it->second);
+    ++stats_.invalidations;
+  }
+}
+
+void RedisNearCache::Clear() {
+  std::lock_guard<std::mutex> lock(mu_);
+  stats_.invalidations += lru_.size();
+  lru_.clear();
+  index_.clear();
+  filling_.clear();
+  stats_.bytes = 0;
+  stats_.entries = 0;
+}
+
+RedisNearCacheStats RedisNearCache::Stats() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  return stats_;
+}
+
+void RedisNearCache::Erase(std::list<Entry>::iterator it) {
+  stats_.bytes -= it->bytes;
+  index_.erase(it->key);
+  lru_.erase(it);
+  stats_.entries = lru_.size();
+}
+
+} // namespace chirp::network
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace chirp::network {
+
+struct RedisNearCacheStats {
+  uint64_t hits{0};
+  uint64_t misses{0};
+  uint64_t evictions{0};     // entries dropped to stay within the memory bound
+  uint64_t invalidations{0}; // entries dropped because the key changed (or the cache was flushed)
+  size_t entries{0};
+  size_t bytes{0};
+};
+
+/// @brief Process-local copy of hot Redis string values, LRU-bounded by memory.
+///
+/// RedisClient keeps it coherent: keys are dropped on CLIENT TRACKING invalidation pushes and on
+/// the client's own writes, and the whole cache is flushed when the tracking connection drops.
+/// A miss hands out a fill token that any invalidation of the key revokes, so a value that
+/// changed while its GET was in flight is never stored. Thread-safe.
+class RedisNearCache {
+public:
+  // Per-entry bookkeeping charged on top of the key and value bytes.
+  static constexpr size_t kEntryOverhead = 96;
+
+  explicit RedisNearCache(size_t max_bytes) : max_bytes_(max_bytes) {}
+
+  RedisNearCache(const RedisNearCache&) = delete;
+  RedisNearCache& operator=(const RedisNearCache&) = delete;
+
+  // nullopt on a miss; a cached nullopt means the key is known not to exist. On a miss
+  // *fill_token is set for the Fill() or Cancel() that must follow the read.
+  std::optional<std::optional<std::string>> Lookup(const std::string& key, uint64_t* fill_token);
+
+  // Caches the GET result unless the key was invalidated since its Lookup().
+  void Fill(const std::string& key, uint64_t fill_token, std::optional<std::string> value);
+  // The read failed; nothing to cache.
+  void Cancel(const std::string& key, uint64_t fill_token);
+
+  void Invalidate(std::string_view key);
+  void Clear();
+
+  RedisNearCacheStats Stats() const;
+
+private:
+  struct Entry {
+    std::string key;
+    std::optional<std::string> value;
+    size_t bytes{0};
+  };
+
+  void Erase(std::list<Entry>::iterator it); // mu_ held
+
+  const size_t max_bytes_;
+  mutable std::mutex mu_;
+  std::list<Entry> lru_; // most recently used first
+  std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+  std::unordered_map<std::string, uint64_t> filling_; // misses being read, by key
+  uint64_t next_token_{0};
+  RedisNearCacheStats stats_;
+};
+
+} // namespace chirp::network
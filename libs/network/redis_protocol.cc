@@ -6,6 +6,10 @@
 namespace chirp::network {
 
 void RedisRespParser::Append(const uint8_t* data, size_t len) {
+  if (pos_ > 0 && pos_ * 2 >= buf_.size()) {
+    buf_.erase(0, pos_);
+    pos_ = 0;
+  }
   buf_.append(reinterpret_cast<const char*>(data), len);
 }
 
@@ -93,12 +97,15 @@ std::optional<std::pair<RedisResp, size_t>> RedisRespParser::ParseAt(size_t off)
 }
 
 std::optional<RedisResp> RedisRespParser::Pop() {
-  auto parsed = ParseAt(0);
+  auto parsed = ParseAt(pos_);
   if (!parsed) {
     return std::nullopt;
   }
   RedisResp out = std::move(parsed->first);
-  buf_.erase(0, parsed->second);
+  pos_ = parsed->second;
+  if (pos_ == buf_.size()) {
+    Clear();
+  }
   return out;
 }
 
@@ -118,5 +125,18 @@ std::string BuildRedisCommand(const std::vector<std::string>& args) {
   return out;
 }
 
-} // namespace chirp::network
+std::vector<std::string> RedisStringArray(RedisResp reply) {
+  std::vector<std::string> out;
+  if (reply.type != RedisResp::Type::kArray) {
+    return out;
+  }
+  out.reserve(reply.array.size());
+  for (auto& e : reply.array) {
+    if (e.type == RedisResp::Type::kBulkString || e.type == RedisResp::Type::kSimpleString) {
+      out.push_back(std::move(e.str));
+    }
+  }
+  return out;
+}
 
+} // namespace chirp::network
@@ -10,26 +10,39 @@
 namespace chirp::network {
 
 struct RedisResp {
-  enum class Type { kSimpleString, kError, kInteger, kBulkString, kArray, kNull };
+  enum class Type {
+    kSimpleString, kError, kInteger, kBulkString, kArray, kNull,
+    // RESP3 only (RedisReplyParser); RedisRespParser never produces these.
+    kBoolean, kDouble, kBigNumber, kMap, kSet, kPush,
+  };
   Type type{Type::kNull};
   std::string str;
   int64_t integer{0};
   std::vector<RedisResp> array;
 };
 
+// Incremental RESP decoder. Pop() returns replies in arrival order; consumed bytes are dropped
+// lazily so draining a deep pipeline does not shift the buffer once per reply.
 class RedisRespParser {
 public:
   void Append(const uint8_t* data, size_t len);
   std::optional<RedisResp> Pop();
-  void Clear() { buf_.clear(); }
+  void Clear() {
+    buf_.clear();
+    pos_ = 0;
+  }
 
 private:
   std::optional<std::pair<RedisResp, size_t>> ParseAt(size_t off) const;
   std::optional<std::pair<std::string_view, size_t>> ReadLine(size_t off) const;
 
   std::string buf_;
+  size_t pos_{0}; // start of the first unparsed reply
 };
 
 std::string BuildRedisCommand(const std::vector<std::string>& args);
 
+// The string elements of an array reply (LRANGE, KEYS, ...); anything else yields an empty list.
+std::vector<std::string> RedisStringArray(RedisResp reply);
+
 } // namespace chirp::network
@@ -0,0 +1,288 @@
+#include "network/redis_reply.h"
+
+#include <charconv>
+#include <cstring>
+
+namespace chirp::network {
+
+struct RedisReply::Arena {
+  std::unique_ptr<char[]> bytes;
+  std::vector<RedisNode> nodes;
+};
+
+namespace {
+
+constexpr int kMaxDepth = 64;
+constexpr int64_t kMaxBulkBytes = 512LL * 1024 * 1024; // Redis' own proto-max-bulk-len default
+
+enum class Scan { kIncomplete, kOk, kError };
+
+// The line starting at `off` (excluding CRLF); *next is the offset just past the CRLF.
+Scan ReadLine(const char* p, size_t n, size_t off, std::string_view* line, size_t* next) {
+  const void* cr = off < n ? std::memchr(p + off, '\r', n - off) : nullptr;
+  if (!cr) {
+    return Scan::kIncomplete;
+  }
+  const size_t pos = static_cast<size_t>(static_cast<const char*>(cr) - p);
+  if (pos + 1 >= n) {
+    return Scan::kIncomplete;
+  }
+  if (p[pos + 1] != '\n') {
+    return Scan::kError;
+  }
+  *line = std::string_view(p + off, pos - off);
+  *next = pos + 2;
+  return Scan::kOk;
+}
+
+bool ParseInt(std::string_view s, int64_t* out) {
+  const auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), *out);
+  return ec == std::errc() && ptr == s.data() + s.size();
+}
+
+bool IsAggregate(char t) { return t == '*' || t == '%' || t == '~' || t == '>' || t == '|'; }
+bool IsBlob(char t) { return t == '$' || t == '!' || t == '='; }
+
+// Checks that a whole value starts at *off and advances past it; *nodes counts the values that
+// Build() will materialize (attributes are skipped, so they are not counted).
+Scan Measure(const char* p, size_t n, size_t* off, size_t* nodes, int depth, bool count) {
+  if (depth > kMaxDepth) {
+    return Scan::kError;
+  }
+  if (*off >= n) {
+    return Scan::kIncomplete;
+  }
+  const char t = p[*off];
+  std::string_view line;
+  size_t next = 0;
+  if (const Scan s = ReadLine(p, n, *off + 1, &line, &next); s != Scan::kOk) {
+    return s;
+  }
+
+  if (IsBlob(t)) {
+    int64_t len = 0;
+    if (!ParseInt(line, &len) || len < -1 || len > kMaxBulkBytes || (len == -1 && t != '$')) {
+      return Scan::kError;
+    }
+    if (len >= 0) {
+      const size_t end = next + static_cast<size_t>(len);
+      if (end + 2 > n) {
+        return Scan::kIncomplete;
+      }
+      if (p[end] != '\r' || p[end + 1] != '\n') {
+        return Scan::kError;
+      }
+      next = end + 2;
+    }
+    *off = next;
+    *nodes += count ? 1 : 0;
+    return Scan::kOk;
+  }
+
+  if (IsAggregate(t)) {
+    int64_t len = 0;
+    if (!ParseInt(line, &len) || len < -1 || (len == -1 && t != '*')) {
+      return Scan::kError;
+    }
+    const int64_t children = (t == '%' || t == '|') ? len * 2 : len;
+    *off = next;
+    for (int64_t i = 0; i < children; ++i) {
+      if (const Scan s = Measure(p, n, off, nodes, depth + 1, count && t != '|'); s != Scan::kOk) {
+        return s;
+      }
+    }
+    if (t == '|') {
+      return Measure(p, n, off, nodes, depth + 1, count); // the value the attributes describe
+    }
+    *nodes += count ? 1 : 0;
+    return Scan::kOk;
+  }
+
+  int64_t ignored = 0;
+  switch (t) {
+    case '+':
+    case '-':
+    case ',':
+    case '(':
+      break;
+    case ':':
+      if (!ParseInt(line, &ignored)) {
+        return Scan::kError;
+      }
+      break;
+    case '_':
+      if (!line.empty()) {
+        return Scan::kError;
+      }
+      break;
+    case '#':
+      if (line != "t" && line != "f") {
+        return Scan::kError;
+      }
+      break;
+    default:
+      return Scan::kError;
+  }
+  *off = next;
+  *nodes += count ? 1 : 0;
+  return Scan::kOk;
+}
+
+// Fills *out from the (already measured) value at *off. Children of an aggregate take
+// consecutive slots of `nodes`, which was reserved up front, so spans never dangle.
+void Build(const char* p, size_t n, size_t* off, RedisNode* out, std::vector<RedisNode>* nodes) {
+  const char t = p[*off];
+  std::string_view line;
+  size_t next = 0;
+  ReadLine(p, n, *off + 1, &line, &next);
+
+  if (t == '|') {
+    size_t skipped = 0;
+    *off = next;
+    int64_t len = 0;
+    ParseInt(line, &len);
+    for (int64_t i = 0; i < len * 2; ++i) {
+      Measure(p, n, off, &skipped, 0, false);
+    }
+    Build(p, n, off, out, nodes);
+    return;
+  }
+
+  if (IsBlob(t)) {
+    int64_t len = 0;
+    ParseInt(line, &len);
+    if (len < 0) {
+      out->type = RedisNode::Type::kNull;
+      *off = next;
+      return;
+    }
+    out->type = t == '!' ? RedisNode::Type::kError : RedisNode::Type::kBulkString;
+    out->str = std::string_view(p + next, static_cast<size_t>(len));
+    if (t == '=' && out->str.size() >= 4) {
+      out->str.remove_prefix(4); // "txt:" / "mkd:"
+    }
+    *off = next + static_cast<size_t>(len) + 2;
+    return;
+  }
+
+  *off = next;
+  if (IsAggregate(t)) {
+    int64_t len = 0;
+    ParseInt(line, &len);
+    if (len < 0) {
+      out->type = RedisNode::Type::kNull;
+      return;
+    }
+    out->type = t == '*' ? RedisNode::Type::kArray
+              : t == '%' ? RedisNode::Type::kMap
+              : t == '~' ? RedisNode::Type::kSet
+                         : RedisNode::Type::kPush;
+    const size_t children = static_cast<size_t>(t == '%' ? len * 2 : len);
+    if (children == 0) {
+      return;
+    }
+    const size_t base = nodes->size();
+    nodes->resize(base + children);
+    out->elements = std::span<const RedisNode>(nodes->data() + base, children);
+    for (size_t i = 0; i < children; ++i) {
+      Build(p, n, off, &(*nodes)[base + i], nodes);
+    }
+    return;
+  }
+
+  out->str = line;
+  switch (t) {
+    case '+':
+      out->type = RedisNode::Type::kSimpleString;
+      break;
+    case '-':
+      out->type = RedisNode::Type::kError;
+      break;
+    case ':':
+      out->type = RedisNode::Type::kInteger;
+      ParseInt(line, &out->integer);
+      break;
+    case '#':
+      out->type = RedisNode::Type::kBoolean;
+      out->integer = line == "t" ? 1 : 0;
+      break;
+    case ',':
+      out->type = RedisNode::Type::kDouble;
+      std::from_chars(line.data(), line.data() + line.size(), out->real);
+      break;
+    case '(':
+      out->type = RedisNode::Type::kBigNumber;
+      break;
+    default: // '_'
+      out->type = RedisNode::Type::kNull;
+      out->str = {};
+      break;
+  }
+}
+
+RedisResp NodeToResp(const RedisNode& node) {
+  RedisResp r;
+  r.type = node.type;
+  r.str.assign(node.str.data(), node.str.size());
+  r.integer = node.integer;
+  r.array.reserve(node.elements.size());
+  for (const auto& e : node.elements) {
+    r.array.push_back(NodeToResp(e));
+  }
+  return r;
+}
+
+} // namespace
+
+RedisResp RedisReply::ToResp() const { return NodeToResp(*this); }
+
+std::vector<std::string> RedisStringArray(const RedisNode& reply) {
+  std::vector<std::string> out;
+  out.reserve(reply.elements.size());
+  for (const auto& e : reply.elements) {
+    if (e.type == RedisNode::Type::kBulkString || e.type == RedisNode::Type::kSimpleString) {
+      out.emplace_back(e.str);
+    }
+  }
+  return out;
+}
+
+std::optional<RedisReply> RedisReplyParser::Pop() {
+  if (failed_) {
+    return std::nullopt;
+  }
+  const auto* p = reinterpret_cast<const char*>(buf_.ReadPtr());
+  const size_t n = buf_.ReadableBytes();
+  size_t len = 0;
+  size_t count = 0;
+  const Scan s = Measure(p, n, &len, &count, 0, true);
+  if (s != Scan::kOk) {
+    failed_ = s == Scan::kError;
+    return std::nullopt;
+  }
+
+  RedisReply reply;
+  size_t off = 0;
+  if (count == 1) {
+    // Scalars without text (integers, nulls, booleans) need no arena at all.
+    Build(p, len, &off, &reply, nullptr);
+    if (reply.str.empty()) {
+      buf_.Consume(len);
+      return reply;
+    }
+    reply = RedisReply();
+    off = 0;
+  }
+
+  auto arena = std::make_shared<RedisReply::Arena>();
+  arena->bytes = std::make_unique_for_overwrite<char[]>(len);
+  std::memcpy(arena->bytes.get(), p, len);
+  buf_.Consume(len);
+
+  arena->nodes.reserve(count - 1); // every value but the root
+  RedisNode root;
+  Build(arena->bytes.get(), len, &off, &root, &arena->nodes);
+  return RedisReply(std::move(arena), root);
+}
+
+} // namespace chirp::network
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "network/input_buffer.h"
+#include "network/redis_protocol.h"
+
+namespace chirp::network {
+
+// One value of a reply. Strings are views and aggregates are spans into the owning
+// RedisReply's arena; they stay valid for as long as any RedisReply sharing that arena lives.
+struct RedisNode {
+  using Type = RedisResp::Type;
+
+  Type type{Type::kNull};
+  std::string_view str;      // simple/bulk/verbatim strings, errors, doubles and big numbers (as text)
+  int64_t integer{0};        // integers; booleans as 0/1
+  double real{0};            // doubles
+  std::span<const RedisNode> elements; // arrays, sets, pushes; maps as flat key/value pairs
+};
+
+// A parsed reply that owns its storage: the reply's wire bytes are copied once into an arena and
+// every string in the tree points into it, so a 1,000-element LRANGE costs a fixed handful of
+// allocations rather than one per element. Copies are cheap and share the arena.
+class RedisReply : public RedisNode {
+public:
+  RedisReply() = default;
+
+  // The i-th element as a reply of its own, sharing this reply's arena (no copying).
+  RedisReply Element(size_t i) const { return RedisReply(arena_, elements[i]); }
+
+  // Deep copy into the owning tree type.
+  RedisResp ToResp() const;
+
+private:
+  friend class RedisReplyParser;
+  struct Arena;
+
+  RedisReply(std::shared_ptr<const Arena> arena, const RedisNode& node) : RedisNode(node), arena_(std::move(arena)) {}
+
+  std::shared_ptr<const Arena> arena_;
+};
+
+// Strings of an aggregate reply, copied out (one allocation each); non-aggregates yield nothing.
+std::vector<std::string> RedisStringArray(const RedisNode& reply);
+
+// Incremental RESP2/RESP3 decoder that parses in place over its receive buffer.
+//
+// Pop() first scans the buffered bytes to see whether a whole reply is there (and how many
+// values it holds) without allocating, then copies exactly that reply into one arena and builds
+// the tree over it. RESP3 attributes are skipped; verbatim strings are returned as bulk strings
+// without their format prefix; blob errors are returned as errors.
+class RedisReplyParser {
+public:
+  // Zero-copy receive path: read straight into the parser's buffer, then commit what arrived.
+  std::span<uint8_t> PrepareWrite(size_t min_bytes) { return buf_.PrepareWrite(min_bytes); }
+  void CommitWrite(size_t n) { buf_.CommitWrite(n); }
+  void Append(const uint8_t* data, size_t len) { buf_.Append(data, len); }
+
+  // The next complete reply, or nullopt when more bytes are needed (or the stream is corrupt).
+  std::optional<RedisReply> Pop();
+
+  // Set once malformed input was seen; the connection cannot be resynchronized.
+  bool Failed() const { return failed_; }
+
+  void Clear() {
+    buf_.Clear();
+    failed_ = false;
+  }
+
+private:
+  InputBuffer buf_;
+  bool failed_{false};
+};
+
+} // namespace chirp::network
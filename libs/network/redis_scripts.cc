@@ -0,0 +1,248 @@
+#include "network/redis_scripts.h"
+
+#include <utility>
+
+namespace chirp::network {
+namespace {
+
+const RedisScript& ClaimSessionScript() {
+  // KEYS[1] session key; ARGV: owner, ttl, kick channel prefix, kick payload.
+  static const RedisScript script("claim_session", R"lua(
+local prev = redis.call('GET', KEYS[1])
+redis.call('SET', KEYS[1], ARGV[1], 'EX', ARGV[2])
+if prev and prev ~= ARGV[1] then
+  redis.call('PUBLISH', ARGV[3] .. prev, ARGV[4])
+end
+return prev
+)lua");
+  return script;
+}
+
+const RedisScript& ReleaseSessionScript() {
+  // KEYS[1] session key; ARGV: owner.
+  static const RedisScript script("release_session", R"lua(
+if redis.call('GET', KEYS[1]) == ARGV[1] then
+  return redis.call('DEL', KEYS[1])
+end
+return 0
+)lua");
+  return script;
+}
+
+const RedisScript& PopListScript() {
+  // KEYS[1] list.
+  static const RedisScript script("pop_list", R"lua(
+local items = redis.call('LRANGE', KEYS[1], 0, -1)
+if #items > 0 then
+  redis.call('DEL', KEYS[1])
+end
+return items
+)lua");
+  return script;
+}
+
+const RedisScript& AppendCappedScript() {
+  // KEYS[1] list; ARGV: value, max length (0 = unbounded), ttl seconds (0 = none).
+  static const RedisScript script("append_capped", R"lua(
+local n = redis.call('RPUSH', KEYS[1], ARGV[1])
+local cap = tonumber(ARGV[2])
+if cap > 0 and n > cap then
+  redis.call('LTRIM', KEYS[1], -cap, -1)
+  n = cap
+end
+if tonumber(ARGV[3]) > 0 then
+  redis.call('EXPIRE', KEYS[1], ARGV[3])
+end
+return n
+)lua");
+  return script;
+}
+
+const RedisScript& AppendScoredScript() {
+  // KEYS[1] sorted set; ARGV: score, member, max size (0 = unbounded), ttl seconds (0 = none).
+  static const RedisScript script("append_scored", R"lua(
+redis.call('ZADD', KEYS[1], ARGV[1], ARGV[2])
+local n = redis.call('ZCARD', KEYS[1])
+local cap = tonumber(ARGV[3])
+if cap > 0 and n > cap then
+  redis.call('ZREMRANGEBYRANK', KEYS[1], 0, n - cap - 1)
+  n = cap
+end
+if tonumber(ARGV[4]) > 0 then
+  redis.call('EXPIRE', KEYS[1], ARGV[4])
+end
+return n
+)lua");
+  return script;
+}
+
+const RedisScript& DeleteDrainedStreamScript() {
+  // KEYS[1] stream, KEYS[2] guard key; ARGV: consumer group.
+  static const RedisScript script("delete_drained_stream", R"lua(
+if redis.call('EXISTS', KEYS[2]) == 1 then
+  return 0
+end
+if redis.call('EXISTS', KEYS[1]) == 0 then
+  return 1
+end
+local last = redis.call('XREVRANGE', KEYS[1], '+', '-', 'COUNT', 1)
+for _, g in ipairs(redis.call('XINFO', 'GROUPS', KEYS[1])) do
+  local info = {}
+  for i = 1, #g, 2 do
+    info[g[i]] = g[i + 1]
+  end
+  if info['name'] == ARGV[1] then
+    if info['pending'] == 0 and (#last == 0 or info['last-delivered-id'] == last[1][1]) then
+      return redis.call('DEL', KEYS[1])
+    end
+    return 0
+  end
+end
+return 0
+)lua");
+  return script;
+}
+
+std::vector<std::string> EvalArgs(const char* command, const std::string& script, const std::vector<std::string>& keys,
+                                  const std::vector<std::string>& args) {
+  std::vector<std::string> out;
+  out.reserve(3 + keys.size() + args.size());
+  out.emplace_back(command);
+  out.push_back(script);
+  out.push_back(std::to_string(keys.size()));
+  out.insert(out.end(), keys.begin(), keys.end());
+  out.insert(out.end(), args.begin(), args.end());
+  return out;
+}
+
+bool IsNoScript(const std::optional<RedisReply>& r) {
+  return r && r->type == RedisReply::Type::kError && r->str.rfind("NOSCRIPT", 0) == 0;
+}
+
+// SCRIPT LOAD + EVAL pipelined: caches the SHA and runs the script in one round trip.
+RedisBatch LoadAndEval(RedisClient& client, const RedisScript& script, const std::vector<std::string>& keys,
+                       const std::vector<std::string>& args) {
+  auto batch = client.Batch();
+  batch.Add({"SCRIPT", "LOAD", script.Source()});
+  batch.Add(EvalArgs("EVAL", script.Source(), keys, args));
+  return batch;
+}
+
+std::optional<RedisReply> TakeEvalReply(const RedisScript& script, RedisBatch::Replies replies) {
+  if (!replies || replies->size() != 2) {
+    return std::nullopt;
+  }
+  if ((*replies)[0].type == RedisReply::Type::kBulkString) {
+    script.SetSha(std::string((*replies)[0].str));
+  }
+  return std::move((*replies)[1]);
+}
+
+} // namespace
+
+RedisScript::RedisScript(std::string name, std::string source) : name_(std::move(name)), source_(std::move(source)) {}
+
+std::string RedisScript::Sha() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  return sha_;
+}
+
+void RedisScript::SetSha(std::string sha) const {
+  std::lock_guard<std::mutex> lock(mu_);
+  sha_ = std::move(sha);
+}
+
+std::optional<RedisReply> EvalScript(RedisClient& client, const RedisScript& script,
+                                    const std::vector<std::string>& keys, const std::vector<std::string>& args) {
+  const std::string sha = script.Sha();
+  if (!sha.empty()) {
+    auto r = client.Execute(EvalArgs("EVALSHA", sha, keys, args));
+    if (!IsNoScript(r)) {
+      return r;
+    }
+  }
+  return TakeEvalReply(script, LoadAndEval(client, script, keys, args).Execute());
+}
+
+void EvalScriptAsync(RedisClient& client, const RedisScript& script, std::vector<std::string> keys,
+                     std::vector<std::string> args, RedisClient::ReplyCallback cb) {
+  auto load = [&client, &script](const std::vector<std::string>& keys, const std::vector<std::string>& args,
+                                 RedisClient::ReplyCallback cb) {
+    LoadAndEval(client, script, keys, args).ExecuteAsync([&script, cb = std::move(cb)](RedisBatch::Replies replies) {
+      auto r = TakeEvalReply(script, std::move(replies));
+      if (cb) {
+        cb(std::move(r));
+      }
+    });
+  };
+
+  const std::string sha = script.Sha();
+  if (sha.empty()) {
+    load(keys, args, std::move(cb));
+    return;
+  }
+  auto evalsha = EvalArgs("EVALSHA", sha, keys, args);
+  client.ExecuteAsync(evalsha, [load, keys = std::move(keys), args = std::move(args),
+                                cb = std::move(cb)](std::optional<RedisReply> r) mutable {
+    if (IsNoScript(r)) {
+      load(keys, args, std::move(cb));
+    } else if (cb) {
+      cb(std::move(r));
+    }
+  });
+}
+
+bool ClaimSession(RedisClient& client, const std::string& key, const std::string& owner, int ttl_seconds,
+                  const std::string& kick_channel_prefix, const std::string& kick_payload,
+                  std::optional<std::string>* previous) {
+  auto r = EvalScript(client, ClaimSessionScript(), {key},
+                      {owner, std::to_string(ttl_seconds), kick_channel_prefix, kick_payload});
+  if (!r || r->type == RedisReply::Type::kError) {
+    return false;
+  }
+  if (previous) {
+    *previous = r->type == RedisReply::Type::kBulkString ? std::optional<std::string>(r->str) : std::nullopt;
+  }
+  return true;
+}
+
+bool ReleaseSession(RedisClient& client, const std::string& key, const std::string& owner) {
+  auto r = EvalScript(client, ReleaseSessionScript(), {key}, {owner});
+  return r && r->type == RedisReply::Type::kInteger && r->integer > 0;
+}
+
+std::optional<RedisReply> PopOfflineAtomically(RedisClient& client, const std::string& key) {
+  auto r = EvalScript(client, PopListScript(), {key}, {});
+  if (!r || r->type != RedisReply::Type::kArray) {
+    return std::nullopt;
+  }
+  return r;
+}
+
+std::optional<int64_t> AppendHistoryCapped(RedisClient& client, const std::string& key, const std::string& value,
+                                           size_t max_len, int ttl_seconds) {
+  auto r = EvalScript(client, AppendCappedScript(), {key},
+                      {value, std::to_string(max_len), std::to_string(ttl_seconds)});
+  if (!r || r->type != RedisReply::Type::kInteger) {
+    return std::nullopt;
+  }
+  return r->integer;
+}
+
+std::optional<int64_t> AppendHistoryScored(RedisClient& client, const std::string& key, int64_t score,
+                                           const std::string& value, size_t max_len, int ttl_seconds) {
+  auto r = EvalScript(client, AppendScoredScript(), {key},
+                      {std::to_string(score), value, std::to_string(max_len), std::to_string(ttl_seconds)});
+  if (!r || r->type != RedisReply::Type::kInteger) {
+    return std::nullopt;
+  }
+  return r->integer;
+}
+
+bool DeleteDrainedStream(RedisClient& client, const std::string& stream, const std::string& group,
+                         const std::string& guard_key) {
+  auto r = EvalScript(client, DeleteDrainedStreamScript(), {stream, guard_key}, {group});
+  return r && r->type == RedisReply::Type::kInteger && r->integer > 0;
+}
+
+} // namespace chirp::network
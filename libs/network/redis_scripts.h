@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "network/redis_client.h"
+#include "network/redis_reply.h"
+
+namespace chirp::network {
+
+// A server-side Lua script, invoked with EVALSHA.
+//
+// The SHA is learned from SCRIPT LOAD on first use and cached in the script object; it depends
+// only on the source, so every client and server shares it. When a server answers NOSCRIPT
+// (restart, failover, SCRIPT FLUSH) the script is re-loaded and the call retried in one
+// pipelined round trip. Scripts are meant to be long-lived (static) objects.
+class RedisScript {
+public:
+  RedisScript(std::string name, std::string source);
+
+  RedisScript(const RedisScript&) = delete;
+  RedisScript& operator=(const RedisScript&) = delete;
+
+  const std::string& Name() const { return name_; }
+  const std::string& Source() const { return source_; }
+
+  // Empty until the script has been loaded once.
+  std::string Sha() const;
+  void SetSha(std::string sha) const;
+
+private:
+  std::string name_;
+  std::string source_;
+  mutable std::mutex mu_;
+  mutable std::string sha_;
+};
+
+// Runs `script` with KEYS = `keys` and ARGV = `args`. Same failure semantics as
+// RedisClient::Execute(); script errors come back as kError.
+std::optional<RedisReply> EvalScript(RedisClient& client, const RedisScript& script,
+                                    const std::vector<std::string>& keys, const std::vector<std::string>& args);
+// Completes on the client's I/O thread. `client` must outlive the call.
+void EvalScriptAsync(RedisClient& client, const RedisScript& script, std::vector<std::string> keys,
+                     std::vector<std::string> args, RedisClient::ReplyCallback cb);
+
+// Typed helpers over the built-in scripts; each is one round trip and atomic.
+
+// Sets `key` to `owner` for `ttl_seconds` and reports the previous owner in *previous (nullopt
+// when there was none). If a different owner held it, publishes `kick_payload` on
+// `kick_channel_prefix` + previous owner. False if Redis could not be reached.
+bool ClaimSession(RedisClient& client, const std::string& key, const std::string& owner, int ttl_seconds,
+                  const std::string& kick_channel_prefix, const std::string& kick_payload,
+                  std::optional<std::string>* previous);
+
+// Deletes `key` only while it still belongs to `owner`. True if it was deleted.
+bool ReleaseSession(RedisClient& client, const std::string& key, const std::string& owner);
+
+// Returns (as an array reply; elements view its arena) and deletes the whole list at `key`.
+// nullopt if Redis could not be reached.
+std::optional<RedisReply> PopOfflineAtomically(RedisClient& client, const std::string& key);
+
+// RPUSHes `value`, trims the list to the newest `max_len` entries (0 = unbounded) and refreshes
+// its TTL (0 = none). Returns the resulting length, or nullopt if Redis could not be reached.
+std::optional<int64_t> AppendHistoryCapped(RedisClient& client, const std::string& key, const std::string& value,
+                                           size_t max_len, int ttl_seconds);
+
+// ZADDs `value` with `score` (e.g. its timestamp), drops the lowest-scored members beyond the
+// newest `max_len` (0 = unbounded) and refreshes the TTL (0 = none). Pages are then read with
+// RedisClient::ZRevRangeByScoreReply(). Returns the resulting size, or nullopt if Redis could
+// not be reached.
+std::optional<int64_t> AppendHistoryScored(RedisClient& client, const std::string& key, int64_t score,
+                                           const std::string& value, size_t max_len, int ttl_seconds);
+
+// Deletes `stream` once consumer `group` has read and acknowledged every entry in it, unless
+// `guard_key` exists (e.g. the stream's owner came back). `guard_key` must hash to the same slot
+// as `stream`. True if the stream is gone (deleted now or already absent).
+bool DeleteDrainedStream(RedisClient& client, const std::string& stream, const std::string& group,
+                         const std::string& guard_key);
+
+} // namespace chirp::network
@@ -0,0 +1,245 @@
+#include "network/redis_stream_consumer.h"
+
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+#include "network/redis_connection.h"
+#include "network/redis_protocol.h"
+#include "network/redis_reply.h"
+
+namespace chirp::network {
+namespace {
+
+constexpr std::chrono::milliseconds kRetryDelay{1000};
+
+bool IsNoGroup(const std::optional<RedisReply>& r) {
+  return r && r->type == RedisReply::Type::kError && r->str.find("NOGROUP") != std::string_view::npos;
+}
+
+} // namespace
+
+void AppendRedisStreamEntries(const RedisNode& list, std::vector<RedisStreamEntry>* out) {
+  for (const auto& e : list.elements) {
+    if (e.elements.size() != 2) {
+      continue;
+    }
+    RedisStreamEntry entry;
+    entry.id = std::string(e.elements[0].str);
+    entry.fields = RedisStringArray(e.elements[1]);
+    out->push_back(std::move(entry));
+  }
+}
+
+// XREADGROUP: null on timeout, otherwise [[stream, entries]].
+std::vector<RedisStreamEntry> ParseRedisStreamRead(const RedisReply& reply) {
+  std::vector<RedisStreamEntry> entries;
+  for (const auto& stream : reply.elements) {
+    if (stream.elements.size() == 2) {
+      AppendRedisStreamEntries(stream.elements[1], &entries);
+    }
+  }
+  return entries;
+}
+
+struct RedisStreamConsumer::Core : std::enable_shared_from_this<Core> {
+  Core(asio::any_io_executor ex, const std::string& host, uint16_t port, std::string s, std::string g,
+       std::string c, RedisStreamConsumerOptions o)
+      : strand(asio::make_strand(ex)),
+        // Connections on our strand, so their callbacks are serialized with everything here.
+        reader(std::make_shared<RedisConnection>(strand, host, port)),
+        writer(std::make_shared<RedisConnection>(strand, host, port)),
+        reclaim_timer(strand),
+        stream(std::move(s)),
+        group(std::move(g)),
+        consumer(std::move(c)),
+        options(o) {}
+
+  asio::strand<asio::any_io_executor> strand;
+  std::shared_ptr<RedisConnection> reader; // parked in the blocking XREADGROUP
+  std::shared_ptr<RedisConnection> writer; // group creation, acks, claims
+  asio::steady_timer reclaim_timer;
+  std::string stream;
+  std::string group;
+  std::string consumer;
+  RedisStreamConsumerOptions options;
+
+  Handler handler; // set before Start(); cb_mu is held while it runs so Stop() can wait it out
+  std::mutex cb_mu;
+  std::atomic<bool> stopped{false};
+  std::atomic<uint64_t> delivered{0};
+  bool reclaiming{false};
+
+  template <typename Fn>
+  void Send(RedisConnection& conn, const std::vector<std::string>& args, Fn then) {
+    conn.Execute(BuildRedisCommand(args),
+                 [self = shared_from_this(), then = std::move(then)](std::optional<RedisReply> r) mutable {
+                   if (!self->stopped.load()) {
+                     then(std::move(r));
+                   }
+                 });
+  }
+
+  template <typename Fn>
+  void RetryLater(Fn fn) {
+    auto timer = std::make_shared<asio::steady_timer>(strand, kRetryDelay);
+    timer->async_wait([self = shared_from_this(), timer, fn = std::move(fn)](std::error_code ec) mutable {
+      if (!ec && !self->stopped.load()) {
+        fn();
+      }
+    });
+  }
+
+  void CreateGroup() {
+    // From "0": whatever was added before this consumer's first start is meant for it too.
+    Send(*writer, {"XGROUP", "CREATE", stream, group, "0", "MKSTREAM"}, [this](std::optional<RedisReply> r) {
+      if (!r || (r->type == RedisReply::Type::kError && r->str.find("BUSYGROUP") == std::string_view::npos)) {
+        RetryLater([this] { CreateGroup(); });
+        return;
+      }
+      ReadPending("0");
+    });
+  }
+
+  // Entries this consumer was given before (e.g. by a previous run) and never acknowledged.
+  void ReadPending(const std::string& after) {
+    Send(*reader,
+         {"XREADGROUP", "GROUP", group, consumer, "COUNT", std::to_string(options.count), "STREAMS", stream, after},
+         [this, after](std::optional<RedisReply> r) {
+           if (IsNoGroup(r)) {
+             CreateGroup();
+             return;
+           }
+           if (!r || r->type == RedisReply::Type::kError) {
+             RetryLater([this, after] { ReadPending(after); });
+             return;
+           }
+           auto entries = ParseRedisStreamRead(*r);
+           if (entries.empty()) {
+             // Claim only after our own backlog is done, or what we claim would be re-read above.
+             if (!reclaiming) {
+               reclaiming = true;
+               Reclaim("0-0");
+             }
+             ReadNew();
+             return;
+           }
+           const std::string last = entries.back().id;
+           Deliver(entries);
+           ReadPending(last);
+         });
+  }
+
+  void ReadNew() {
+    Send(*reader,
+         {"XREADGROUP", "GROUP", group, consumer, "COUNT", std::to_string(options.count), "BLOCK",
+          std::to_string(options.block.count()), "STREAMS", stream, ">"},
+         [this](std::optional<RedisReply> r) {
+           if (IsNoGroup(r)) {
+             CreateGroup(); // the stream or group was deleted (e.g. Redis restarted empty)
+             return;
+           }
+           if (!r || r->type == RedisReply::Type::kError) {
+             RetryLater([this] { ReadNew(); });
+             return;
+           }
+           Deliver(ParseRedisStreamRead(*r));
+           ReadNew();
+         });
+  }
+
+  // Takes over entries other consumers of the group read but left unacknowledged (a crashed
+  // instance, or this one under a previous consumer name).
+  void Reclaim(const std::string& cursor) {
+    Send(*writer,
+         {"XAUTOCLAIM", stream, group, consumer, std::to_string(options.reclaim_idle.count()), cursor, "COUNT",
+          std::to_string(options.count)},
+         [this](std::optional<RedisReply> r) {
+           if (!r || r->type != RedisReply::Type::kArray || r->elements.size() < 2) {
+             ScheduleReclaim();
+             return;
+           }
+           std::vector<RedisStreamEntry> entries;
+           AppendRedisStreamEntries(r->elements[1], &entries);
+           const std::string next(r->elements[0].str);
+           Deliver(entries);
+           if (next == "0-0" || next.empty()) {
+             ScheduleReclaim();
+           } else {
+             Reclaim(next);
+           }
+         });
+  }
+
+  void ScheduleReclaim() {
+    reclaim_timer.expires_after(options.reclaim_interval);
+    reclaim_timer.async_wait([self = shared_from_this()](std::error_code ec) {
+      if (!ec && !self->stopped.load()) {
+        self->Reclaim("0-0");
+      }
+    });
+  }
+
+  void Deliver(const std::vector<RedisStreamEntry>& entries) {
+    if (entries.empty()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(cb_mu);
+      if (stopped.load()) {
+        return; // left pending; re-delivered on the next start
+      }
+      if (handler) {
+        handler(entries);
+      }
+    }
+    delivered.fetch_add(entries.size(), std::memory_order_relaxed);
+    std::vector<std::string> ack = {"XACK", stream, group};
+    ack.reserve(entries.size() + 3);
+    for (const auto& e : entries) {
+      ack.push_back(e.id);
+    }
+    Send(*writer, ack, [](std::optional<RedisReply>) {});
+  }
+};
+
+RedisStreamConsumer::RedisStreamConsumer(asio::any_io_executor ex,
+                                         std::string host,
+                                         uint16_t port,
+                                         std::string stream,
+                                         std::string group,
+                                         std::string consumer,
+                                         RedisStreamConsumerOptions options)
+    : core_(std::make_shared<Core>(std::move(ex), host, port, std::move(stream), std::move(group),
+                                   std::move(consumer), options)) {}
+
+RedisStreamConsumer::~RedisStreamConsumer() { Stop(); }
+
+void RedisStreamConsumer::SetHandler(Handler handler) { core_->handler = std::move(handler); }
+
+void RedisStreamConsumer::Start() {
+  asio::post(core_->strand, [core = core_] {
+    if (!core->stopped.load()) {
+      core->CreateGroup();
+    }
+  });
+}
+
+void RedisStreamConsumer::Stop() {
+  if (core_->stopped.exchange(true)) {
+    return;
+  }
+  asio::post(core_->strand, [core = core_] {
+    core->reclaim_timer.cancel();
+    core->reader->Close();
+    core->writer->Close();
+  });
+  if (!core_->strand.running_in_this_thread()) {
+    std::lock_guard<std::mutex> lock(core_->cb_mu); // waits out a handler already running
+  }
+}
+
+uint64_t RedisStreamConsumer::Delivered() const { return core_->delivered.load(std::memory_order_relaxed); }
+
+} // namespace chirp::network
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <asio.hpp>
+
+#include "network/redis_reply.h"
+
+namespace chirp::network {
+
+struct RedisStreamEntry {
+  std::string id;
+  std::vector<std::string> fields; // field, value, field, value, ...
+};
+
+/// @brief Appends the entries of an [[id, [field, value, ...]], ...] list (the body of XREADGROUP,
+/// XRANGE and XAUTOCLAIM replies). Entries trimmed away while pending come back with a null body;
+/// they are kept (with no fields) so that they get acknowledged.
+void AppendRedisStreamEntries(const RedisNode& list, std::vector<RedisStreamEntry>* out);
+
+/// @brief Entries of an XREADGROUP reply (none when it timed out).
+std::vector<RedisStreamEntry> ParseRedisStreamRead(const RedisReply& reply);
+
+struct RedisStreamConsumerOptions {
+  size_t count{128};                               // entries per XREADGROUP / XAUTOCLAIM
+  std::chrono::milliseconds block{2000};           // how long one read waits for new entries
+  std::chrono::milliseconds reclaim_idle{30000};   // pending entries idle this long are taken over
+  std::chrono::milliseconds reclaim_interval{10000};
+};
+
+/// @brief Reads one Redis stream as a member of a consumer group.
+///
+/// On start the group is created (from the beginning of the stream) if it does not exist, then
+/// entries this consumer read earlier but never acknowledged are re-delivered, pending entries
+/// other consumers left idle for `reclaim_idle` are claimed (XAUTOCLAIM, also re-run every
+/// `reclaim_interval`), and new entries are read in batches of `count` with a blocking
+/// XREADGROUP. Each batch is acknowledged once the handler returns, so delivery is
+/// at-least-once. Runs on a strand of the given executor, on two connections of its own (one
+/// parked in the blocking read, one for acks and claims).
+class RedisStreamConsumer {
+public:
+  using Handler = std::function<void(const std::vector<RedisStreamEntry>& entries)>;
+
+  RedisStreamConsumer(asio::any_io_executor ex,
+                      std::string host,
+                      uint16_t port,
+                      std::string stream,
+                      std::string group,
+                      std::string consumer,
+                      RedisStreamConsumerOptions options = {});
+  ~RedisStreamConsumer();
+
+  RedisStreamConsumer(const RedisStreamConsumer&) = delete;
+  RedisStreamConsumer& operator=(const RedisStreamConsumer&) = delete;
+
+  /// @brief Set the handler. Call before Start().
+  void SetHandler(Handler handler);
+
+  void Start();
+
+  /// @brief Stop reading. Entries handed out but not yet acknowledged stay pending and are
+  /// re-delivered on the next start.
+  void Stop();
+
+  /// @brief Entries handed to the handler so far.
+  uint64_t Delivered() const;
+
+private:
+  struct Core;
+  std::shared_ptr<Core> core_;
+};
+
+} // namespace chirp::network
@@ -0,0 +1,388 @@
+#include "network/redis_subscriber.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <utility>
+
+#include "network/redis_protocol.h"
+#include "network/redis_reply.h"
+
+namespace chirp::network {
+namespace {
+
+constexpr size_t kReadChunk = 16 * 1024;
+// Names per (P)(UN)SUBSCRIBE command, so a huge resubscribe is not one multi-megabyte command.
+constexpr size_t kMaxNamesPerCommand = 512;
+constexpr std::chrono::milliseconds kMinReconnectDelay{200};
+constexpr std::chrono::milliseconds kMaxReconnectDelay{10000};
+
+} // namespace
+
+struct RedisSubscriber::Core : std::enable_shared_from_this<Core> {
+  Core(asio::any_io_executor ex, std::string h, uint16_t p)
+      : strand(asio::make_strand(ex)),
+        resolver(strand),
+        socket(strand),
+        retry_timer(strand),
+        host(std::move(h)),
+        port(p) {}
+
+  asio::strand<asio::any_io_executor> strand;
+  asio::ip::tcp::resolver resolver;
+  asio::ip::tcp::socket socket;
+  asio::steady_timer retry_timer;
+  std::string host;
+  uint16_t port;
+
+  // Set before Start(). Held while a callback runs so that Stop() can wait it out.
+  MessageCallback on_message;
+  PatternMessageCallback on_pmessage;
+  ErrorCallback on_error;
+  ConnectCallback on_connect;
+  std::mutex cb_mu;
+
+  // What callers asked for, plus the names changed since the last flush.
+  std::mutex mu;
+  std::set<std::string> channels;
+  std::set<std::string> patterns;
+  std::set<std::string> dirty_channels;
+  std::set<std::string> dirty_patterns;
+  bool started{false};
+  bool flush_posted{false};
+
+  std::atomic<bool> stopped{false};
+  std::atomic<bool> connected{false};
+  std::atomic<uint64_t> commands_sent{0};
+
+  // Strand only.
+  std::set<std::string> sent_channels; // what this connection has asked the server for
+  std::set<std::string> sent_patterns;
+  uint64_t generation{0}; // bumped on every failure; completions from older sockets are ignored
+  std::string out;
+  std::string writing;
+  bool write_in_flight{false};
+  RedisReplyParser parser;
+  std::chrono::milliseconds reconnect_delay{kMinReconnectDelay};
+
+  bool Update(const std::vector<std::string>& names, bool pattern, bool add) {
+    std::lock_guard<std::mutex> lock(mu);
+    if (stopped.load()) {
+      return false;
+    }
+    auto& wanted = pattern ? patterns : channels;
+    auto& dirty = pattern ? dirty_patterns : dirty_channels;
+    for (const auto& name : names) {
+      if (add) {
+        wanted.insert(name);
+      } else {
+        wanted.erase(name);
+      }
+      dirty.insert(name);
+    }
+    if (started && !flush_posted) {
+      flush_posted = true;
+      asio::post(strand, [self = shared_from_this()] { self->Flush(); });
+    }
+    return true;
+  }
+
+  void Append(const char* verb, const std::vector<std::string>& names) {
+    for (size_t i = 0; i < names.size(); i += kMaxNamesPerCommand) {
+      const size_t end = std::min(names.size(), i + kMaxNamesPerCommand);
+      std::vector<std::string> args;
+      args.reserve(end - i + 1);
+      args.emplace_back(verb);
+      args.insert(args.end(), names.begin() + static_cast<std::ptrdiff_t>(i),
+                  names.begin() + static_cast<std::ptrdiff_t>(end));
+      out += BuildRedisCommand(args);
+      commands_sent.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  // Sends the difference between what is wanted and what this connection already asked for.
+  // A name subscribed and unsubscribed again within one flush costs nothing.
+  void Flush() {
+    std::vector<std::string> sub, unsub, psub, punsub;
+    {
+      std::lock_guard<std::mutex> lock(mu);
+      flush_posted = false;
+      if (!connected.load()) {
+        dirty_channels.clear(); // the full set goes out on connect
+        dirty_patterns.clear();
+        return;
+      }
+      Diff(dirty_channels, channels, sent_channels, &sub, &unsub);
+      Diff(dirty_patterns, patterns, sent_patterns, &psub, &punsub);
+    }
+    Append("SUBSCRIBE", sub);
+    Append("UNSUBSCRIBE", unsub);
+    Append("PSUBSCRIBE", psub);
+    Append("PUNSUBSCRIBE", punsub);
+    if (!out.empty() && !write_in_flight) {
+      DoWrite();
+    }
+  }
+
+  static void Diff(std::set<std::string>& dirty, const std::set<std::string>& wanted, std::set<std::string>& sent,
+                   std::vector<std::string>* add, std::vector<std::string>* remove) {
+    for (const auto& name : dirty) {
+      const bool want = wanted.count(name) > 0;
+      if (want && sent.insert(name).second) {
+        add->push_back(name);
+      } else if (!want && sent.erase(name) > 0) {
+        remove->push_back(name);
+      }
+    }
+    dirty.clear();
+  }
+
+  void Connect() {
+    if (stopped.load()) {
+      return;
+    }
+    auto self = shared_from_this();
+    const uint64_t gen = generation;
+    resolver.async_resolve(host, std::to_string(port), [self, gen](std::error_code ec, auto results) {
+      if (gen != self->generation) {
+        return;
+      }
+      if (ec) {
+        self->Fail("resolve failed: " + ec.message());
+        return;
+      }
+      asio::async_connect(self->socket, results, [self, gen](std::error_code ec, const auto& /*endpoint*/) {
+        if (gen != self->generation) {
+          return;
+        }
+        if (ec) {
+          self->Fail("connect failed: " + ec.message());
+          return;
+        }
+        self->OnConnected();
+      });
+    });
+  }
+
+  void OnConnected() {
+    asio::error_code opt_ec;
+    socket.set_option(asio::ip::tcp::no_delay(true), opt_ec);
+    reconnect_delay = kMinReconnectDelay;
+
+    std::vector<std::string> sub, psub;
+    {
+      std::lock_guard<std::mutex> lock(mu);
+      connected.store(true);
+      sent_channels = channels;
+      sent_patterns = patterns;
+      dirty_channels.clear();
+      dirty_patterns.clear();
+      sub.assign(channels.begin(), channels.end());
+      psub.assign(patterns.begin(), patterns.end());
+    }
+    Append("SUBSCRIBE", sub);
+    Append("PSUBSCRIBE", psub);
+    DoRead();
+    if (!out.empty()) {
+      DoWrite();
+    }
+    Invoke([&] {
+      if (on_connect) {
+        on_connect();
+      }
+    });
+  }
+
+  void DoWrite() {
+    write_in_flight = true;
+    writing.swap(out);
+    out.clear();
+    auto self = shared_from_this();
+    asio::async_write(socket, asio::buffer(writing), [self, gen = generation](std::error_code ec, std::size_t /*n*/) {
+      if (gen != self->generation) {
+        return;
+      }
+      self->write_in_flight = false;
+      if (ec) {
+        self->Fail("write failed: " + ec.message());
+        return;
+      }
+      if (!self->out.empty()) {
+        self->DoWrite();
+      }
+    });
+  }
+
+  void DoRead() {
+    auto self = shared_from_this();
+    auto buf = parser.PrepareWrite(kReadChunk);
+    socket.async_read_some(asio::buffer(buf.data(), buf.size()), [self, gen = generation](asio::error_code ec,
+                                                                                         std::size_t n) {
+      if (gen != self->generation) {
+        return;
+      }
+      if (ec) {
+        self->Fail(ec == asio::error::eof ? std::string("connection closed by server")
+                                          : "read failed: " + ec.message());
+        return;
+      }
+      self->parser.CommitWrite(n);
+      while (auto reply = self->parser.Pop()) {
+        self->Dispatch(*reply);
+        if (gen != self->generation) {
+          return; // a callback stopped the subscriber
+        }
+      }
+      if (self->parser.Failed()) {
+        self->Fail("malformed reply");
+        return;
+      }
+      self->DoRead();
+    });
+  }
+
+  // ["message", channel, payload] / ["pmessage", pattern, channel, payload]; (un)subscribe
+  // confirmations are ignored.
+  void Dispatch(const RedisReply& reply) {
+    if (reply.type == RedisReply::Type::kError) {
+      Invoke([&] {
+        if (on_error) {
+          on_error("redis error: " + std::string(reply.str));
+        }
+      });
+      return;
+    }
+    if (reply.type != RedisReply::Type::kArray && reply.type != RedisReply::Type::kPush) {
+      return;
+    }
+    const auto& e = reply.elements;
+    if (e.size() == 3 && e[0].str == "message") {
+      const std::string channel(e[1].str);
+      const std::string payload(e[2].str);
+      Invoke([&] {
+        if (on_message) {
+          on_message(channel, payload);
+        }
+      });
+    } else if (e.size() == 4 && e[0].str == "pmessage") {
+      const std::string pattern(e[1].str);
+      const std::string channel(e[2].str);
+      const std::string payload(e[3].str);
+      Invoke([&] {
+        if (on_pmessage) {
+          on_pmessage(pattern, channel, payload);
+        } else if (on_message) {
+          on_message(channel, payload);
+        }
+      });
+    }
+  }
+
+  template <typename Fn>
+  void Invoke(Fn&& fn) {
+    if (stopped.load()) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(cb_mu);
+    if (!stopped.load()) {
+      fn();
+    }
+  }
+
+  void Fail(const std::string& reason) {
+    Close();
+    if (stopped.load()) {
+      return;
+    }
+    Invoke([&] {
+      if (on_error) {
+        on_error(reason);
+      }
+    });
+    retry_timer.expires_after(reconnect_delay);
+    reconnect_delay = std::min(reconnect_delay * 2, kMaxReconnectDelay);
+    retry_timer.async_wait([self = shared_from_this(), gen = generation](std::error_code ec) {
+      if (!ec && gen == self->generation) {
+        self->Connect();
+      }
+    });
+  }
+
+  void Close() {
+    ++generation; // handlers still pending on the old socket become no-ops
+    {
+      std::lock_guard<std::mutex> lock(mu);
+      connected.store(false);
+      sent_channels.clear();
+      sent_patterns.clear();
+    }
+    write_in_flight = false;
+    asio::error_code ec;
+    retry_timer.cancel();
+    resolver.cancel();
+    socket.close(ec);
+    out.clear();
+    parser.Clear();
+  }
+};
+
+RedisSubscriber::RedisSubscriber(asio::any_io_executor ex, std::string host, uint16_t port)
+    : core_(std::make_shared<Core>(std::move(ex), std::move(host), port)) {}
+
+RedisSubscriber::~RedisSubscriber() { Stop(); }
+
+void RedisSubscriber::SetMessageCallback(MessageCallback cb) { core_->on_message = std::move(cb); }
+
+void RedisSubscriber::SetPatternMessageCallback(PatternMessageCallback cb) { core_->on_pmessage = std::move(cb); }
+
+void RedisSubscriber::SetErrorCallback(ErrorCallback cb) { core_->on_error = std::move(cb); }
+
+void RedisSubscriber::SetConnectCallback(ConnectCallback cb) { core_->on_connect = std::move(cb); }
+
+bool RedisSubscriber::Subscribe(const std::string& channel) { return core_->Update({channel}, false, true); }
+
+bool RedisSubscriber::Subscribe(const std::vector<std::string>& channels) {
+  return core_->Update(channels, false, true);
+}
+
+bool RedisSubscriber::PSubscribe(const std::string& pattern) { return core_->Update({pattern}, true, true); }
+
+bool RedisSubscriber::Unsubscribe(const std::string& channel) { return core_->Update({channel}, false, false); }
+
+bool RedisSubscriber::Unsubscribe(const std::vector<std::string>& channels) {
+  return core_->Update(channels, false, false);
+}
+
+bool RedisSubscriber::PUnsubscribe(const std::string& pattern) { return core_->Update({pattern}, true, false); }
+
+void RedisSubscriber::Start() {
+  {
+    std::lock_guard<std::mutex> lock(core_->mu);
+    if (core_->started || core_->stopped.load()) {
+      return;
+    }
+    core_->started = true;
+  }
+  asio::post(core_->strand, [core = core_] { core->Connect(); });
+}
+
+void RedisSubscriber::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(core_->mu);
+    if (core_->stopped.exchange(true)) {
+      return;
+    }
+  }
+  asio::post(core_->strand, [core = core_] { core->Close(); });
+  if (!core_->strand.running_in_this_thread()) {
+    std::lock_guard<std::mutex> lock(core_->cb_mu); // waits out a callback already running
+  }
+}
+
+bool RedisSubscriber::IsConnected() const { return core_->connected.load(); }
+
+uint64_t RedisSubscriber::CommandsSent() const { return core_->commands_sent.load(std::memory_order_relaxed); }
+
+} // namespace chirp::network
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <asio.hpp>
+
+namespace chirp::network {
+
+/// @brief Redis Pub/Sub subscriber running on the caller's executor.
+///
+/// The subscriber keeps the set of channels and patterns it should be subscribed to. Subscribe()
+/// and friends only update that set; changes made before the strand gets to run are flushed
+/// together, so a login storm becomes a handful of `SUBSCRIBE c1 c2 ...` commands rather than
+/// one per user. After a disconnect the connection is re-opened with backoff and the whole set
+/// is subscribed again. Callbacks run on the subscriber's strand and must not block.
+class RedisSubscriber {
+public:
+  using MessageCallback = std::function<void(const std::string& channel, const std::string& payload)>;
+  using PatternMessageCallback =
+      std::function<void(const std::string& pattern, const std::string& channel, const std::string& payload)>;
+  using ErrorCallback = std::function<void(const std::string& error)>;
+  using ConnectCallback = std::function<void()>;
+
+  RedisSubscriber(asio::any_io_executor ex, std::string host, uint16_t port);
+  ~RedisSubscriber();
+
+  RedisSubscriber(const RedisSubscriber&) = delete;
+  RedisSubscriber& operator=(const RedisSubscriber&) = delete;
+
+  // Call the setters before Start().
+
+  /// @brief Set the callback for messages on subscribed channels.
+  void SetMessageCallback(MessageCallback cb);
+
+  /// @brief Set the callback for messages matched by a pattern. When unset they go to the
+  /// message callback.
+  void SetPatternMessageCallback(PatternMessageCallback cb);
+
+  /// @brief Set the error callback.
+  void SetErrorCallback(ErrorCallback cb);
+
+  /// @brief Set the connect callback (runs after every (re)connect, once the set is re-sent).
+  void SetConnectCallback(ConnectCallback cb);
+
+  /// @brief Subscribe to channels / patterns. Thread-safe; false once stopped.
+  bool Subscribe(const std::string& channel);
+  bool Subscribe(const std::vector<std::string>& channels);
+  bool PSubscribe(const std::string& pattern);
+
+  /// @brief Unsubscribe from channels / patterns. Thread-safe; false once stopped.
+  bool Unsubscribe(const std::string& channel);
+  bool Unsubscribe(const std::vector<std::string>& channels);
+  bool PUnsubscribe(const std::string& pattern);
+
+  /// @brief Connect and subscribe to everything requested so far.
+  void Start();
+
+  /// @brief Close the connection. No callback starts after Stop() returns; a subscriber cannot
+  /// be restarted.
+  void Stop();
+
+  /// @brief Check whether the subscriber is connected.
+  bool IsConnected() const;
+
+  /// @brief SUBSCRIBE/UNSUBSCRIBE/PSUBSCRIBE/PUNSUBSCRIBE commands written so far.
+  uint64_t CommandsSent() const;
+
+private:
+  struct Core;
+  std::shared_ptr<Core> core_;
+};
+
+} // namespace chirp::network
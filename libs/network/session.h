@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
 
+#include "network/shared_frame.h"
+
 namespace chirp::network {
 
 class Session {
@@ -11,6 +14,17 @@ public:
   // Sends bytes as-is (caller decides framing). Thread-safe.
   virtual void Send(std::string bytes) = 0;
 
+  // Sends a shared frame (see BroadcastPacket). Thread-safe. Sessions that can queue the
+  // shared buffer directly override this; the default falls back to a private copy.
+  virtual void Send(SharedFrame frame) { Send(std::string(frame.Bytes())); }
+
+  // Like Send(SharedFrame), but for traffic that may be lost (presence, typing): when the
+  // write queue is over its high watermark the frame is shed instead of evicting the session.
+  virtual void SendDroppable(SharedFrame frame) { Send(std::move(frame)); }
+
+  // Bytes queued for writing and not yet acknowledged by the socket. Thread-safe.
+  virtual size_t QueuedBytes() const { return 0; }
+
   // Sends bytes and closes the connection once pending writes are flushed.
   virtual void SendAndClose(std::string bytes) = 0;
 
@@ -22,4 +36,3 @@ public:
 };
 
 } // namespace chirp::network
-
@@ -0,0 +1,15 @@
+#include "network/shared_frame.h"
+
+#include "network/websocket_frame.h"
+
+namespace chirp::network {
+
+SharedFrame::SharedFrame(std::string bytes) {
+  auto rep = std::make_shared<Rep>();
+  rep->bytes = std::move(bytes);
+  rep->ws_header_len = static_cast<uint8_t>(
+      EncodeWebSocketFrameHeader(/*opcode=*/0x2, rep->bytes.size(), /*mask_key=*/nullptr, rep->ws_header.data()));
+  rep_ = std::move(rep);
+}
+
+} // namespace chirp::network
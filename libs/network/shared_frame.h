@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace chirp::network {
+
+// Immutable, refcounted wire bytes for fan-out: encode a packet once and hand the same frame
+// to any number of sessions. Copies share the underlying buffer, and the buffer is never
+// mutated after construction, so a frame may be queued on sessions living on different io
+// threads at the same time.
+//
+// Alongside the raw bytes (what TcpSession writes) the frame carries the header of a
+// server-to-client WebSocket binary message wrapping them, so WebSocketSession can send
+// header + shared bytes as two buffers without re-framing per recipient.
+class SharedFrame {
+public:
+  SharedFrame() = default;
+  explicit SharedFrame(std::string bytes);
+
+  std::string_view Bytes() const { return rep_ ? std::string_view(rep_->bytes) : std::string_view{}; }
+  std::string_view WebSocketHeader() const {
+    return rep_ ? std::string_view(reinterpret_cast<const char*>(rep_->ws_header.data()), rep_->ws_header_len)
+                : std::string_view{};
+  }
+
+  size_t size() const { return rep_ ? rep_->bytes.size() : 0; }
+  bool empty() const { return size() == 0; }
+
+private:
+  struct Rep {
+    std::string bytes;
+    std::array<uint8_t, 10> ws_header{};
+    uint8_t ws_header_len{0};
+  };
+
+  std::shared_ptr<const Rep> rep_;
+};
+
+} // namespace chirp::network
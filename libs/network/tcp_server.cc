@@ -8,6 +8,11 @@ TcpServer::TcpServer(asio::io_context& io, uint16_t port, FrameCallback on_frame
       on_frame_(std::move(on_frame)),
       on_close_(std::move(on_close)) {}
 
+TcpServer::TcpServer(IoContextPool& pool, uint16_t port, FrameCallback on_frame, CloseCallback on_close)
+    : TcpServer(pool.MainIoContext(), port, std::move(on_frame), std::move(on_close)) {
+  pool_ = &pool;
+}
+
 void TcpServer::Start() { DoAccept(); }
 
 void TcpServer::Stop() {
@@ -16,9 +21,12 @@ void TcpServer::Stop() {
 }
 
 void TcpServer::DoAccept() {
-  acceptor_.async_accept([this](std::error_code ec, asio::ip::tcp::socket socket) {
+  asio::io_context& target = pool_ ? pool_->GetNextIoContext() : io_;
+  acceptor_.async_accept(target, [this](std::error_code ec, asio::ip::tcp::socket socket) {
     if (!ec) {
       auto session = std::make_shared<TcpSession>(std::move(socket), on_frame_, on_close_);
+      session->SetWriteQueueLimits(write_limits_);
+      session->SetIdleTimeout(idle_timeout_);
       session->Start();
     }
     if (acceptor_.is_open()) {
@@ -1,11 +1,13 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <memory>
 
 #include <asio.hpp>
 
+#include "network/io_context_pool.h"
 #include "network/tcp_session.h"
 
 namespace chirp::network {
@@ -17,6 +19,13 @@ public:
 
   TcpServer(asio::io_context& io, uint16_t port, FrameCallback on_frame, CloseCallback on_close = nullptr);
 
+  // Accepts on the pool's main io_context and hands each new session to the next pool context.
+  TcpServer(IoContextPool& pool, uint16_t port, FrameCallback on_frame, CloseCallback on_close = nullptr);
+
+  // Applied to every session accepted after the call.
+  void SetWriteQueueLimits(const WriteQueueLimits& limits) { write_limits_ = limits; }
+  void SetIdleTimeout(std::chrono::milliseconds timeout) { idle_timeout_ = timeout; }
+
   void Start();
   void Stop();
 
@@ -27,6 +36,9 @@ private:
   asio::ip::tcp::acceptor acceptor_;
   FrameCallback on_frame_;
   CloseCallback on_close_;
+  WriteQueueLimits write_limits_;
+  std::chrono::milliseconds idle_timeout_{0};
+  IoContextPool* pool_{nullptr};
 };
 
 } // namespace chirp::network
@@ -1,6 +1,18 @@
 #include "network/tcp_session.h"
 
+#include "network/network_stats.h"
+
 namespace chirp::network {
+namespace {
+
+constexpr size_t kMinReadSize = 4096;
+
+// Caps for one gathered write (IOV_MAX is >= 1024 on the platforms we ship).
+constexpr size_t kMaxWriteBuffers = 64;
+constexpr size_t kMaxWriteBytes = 256 * 1024;
+
+} // namespace
+
 
 TcpSession::TcpSession(asio::ip::tcp::socket socket, FrameCallback on_frame, CloseCallback on_close)
     : socket_(std::move(socket)),
@@ -8,7 +20,12 @@ TcpSession::TcpSession(asio::ip::tcp::socket socket, FrameCallback on_frame, Clo
       on_frame_(std::move(on_frame)),
       on_close_(std::move(on_close)) {}
 
-void TcpSession::Start() { DoRead(); }
+void TcpSession::Start() {
+  if (idle_timeout_.count() > 0) {
+    asio::post(strand_, [self = shared_from_this()] { self->StartTimers(); });
+  }
+  DoRead();
+}
 
 void TcpSession::Close() {
   asio::post(strand_, [self = shared_from_this()] { self->DoClose(); });
@@ -19,20 +36,27 @@ asio::ip::tcp::endpoint TcpSession::RemoteEndpoint() const {
   return socket_.remote_endpoint(ec);
 }
 
-void TcpSession::Send(std::string bytes) {
-  asio::post(strand_, [self = shared_from_this(), bytes = std::move(bytes)]() mutable {
-    self->write_q_.push_back(std::move(bytes));
-    if (!self->write_in_flight_) {
-      self->write_in_flight_ = true;
-      self->DoWrite();
-    }
-  });
-}
+void TcpSession::Send(std::string bytes) { Enqueue(SharedFrame(std::move(bytes)), false, false); }
+
+void TcpSession::Send(SharedFrame frame) { Enqueue(std::move(frame), false, false); }
+
+void TcpSession::SendDroppable(SharedFrame frame) { Enqueue(std::move(frame), true, false); }
 
-void TcpSession::SendAndClose(std::string bytes) {
-  asio::post(strand_, [self = shared_from_this(), bytes = std::move(bytes)]() mutable {
-    self->close_after_write_ = true;
-    self->write_q_.push_back(std::move(bytes));
+void TcpSession::SendAndClose(std::string bytes) { Enqueue(SharedFrame(std::move(bytes)), false, true); }
+
+void TcpSession::Enqueue(SharedFrame frame, bool droppable, bool close_after) {
+  asio::post(strand_, [self = shared_from_this(), frame = std::move(frame), droppable, close_after]() mutable {
+    if (self->closed_) {
+      return;
+    }
+    if (self->write_q_.Push(std::move(frame), droppable) == WriteQueue::PushResult::kOverflow) {
+      NetworkStats::Instance().slow_consumer_disconnects.fetch_add(1, std::memory_order_relaxed);
+      self->DoClose();
+      return;
+    }
+    if (close_after) {
+      self->close_after_write_ = true;
+    }
     if (!self->write_in_flight_) {
       self->write_in_flight_ = true;
       self->DoWrite();
@@ -42,21 +66,22 @@ void TcpSession::SendAndClose(std::string bytes) {
 
 void TcpSession::DoRead() {
   auto self = shared_from_this();
-  socket_.async_read_some(asio::buffer(read_buf_),
+  auto buf = framer_.PrepareWrite(kMinReadSize);
+  socket_.async_read_some(asio::buffer(buf.data(), buf.size()),
                           asio::bind_executor(strand_, [self](std::error_code ec, std::size_t n) {
                             if (ec) {
                               self->DoClose();
                               return;
                             }
-                            self->framer_.Append(self->read_buf_.data(), n);
-                            while (true) {
-                              auto frame = self->framer_.PopFrame();
-                              if (!frame) {
-                                break;
-                              }
+                            self->framer_.CommitWrite(n);
+                            if (self->wheel_) {
+                              self->last_read_tick_ = self->wheel_->NowTick();
+                            }
+                            while (auto frame = self->framer_.PeekFrame()) {
                               if (self->on_frame_) {
-                                self->on_frame_(std::static_pointer_cast<Session>(self), std::move(*frame));
+                                self->on_frame_(std::static_pointer_cast<Session>(self), *frame);
                               }
+                              self->framer_.ConsumeFrame();
                             }
                             self->DoRead();
                           }));
@@ -64,7 +89,7 @@ void TcpSession::DoRead() {
 
 void TcpSession::DoWrite() {
   auto self = shared_from_this();
-  if (write_q_.empty()) {
+  if (write_q_.Empty()) {
     write_in_flight_ = false;
     if (close_after_write_) {
       DoClose();
@@ -72,22 +97,62 @@ void TcpSession::DoWrite() {
     return;
   }
 
-  asio::async_write(socket_, asio::buffer(write_q_.front()),
+  // Gather everything queued (up to the caps) into one scatter/gather write.
+  write_q_.GatherBatch(write_batch_, kMaxWriteBuffers, kMaxWriteBytes);
+
+  asio::async_write(socket_, write_batch_,
                     asio::bind_executor(strand_, [self](std::error_code ec, std::size_t /*n*/) {
                       if (ec) {
                         self->DoClose();
                         return;
                       }
-                      self->write_q_.pop_front();
+                      self->write_q_.PopBatch();
                       self->DoWrite();
                     }));
 }
 
+void TcpSession::StartTimers() {
+  wheel_ = IoTimingWheel::ForExecutor(socket_.get_executor());
+  if (!wheel_ || closed_) {
+    return;
+  }
+  idle_ticks_ = wheel_->ToTicks(idle_timeout_);
+  last_read_tick_ = wheel_->NowTick();
+  ScheduleTimeoutCheck();
+}
+
+void TcpSession::ScheduleTimeoutCheck() {
+  const uint64_t deadline = last_read_tick_ + idle_ticks_;
+  const uint64_t now = wheel_->NowTick();
+  timeout_timer_ = wheel_->ScheduleTicks(deadline > now ? deadline - now : 1, [weak = weak_from_this()] {
+    if (auto self = weak.lock()) {
+      asio::post(self->strand_, [self] { self->CheckTimeouts(); });
+    }
+  });
+}
+
+void TcpSession::CheckTimeouts() {
+  timeout_timer_ = 0;
+  if (closed_) {
+    return;
+  }
+  if (wheel_->NowTick() >= last_read_tick_ + idle_ticks_) {
+    NetworkStats::Instance().idle_timeouts.fetch_add(1, std::memory_order_relaxed);
+    DoClose();
+    return;
+  }
+  ScheduleTimeoutCheck(); // there was traffic since; sleep until the new deadline
+}
+
 void TcpSession::DoClose() {
   if (closed_) {
     return;
   }
   closed_ = true;
+  if (timeout_timer_) {
+    wheel_->Cancel(timeout_timer_);
+    timeout_timer_ = 0;
+  }
 
   asio::error_code ec;
   socket_.shutdown(asio::ip::tcp::socket::shutdown_both, ec);
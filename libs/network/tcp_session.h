@@ -1,52 +1,77 @@
 #pragma once
 
-#include <array>
-#include <deque>
+#include <chrono>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include <asio.hpp>
 
 #include "network/length_prefixed_framer.h"
 #include "network/session.h"
+#include "network/timing_wheel.h"
+#include "network/write_queue.h"
 
 namespace chirp::network {
 
 class TcpSession : public Session, public std::enable_shared_from_this<TcpSession> {
 public:
-  using FrameCallback = std::function<void(std::shared_ptr<Session>, std::string&& payload)>;
+  // `payload` views the session's receive buffer and is only valid for the duration of the call.
+  using FrameCallback = std::function<void(std::shared_ptr<Session>, std::string_view payload)>;
   using CloseCallback = std::function<void(std::shared_ptr<Session>)>;
 
   TcpSession(asio::ip::tcp::socket socket, FrameCallback on_frame, CloseCallback on_close = nullptr);
 
+  // Call before Start().
+  void SetWriteQueueLimits(const WriteQueueLimits& limits) { write_q_.SetLimits(limits); }
+  // Closes the session once nothing has been read from it for `timeout` (0 disables). Tracked
+  // on the io_context's IoTimingWheel, so it costs one wheel node per session.
+  void SetIdleTimeout(std::chrono::milliseconds timeout) { idle_timeout_ = timeout; }
+
   void Start();
   void Close() override;
   bool IsClosed() const override { return closed_; }
 
   // Sends bytes as-is (caller decides framing). Thread-safe.
   void Send(std::string bytes) override;
+  void Send(SharedFrame frame) override;
+  void SendDroppable(SharedFrame frame) override;
 
   // Sends bytes and closes the connection once pending writes are flushed.
   void SendAndClose(std::string bytes) override;
 
+  size_t QueuedBytes() const override { return write_q_.QueuedBytes(); }
+
   asio::ip::tcp::endpoint RemoteEndpoint() const;
 
 private:
   void DoRead();
+  void Enqueue(SharedFrame frame, bool droppable, bool close_after);
   void DoWrite();
   void DoClose();
+  void StartTimers();
+  void ScheduleTimeoutCheck();
+  void CheckTimeouts();
 
   asio::ip::tcp::socket socket_;
   asio::strand<asio::any_io_executor> strand_;
   FrameCallback on_frame_;
   CloseCallback on_close_;
 
-  std::array<uint8_t, 4096> read_buf_{};
   LengthPrefixedFramer framer_;
 
-  std::deque<std::string> write_q_;
+  // Idle tracking: reads only store the current tick; the wheel timer re-checks lazily.
+  std::chrono::milliseconds idle_timeout_{0};
+  IoTimingWheel* wheel_{nullptr};
+  uint64_t idle_ticks_{0};
+  uint64_t last_read_tick_{0};
+  IoTimingWheel::TimerId timeout_timer_{0};
+
+  WriteQueue write_q_;
+  std::vector<asio::const_buffer> write_batch_;
   bool write_in_flight_{false};
   bool close_after_write_{false};
   bool closed_{false};
@@ -0,0 +1,217 @@
+#include "network/timing_wheel.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace chirp::network {
+
+TimingWheel::TimerId TimingWheel::Schedule(uint64_t ticks, Callback cb) {
+  constexpr uint64_t kMaxTicks = (uint64_t{1} << (kLevels * kSlotBits)) - 1;
+
+  uint32_t index;
+  if (!free_.empty()) {
+    index = free_.back();
+    free_.pop_back();
+  } else {
+    index = static_cast<uint32_t>(nodes_.size());
+    nodes_.emplace_back();
+  }
+  Node& node = nodes_[index];
+  node.expiry = tick_ + std::clamp<uint64_t>(ticks, 1, kMaxTicks);
+  node.cb = std::move(cb);
+  Place(index);
+  ++size_;
+  return (static_cast<uint64_t>(node.generation) << 32) | (static_cast<uint64_t>(index) + 1);
+}
+
+bool TimingWheel::Cancel(TimerId id) {
+  const uint64_t low = id & 0xFFFFFFFFu;
+  if (low == 0 || low > nodes_.size()) {
+    return false;
+  }
+  const auto index = static_cast<uint32_t>(low - 1);
+  Node& node = nodes_[index];
+  if (node.list == kNil || node.generation != static_cast<uint32_t>(id >> 32)) {
+    return false;
+  }
+  Unlink(index);
+  Release(index);
+  return true;
+}
+
+size_t TimingWheel::AdvanceTo(uint64_t tick) {
+  size_t fired = 0;
+  if (size_ == 0) {
+    tick_ = std::max(tick_, tick + 1); // nothing pending: no slots to visit
+    return 0;
+  }
+  while (tick_ <= tick) {
+    if (size_ == 0) {
+      tick_ = tick + 1;
+      break;
+    }
+    // Every 64 ticks the next level-1 slot is due and is spread over level 0; likewise upward.
+    const size_t slot = tick_ & (kSlots - 1);
+    if (slot == 0) {
+      for (int level = 1; level < kLevels && Cascade(level) == 0; ++level) {
+      }
+    }
+
+    // Detach the slot first: callbacks may schedule into it (for a later round) or cancel
+    // timers that are due in this same tick.
+    while (heads_[slot] != kNil) {
+      const uint32_t index = heads_[slot];
+      Unlink(index);
+      Link(index, kFiring);
+    }
+    while (heads_[kFiring] != kNil) {
+      const uint32_t index = heads_[kFiring];
+      Unlink(index);
+      Callback cb = std::move(nodes_[index].cb);
+      Release(index);
+      ++fired;
+      cb();
+    }
+    ++tick_;
+  }
+  return fired;
+}
+
+void TimingWheel::Place(uint32_t index) {
+  const uint64_t expiry = nodes_[index].expiry;
+  const uint64_t delta = expiry - std::min(expiry, tick_);
+  int level = 0;
+  while (level + 1 < kLevels && delta >= (uint64_t{1} << ((level + 1) * kSlotBits))) {
+    ++level;
+  }
+  const size_t slot = (expiry >> (level * kSlotBits)) & (kSlots - 1);
+  Link(index, static_cast<uint32_t>(level * kSlots + slot));
+}
+
+void TimingWheel::Link(uint32_t index, uint32_t list) {
+  Node& node = nodes_[index];
+  node.list = list;
+  node.prev = kNil;
+  node.next = heads_[list];
+  if (node.next != kNil) {
+    nodes_[node.next].prev = index;
+  }
+  heads_[list] = index;
+}
+
+void TimingWheel::Unlink(uint32_t index) {
+  Node& node = nodes_[index];
+  if (node.prev != kNil) {
+    nodes_[node.prev].next = node.next;
+  } else {
+    heads_[node.list] = node.next;
+  }
+  if (node.next != kNil) {
+    nodes_[node.next].prev = node.prev;
+  }
+  node.prev = kNil;
+  node.next = kNil;
+  node.list = kNil;
+}
+
+void TimingWheel::Release(uint32_t index) {
+  Node& node = nodes_[index];
+  node.cb = nullptr;
+  ++node.generation; // stale ids no longer match
+  free_.push_back(index);
+  --size_;
+}
+
+size_t TimingWheel::Cascade(int level) {
+  const size_t slot = (tick_ >> (level * kSlotBits)) & (kSlots - 1);
+  const auto list = static_cast<uint32_t>(level * kSlots + slot);
+  uint32_t index = heads_[list];
+  heads_[list] = kNil;
+  while (index != kNil) {
+    const uint32_t next = nodes_[index].next;
+    nodes_[index].list = kNil;
+    Place(index);
+    index = next;
+  }
+  return slot;
+}
+
+asio::execution_context::id IoTimingWheel::id;
+
+IoTimingWheel::IoTimingWheel(asio::io_context& io)
+    : asio::execution_context::service(io), timer_(io), epoch_(std::chrono::steady_clock::now()) {}
+
+void IoTimingWheel::SetTickInterval(std::chrono::milliseconds tick) {
+  if (wheel_.Size() == 0 && tick.count() > 0) {
+    tick_interval_ = tick;
+    epoch_ = std::chrono::steady_clock::now() - tick_interval_ * wheel_.Now();
+  }
+}
+
+uint64_t IoTimingWheel::ToTicks(std::chrono::milliseconds d) const {
+  if (d.count() <= 0) {
+    return 0;
+  }
+  return static_cast<uint64_t>((d.count() + tick_interval_.count() - 1) / tick_interval_.count());
+}
+
+IoTimingWheel* IoTimingWheel::ForExecutor(const asio::any_io_executor& ex) {
+  const auto* io_ex = ex.target<asio::io_context::executor_type>();
+  return io_ex ? &asio::use_service<IoTimingWheel>(io_ex->context()) : nullptr;
+}
+
+IoTimingWheel::TimerId IoTimingWheel::ScheduleTicks(uint64_t ticks, TimingWheel::Callback cb) {
+  if (shut_down_) {
+    return 0;
+  }
+  if (!advancing_ && wheel_.Size() == 0) {
+    Advance(); // the wheel stood still while empty; catch its clock up first
+  }
+  const TimerId id = wheel_.Schedule(ticks, std::move(cb));
+  Arm();
+  return id;
+}
+
+void IoTimingWheel::shutdown() {
+  shut_down_ = true;
+  asio::error_code ec;
+  timer_.cancel(ec);
+  wheel_ = TimingWheel(); // drop callbacks (and what they capture) before the context dies
+}
+
+void IoTimingWheel::Arm() {
+  if (armed_ || advancing_ || shut_down_ || wheel_.Size() == 0) {
+    return;
+  }
+  armed_ = true;
+  timer_.expires_at(epoch_ + tick_interval_ * (wheel_.Now() + 1));
+  timer_.async_wait([this](std::error_code ec) {
+    armed_ = false;
+    if (ec || shut_down_) {
+      return;
+    }
+    OnTick();
+  });
+}
+
+void IoTimingWheel::OnTick() {
+  Advance();
+  Arm();
+}
+
+void IoTimingWheel::Advance() {
+  const uint64_t elapsed = ElapsedTicks();
+  if (elapsed == 0) {
+    return;
+  }
+  advancing_ = true;
+  wheel_.AdvanceTo(elapsed - 1);
+  advancing_ = false;
+}
+
+uint64_t IoTimingWheel::ElapsedTicks() const {
+  const auto since = std::chrono::steady_clock::now() - epoch_;
+  return static_cast<uint64_t>(since / tick_interval_);
+}
+
+} // namespace chirp::network
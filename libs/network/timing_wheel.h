@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <asio.hpp>
+
+namespace chirp::network {
+
+// Hierarchical timing wheel (4 levels x 64 slots, ~16.7M ticks of range). Schedule and Cancel
+// are O(1); each tick fires one level-0 slot and, every 64 ticks, cascades one higher slot down.
+// Timers are stored in a node pool, so a million sessions cost a million small nodes and no
+// per-timer OS or asio state. Not thread-safe.
+class TimingWheel {
+public:
+  using TimerId = uint64_t; // 0 is never a valid id
+  using Callback = std::function<void()>;
+
+  // Schedules `cb` to run when tick Now() + `ticks` is processed (`ticks` is at least 1). Delays
+  // beyond the wheel's range are clamped to it.
+  TimerId Schedule(uint64_t ticks, Callback cb);
+
+  // Returns false if the timer already fired or was cancelled.
+  bool Cancel(TimerId id);
+
+  // Processes ticks up to and including `tick`, running due callbacks. Callbacks may schedule
+  // and cancel timers. Returns the number of callbacks run.
+  size_t AdvanceTo(uint64_t tick);
+
+  // The next tick to be processed.
+  uint64_t Now() const { return tick_; }
+  size_t Size() const { return size_; }
+
+private:
+  static constexpr int kLevels = 4;
+  static constexpr int kSlotBits = 6;
+  static constexpr size_t kSlots = size_t{1} << kSlotBits;
+  static constexpr uint32_t kNil = UINT32_MAX;
+  static constexpr uint32_t kFiring = kLevels * kSlots; // list of timers due this tick
+
+  struct Node {
+    uint64_t expiry{0};
+    Callback cb;
+    uint32_t prev{kNil};
+    uint32_t next{kNil};
+    uint32_t list{kNil}; // slot list the node is linked into, kNil when free
+    uint32_t generation{0};
+  };
+
+  void Place(uint32_t index);
+  void Link(uint32_t index, uint32_t list);
+  void Unlink(uint32_t index);
+  void Release(uint32_t index);
+  // Re-places every timer of a higher-level slot; returns the slot number.
+  size_t Cascade(int level);
+
+  std::vector<Node> nodes_;
+  std::vector<uint32_t> free_;
+  std::array<uint32_t, kLevels * kSlots + 1> heads_ = MakeHeads();
+  uint64_t tick_{0};
+  size_t size_{0};
+
+  static std::array<uint32_t, kLevels * kSlots + 1> MakeHeads() {
+    std::array<uint32_t, kLevels * kSlots + 1> heads;
+    heads.fill(kNil);
+    return heads;
+  }
+};
+
+// One TimingWheel per io_context, driven by a single steady_timer that only runs while timers
+// are pending. Obtain it with asio::use_service<IoTimingWheel>(io) and use it only from that
+// io_context's thread (IoContextPool runs each context on exactly one thread, so session strands
+// on the context qualify).
+class IoTimingWheel : public asio::execution_context::service {
+public:
+  using TimerId = TimingWheel::TimerId;
+
+  static constexpr std::chrono::milliseconds kDefaultTick{100};
+  static asio::execution_context::id id;
+
+  explicit IoTimingWheel(asio::io_context& io);
+
+  // The wheel of the io_context behind `ex`, or nullptr if `ex` is not an io_context executor.
+  static IoTimingWheel* ForExecutor(const asio::any_io_executor& ex);
+
+  // Resolution of the wheel. Only takes effect while no timers are pending.
+  void SetTickInterval(std::chrono::milliseconds tick);
+  std::chrono::milliseconds TickInterval() const { return tick_interval_; }
+
+  TimerId Schedule(std::chrono::milliseconds delay, TimingWheel::Callback cb) {
+    return ScheduleTicks(ToTicks(delay), std::move(cb));
+  }
+  TimerId ScheduleTicks(uint64_t ticks, TimingWheel::Callback cb);
+  bool Cancel(TimerId id) { return wheel_.Cancel(id); }
+
+  // Current time in ticks; cheap enough to call on every read.
+  uint64_t NowTick() const { return wheel_.Now(); }
+  // Rounds `d` up to whole ticks; timers fire up to one tick after their delay.
+  uint64_t ToTicks(std::chrono::milliseconds d) const;
+  size_t Size() const { return wheel_.Size(); }
+
+private:
+  void shutdown() override;
+  void Arm();
+  void OnTick();
+  // Runs every tick that has elapsed on the steady clock.
+  void Advance();
+  uint64_t ElapsedTicks() const;
+
+  asio::steady_timer timer_;
+  std::chrono::milliseconds tick_interval_{kDefaultTick};
+  std::chrono::steady_clock::time_point epoch_;
+  TimingWheel wheel_;
+  bool armed_{false};
+  bool advancing_{false}; // callbacks are running; they may schedule but must not advance
+  bool shut_down_{false};
+};
+
+} // namespace chirp::network
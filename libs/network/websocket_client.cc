@@ -1,6 +1,7 @@
 #include "websocket_client.h"
 
 #include "common/logger.h"
+#include "websocket_util.h"
 #include "websocket_utils.h"
 
 using chirp::common::Logger;
@@ -31,7 +32,9 @@ bool WebSocketClient::Connect(const std::string& host, uint16_t port, const std:
     }
 
     // Send WebSocket handshake using helper function
-    std::string handshake = BuildWebSocketHandshake(host, port, path);
+    const bool offer_deflate = deflate_config_.enabled && PerMessageDeflateAvailable();
+    std::string handshake = BuildWebSocketHandshake(
+        host, port, path, offer_deflate ? FormatPerMessageDeflateOffer(deflate_config_) : "");
 
     asio::write(socket_, asio::buffer(handshake), ec);
     if (ec) {
@@ -39,23 +42,49 @@ bool WebSocketClient::Connect(const std::string& host, uint16_t port, const std:
       return false;
     }
 
-    // Read response
+    // Read response up to the end of its head; the server may send frames right behind it.
+    // The head is capped like an upgrade request on the server side.
+    std::string received;
+    size_t head_end = std::string::npos;
     std::array<char, 1024> response_buf;
-    size_t bytes_read = socket_.read_some(asio::buffer(response_buf), ec);
-    if (ec) {
-      Logger::Instance().Error("WebSocket handshake response failed: " + ec.message());
-      return false;
+    while (head_end == std::string::npos) {
+      size_t bytes_read = socket_.read_some(asio::buffer(response_buf), ec);
+      if (ec) {
+        Logger::Instance().Error("WebSocket handshake response failed: " + ec.message());
+        return false;
+      }
+      const size_t scanned = received.size();
+      received.append(response_buf.data(), bytes_read);
+      // Back up 3 bytes in case "\r\n\r\n" straddles reads.
+      head_end = received.find("\r\n\r\n", scanned > 3 ? scanned - 3 : 0);
+      const size_t head_len = head_end == std::string::npos ? received.size() : head_end + 4;
+      if (head_len > max_handshake_bytes_) {
+        Logger::Instance().Error("WebSocket handshake failed: response head exceeds " +
+                                 std::to_string(max_handshake_bytes_) + " bytes");
+        return false;
+      }
     }
 
-    std::string response(response_buf.data(), bytes_read);
+    std::string response = received.substr(0, head_end + 4);
     if (!IsWebSocketUpgradeSuccessful(response)) {
       Logger::Instance().Error("WebSocket handshake failed: Invalid response");
       return false;
     }
 
+    std::optional<PerMessageDeflateParams> deflate;
+    const std::string_view extensions = FindHttpHeader(response, "Sec-WebSocket-Extensions");
+    if (!extensions.empty()) {
+      deflate = offer_deflate ? ParsePerMessageDeflateResponse(extensions) : std::nullopt;
+      if (!deflate) {
+        Logger::Instance().Error("WebSocket handshake failed: unexpected extensions: " + std::string(extensions));
+        return false;
+      }
+    }
+
     // Create session with stored callbacks and start it
     session_ = std::make_shared<WebSocketSession>(std::move(socket_), on_frame_, on_close_);
-    session_->Start();
+    session_->SetPerMessageDeflate(deflate_config_);
+    session_->StartClient(std::string_view(received).substr(head_end + 4), deflate);
     return true;
   } catch (const std::exception& e) {
     Logger::Instance().Error(std::string("WebSocket connect exception: ") + e.what());
@@ -28,12 +28,20 @@ public:
 
   void SetCallbacks(FrameCallback on_frame, CloseCallback on_close = nullptr);
 
+  // Offers permessage-deflate in the handshake; used only if the server accepts it.
+  void SetPerMessageDeflate(const PerMessageDeflateConfig& config) { deflate_config_ = config; }
+
+  // Largest handshake response head accepted; Connect() fails past it.
+  void SetMaxHandshakeSize(size_t bytes) { max_handshake_bytes_ = bytes; }
+
 private:
   asio::io_context& io_;
   asio::ip::tcp::socket socket_;
   std::shared_ptr<WebSocketSession> session_;
   FrameCallback on_frame_;
   CloseCallback on_close_;
+  PerMessageDeflateConfig deflate_config_;
+  size_t max_handshake_bytes_{WebSocketSession::kDefaultMaxHandshakeBytes};
 };
 
 } // namespace network
@@ -0,0 +1,434 @@
+#include "network/websocket_deflate.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "network/network_stats.h"
+
+#if CHIRP_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace chirp::network {
+namespace {
+
+constexpr int kDefaultWindowBits = 15;
+// zlib cannot produce raw deflate with an 8-bit window (it silently uses 9).
+constexpr int kMinWindowBits = 9;
+
+std::string_view Trim(std::string_view s) {
+  auto is_ws = [](char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; };
+  while (!s.empty() && is_ws(s.front())) {
+    s.remove_prefix(1);
+  }
+  while (!s.empty() && is_ws(s.back())) {
+    s.remove_suffix(1);
+  }
+  return s;
+}
+
+bool IEquals(std::string_view a, std::string_view b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    char x = a[i];
+    char y = b[i];
+    if (x >= 'A' && x <= 'Z') {
+      x = static_cast<char>(x - 'A' + 'a');
+    }
+    if (y >= 'A' && y <= 'Z') {
+      y = static_cast<char>(y - 'A' + 'a');
+    }
+    if (x != y) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Calls fn(piece) for each `sep`-separated piece of `s`, trimmed.
+template <typename Fn>
+void ForEachPiece(std::string_view s, char sep, Fn&& fn) {
+  while (true) {
+    const size_t pos = s.find(sep);
+    fn(Trim(s.substr(0, pos)));
+    if (pos == std::string_view::npos) {
+      return;
+    }
+    s.remove_prefix(pos + 1);
+  }
+}
+
+std::optional<int> ParseWindowBits(std::string_view value) {
+  if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+    value = value.substr(1, value.size() - 2);
+  }
+  if (value.empty() || value.size() > 2) {
+    return std::nullopt;
+  }
+  int bits = 0;
+  for (char c : value) {
+    if (c < '0' || c > '9') {
+      return std::nullopt;
+    }
+    bits = bits * 10 + (c - '0');
+  }
+  if (bits < 8 || bits > 15) {
+    return std::nullopt;
+  }
+  return bits;
+}
+
+// Parses one extension element ("permessage-deflate; a; b=1"). `client_max_window_bits` may
+// appear without a value in offers only.
+std::optional<PerMessageDeflateParams> ParseElement(std::string_view element, bool is_offer) {
+  PerMessageDeflateParams params;
+  bool first = true;
+  bool ok = true;
+  bool seen[4] = {false, false, false, false};
+  ForEachPiece(element, ';', [&](std::string_view token) {
+    if (!ok) {
+      return;
+    }
+    if (first) {
+      first = false;
+      ok = IEquals(token, "permessage-deflate");
+      return;
+    }
+    const size_t eq = token.find('=');
+    const std::string_view name = Trim(token.substr(0, eq));
+    const std::optional<std::string_view> value =
+        eq == std::string_view::npos ? std::nullopt : std::optional<std::string_view>(Trim(token.substr(eq + 1)));
+
+    int index = -1;
+    if (IEquals(name, "server_no_context_takeover") && !value) {
+      index = 0;
+      params.server_no_context_takeover = true;
+    } else if (IEquals(name, "client_no_context_takeover") && !value) {
+      index = 1;
+      params.client_no_context_takeover = true;
+    } else if (IEquals(name, "server_max_window_bits") && value) {
+      index = 2;
+      const auto bits = ParseWindowBits(*value);
+      ok = bits.has_value();
+      params.server_max_window_bits = bits.value_or(kDefaultWindowBits);
+    } else if (IEquals(name, "client_max_window_bits") && (value || is_offer)) {
+      index = 3;
+      if (value) {
+        const auto bits = ParseWindowBits(*value);
+        ok = bits.has_value();
+        params.client_max_window_bits = bits.value_or(kDefaultWindowBits);
+      }
+    } else {
+      ok = false;
+      return;
+    }
+    ok = ok && !seen[index];
+    seen[index] = true;
+  });
+  if (!ok || first) {
+    return std::nullopt;
+  }
+  return params;
+}
+
+int64_t ElapsedNs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+std::optional<PerMessageDeflateParams> NegotiatePerMessageDeflate(std::string_view offers,
+                                                                  const PerMessageDeflateConfig& config) {
+  if (!config.enabled || !PerMessageDeflateAvailable()) {
+    return std::nullopt;
+  }
+  std::optional<PerMessageDeflateParams> accepted;
+  ForEachPiece(offers, ',', [&](std::string_view element) {
+    if (accepted) {
+      return;
+    }
+    auto params = ParseElement(element, /*is_offer=*/true);
+    if (!params || params->server_max_window_bits < kMinWindowBits) {
+      return;
+    }
+    // We inflate with a full window whatever the client uses, so its window is not restricted.
+    params->client_max_window_bits = kDefaultWindowBits;
+    if (!config.context_takeover) {
+      params->server_no_context_takeover = true;
+      params->client_no_context_takeover = true;
+    }
+    accepted = params;
+  });
+  return accepted;
+}
+
+std::string FormatPerMessageDeflateResponse(const PerMessageDeflateParams& params) {
+  std::string out = "permessage-deflate";
+  if (params.server_no_context_takeover) {
+    out += "; server_no_context_takeover";
+  }
+  if (params.client_no_context_takeover) {
+    out += "; client_no_context_takeover";
+  }
+  if (params.server_max_window_bits != kDefaultWindowBits) {
+    out += "; server_max_window_bits=" + std::to_string(params.server_max_window_bits);
+  }
+  return out;
+}
+
+std::string FormatPerMessageDeflateOffer(const PerMessageDeflateConfig& config) {
+  std::string out = "permessage-deflate; client_max_window_bits";
+  if (!config.context_takeover) {
+    out += "; server_no_context_takeover; client_no_context_takeover";
+  }
+  return out;
+}
+
+std::optional<PerMessageDeflateParams> ParsePerMessageDeflateResponse(std::string_view response) {
+  auto params = ParseElement(Trim(response), /*is_offer=*/false);
+  if (!params || params->client_max_window_bits < kMinWindowBits) {
+    return std::nullopt;
+  }
+  return params;
+}
+
+#if CHIRP_HAVE_ZLIB
+
+namespace {
+
+// Free lists of initialized z_streams keyed by (kind, level, window bits). Reset on release,
+// so a lease starts from a clean state without another deflateInit2/inflateInit2.
+class ZStreamPool {
+public:
+  static ZStreamPool& Instance() {
+    static ZStreamPool pool;
+    return pool;
+  }
+
+  z_stream* Acquire(bool deflater, int level, int window_bits) {
+    const int key = Key(deflater, level, window_bits);
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      auto& free = free_[key];
+      if (!free.empty()) {
+        z_stream* zs = free.back();
+        free.pop_back();
+        return zs;
+      }
+    }
+    auto* zs = new z_stream{};
+    const int rc = deflater ? deflateInit2(zs, level, Z_DEFLATED, -window_bits, 8, Z_DEFAULT_STRATEGY)
+                            : inflateInit2(zs, -window_bits);
+    if (rc != Z_OK) {
+      delete zs;
+      return nullptr;
+    }
+    return zs;
+  }
+
+  void Release(z_stream* zs, bool deflater, int level, int window_bits) {
+    if (!zs) {
+      return;
+    }
+    if ((deflater ? deflateReset(zs) : inflateReset(zs)) == Z_OK) {
+      std::lock_guard<std::mutex> lock(mu_);
+      auto& free = free_[Key(deflater, level, window_bits)];
+      if (free.size() < kMaxPooledPerKey) {
+        free.push_back(zs);
+        return;
+      }
+    }
+    if (deflater) {
+      deflateEnd(zs);
+    } else {
+      inflateEnd(zs);
+    }
+    delete zs;
+  }
+
+private:
+  static constexpr size_t kMaxPooledPerKey = 256;
+
+  static int Key(bool deflater, int level, int window_bits) {
+    return (deflater ? 1 << 16 : 0) | ((level & 0xFF) << 8) | window_bits;
+  }
+
+  std::mutex mu_;
+  std::unordered_map<int, std::vector<z_stream*>> free_;
+};
+
+constexpr uint8_t kDeflateTail[4] = {0x00, 0x00, 0xFF, 0xFF};
+constexpr size_t kInflateChunk = 16 * 1024;
+
+} // namespace
+
+bool PerMessageDeflateAvailable() { return true; }
+
+struct PerMessageDeflate::Impl {
+  int level{Z_DEFAULT_COMPRESSION};
+  int deflate_window_bits{kDefaultWindowBits};
+  bool deflate_reset_per_message{false};
+  bool inflate_reset_per_message{false};
+
+  z_stream* deflater{nullptr};
+  z_stream* inflater{nullptr};
+  size_t message_out{0};
+
+  ~Impl() {
+    ZStreamPool::Instance().Release(deflater, true, level, deflate_window_bits);
+    ZStreamPool::Instance().Release(inflater, false, 0, kDefaultWindowBits);
+  }
+
+  // Feeds `len` bytes to the inflater, appending output to `out`.
+  InflateResult Inflate(const uint8_t* in, size_t len, InputBuffer* out, size_t max_out) {
+    inflater->next_in = const_cast<Bytef*>(in);
+    inflater->avail_in = static_cast<uInt>(len);
+    do {
+      auto dst = out->PrepareWrite(kInflateChunk);
+      inflater->next_out = dst.data();
+      inflater->avail_out = static_cast<uInt>(dst.size());
+      const int rc = inflate(inflater, Z_SYNC_FLUSH);
+      const size_t produced = dst.size() - inflater->avail_out;
+      out->CommitWrite(produced);
+      message_out += produced;
+      if (message_out > max_out) {
+        return InflateResult::kTooLarge;
+      }
+      if (rc == Z_STREAM_END) {
+        // The peer closed the block stream (BFINAL); the next bytes start a new one.
+        if (inflateReset(inflater) != Z_OK) {
+          return InflateResult::kError;
+        }
+      } else if (rc == Z_BUF_ERROR) {
+        break; // no more progress possible with the input given
+      } else if (rc != Z_OK) {
+        return InflateResult::kError;
+      }
+    } while (inflater->avail_in > 0 || inflater->avail_out == 0);
+    return InflateResult::kOk;
+  }
+};
+
+PerMessageDeflate::PerMessageDeflate(const PerMessageDeflateParams& params, bool is_server,
+                                     const PerMessageDeflateConfig& config)
+    : impl_(std::make_unique<Impl>()) {
+  impl_->level = config.level;
+  impl_->deflate_window_bits =
+      std::max(kMinWindowBits, is_server ? params.server_max_window_bits : params.client_max_window_bits);
+  impl_->deflate_reset_per_message =
+      !config.context_takeover ||
+      (is_server ? params.server_no_context_takeover : params.client_no_context_takeover);
+  impl_->inflate_reset_per_message =
+      is_server ? params.client_no_context_takeover : params.server_no_context_takeover;
+}
+
+PerMessageDeflate::~PerMessageDeflate() = default;
+
+bool PerMessageDeflate::KeepsContext() const { return !impl_->deflate_reset_per_message; }
+
+bool PerMessageDeflate::Compress(std::string_view in, std::string* out) {
+  const auto start = std::chrono::steady_clock::now();
+  auto& pool = ZStreamPool::Instance();
+  if (!impl_->deflater) {
+    impl_->deflater = pool.Acquire(true, impl_->level, impl_->deflate_window_bits);
+    if (!impl_->deflater) {
+      return false;
+    }
+  }
+  z_stream* zs = impl_->deflater;
+
+  const size_t base = out->size();
+  size_t written = base;
+  out->resize(base + deflateBound(zs, static_cast<uLong>(in.size())) + 16);
+  zs->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+  zs->avail_in = static_cast<uInt>(in.size());
+  do {
+    if (out->size() - written < 64) {
+      out->resize(out->size() * 2);
+    }
+    zs->next_out = reinterpret_cast<Bytef*>(out->data() + written);
+    zs->avail_out = static_cast<uInt>(out->size() - written);
+    if (deflate(zs, Z_SYNC_FLUSH) == Z_STREAM_ERROR) {
+      out->resize(base);
+      return false;
+    }
+    written = out->size() - zs->avail_out;
+  } while (zs->avail_out == 0);
+
+  // A sync flush always ends with an empty stored block; the receiver re-appends it.
+  if (written - base >= 4 && std::memcmp(out->data() + written - 4, kDeflateTail, 4) == 0) {
+    written -= 4;
+  }
+  out->resize(written);
+
+  if (impl_->deflate_reset_per_message) {
+    pool.Release(impl_->deflater, true, impl_->level, impl_->deflate_window_bits);
+    impl_->deflater = nullptr;
+  }
+
+  auto& stats = NetworkStats::Instance();
+  stats.deflate_in_bytes.fetch_add(in.size(), std::memory_order_relaxed);
+  stats.deflate_out_bytes.fetch_add(written - base, std::memory_order_relaxed);
+  stats.deflate_ns.fetch_add(ElapsedNs(start), std::memory_order_relaxed);
+  return true;
+}
+
+PerMessageDeflate::InflateResult PerMessageDeflate::Decompress(const uint8_t* in, size_t len, bool last,
+                                                               InputBuffer* out, size_t max_out) {
+  const auto start = std::chrono::steady_clock::now();
+  auto& pool = ZStreamPool::Instance();
+  if (!impl_->inflater) {
+    impl_->inflater = pool.Acquire(false, 0, kDefaultWindowBits);
+    if (!impl_->inflater) {
+      return InflateResult::kError;
+    }
+  }
+
+  const size_t out_before = impl_->message_out;
+  InflateResult result = len > 0 ? impl_->Inflate(in, len, out, max_out) : InflateResult::kOk;
+  if (result == InflateResult::kOk && last) {
+    result = impl_->Inflate(kDeflateTail, sizeof(kDeflateTail), out, max_out);
+  }
+
+  auto& stats = NetworkStats::Instance();
+  stats.inflate_in_bytes.fetch_add(len, std::memory_order_relaxed);
+  stats.inflate_out_bytes.fetch_add(impl_->message_out - out_before, std::memory_order_relaxed);
+  stats.inflate_ns.fetch_add(ElapsedNs(start), std::memory_order_relaxed);
+
+  if (last) {
+    impl_->message_out = 0;
+    if (impl_->inflate_reset_per_message) {
+      pool.Release(impl_->inflater, false, 0, kDefaultWindowBits);
+      impl_->inflater = nullptr;
+    }
+  }
+  return result;
+}
+
+#else // !CHIRP_HAVE_ZLIB
+
+bool PerMessageDeflateAvailable() { return false; }
+
+struct PerMessageDeflate::Impl {};
+
+PerMessageDeflate::PerMessageDeflate(const PerMessageDeflateParams&, bool, const PerMessageDeflateConfig&) {}
+
+PerMessageDeflate::~PerMessageDeflate() = default;
+
+bool PerMessageDeflate::KeepsContext() const { return false; }
+
+bool PerMessageDeflate::Compress(std::string_view, std::string*) { return false; }
+
+PerMessageDeflate::InflateResult PerMessageDeflate::Decompress(const uint8_t*, size_t, bool, InputBuffer*, size_t) {
+  return InflateResult::kError;
+}
+
+#endif // CHIRP_HAVE_ZLIB
+
+} // namespace chirp::network
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "network/input_buffer.h"
+
+namespace chirp::network {
+
+// permessage-deflate (RFC 7692) settings for one side of a deployment.
+struct PerMessageDeflateConfig {
+  bool enabled{false};
+  // Keep the LZ77 window between messages: better ratio for chatty sessions, at the cost of
+  // ~300 KB of zlib state per direction held for the session's lifetime. When off, both
+  // sides reset per message and the zlib state goes back to a shared pool in between.
+  bool context_takeover{true};
+  int level{6};
+  // Smaller messages are sent uncompressed (RSV1 is per message).
+  size_t min_message_bytes{256};
+};
+
+// Parameters agreed in the handshake.
+struct PerMessageDeflateParams {
+  bool server_no_context_takeover{false};
+  bool client_no_context_takeover{false};
+  int server_max_window_bits{15};
+  int client_max_window_bits{15};
+};
+
+// False when built without zlib; negotiation then never accepts an offer.
+bool PerMessageDeflateAvailable();
+
+// Server: picks the first acceptable permessage-deflate offer from a Sec-WebSocket-Extensions
+// value. Returns nullopt if there is none (the connection proceeds uncompressed).
+std::optional<PerMessageDeflateParams> NegotiatePerMessageDeflate(std::string_view offers,
+                                                                  const PerMessageDeflateConfig& config);
+std::string FormatPerMessageDeflateResponse(const PerMessageDeflateParams& params);
+
+// Client: the offer to send, and the server's response parsed back. A response the client
+// cannot honour yields nullopt and the connection must be failed.
+std::string FormatPerMessageDeflateOffer(const PerMessageDeflateConfig& config);
+std::optional<PerMessageDeflateParams> ParsePerMessageDeflateResponse(std::string_view response);
+
+// Per-session compressor/decompressor. zlib streams are leased from a process-wide pool: for
+// the session's lifetime with context takeover, otherwise only while a message is processed.
+// Not thread-safe; driven by the session strand.
+class PerMessageDeflate {
+public:
+  enum class InflateResult { kOk, kTooLarge, kError };
+
+  PerMessageDeflate(const PerMessageDeflateParams& params, bool is_server, const PerMessageDeflateConfig& config);
+  ~PerMessageDeflate();
+
+  PerMessageDeflate(const PerMessageDeflate&) = delete;
+  PerMessageDeflate& operator=(const PerMessageDeflate&) = delete;
+
+  // True when compressed messages depend on earlier ones (no reset between messages).
+  bool KeepsContext() const;
+
+  // Compresses one whole message and appends it to `out` (without the 00 00 ff ff tail).
+  bool Compress(std::string_view in, std::string* out);
+
+  // Inflates the next chunk of a compressed message into `out`. `last` marks the end of the
+  // message. Fails with kTooLarge once the message inflates past `max_out` bytes.
+  InflateResult Decompress(const uint8_t* in, size_t len, bool last, InputBuffer* out, size_t max_out);
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+} // namespace chirp::network
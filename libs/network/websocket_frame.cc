@@ -2,9 +2,20 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <limits>
 #include <random>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CHIRP_WS_MASK_SSE2 1
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#include <immintrin.h>
+#define CHIRP_WS_MASK_AVX2 1
+#endif
+
 namespace chirp::network {
 namespace {
 
@@ -16,121 +27,204 @@ uint64_t ReadU64BE(const uint8_t* p) {
   return v;
 }
 
-} // namespace
+// Every kernel below consumes a multiple of 4 bytes per step, so the key phase never changes
+// between the wide loops and the byte tail.
 
-void WebSocketFrameParser::Append(const uint8_t* data, size_t len) {
-  buf_.append(reinterpret_cast<const char*>(data), len);
+size_t MaskWords(const uint8_t* src, uint8_t* dst, size_t len, uint64_t mask64) {
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t v;
+    std::memcpy(&v, src + i, 8);
+    v ^= mask64;
+    std::memcpy(dst + i, &v, 8);
+  }
+  return i;
 }
 
-std::optional<WebSocketFrame> WebSocketFrameParser::PopFrame() {
-  constexpr size_t kMinHeader = 2;
-  constexpr uint64_t kMaxPayload = 16ULL * 1024 * 1024; // scaffolding safety limit
+#if CHIRP_WS_MASK_SSE2
+size_t MaskSse2(const uint8_t* src, uint8_t* dst, size_t len, uint64_t mask64) {
+  const __m128i m = _mm_set1_epi64x(static_cast<long long>(mask64));
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(v, m));
+  }
+  return i;
+}
+#endif
+
+#if CHIRP_WS_MASK_AVX2
+__attribute__((target("avx2"))) size_t MaskAvx2(const uint8_t* src, uint8_t* dst, size_t len, uint64_t mask64) {
+  const __m256i m = _mm256_set1_epi64x(static_cast<long long>(mask64));
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_xor_si256(v, m));
+  }
+  return i;
+}
 
-  if (buf_.size() < kMinHeader) {
-    return std::nullopt;
+bool CpuHasAvx2() {
+  static const bool has = __builtin_cpu_supports("avx2");
+  return has;
+}
+#endif
+
+} // namespace
+
+void ApplyWebSocketMask(const uint8_t* src, uint8_t* dst, size_t len, const uint8_t* mask_key, size_t key_offset) {
+  uint8_t key[8];
+  for (size_t k = 0; k < 8; ++k) {
+    key[k] = mask_key[(key_offset + k) % 4];
+  }
+  uint64_t mask64;
+  std::memcpy(&mask64, key, 8); // memory order, so it lines up with the bytes it is XORed with
+
+  size_t i = 0;
+#if CHIRP_WS_MASK_AVX2
+  if (len >= 32 && CpuHasAvx2()) {
+    i = MaskAvx2(src, dst, len, mask64);
+  }
+#endif
+#if CHIRP_WS_MASK_SSE2
+  i += MaskSse2(src + i, dst + i, len - i, mask64);
+#endif
+  i += MaskWords(src + i, dst + i, len - i, mask64);
+  for (; i < len; ++i) {
+    dst[i] = static_cast<uint8_t>(src[i] ^ key[i % 4]);
   }
-  const auto* p = reinterpret_cast<const uint8_t*>(buf_.data());
+}
 
-  const uint8_t b0 = p[0];
-  const uint8_t b1 = p[1];
+void WebSocketFrameParser::Append(const uint8_t* data, size_t len) { buf_.Append(data, len); }
 
-  const bool fin = (b0 & 0x80) != 0;
-  const uint8_t opcode = static_cast<uint8_t>(b0 & 0x0F);
-  const bool masked = (b1 & 0x80) != 0;
+bool WebSocketFrameParser::PeekHeader(WebSocketFrameHeader* out) const {
+  constexpr size_t kMinHeader = 2;
 
-  uint64_t payload_len = static_cast<uint8_t>(b1 & 0x7F);
+  const size_t avail = buf_.ReadableBytes();
+  if (avail < kMinHeader) {
+    return false;
+  }
+  const uint8_t* p = buf_.ReadPtr();
+
+  WebSocketFrameHeader h;
+  h.fin = (p[0] & 0x80) != 0;
+  h.rsv = static_cast<uint8_t>((p[0] >> 4) & 0x07);
+  h.opcode = static_cast<uint8_t>(p[0] & 0x0F);
+  h.masked = (p[1] & 0x80) != 0;
+  h.payload_len = static_cast<uint8_t>(p[1] & 0x7F);
   size_t off = 2;
 
-  if (payload_len == 126) {
-    if (buf_.size() < off + 2) {
-      return std::nullopt;
+  if (h.payload_len == 126) {
+    if (avail < off + 2) {
+      return false;
     }
-    payload_len = (static_cast<uint64_t>(static_cast<uint8_t>(p[off])) << 8) |
-                  static_cast<uint64_t>(static_cast<uint8_t>(p[off + 1]));
+    h.payload_len = (static_cast<uint64_t>(p[off]) << 8) | static_cast<uint64_t>(p[off + 1]);
     off += 2;
-  } else if (payload_len == 127) {
-    if (buf_.size() < off + 8) {
-      return std::nullopt;
+  } else if (h.payload_len == 127) {
+    if (avail < off + 8) {
+      return false;
     }
-    payload_len = ReadU64BE(p + off);
+    h.payload_len = ReadU64BE(p + off);
     off += 8;
   }
 
-  if (payload_len > kMaxPayload) {
-    // Too large; drop.
-    buf_.clear();
+  if (h.masked) {
+    if (avail < off + 4) {
+      return false;
+    }
+    std::memcpy(h.mask_key, p + off, 4);
+    off += 4;
+  }
+
+  h.header_len = off;
+  *out = h;
+  return true;
+}
+
+std::optional<WebSocketFrame> WebSocketFrameParser::PopFrame() {
+  constexpr uint64_t kMaxPayload = 16ULL * 1024 * 1024; // scaffolding safety limit
+
+  WebSocketFrameHeader h;
+  if (!PeekHeader(&h)) {
     return std::nullopt;
   }
 
-  uint8_t mask_key[4] = {0, 0, 0, 0};
-  if (masked) {
-    if (buf_.size() < off + 4) {
-      return std::nullopt;
-    }
-    mask_key[0] = p[off];
-    mask_key[1] = p[off + 1];
-    mask_key[2] = p[off + 2];
-    mask_key[3] = p[off + 3];
-    off += 4;
+  if (h.payload_len > kMaxPayload) {
+    // Too large; drop.
+    buf_.Clear();
+    return std::nullopt;
   }
 
-  if (buf_.size() < off + payload_len) {
+  if (buf_.ReadableBytes() < h.header_len + h.payload_len) {
     return std::nullopt;
   }
 
   WebSocketFrame f;
-  f.fin = fin;
-  f.opcode = opcode;
-  f.payload.assign(buf_.data() + off, static_cast<size_t>(payload_len));
-
-  if (masked) {
-    for (size_t i = 0; i < f.payload.size(); ++i) {
-      f.payload[i] = static_cast<char>(static_cast<uint8_t>(f.payload[i]) ^ mask_key[i % 4]);
-    }
+  f.fin = h.fin;
+  f.opcode = h.opcode;
+  f.payload.resize(static_cast<size_t>(h.payload_len));
+  auto* dst = reinterpret_cast<uint8_t*>(f.payload.data());
+  const uint8_t* src = buf_.ReadPtr() + h.header_len;
+  if (h.masked) {
+    ApplyWebSocketMask(src, dst, f.payload.size(), h.mask_key);
+  } else if (!f.payload.empty()) {
+    std::memcpy(dst, src, f.payload.size());
   }
 
-  buf_.erase(0, off + static_cast<size_t>(payload_len));
+  buf_.Consume(h.header_len + static_cast<size_t>(h.payload_len));
   return f;
 }
 
-std::string BuildWebSocketFrame(uint8_t opcode, const std::string& payload, bool mask) {
-  std::string out;
-  const uint64_t len = payload.size();
-
-  out.push_back(static_cast<char>(0x80 | (opcode & 0x0F))); // FIN=1
-
-  uint8_t b1 = mask ? 0x80 : 0x00;
-  if (len <= 125) {
-    out.push_back(static_cast<char>(b1 | static_cast<uint8_t>(len)));
-  } else if (len <= 65535) {
-    out.push_back(static_cast<char>(b1 | 126));
-    out.push_back(static_cast<char>((len >> 8) & 0xFF));
-    out.push_back(static_cast<char>(len & 0xFF));
+size_t EncodeWebSocketFrameHeader(uint8_t opcode, uint64_t payload_len, const uint8_t* mask_key, uint8_t* out) {
+  size_t off = 0;
+  out[off++] = static_cast<uint8_t>(0x80 | (opcode & 0x0F)); // FIN=1
+
+  const uint8_t b1 = mask_key ? 0x80 : 0x00;
+  if (payload_len <= 125) {
+    out[off++] = static_cast<uint8_t>(b1 | static_cast<uint8_t>(payload_len));
+  } else if (payload_len <= 65535) {
+    out[off++] = static_cast<uint8_t>(b1 | 126);
+    out[off++] = static_cast<uint8_t>((payload_len >> 8) & 0xFF);
+    out[off++] = static_cast<uint8_t>(payload_len & 0xFF);
   } else {
-    out.push_back(static_cast<char>(b1 | 127));
+    out[off++] = static_cast<uint8_t>(b1 | 127);
     for (int i = 7; i >= 0; --i) {
-      out.push_back(static_cast<char>((len >> (i * 8)) & 0xFF));
+      out[off++] = static_cast<uint8_t>((payload_len >> (i * 8)) & 0xFF);
+    }
+  }
+
+  if (mask_key) {
+    for (int i = 0; i < 4; ++i) {
+      out[off++] = mask_key[i];
     }
   }
+  return off;
+}
 
+std::string BuildWebSocketFrame(uint8_t opcode, std::string_view payload, bool mask) {
   uint8_t mask_key[4] = {0, 0, 0, 0};
   if (mask) {
     static thread_local std::mt19937 rng{std::random_device{}()};
     std::uniform_int_distribution<uint32_t> dist(0, 255);
     for (int i = 0; i < 4; ++i) {
       mask_key[i] = static_cast<uint8_t>(dist(rng));
-      out.push_back(static_cast<char>(mask_key[i]));
     }
   }
 
-  if (!mask) {
-    out.append(payload);
+  uint8_t header[kMaxWebSocketFrameHeader];
+  const size_t header_len = EncodeWebSocketFrameHeader(opcode, payload.size(), mask ? mask_key : nullptr, header);
+
+  // Sized once; the payload is copied (and masked) straight into place.
+  std::string out(header_len + payload.size(), '\0');
+  auto* dst = reinterpret_cast<uint8_t*>(out.data());
+  std::memcpy(dst, header, header_len);
+  if (payload.empty()) {
     return out;
   }
-
-  out.reserve(out.size() + payload.size());
-  for (size_t i = 0; i < payload.size(); ++i) {
-    out.push_back(static_cast<char>(static_cast<uint8_t>(payload[i]) ^ mask_key[i % 4]));
+  if (mask) {
+    ApplyWebSocketMask(reinterpret_cast<const uint8_t*>(payload.data()), dst + header_len, payload.size(), mask_key);
+  } else {
+    std::memcpy(dst + header_len, payload.data(), payload.size());
   }
   return out;
 }
@@ -3,7 +3,11 @@
 #include <cstddef>
 #include <cstdint>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+
+#include "network/input_buffer.h"
 
 namespace chirp::network {
 
@@ -13,16 +17,56 @@ struct WebSocketFrame {
   std::string payload;
 };
 
+struct WebSocketFrameHeader {
+  uint8_t opcode{0};
+  bool fin{true};
+  uint8_t rsv{0}; // RSV1..RSV3 as bits 2..0 (0x4 = RSV1, per-message compression)
+  bool masked{false};
+  uint8_t mask_key[4]{0, 0, 0, 0};
+  uint64_t payload_len{0};
+  size_t header_len{0}; // bytes before the payload
+};
+
+// Incremental frame decoder over a receive buffer.
+//
+// Two ways to drain it: PopFrame() returns whole frames as owned strings (clients, tools);
+// PeekHeader() + ReadPtr()/Consume() let the server stream a payload into its destination
+// (unmasking as it goes) without materializing the frame first.
 class WebSocketFrameParser {
 public:
   void Append(const uint8_t* data, size_t len);
+
+  // Zero-copy receive path: read straight into the parser's buffer, then commit what arrived.
+  std::span<uint8_t> PrepareWrite(size_t min_bytes) { return buf_.PrepareWrite(min_bytes); }
+  void CommitWrite(size_t n) { buf_.CommitWrite(n); }
+
+  // Decodes the next frame header once all of it is buffered. Does not consume anything.
+  bool PeekHeader(WebSocketFrameHeader* out) const;
+
+  const uint8_t* ReadPtr() const { return buf_.ReadPtr(); }
+  size_t ReadableBytes() const { return buf_.ReadableBytes(); }
+  std::string_view Readable() const { return buf_.Readable(); }
+  void Consume(size_t n) { buf_.Consume(n); }
+
   std::optional<WebSocketFrame> PopFrame();
-  void Clear() { buf_.clear(); }
+  void Clear() { buf_.Clear(); }
 
 private:
-  std::string buf_;
+  InputBuffer buf_;
 };
 
-std::string BuildWebSocketFrame(uint8_t opcode, const std::string& payload, bool mask);
+// Largest possible frame header: 2 + 8 (64-bit length) + 4 (mask key).
+constexpr size_t kMaxWebSocketFrameHeader = 14;
+
+// Writes a FIN frame header for `payload_len` bytes into `out` (at least kMaxWebSocketFrameHeader
+// bytes) and returns its length. A non-null `mask_key` (4 bytes) sets the MASK bit and appends it.
+size_t EncodeWebSocketFrameHeader(uint8_t opcode, uint64_t payload_len, const uint8_t* mask_key, uint8_t* out);
+
+// Masks/unmasks `len` bytes from `src` into `dst` (which may alias `src`) with the 4-byte
+// `mask_key`, starting at key position `key_offset`. Vectorized (AVX2/SSE2, 64-bit words
+// otherwise).
+void ApplyWebSocketMask(const uint8_t* src, uint8_t* dst, size_t len, const uint8_t* mask_key, size_t key_offset = 0);
+
+std::string BuildWebSocketFrame(uint8_t opcode, std::string_view payload, bool mask);
 
 } // namespace chirp::network
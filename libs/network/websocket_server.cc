@@ -8,6 +8,11 @@ WebSocketServer::WebSocketServer(asio::io_context& io, uint16_t port, FrameCallb
       on_frame_(std::move(on_frame)),
       on_close_(std::move(on_close)) {}
 
+WebSocketServer::WebSocketServer(IoContextPool& pool, uint16_t port, FrameCallback on_frame, CloseCallback on_close)
+    : WebSocketServer(pool.MainIoContext(), port, std::move(on_frame), std::move(on_close)) {
+  pool_ = &pool;
+}
+
 void WebSocketServer::Start() { DoAccept(); }
 
 void WebSocketServer::Stop() {
@@ -16,9 +21,15 @@ void WebSocketServer::Stop() {
 }
 
 void WebSocketServer::DoAccept() {
-  acceptor_.async_accept([this](std::error_code ec, asio::ip::tcp::socket socket) {
+  asio::io_context& target = pool_ ? pool_->GetNextIoContext() : io_;
+  acceptor_.async_accept(target, [this](std::error_code ec, asio::ip::tcp::socket socket) {
     if (!ec) {
       auto session = std::make_shared<WebSocketSession>(std::move(socket), on_frame_, on_close_);
+      session->SetWriteQueueLimits(write_limits_);
+      session->SetMaxMessageSize(max_message_bytes_);
+      session->SetPerMessageDeflate(deflate_config_);
+      session->SetHandshakeTimeout(handshake_timeout_);
+      session->SetIdleTimeout(idle_timeout_);
       session->Start();
     }
     if (acceptor_.is_open()) {
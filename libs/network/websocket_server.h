@@ -1,10 +1,12 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <functional>
 
 #include <asio.hpp>
 
+#include "network/io_context_pool.h"
 #include "network/websocket_session.h"
 
 namespace chirp::network {
@@ -16,6 +18,16 @@ public:
 
   WebSocketServer(asio::io_context& io, uint16_t port, FrameCallback on_frame, CloseCallback on_close = nullptr);
 
+  // Accepts on the pool's main io_context and hands each new session to the next pool context.
+  WebSocketServer(IoContextPool& pool, uint16_t port, FrameCallback on_frame, CloseCallback on_close = nullptr);
+
+  // Applied to every session accepted after the call.
+  void SetWriteQueueLimits(const WriteQueueLimits& limits) { write_limits_ = limits; }
+  void SetMaxMessageSize(size_t bytes) { max_message_bytes_ = bytes; }
+  void SetPerMessageDeflate(const PerMessageDeflateConfig& config) { deflate_config_ = config; }
+  void SetHandshakeTimeout(std::chrono::milliseconds timeout) { handshake_timeout_ = timeout; }
+  void SetIdleTimeout(std::chrono::milliseconds timeout) { idle_timeout_ = timeout; }
+
   void Start();
   void Stop();
 
@@ -26,6 +38,12 @@ private:
   asio::ip::tcp::acceptor acceptor_;
   FrameCallback on_frame_;
   CloseCallback on_close_;
+  WriteQueueLimits write_limits_;
+  size_t max_message_bytes_{WebSocketSession::kDefaultMaxMessageBytes};
+  PerMessageDeflateConfig deflate_config_;
+  std::chrono::milliseconds handshake_timeout_{WebSocketSession::kDefaultHandshakeTimeout};
+  std::chrono::milliseconds idle_timeout_{0};
+  IoContextPool* pool_{nullptr};
 };
 
 } // namespace chirp::network
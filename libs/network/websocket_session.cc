@@ -1,26 +1,24 @@
 #include "network/websocket_session.h"
 
-#include <sstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 
-#include "network/websocket_util.h"
+#include "network/network_stats.h"
 
 namespace chirp::network {
 namespace {
 
-std::string FindHeaderValue(const std::string& headers, const std::string& key) {
-  std::istringstream iss(headers);
-  std::string line;
-  const std::string want = key + ":";
-  while (std::getline(iss, line)) {
-    if (!line.empty() && line.back() == '\r') {
-      line.pop_back();
-    }
-    if (IStartsWith(line, want)) {
-      return TrimAsciiWhitespace(line.substr(want.size()));
-    }
-  }
-  return "";
-}
+constexpr size_t kMinReadSize = 4096;
+
+// Close status codes (RFC 6455 section 7.4.1).
+constexpr uint16_t kCloseProtocolError = 1002;
+constexpr uint16_t kCloseInvalidPayload = 1007;
+constexpr uint16_t kCloseMessageTooBig = 1009;
+
+// Caps for one gathered write (IOV_MAX is >= 1024 on the platforms we ship).
+constexpr size_t kMaxWriteBuffers = 64;
+constexpr size_t kMaxWriteBytes = 256 * 1024;
 
 } // namespace
 
@@ -30,7 +28,26 @@ WebSocketSession::WebSocketSession(asio::ip::tcp::socket socket, FrameCallback o
       on_frame_(std::move(on_frame)),
       on_close_(std::move(on_close)) {}
 
-void WebSocketSession::Start() { DoRead(); }
+void WebSocketSession::Start() {
+  asio::post(strand_, [self = shared_from_this()] { self->StartTimers(); });
+  DoRead();
+}
+
+void WebSocketSession::StartClient(std::string_view leftover, std::optional<PerMessageDeflateParams> deflate) {
+  client_mode_ = true;
+  handshake_done_ = true;
+  if (deflate) {
+    deflate_ = std::make_unique<PerMessageDeflate>(*deflate, /*is_server=*/false, deflate_config_);
+  }
+  ws_parser_.Append(reinterpret_cast<const uint8_t*>(leftover.data()), leftover.size());
+  asio::post(strand_, [self = shared_from_this()] {
+    self->StartTimers();
+    self->ConsumeWebSocketFrames();
+    if (!self->closed_ && !self->input_closed_) {
+      self->DoRead();
+    }
+  });
+}
 
 asio::ip::tcp::endpoint WebSocketSession::RemoteEndpoint() const {
   asio::error_code ec;
@@ -41,26 +58,41 @@ void WebSocketSession::Close() {
   asio::post(strand_, [self = shared_from_this()] { self->DoClose(); });
 }
 
-void WebSocketSession::Send(std::string bytes) {
-  asio::post(strand_, [self = shared_from_this(), bytes = std::move(bytes)]() mutable {
+void WebSocketSession::Send(std::string bytes) { Enqueue(SharedFrame(std::move(bytes)), false, false); }
+
+void WebSocketSession::Send(SharedFrame frame) { Enqueue(std::move(frame), false, false); }
+
+void WebSocketSession::SendDroppable(SharedFrame frame) { Enqueue(std::move(frame), true, false); }
+
+void WebSocketSession::SendAndClose(std::string bytes) { Enqueue(SharedFrame(std::move(bytes)), false, true); }
+
+void WebSocketSession::Enqueue(SharedFrame frame, bool droppable, bool close_after) {
+  asio::post(strand_, [self = shared_from_this(), frame = std::move(frame), droppable, close_after]() mutable {
     if (self->closed_) {
       return;
     }
-    self->write_q_.push_back(BuildWebSocketFrame(/*opcode=*/0x2, bytes, /*mask=*/false));
-    if (!self->write_in_flight_) {
-      self->write_in_flight_ = true;
-      self->DoWrite();
+    WriteQueue::PushResult result;
+    if (self->client_mode_ || self->deflate_) {
+      // Per-connection bytes: the shared frame cannot be sent as is.
+      bool compressed = false;
+      std::string wire = self->EncodeMessage(frame.Bytes(), &compressed);
+      // With context takeover the peer's inflater depends on every compressed message, so
+      // none of them may be shed.
+      if (compressed && self->deflate_->KeepsContext()) {
+        droppable = false;
+      }
+      result = self->write_q_.Push(SharedFrame(std::move(wire)), droppable);
+    } else {
+      result = self->write_q_.Push(std::move(frame), droppable, /*ws_header=*/true);
     }
-  });
-}
-
-void WebSocketSession::SendAndClose(std::string bytes) {
-  asio::post(strand_, [self = shared_from_this(), bytes = std::move(bytes)]() mutable {
-    if (self->closed_) {
+    if (result == WriteQueue::PushResult::kOverflow) {
+      NetworkStats::Instance().slow_consumer_disconnects.fetch_add(1, std::memory_order_relaxed);
+      self->DoClose();
       return;
     }
-    self->close_after_write_ = true;
-    self->write_q_.push_back(BuildWebSocketFrame(/*opcode=*/0x2, bytes, /*mask=*/false));
+    if (close_after) {
+      self->close_after_write_ = true;
+    }
     if (!self->write_in_flight_) {
       self->write_in_flight_ = true;
       self->DoWrite();
@@ -68,115 +100,329 @@ void WebSocketSession::SendAndClose(std::string bytes) {
   });
 }
 
+void WebSocketSession::EnqueueRaw(std::string bytes) {
+  if (write_q_.Push(SharedFrame(std::move(bytes)), /*droppable=*/false) == WriteQueue::PushResult::kOverflow) {
+    NetworkStats::Instance().slow_consumer_disconnects.fetch_add(1, std::memory_order_relaxed);
+    DoClose();
+    return;
+  }
+  if (!write_in_flight_) {
+    write_in_flight_ = true;
+    DoWrite();
+  }
+}
+
+std::string WebSocketSession::EncodeMessage(std::string_view payload, bool* compressed) {
+  *compressed = false;
+  if (deflate_ && payload.size() >= deflate_config_.min_message_bytes) {
+    deflate_out_.clear();
+    *compressed = deflate_->Compress(payload, &deflate_out_);
+  }
+  if (!*compressed) {
+    return BuildWebSocketFrame(/*opcode=*/0x2, payload, /*mask=*/client_mode_);
+  }
+  std::string out = BuildWebSocketFrame(/*opcode=*/0x2, deflate_out_, /*mask=*/client_mode_);
+  out[0] = static_cast<char>(out[0] | 0x40); // RSV1: compressed message
+  return out;
+}
+
 void WebSocketSession::DoRead() {
   auto self = shared_from_this();
-  socket_.async_read_some(asio::buffer(read_buf_),
+  auto buf = ws_parser_.PrepareWrite(kMinReadSize);
+  socket_.async_read_some(asio::buffer(buf.data(), buf.size()),
                           asio::bind_executor(strand_, [self](std::error_code ec, std::size_t n) {
                             if (ec) {
                               self->DoClose();
                               return;
                             }
+                            self->ws_parser_.CommitWrite(n);
+                            if (self->wheel_) {
+                              self->last_read_tick_ = self->wheel_->NowTick();
+                            }
 
-                            if (!self->handshake_done_) {
-                              self->handshake_buf_.append(reinterpret_cast<const char*>(self->read_buf_.data()), n);
-                              if (!self->TryConsumeHandshake()) {
+                            if (!self->handshake_done_ && !self->TryConsumeHandshake()) {
+                              if (!self->closed_ && !self->input_closed_) {
                                 self->DoRead();
-                                return;
                               }
-                            } else {
-                              self->ws_parser_.Append(self->read_buf_.data(), n);
+                              return;
                             }
 
                             self->ConsumeWebSocketFrames();
-                            self->DoRead();
+                            if (!self->closed_ && !self->input_closed_) {
+                              self->DoRead();
+                            }
                           }));
 }
 
-bool WebSocketSession::TryConsumeHandshake() {
-  const size_t end = handshake_buf_.find("\r\n\r\n");
-  if (end == std::string::npos) {
-    return false;
+void WebSocketSession::StartTimers() {
+  if (closed_ || (handshake_done_ && idle_timeout_.count() <= 0) ||
+      (handshake_timeout_.count() <= 0 && idle_timeout_.count() <= 0)) {
+    return;
+  }
+  wheel_ = IoTimingWheel::ForExecutor(socket_.get_executor());
+  if (!wheel_) {
+    return;
   }
+  start_tick_ = wheel_->NowTick();
+  last_read_tick_ = start_tick_;
+  handshake_ticks_ = wheel_->ToTicks(handshake_timeout_);
+  idle_ticks_ = wheel_->ToTicks(idle_timeout_);
+  ScheduleTimeoutCheck();
+}
 
-  const std::string request = handshake_buf_.substr(0, end + 4);
-  std::string leftover = handshake_buf_.substr(end + 4);
-  handshake_buf_.clear();
-  handshake_done_ = true;
+void WebSocketSession::ScheduleTimeoutCheck() {
+  uint64_t deadline = UINT64_MAX;
+  if (!handshake_done_ && handshake_ticks_ > 0) {
+    deadline = start_tick_ + handshake_ticks_;
+  }
+  if (idle_ticks_ > 0) {
+    deadline = std::min(deadline, last_read_tick_ + idle_ticks_);
+  }
+  if (deadline == UINT64_MAX) {
+    return;
+  }
+  const uint64_t now = wheel_->NowTick();
+  timeout_timer_ = wheel_->ScheduleTicks(deadline > now ? deadline - now : 1, [weak = weak_from_this()] {
+    if (auto self = weak.lock()) {
+      asio::post(self->strand_, [self] { self->CheckTimeouts(); });
+    }
+  });
+}
 
-  const std::string key = FindHeaderValue(request, "Sec-WebSocket-Key");
-  const std::string accept = ComputeWebSocketAccept(key);
+void WebSocketSession::CheckTimeouts() {
+  timeout_timer_ = 0;
+  if (closed_) {
+    return;
+  }
+  const uint64_t now = wheel_->NowTick();
+  if (!handshake_done_ && handshake_ticks_ > 0 && now >= start_tick_ + handshake_ticks_) {
+    NetworkStats::Instance().ws_handshake_timeouts.fetch_add(1, std::memory_order_relaxed);
+    DoClose();
+    return;
+  }
+  if (idle_ticks_ > 0 && now >= last_read_tick_ + idle_ticks_) {
+    NetworkStats::Instance().idle_timeouts.fetch_add(1, std::memory_order_relaxed);
+    DoClose();
+    return;
+  }
+  ScheduleTimeoutCheck();
+}
 
-  std::string resp = "HTTP/1.1 101 Switching Protocols\r\n";
-  resp += "Upgrade: websocket\r\n";
-  resp += "Connection: Upgrade\r\n";
-  resp += "Sec-WebSocket-Accept: " + accept + "\r\n\r\n";
+bool WebSocketSession::TryConsumeHandshake() {
+  const std::string_view buffered = ws_parser_.Readable();
+  // Resume where the last read left off; back up 3 bytes in case "\r\n\r\n" straddles reads.
+  const size_t end = buffered.find("\r\n\r\n", handshake_scanned_ > 3 ? handshake_scanned_ - 3 : 0);
+  if (end == std::string_view::npos) {
+    handshake_scanned_ = buffered.size();
+    if (buffered.size() > max_handshake_bytes_) {
+      RejectHandshake(HttpUpgradeError::kTooLarge);
+    }
+    return false;
+  }
+  const size_t head_len = end + 4;
+  if (head_len > max_handshake_bytes_) {
+    RejectHandshake(HttpUpgradeError::kTooLarge);
+    return false;
+  }
 
-  write_q_.push_back(resp);
-  if (!write_in_flight_) {
-    write_in_flight_ = true;
-    DoWrite();
+  // The request is parsed in place; its views stay valid until the Consume() below.
+  HttpUpgradeRequest request;
+  const HttpUpgradeError error = ParseHttpUpgradeRequest(buffered.substr(0, head_len), &request);
+  if (error != HttpUpgradeError::kNone) {
+    RejectHandshake(error);
+    return false;
   }
 
-  if (!leftover.empty()) {
-    ws_parser_.Append(reinterpret_cast<const uint8_t*>(leftover.data()), leftover.size());
+  std::string extensions;
+  if (deflate_config_.enabled && !request.ws_extensions.empty()) {
+    const auto params = NegotiatePerMessageDeflate(request.ws_extensions, deflate_config_);
+    if (params) {
+      deflate_ = std::make_unique<PerMessageDeflate>(*params, /*is_server=*/true, deflate_config_);
+      extensions = FormatPerMessageDeflateResponse(*params);
+    }
   }
+  EnqueueRaw(BuildWebSocketUpgradeResponse(request.ws_key, extensions));
 
+  // Anything after the request stays buffered as the first frame bytes.
+  ws_parser_.Consume(head_len);
+  handshake_done_ = true; // a pending handshake check now only looks at idleness
+  NetworkStats::Instance().ws_handshakes.fetch_add(1, std::memory_order_relaxed);
   return true;
 }
 
+void WebSocketSession::RejectHandshake(HttpUpgradeError error) {
+  NetworkStats::Instance().ws_handshake_rejects.fetch_add(1, std::memory_order_relaxed);
+  input_closed_ = true;
+  close_after_write_ = true;
+  EnqueueRaw(BuildHttpUpgradeRejection(error));
+}
+
 void WebSocketSession::ConsumeWebSocketFrames() {
-  while (true) {
-    auto f = ws_parser_.PopFrame();
-    if (!f) {
+  while (!closed_ && !input_closed_) {
+    if (in_frame_) {
+      ConsumeDataPayload();
+      if (in_frame_) {
+        break; // rest of the payload has not arrived yet
+      }
+      continue;
+    }
+
+    WebSocketFrameHeader h;
+    if (!ws_parser_.PeekHeader(&h)) {
+      break;
+    }
+    // Clients mask every frame and servers none (RFC 6455 §5.1).
+    if (h.masked == client_mode_) {
+      FailConnection(kCloseProtocolError);
       break;
     }
 
-    if (!f->fin) {
-      DoClose();
-      return;
+    if (h.opcode & 0x8) {
+      // Control frames are never fragmented and carry at most 125 bytes, so wait for all of it.
+      if (!h.fin || h.payload_len > 125 || h.rsv != 0) {
+        FailConnection(kCloseProtocolError);
+        break;
+      }
+      if (ws_parser_.ReadableBytes() < h.header_len + h.payload_len) {
+        break;
+      }
+      HandleControlFrame(h);
+      ws_parser_.Consume(h.header_len + static_cast<size_t>(h.payload_len));
+      continue;
     }
 
-    switch (f->opcode) {
-    case 0x2: { // binary
-      framer_.Append(reinterpret_cast<const uint8_t*>(f->payload.data()), f->payload.size());
-      while (true) {
-        auto frame = framer_.PopFrame();
-        if (!frame) {
-          break;
-        }
-        if (on_frame_) {
-          on_frame_(std::static_pointer_cast<Session>(shared_from_this()), std::move(*frame));
-        }
+    if (h.opcode == 0x0) {
+      if (!in_message_ || h.rsv != 0) {
+        FailConnection(kCloseProtocolError); // continuation without a first fragment
+        break;
       }
+    } else if (h.opcode == 0x1 || h.opcode == 0x2) {
+      // RSV1 marks a compressed message and is only legal once permessage-deflate is agreed.
+      if (in_message_ || (h.rsv & 0x3) != 0 || ((h.rsv & 0x4) != 0 && !deflate_)) {
+        FailConnection(kCloseProtocolError);
+        break;
+      }
+      in_message_ = true;
+      message_opcode_ = h.opcode;
+      message_bytes_ = 0;
+      message_compressed_ = (h.rsv & 0x4) != 0;
+    } else {
+      FailConnection(kCloseProtocolError);
       break;
     }
-    case 0x9: { // ping
-      write_q_.push_back(BuildWebSocketFrame(/*opcode=*/0xA, f->payload, /*mask=*/false));
-      if (!write_in_flight_) {
-        write_in_flight_ = true;
-        DoWrite();
-      }
+
+    if (h.payload_len > max_message_bytes_ - message_bytes_) {
+      FailConnection(kCloseMessageTooBig);
       break;
     }
-    case 0x8: { // close
-      write_q_.push_back(BuildWebSocketFrame(/*opcode=*/0x8, "", /*mask=*/false));
-      close_after_write_ = true;
-      if (!write_in_flight_) {
-        write_in_flight_ = true;
-        DoWrite();
+
+    ws_parser_.Consume(h.header_len);
+    frame_ = h;
+    frame_read_ = 0;
+    in_frame_ = true;
+  }
+}
+
+void WebSocketSession::ConsumeDataPayload() {
+  const size_t n = static_cast<size_t>(
+      std::min<uint64_t>(frame_.payload_len - frame_read_, ws_parser_.ReadableBytes()));
+
+  const bool last = frame_.fin && frame_read_ + n == frame_.payload_len;
+  if (message_compressed_) {
+    // The inflater needs unmasked bytes; an empty final frame still has to finish the message.
+    const uint8_t* data = ws_parser_.ReadPtr();
+    if (frame_.masked && n > 0) {
+      inflate_in_.resize(n);
+      ApplyWebSocketMask(data, inflate_in_.data(), n, frame_.mask_key, static_cast<size_t>(frame_read_));
+      data = inflate_in_.data();
+    }
+    if ((n > 0 || last) && !InflatePayload(data, n, last)) {
+      return;
+    }
+  } else if (n > 0 && message_opcode_ == 0x2) {
+    // Unmask straight into the framer: the only copy between the socket buffer and on_frame_.
+    auto dst = framer_.PrepareWrite(n);
+    if (frame_.masked) {
+      ApplyWebSocketMask(ws_parser_.ReadPtr(), dst.data(), n, frame_.mask_key, static_cast<size_t>(frame_read_));
+    } else {
+      std::memcpy(dst.data(), ws_parser_.ReadPtr(), n);
+    }
+    framer_.CommitWrite(n);
+
+    while (auto frame = framer_.PeekFrame()) {
+      if (on_frame_) {
+        on_frame_(std::static_pointer_cast<Session>(shared_from_this()), *frame);
       }
-      break;
+      framer_.ConsumeFrame();
     }
-    default:
-      // ignore
-      break;
+  }
+  // Text messages are not part of the protocol; their payload is skipped.
+
+  ws_parser_.Consume(n);
+  frame_read_ += n;
+  message_bytes_ += n;
+
+  if (frame_read_ == frame_.payload_len) {
+    in_frame_ = false;
+    if (frame_.fin) {
+      in_message_ = false;
+    }
+  }
+}
+
+bool WebSocketSession::InflatePayload(const uint8_t* data, size_t n, bool last) {
+  InputBuffer& sink = message_opcode_ == 0x2 ? framer_.MutableBuffer() : text_sink_;
+  const auto result = deflate_->Decompress(data, n, last, &sink, max_message_bytes_);
+  if (result != PerMessageDeflate::InflateResult::kOk) {
+    FailConnection(result == PerMessageDeflate::InflateResult::kTooLarge ? kCloseMessageTooBig
+                                                                         : kCloseInvalidPayload);
+    return false;
+  }
+  if (message_opcode_ != 0x2) {
+    text_sink_.Clear();
+    return true;
+  }
+  while (auto frame = framer_.PeekFrame()) {
+    if (on_frame_) {
+      on_frame_(std::static_pointer_cast<Session>(shared_from_this()), *frame);
     }
+    framer_.ConsumeFrame();
   }
+  return true;
+}
+
+void WebSocketSession::HandleControlFrame(const WebSocketFrameHeader& h) {
+  std::string payload(reinterpret_cast<const char*>(ws_parser_.ReadPtr() + h.header_len),
+                      static_cast<size_t>(h.payload_len));
+  if (h.masked && !payload.empty()) {
+    auto* data = reinterpret_cast<uint8_t*>(payload.data());
+    ApplyWebSocketMask(data, data, payload.size(), h.mask_key);
+  }
+
+  switch (h.opcode) {
+  case 0x9: // ping
+    EnqueueRaw(BuildWebSocketFrame(/*opcode=*/0xA, payload, /*mask=*/client_mode_));
+    break;
+  case 0x8: // close
+    input_closed_ = true;
+    close_after_write_ = true;
+    EnqueueRaw(BuildWebSocketFrame(/*opcode=*/0x8, "", /*mask=*/client_mode_));
+    break;
+  default: // pong and reserved control opcodes
+    break;
+  }
+}
+
+void WebSocketSession::FailConnection(uint16_t status) {
+  const char payload[2] = {static_cast<char>(status >> 8), static_cast<char>(status & 0xFF)};
+  input_closed_ = true;
+  close_after_write_ = true;
+  EnqueueRaw(BuildWebSocketFrame(/*opcode=*/0x8, std::string_view(payload, 2), /*mask=*/client_mode_));
 }
 
 void WebSocketSession::DoWrite() {
   auto self = shared_from_this();
-  if (write_q_.empty()) {
+  if (write_q_.Empty()) {
     write_in_flight_ = false;
     if (close_after_write_) {
       DoClose();
@@ -184,13 +430,16 @@ void WebSocketSession::DoWrite() {
     return;
   }
 
-  asio::async_write(socket_, asio::buffer(write_q_.front()),
+  // Gather everything queued (up to the caps) into one scatter/gather write.
+  write_q_.GatherBatch(write_batch_, kMaxWriteBuffers, kMaxWriteBytes);
+
+  asio::async_write(socket_, write_batch_,
                     asio::bind_executor(strand_, [self](std::error_code ec, std::size_t /*n*/) {
                       if (ec) {
                         self->DoClose();
                         return;
                       }
-                      self->write_q_.pop_front();
+                      self->write_q_.PopBatch();
                       self->DoWrite();
                     }));
 }
@@ -200,6 +449,10 @@ void WebSocketSession::DoClose() {
     return;
   }
   closed_ = true;
+  if (timeout_timer_) {
+    wheel_->Cancel(timeout_timer_);
+    timeout_timer_ = 0;
+  }
 
   asio::error_code ec;
   socket_.shutdown(asio::ip::tcp::socket::shutdown_both, ec);
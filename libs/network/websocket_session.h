@@ -1,54 +1,141 @@
 #pragma once
 
-#include <array>
-#include <deque>
+#include <chrono>
 #include <functional>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include <asio.hpp>
 
 #include "network/length_prefixed_framer.h"
 #include "network/session.h"
+#include "network/timing_wheel.h"
+#include "network/websocket_deflate.h"
 #include "network/websocket_frame.h"
+#include "network/websocket_util.h"
+#include "network/write_queue.h"
 
 namespace chirp::network {
 
 class WebSocketSession : public Session, public std::enable_shared_from_this<WebSocketSession> {
 public:
-  using FrameCallback = std::function<void(std::shared_ptr<Session>, std::string&& payload)>;
+  // `payload` views the session's receive buffer and is only valid for the duration of the call.
+  using FrameCallback = std::function<void(std::shared_ptr<Session>, std::string_view payload)>;
   using CloseCallback = std::function<void(std::shared_ptr<Session>)>;
 
   WebSocketSession(asio::ip::tcp::socket socket, FrameCallback on_frame, CloseCallback on_close = nullptr);
 
+  // Largest reassembled message (all fragments) accepted before failing the connection with 1009.
+  static constexpr size_t kDefaultMaxMessageBytes = 16 * 1024 * 1024;
+  // Upgrade requests larger than this are answered with 431; clients that have not completed
+  // the handshake within the timeout are disconnected (0 disables the timer).
+  static constexpr size_t kDefaultMaxHandshakeBytes = 8 * 1024;
+  static constexpr std::chrono::milliseconds kDefaultHandshakeTimeout{10000};
+
+  // Call before Start().
+  void SetWriteQueueLimits(const WriteQueueLimits& limits) { write_q_.SetLimits(limits); }
+  void SetMaxMessageSize(size_t bytes) { max_message_bytes_ = bytes; }
+  void SetMaxHandshakeSize(size_t bytes) { max_handshake_bytes_ = bytes; }
+  void SetHandshakeTimeout(std::chrono::milliseconds timeout) { handshake_timeout_ = timeout; }
+  // Closes the session once nothing has been read from it for `timeout` (0 disables). Both
+  // timeouts are tracked on the io_context's IoTimingWheel.
+  void SetIdleTimeout(std::chrono::milliseconds timeout) { idle_timeout_ = timeout; }
+  // Server: offered to clients in the handshake. Client: compression settings for StartClient().
+  void SetPerMessageDeflate(const PerMessageDeflateConfig& config) { deflate_config_ = config; }
+
+  // Server side: waits for the HTTP upgrade request, then speaks WebSocket.
   void Start();
+  // Client side, after the caller completed the handshake: frames sent are masked. `leftover` is
+  // whatever was read past the handshake response; `deflate` is what the server accepted.
+  void StartClient(std::string_view leftover, std::optional<PerMessageDeflateParams> deflate);
   void Close() override;
   bool IsClosed() const override { return closed_; }
 
   void Send(std::string bytes) override;
+  void Send(SharedFrame frame) override;
+  void SendDroppable(SharedFrame frame) override;
   void SendAndClose(std::string bytes) override;
 
+  size_t QueuedBytes() const override { return write_q_.QueuedBytes(); }
+
   asio::ip::tcp::endpoint RemoteEndpoint() const;
 
 private:
   void DoRead();
+  // Queues `frame` as a binary message (header + shared bytes).
+  void Enqueue(SharedFrame frame, bool droppable, bool close_after);
+  // Queues already-framed bytes (handshake response, control frames). Strand only.
+  void EnqueueRaw(std::string bytes);
+  // Frames one outgoing binary message for this connection's role and extensions (masking,
+  // permessage-deflate). Sets *compressed when the payload went through the deflater.
+  std::string EncodeMessage(std::string_view payload, bool* compressed);
   void DoWrite();
   void DoClose();
+  void StartTimers();
+  void ScheduleTimeoutCheck();
+  void CheckTimeouts();
 
   bool TryConsumeHandshake();
+  // Answers a bad upgrade request with an HTTP error and closes once it is flushed.
+  void RejectHandshake(HttpUpgradeError error);
   void ConsumeWebSocketFrames();
+  // Moves buffered payload of the current data frame into framer_ and dispatches whole packets.
+  void ConsumeDataPayload();
+  // Inflates `n` payload bytes of a compressed message. False once the connection was failed.
+  bool InflatePayload(const uint8_t* data, size_t n, bool last);
+  void HandleControlFrame(const WebSocketFrameHeader& h);
+  // Sends a close frame with `status`, stops reading and closes once it is flushed.
+  void FailConnection(uint16_t status);
 
   asio::ip::tcp::socket socket_;
   asio::strand<asio::any_io_executor> strand_;
   FrameCallback on_frame_;
   CloseCallback on_close_;
 
-  std::array<uint8_t, 4096> read_buf_{};
-  std::string handshake_buf_;
+  size_t max_handshake_bytes_{kDefaultMaxHandshakeBytes};
+  std::chrono::milliseconds handshake_timeout_{kDefaultHandshakeTimeout};
+  size_t handshake_scanned_{0}; // bytes already searched for the end of the request head
+
+  // Deadlines in wheel ticks: the handshake counts from Start(), idleness from the last read.
+  // Reads only store the current tick; one wheel timer per session re-checks lazily.
+  std::chrono::milliseconds idle_timeout_{0};
+  IoTimingWheel* wheel_{nullptr};
+  uint64_t start_tick_{0};
+  uint64_t handshake_ticks_{0};
+  uint64_t idle_ticks_{0};
+  uint64_t last_read_tick_{0};
+  IoTimingWheel::TimerId timeout_timer_{0};
+
+  // Socket reads land here: first the HTTP upgrade request, then WebSocket frames.
   WebSocketFrameParser ws_parser_;
   LengthPrefixedFramer framer_;
 
-  std::deque<std::string> write_q_;
+  // Reassembly state. A message is a first frame (0x1/0x2) plus continuation frames (0x0)
+  // up to FIN; control frames may be interleaved between fragments.
+  size_t max_message_bytes_{kDefaultMaxMessageBytes};
+  WebSocketFrameHeader frame_;  // current data frame
+  uint64_t frame_read_{0};      // payload bytes of frame_ already consumed
+  bool in_frame_{false};
+  bool in_message_{false};
+  uint8_t message_opcode_{0};
+  uint64_t message_bytes_{0};
+  bool message_compressed_{false};
+  bool input_closed_{false};
+
+  // permessage-deflate, when negotiated. Compressed payloads are unmasked into inflate_in_;
+  // text messages inflate into text_sink_ and are discarded like uncompressed text.
+  PerMessageDeflateConfig deflate_config_;
+  std::unique_ptr<PerMessageDeflate> deflate_;
+  std::string deflate_out_;
+  std::vector<uint8_t> inflate_in_;
+  InputBuffer text_sink_;
+  bool client_mode_{false};
+
+  WriteQueue write_q_;
+  std::vector<asio::const_buffer> write_batch_;
   bool write_in_flight_{false};
   bool close_after_write_{false};
   bool closed_{false};
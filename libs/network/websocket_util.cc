@@ -1,8 +1,10 @@
 #include "network/websocket_util.h"
 
+#include <algorithm>
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <string>
 
 namespace chirp::network {
@@ -12,30 +14,57 @@ constexpr char kWebSocketGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
 
 uint32_t Rol32(uint32_t v, uint32_t bits) { return (v << bits) | (v >> (32 - bits)); }
 
-std::array<uint8_t, 20> Sha1(const uint8_t* data, size_t len) {
-  uint32_t h0 = 0x67452301;
-  uint32_t h1 = 0xEFCDAB89;
-  uint32_t h2 = 0x98BADCFE;
-  uint32_t h3 = 0x10325476;
-  uint32_t h4 = 0xC3D2E1F0;
-
-  // Pre-processing: padding
-  const uint64_t bit_len = static_cast<uint64_t>(len) * 8;
-  std::string msg(reinterpret_cast<const char*>(data), len);
-  msg.push_back(static_cast<char>(0x80));
-  while ((msg.size() % 64) != 56) {
-    msg.push_back('\0');
-  }
-  for (int i = 7; i >= 0; --i) {
-    msg.push_back(static_cast<char>((bit_len >> (i * 8)) & 0xFF));
+// Streaming SHA-1 over caller-provided pieces; state lives on the stack.
+class Sha1 {
+public:
+  void Update(const uint8_t* data, size_t len) {
+    total_ += len;
+    if (block_len_ > 0) {
+      const size_t take = std::min(len, sizeof(block_) - block_len_);
+      std::memcpy(block_ + block_len_, data, take);
+      block_len_ += take;
+      data += take;
+      len -= take;
+      if (block_len_ < sizeof(block_)) {
+        return;
+      }
+      Compress(block_);
+      block_len_ = 0;
+    }
+    for (; len >= sizeof(block_); data += sizeof(block_), len -= sizeof(block_)) {
+      Compress(data);
+    }
+    std::memcpy(block_, data, len);
+    block_len_ = len;
   }
 
-  const uint8_t* p = reinterpret_cast<const uint8_t*>(msg.data());
-  const size_t blocks = msg.size() / 64;
+  std::array<uint8_t, 20> Final() {
+    const uint64_t bit_len = total_ * 8;
+    block_[block_len_++] = 0x80;
+    if (block_len_ > 56) {
+      std::memset(block_ + block_len_, 0, sizeof(block_) - block_len_);
+      Compress(block_);
+      block_len_ = 0;
+    }
+    std::memset(block_ + block_len_, 0, 56 - block_len_);
+    for (int i = 0; i < 8; ++i) {
+      block_[56 + i] = static_cast<uint8_t>((bit_len >> ((7 - i) * 8)) & 0xFF);
+    }
+    Compress(block_);
+
+    std::array<uint8_t, 20> out{};
+    for (int i = 0; i < 5; ++i) {
+      out[i * 4] = static_cast<uint8_t>((h_[i] >> 24) & 0xFF);
+      out[i * 4 + 1] = static_cast<uint8_t>((h_[i] >> 16) & 0xFF);
+      out[i * 4 + 2] = static_cast<uint8_t>((h_[i] >> 8) & 0xFF);
+      out[i * 4 + 3] = static_cast<uint8_t>((h_[i]) & 0xFF);
+    }
+    return out;
+  }
 
-  for (size_t b = 0; b < blocks; ++b) {
+private:
+  void Compress(const uint8_t* chunk) {
     uint32_t w[80];
-    const uint8_t* chunk = p + b * 64;
     for (int i = 0; i < 16; ++i) {
       w[i] = (static_cast<uint32_t>(chunk[i * 4]) << 24) |
              (static_cast<uint32_t>(chunk[i * 4 + 1]) << 16) |
@@ -45,96 +74,174 @@ std::array<uint8_t, 20> Sha1(const uint8_t* data, size_t len) {
       w[i] = Rol32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
     }
 
-    uint32_t a = h0;
-    uint32_t b2 = h1;
-    uint32_t c = h2;
-    uint32_t d = h3;
-    uint32_t e = h4;
+    uint32_t a = h_[0];
+    uint32_t b = h_[1];
+    uint32_t c = h_[2];
+    uint32_t d = h_[3];
+    uint32_t e = h_[4];
 
     for (int i = 0; i < 80; ++i) {
       uint32_t f = 0;
       uint32_t k = 0;
       if (i < 20) {
-        f = (b2 & c) | ((~b2) & d);
+        f = (b & c) | ((~b) & d);
         k = 0x5A827999;
       } else if (i < 40) {
-        f = b2 ^ c ^ d;
+        f = b ^ c ^ d;
         k = 0x6ED9EBA1;
       } else if (i < 60) {
-        f = (b2 & c) | (b2 & d) | (c & d);
+        f = (b & c) | (b & d) | (c & d);
         k = 0x8F1BBCDC;
       } else {
-        f = b2 ^ c ^ d;
+        f = b ^ c ^ d;
         k = 0xCA62C1D6;
       }
 
       uint32_t temp = Rol32(a, 5) + f + e + k + w[i];
       e = d;
       d = c;
-      c = Rol32(b2, 30);
-      b2 = a;
+      c = Rol32(b, 30);
+      b = a;
       a = temp;
     }
 
-    h0 += a;
-    h1 += b2;
-    h2 += c;
-    h3 += d;
-    h4 += e;
+    h_[0] += a;
+    h_[1] += b;
+    h_[2] += c;
+    h_[3] += d;
+    h_[4] += e;
   }
 
-  std::array<uint8_t, 20> out{};
-  const uint32_t hs[5] = {h0, h1, h2, h3, h4};
-  for (int i = 0; i < 5; ++i) {
-    out[i * 4] = static_cast<uint8_t>((hs[i] >> 24) & 0xFF);
-    out[i * 4 + 1] = static_cast<uint8_t>((hs[i] >> 16) & 0xFF);
-    out[i * 4 + 2] = static_cast<uint8_t>((hs[i] >> 8) & 0xFF);
-    out[i * 4 + 3] = static_cast<uint8_t>((hs[i]) & 0xFF);
-  }
-  return out;
-}
+  uint32_t h_[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+  uint8_t block_[64];
+  size_t block_len_{0};
+  uint64_t total_{0};
+};
 
-std::string Base64Encode(const uint8_t* data, size_t len) {
+// Writes ((len + 2) / 3) * 4 characters to `out`.
+void Base64Encode(const uint8_t* data, size_t len, char* out) {
   static constexpr char kTable[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-  std::string out;
-  out.reserve(((len + 2) / 3) * 4);
 
   size_t i = 0;
   while (i + 3 <= len) {
     uint32_t n = (static_cast<uint32_t>(data[i]) << 16) | (static_cast<uint32_t>(data[i + 1]) << 8) |
                  static_cast<uint32_t>(data[i + 2]);
-    out.push_back(kTable[(n >> 18) & 0x3F]);
-    out.push_back(kTable[(n >> 12) & 0x3F]);
-    out.push_back(kTable[(n >> 6) & 0x3F]);
-    out.push_back(kTable[n & 0x3F]);
+    *out++ = kTable[(n >> 18) & 0x3F];
+    *out++ = kTable[(n >> 12) & 0x3F];
+    *out++ = kTable[(n >> 6) & 0x3F];
+    *out++ = kTable[n & 0x3F];
     i += 3;
   }
 
   const size_t rem = len - i;
   if (rem == 1) {
     uint32_t n = (static_cast<uint32_t>(data[i]) << 16);
-    out.push_back(kTable[(n >> 18) & 0x3F]);
-    out.push_back(kTable[(n >> 12) & 0x3F]);
-    out.push_back('=');
-    out.push_back('=');
+    *out++ = kTable[(n >> 18) & 0x3F];
+    *out++ = kTable[(n >> 12) & 0x3F];
+    *out++ = '=';
+    *out++ = '=';
   } else if (rem == 2) {
     uint32_t n = (static_cast<uint32_t>(data[i]) << 16) | (static_cast<uint32_t>(data[i + 1]) << 8);
-    out.push_back(kTable[(n >> 18) & 0x3F]);
-    out.push_back(kTable[(n >> 12) & 0x3F]);
-    out.push_back(kTable[(n >> 6) & 0x3F]);
-    out.push_back('=');
+    *out++ = kTable[(n >> 18) & 0x3F];
+    *out++ = kTable[(n >> 12) & 0x3F];
+    *out++ = kTable[(n >> 6) & 0x3F];
+    *out++ = '=';
   }
+}
 
-  return out;
+char ToLowerAscii(char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c; }
+
+bool IEquals(std::string_view a, std::string_view b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (ToLowerAscii(a[i]) != ToLowerAscii(b[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool IsSpaceOrTab(char c) { return c == ' ' || c == '\t'; }
+
+std::string_view TrimView(std::string_view s) {
+  while (!s.empty() && IsSpaceOrTab(s.front())) {
+    s.remove_prefix(1);
+  }
+  while (!s.empty() && IsSpaceOrTab(s.back())) {
+    s.remove_suffix(1);
+  }
+  return s;
 }
 
+// True if the comma-separated header `value` lists `token` (case-insensitive).
+bool HasToken(std::string_view value, std::string_view token) {
+  while (true) {
+    const size_t comma = value.find(',');
+    if (IEquals(TrimView(value.substr(0, comma)), token)) {
+      return true;
+    }
+    if (comma == std::string_view::npos) {
+      return false;
+    }
+    value.remove_prefix(comma + 1);
+  }
+}
+
+bool IsBase64Char(char c) {
+  return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '+' || c == '/';
+}
+
+// Calls fn(name, value) for each header line of `head` (after the request/status line) until
+// fn returns false. Returns false on a malformed line. Allocation-free.
+template <typename Fn>
+bool ForEachHeader(std::string_view head, Fn&& fn) {
+  size_t pos = head.find("\r\n");
+  if (pos == std::string_view::npos) {
+    return false;
+  }
+  pos += 2;
+  while (pos < head.size()) {
+    const size_t eol = head.find("\r\n", pos);
+    if (eol == std::string_view::npos) {
+      return false;
+    }
+    if (eol == pos) {
+      return true; // blank line ends the head
+    }
+    const std::string_view line = head.substr(pos, eol - pos);
+    const size_t colon = line.find(':');
+    // Obsolete line folding and names with whitespace are rejected (RFC 7230 section 3.2.4).
+    if (colon == std::string_view::npos || colon == 0 || IsSpaceOrTab(line[0]) || IsSpaceOrTab(line[colon - 1])) {
+      return false;
+    }
+    if (!fn(line.substr(0, colon), TrimView(line.substr(colon + 1)))) {
+      return true;
+    }
+    pos = eol + 2;
+  }
+  return true;
+}
+
+constexpr std::string_view kSwitchingProtocols =
+    "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: ";
+constexpr std::string_view kExtensionsHeader = "\r\nSec-WebSocket-Extensions: ";
+
 } // namespace
 
 std::string ComputeWebSocketAccept(const std::string& sec_websocket_key) {
-  std::string in = sec_websocket_key;
-  in += kWebSocketGuid;
-  auto digest = Sha1(reinterpret_cast<const uint8_t*>(in.data()), in.size());
-  return Base64Encode(digest.data(), digest.size());
+  std::string out(kWebSocketAcceptLength, '\0');
+  ComputeWebSocketAccept(std::string_view(sec_websocket_key), out.data());
+  return out;
+}
+
+void ComputeWebSocketAccept(std::string_view sec_websocket_key, char* out) {
+  Sha1 sha1;
+  sha1.Update(reinterpret_cast<const uint8_t*>(sec_websocket_key.data()), sec_websocket_key.size());
+  sha1.Update(reinterpret_cast<const uint8_t*>(kWebSocketGuid), sizeof(kWebSocketGuid) - 1);
+  const auto digest = sha1.Final();
+  Base64Encode(digest.data(), digest.size(), out);
 }
 
 bool IStartsWith(const std::string& s, const std::string& prefix) {
@@ -170,5 +277,113 @@ std::string TrimAsciiWhitespace(std::string s) {
   return s.substr(start, end - start);
 }
 
-} // namespace chirp::network
+std::string_view FindHttpHeader(std::string_view head, std::string_view name) {
+  std::string_view found;
+  ForEachHeader(head, [&](std::string_view key, std::string_view value) {
+    if (!IEquals(key, name)) {
+      return true;
+    }
+    found = value;
+    return false;
+  });
+  return found;
+}
+
+HttpUpgradeError ParseHttpUpgradeRequest(std::string_view head, HttpUpgradeRequest* out) {
+  // Request line: GET <target> HTTP/1.1
+  const size_t eol = head.find("\r\n");
+  if (eol == std::string_view::npos) {
+    return HttpUpgradeError::kMalformed;
+  }
+  const std::string_view line = head.substr(0, eol);
+  const size_t sp1 = line.find(' ');
+  const size_t sp2 = sp1 == std::string_view::npos ? sp1 : line.find(' ', sp1 + 1);
+  if (sp2 == std::string_view::npos || sp2 == sp1 + 1) {
+    return HttpUpgradeError::kMalformed;
+  }
+  HttpUpgradeRequest req;
+  req.method = line.substr(0, sp1);
+  req.target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+  if (req.method != "GET" || line.substr(sp2 + 1) != "HTTP/1.1") {
+    return HttpUpgradeError::kMalformed;
+  }
 
+  bool upgrade = false;
+  bool connection = false;
+  std::string_view version;
+  const bool well_formed = ForEachHeader(head, [&](std::string_view name, std::string_view value) {
+    // Cheap length dispatch first; most request headers are none of these.
+    switch (name.size()) {
+    case 7:
+      upgrade = upgrade || (IEquals(name, "Upgrade") && HasToken(value, "websocket"));
+      break;
+    case 10:
+      connection = connection || (IEquals(name, "Connection") && HasToken(value, "Upgrade"));
+      break;
+    case 17:
+      if (req.ws_key.empty() && IEquals(name, "Sec-WebSocket-Key")) {
+        req.ws_key = value;
+      }
+      break;
+    case 21:
+      if (version.empty() && IEquals(name, "Sec-WebSocket-Version")) {
+        version = value;
+      }
+      break;
+    case 24:
+      if (req.ws_extensions.empty() && IEquals(name, "Sec-WebSocket-Extensions")) {
+        req.ws_extensions = value;
+      }
+      break;
+    default:
+      break;
+    }
+    return true;
+  });
+  if (!well_formed) {
+    return HttpUpgradeError::kMalformed;
+  }
+  if (!upgrade || !connection) {
+    return HttpUpgradeError::kNotUpgrade;
+  }
+  if (version != "13") {
+    return HttpUpgradeError::kBadVersion;
+  }
+  // 16 random bytes, base64: 22 characters and "==".
+  if (req.ws_key.size() != 24 || req.ws_key.substr(22) != "==" ||
+      !std::all_of(req.ws_key.begin(), req.ws_key.begin() + 22, IsBase64Char)) {
+    return HttpUpgradeError::kBadKey;
+  }
+  *out = req;
+  return HttpUpgradeError::kNone;
+}
+
+std::string BuildWebSocketUpgradeResponse(std::string_view ws_key, std::string_view extensions) {
+  const size_t size = kSwitchingProtocols.size() + kWebSocketAcceptLength +
+                      (extensions.empty() ? 0 : kExtensionsHeader.size() + extensions.size()) + 4;
+  std::string out(size, '\0');
+  char* p = out.data();
+  p = std::copy(kSwitchingProtocols.begin(), kSwitchingProtocols.end(), p);
+  ComputeWebSocketAccept(ws_key, p);
+  p += kWebSocketAcceptLength;
+  if (!extensions.empty()) {
+    p = std::copy(kExtensionsHeader.begin(), kExtensionsHeader.end(), p);
+    p = std::copy(extensions.begin(), extensions.end(), p);
+  }
+  std::memcpy(p, "\r\n\r\n", 4);
+  return out;
+}
+
+std::string BuildHttpUpgradeRejection(HttpUpgradeError error) {
+  switch (error) {
+  case HttpUpgradeError::kBadVersion:
+    return "HTTP/1.1 426 Upgrade Required\r\nSec-WebSocket-Version: 13\r\nConnection: close\r\n"
+           "Content-Length: 0\r\n\r\n";
+  case HttpUpgradeError::kTooLarge:
+    return "HTTP/1.1 431 Request Header Fields Too Large\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+  default:
+    return "HTTP/1.1 400 Bad Request\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+  }
+}
+
+} // namespace chirp::network
@@ -1,18 +1,58 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
+#include <string_view>
 
 namespace chirp::network {
 
 // Computes "Sec-WebSocket-Accept" value for a given "Sec-WebSocket-Key".
 std::string ComputeWebSocketAccept(const std::string& sec_websocket_key);
 
+// Length of a Sec-WebSocket-Accept value (base64 of a SHA-1 digest).
+constexpr size_t kWebSocketAcceptLength = 28;
+
+// Same, written to `out` (kWebSocketAcceptLength chars) without allocating.
+void ComputeWebSocketAccept(std::string_view sec_websocket_key, char* out);
+
 // Returns true if `s` starts with `prefix` (case-insensitive ASCII).
 bool IStartsWith(const std::string& s, const std::string& prefix);
 
 // Trims ASCII whitespace (space/tab/CR/LF) from both ends.
 std::string TrimAsciiWhitespace(std::string s);
 
+// Returns the trimmed value of the first `name:` header line in an HTTP head, or an empty view.
+// Header names match case-insensitively. The view points into `head`.
+std::string_view FindHttpHeader(std::string_view head, std::string_view name);
+
+// The parts of a WebSocket upgrade request the server acts on. Views into the request buffer.
+struct HttpUpgradeRequest {
+  std::string_view method;
+  std::string_view target;
+  std::string_view ws_key;
+  std::string_view ws_extensions;
+};
+
+enum class HttpUpgradeError {
+  kNone,
+  kMalformed,   // not an HTTP/1.1 GET with well-formed header lines
+  kNotUpgrade,  // missing "Upgrade: websocket" or "Connection: Upgrade"
+  kBadVersion,  // Sec-WebSocket-Version is not 13
+  kBadKey,      // Sec-WebSocket-Key is not 16 base64-encoded bytes
+  kTooLarge,    // head exceeds the server's limit
+};
+
+// Scans and validates an upgrade request head (request line through the blank line) in place,
+// without allocating. `out` is only meaningful on kNone.
+HttpUpgradeError ParseHttpUpgradeRequest(std::string_view head, HttpUpgradeRequest* out);
+
+// The 101 response for `ws_key`; the extensions line is omitted when `extensions` is empty.
+// Sized up front, so building it costs one allocation.
+std::string BuildWebSocketUpgradeResponse(std::string_view ws_key, std::string_view extensions);
+
+// The HTTP error response sent before closing a rejected upgrade.
+std::string BuildHttpUpgradeRejection(HttpUpgradeError error);
+
 } // namespace chirp::network
 
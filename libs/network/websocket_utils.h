@@ -8,19 +8,25 @@ namespace chirp::network {
 /// @param host Target host (e.g., "localhost" or "example.com")
 /// @param port Target port (e.g., 8080)
 /// @param path WebSocket path (default: "/")
+/// @param extensions Sec-WebSocket-Extensions offer, omitted when empty
 /// @return Complete HTTP handshake request as string
 inline std::string BuildWebSocketHandshake(
     const std::string& host,
     uint16_t port,
-    const std::string& path = "/") {
+    const std::string& path = "/",
+    const std::string& extensions = "") {
 
-  return "GET " + path + " HTTP/1.1\r\n"
+  std::string request = "GET " + path + " HTTP/1.1\r\n"
          "Host: " + host + ":" + std::to_string(port) + "\r\n"
          "Upgrade: websocket\r\n"
          "Connection: Upgrade\r\n"
          "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
-         "Sec-WebSocket-Version: 13\r\n"
-         "\r\n";
+         "Sec-WebSocket-Version: 13\r\n";
+  if (!extensions.empty()) {
+    request += "Sec-WebSocket-Extensions: " + extensions + "\r\n";
+  }
+  request += "\r\n";
+  return request;
 }
 
 /// Check if HTTP response indicates successful WebSocket upgrade
@@ -0,0 +1,95 @@
+#include "network/write_queue.h"
+
+#include "network/network_stats.h"
+
+namespace chirp::network {
+
+WriteQueue::~WriteQueue() { SubQueued(QueuedBytes()); }
+
+WriteQueue::PushResult WriteQueue::Push(SharedFrame frame, bool droppable, bool ws_header) {
+  Entry entry{std::move(frame), ws_header, droppable};
+  const size_t size = entry.WireSize();
+
+  // An empty queue always takes the frame, however large.
+  if (!q_.empty() && QueuedBytes() + size > limits_.high_watermark_bytes) {
+    ShedDroppable(limits_.low_watermark_bytes);
+    if (QueuedBytes() + size > limits_.high_watermark_bytes) {
+      if (droppable) {
+        NetworkStats::Instance().frames_dropped.fetch_add(1, std::memory_order_relaxed);
+        return PushResult::kDropped;
+      }
+      return PushResult::kOverflow;
+    }
+  }
+
+  q_.push_back(std::move(entry));
+  AddQueued(size);
+  return PushResult::kQueued;
+}
+
+void WriteQueue::GatherBatch(std::vector<asio::const_buffer>& out, size_t max_buffers, size_t max_bytes) {
+  out.clear();
+  in_flight_frames_ = 0;
+  in_flight_bytes_ = 0;
+  for (const auto& entry : q_) {
+    const size_t buffers = entry.ws_header ? 2 : 1;
+    const size_t size = entry.WireSize();
+    if (in_flight_frames_ > 0 &&
+        (out.size() + buffers > max_buffers || in_flight_bytes_ + size > max_bytes)) {
+      break;
+    }
+    if (entry.ws_header) {
+      const auto header = entry.frame.WebSocketHeader();
+      out.push_back(asio::buffer(header.data(), header.size()));
+    }
+    const auto bytes = entry.frame.Bytes();
+    out.push_back(asio::buffer(bytes.data(), bytes.size()));
+    in_flight_bytes_ += size;
+    ++in_flight_frames_;
+  }
+  NetworkStats::Instance().RecordWrite(in_flight_frames_, in_flight_bytes_);
+}
+
+void WriteQueue::PopBatch() {
+  q_.erase(q_.begin(), q_.begin() + static_cast<std::ptrdiff_t>(in_flight_frames_));
+  SubQueued(in_flight_bytes_);
+  in_flight_frames_ = 0;
+  in_flight_bytes_ = 0;
+}
+
+void WriteQueue::ShedDroppable(size_t target) {
+  // Frames are heap-backed (SharedFrame), so compacting the deque does not move the bytes the
+  // in-flight batch points at.
+  size_t queued = QueuedBytes();
+  size_t keep = in_flight_frames_;
+  size_t dropped = 0;
+  for (size_t i = in_flight_frames_; i < q_.size(); ++i) {
+    if (queued > target && q_[i].droppable) {
+      queued -= q_[i].WireSize();
+      ++dropped;
+      continue;
+    }
+    if (keep != i) {
+      q_[keep] = std::move(q_[i]);
+    }
+    ++keep;
+  }
+  if (dropped == 0) {
+    return;
+  }
+  q_.resize(keep);
+  SubQueued(QueuedBytes() - queued);
+  NetworkStats::Instance().frames_dropped.fetch_add(dropped, std::memory_order_relaxed);
+}
+
+void WriteQueue::AddQueued(size_t bytes) {
+  queued_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  NetworkStats::Instance().queued_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void WriteQueue::SubQueued(size_t bytes) {
+  queued_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+  NetworkStats::Instance().queued_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+} // namespace chirp::network
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include <asio.hpp>
+
+#include "network/shared_frame.h"
+
+namespace chirp::network {
+
+// Per-session bounds on bytes waiting to be written.
+//
+// Once a push would take the queue above `high_watermark_bytes`, queued droppable frames
+// (presence, typing...) are shed oldest-first until the queue is back under
+// `low_watermark_bytes`. If that is not enough, a droppable push is discarded and a reliable
+// push reports overflow so the session can evict the slow consumer.
+struct WriteQueueLimits {
+  size_t high_watermark_bytes{4 * 1024 * 1024};
+  size_t low_watermark_bytes{1024 * 1024};
+};
+
+// Outgoing frames of one session plus the scatter/gather batch currently being written.
+// Not thread-safe: owned and driven by the session strand. QueuedBytes() may be read from
+// any thread.
+class WriteQueue {
+public:
+  enum class PushResult { kQueued, kDropped, kOverflow };
+
+  WriteQueue() = default;
+  ~WriteQueue();
+
+  WriteQueue(const WriteQueue&) = delete;
+  WriteQueue& operator=(const WriteQueue&) = delete;
+
+  void SetLimits(const WriteQueueLimits& limits) { limits_ = limits; }
+
+  // `ws_header`: write frame.WebSocketHeader() before the bytes.
+  PushResult Push(SharedFrame frame, bool droppable, bool ws_header = false);
+
+  bool Empty() const { return q_.empty(); }
+  size_t QueuedBytes() const { return queued_bytes_.load(std::memory_order_relaxed); }
+
+  // Fills `out` with the next batch (at least one frame, then up to the caps) and marks it in
+  // flight. Buffers stay valid until PopBatch().
+  void GatherBatch(std::vector<asio::const_buffer>& out, size_t max_buffers, size_t max_bytes);
+
+  // Releases the batch returned by the last GatherBatch().
+  void PopBatch();
+
+private:
+  struct Entry {
+    SharedFrame frame;
+    bool ws_header{false};
+    bool droppable{false};
+
+    size_t WireSize() const { return (ws_header ? frame.WebSocketHeader().size() : 0) + frame.size(); }
+  };
+
+  // Drops queued droppable frames (never the batch in flight) until at or below `target`.
+  void ShedDroppable(size_t target);
+  void AddQueued(size_t bytes);
+  void SubQueued(size_t bytes);
+
+  WriteQueueLimits limits_;
+  std::deque<Entry> q_;
+  size_t in_flight_frames_{0};
+  size_t in_flight_bytes_{0};
+  std::atomic<size_t> queued_bytes_{0};
+};
+
+} // namespace chirp::network
@@ -45,7 +45,7 @@ CREATE TABLE IF NOT EXISTS messages (
   content TEXT,
   timestamp BIGINT NOT NULL,
   created_at BIGINT NOT NULL,
-  INDEX idx_channel (channel_id, channel_type, timestamp),
+  INDEX idx_channel (channel_id, channel_type, timestamp, id),
   INDEX idx_receiver (receiver_id, timestamp),
   INDEX idx_timestamp (timestamp),
   INDEX idx_sender (sender_id, timestamp)
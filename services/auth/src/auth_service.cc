@@ -27,8 +27,10 @@ int64_t NowSeconds() {
 AuthService::AuthService(asio::io_context& io, const Config& config)
     : io_(io), config_(config) {
 
-  user_store_ = std::make_shared<UserStore>(config_.user_store_config);
-  session_store_ = std::make_shared<SessionStore>(config_.session_store_config);
+  // Both stores draw on one pool: same server, same schema, same request threads
+  mysql_pool_ = std::make_shared<database::MySQLConnectionPool>(config_.user_store_config.PoolOptions());
+  user_store_ = std::make_shared<UserStore>(mysql_pool_);
+  session_store_ = std::make_shared<SessionStore>(mysql_pool_);
   redis_store_ = std::make_shared<RedisAuthStore>(io_, config_.redis_config);
   rate_limiter_ = std::make_shared<RateLimiter>(redis_store_, config_.rate_limiter_config);
   brute_force_protector_ = std::make_shared<BruteForceProtector>(
@@ -62,6 +64,7 @@ bool AuthService::Initialize() {
 
 void AuthService::Shutdown() {
   Logger::Instance().Info("Shutting down AuthService...");
+  mysql_pool_->Stop();  // lets requests already handed to the executor finish
   redis_store_->Disconnect();
 }
 
@@ -10,6 +10,7 @@
 
 #include <asio.hpp>
 
+#include "database/mysql_connection_pool.h"
 #include "proto/common.pb.h"
 #include "brute_force_protector.h"
 #include "rate_limiter.h"
@@ -141,6 +142,12 @@ public:
   /// @brief Get configuration
   const Config& GetConfig() const { return config_; }
 
+  /// @brief Executor for blocking calls into the service (they reach MySQL), off the io thread
+  asio::thread_pool::executor_type GetMySQLExecutor() { return mysql_pool_->GetExecutor(); }
+
+  /// @brief Get MySQL connection pool statistics (shared by UserStore and SessionStore)
+  database::MySQLPoolStats GetPoolStats() const { return mysql_pool_->GetStats(); }
+
 private:
   std::string GenerateAccessToken(const std::string& user_id, int64_t expires_at);
   std::string GenerateRefreshToken();
@@ -148,6 +155,7 @@ private:
   asio::io_context& io_;
   Config config_;
 
+  std::shared_ptr<database::MySQLConnectionPool> mysql_pool_;
   std::shared_ptr<UserStore> user_store_;
   std::shared_ptr<SessionStore> session_store_;
   std::shared_ptr<RedisAuthStore> redis_store_;
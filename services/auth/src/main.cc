@@ -4,11 +4,13 @@
 #include <optional>
 #include <random>
 #include <string>
+#include <string_view>
 
 #include <asio.hpp>
 
 #include "jwt.h"
 #include "logger.h"
+#include "network/io_context_pool.h"
 #include "network/protobuf_framing.h"
 #include "network/session.h"
 #include "network/tcp_server.h"
@@ -89,13 +91,15 @@ int main(int argc, char** argv) {
   Logger::Instance().SetLevel(Logger::Level::kInfo);
   const uint16_t port = ParsePort(argc, argv);
   const std::string jwt_secret = GetArg(argc, argv, "--jwt_secret", "dev_secret");
+  const size_t io_threads = chirp::network::ResolveIoThreads(std::atoi(GetArg(argc, argv, "--io_threads", "1").c_str()));
   Logger::Instance().Info("chirp_auth starting on port " + std::to_string(port));
 
   asio::io_context io;
+  chirp::network::IoContextPool io_pool(io, io_threads);
 
   chirp::network::TcpServer server(
-      io, port,
-      [jwt_secret](std::shared_ptr<chirp::network::Session> session, std::string&& payload) {
+      io_pool, port,
+      [jwt_secret](std::shared_ptr<chirp::network::Session> session, std::string_view payload) {
         chirp::gateway::Packet pkt;
         if (!pkt.ParseFromArray(payload.data(), static_cast<int>(payload.size()))) {
           Logger::Instance().Warn("failed to parse Packet from client");
@@ -170,11 +174,13 @@ int main(int argc, char** argv) {
       });
 
   server.Start();
+  io_pool.Start();
 
   asio::signal_set signals(io, SIGINT, SIGTERM);
   signals.async_wait([&](const std::error_code& /*ec*/, int /*sig*/) {
     Logger::Instance().Info("shutdown requested");
     server.Stop();
+    io_pool.Stop();
     io.stop();
   });
 
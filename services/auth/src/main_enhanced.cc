@@ -5,12 +5,16 @@
 #include <cstdint>
 #include <cstdlib>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 
 #include <asio.hpp>
 
 #include "auth_service.h"
 #include "logger.h"
+#include "network/io_context_pool.h"
 #include "network/protobuf_framing.h"
 #include "network/session.h"
 #include "network/tcp_server.h"
@@ -70,6 +74,36 @@ void SendPacket(const std::shared_ptr<chirp::network::Session>& session,
   session->Send(std::string(reinterpret_cast<const char*>(framed.data()), framed.size()));
 }
 
+/// @brief One strand per connection on the MySQL executor
+/// A connection's requests reach MySQL on the executor's threads but still run one at a time and
+/// in arrival order (a LOGOUT is done before the LOGIN that follows it starts).
+class SessionStrands {
+public:
+  using Strand = asio::strand<asio::thread_pool::executor_type>;
+
+  explicit SessionStrands(asio::thread_pool::executor_type executor) : executor_(std::move(executor)) {}
+
+  Strand Get(chirp::network::Session* session) {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = strands_.find(session);
+    if (it == strands_.end()) {
+      it = strands_.emplace(session, asio::make_strand(executor_)).first;
+    }
+    return it->second;
+  }
+
+  /// @brief Work already posted keeps the strand alive until it has run
+  void Remove(chirp::network::Session* session) {
+    std::lock_guard<std::mutex> lock(mu_);
+    strands_.erase(session);
+  }
+
+private:
+  asio::thread_pool::executor_type executor_;
+  std::mutex mu_;
+  std::unordered_map<chirp::network::Session*, Strand> strands_;
+};
+
 } // namespace
 
 int main(int argc, char** argv) {
@@ -98,6 +132,9 @@ int main(int argc, char** argv) {
   config.user_store_config.user = GetArg(argc, argv, "--mysql_user", "chirp");
   config.user_store_config.password = GetArg(argc, argv, "--mysql_password", "chirp_password");
   config.user_store_config.pool_size = ParseIntArg(argc, argv, "--mysql_pool_size", 10);
+  config.user_store_config.min_pool_size = ParseIntArg(argc, argv, "--mysql_pool_min", 2);
+  config.user_store_config.acquire_timeout_ms = ParseIntArg(argc, argv, "--mysql_acquire_timeout_ms", 2000);
+  config.user_store_config.query_threads = ParseIntArg(argc, argv, "--mysql_query_threads", 4);
 
   config.session_store_config.host = config.user_store_config.host;
   config.session_store_config.port = config.user_store_config.port;
@@ -105,6 +142,9 @@ int main(int argc, char** argv) {
   config.session_store_config.user = config.user_store_config.user;
   config.session_store_config.password = config.user_store_config.password;
   config.session_store_config.pool_size = config.user_store_config.pool_size;
+  config.session_store_config.min_pool_size = config.user_store_config.min_pool_size;
+  config.session_store_config.acquire_timeout_ms = config.user_store_config.acquire_timeout_ms;
+  config.session_store_config.query_threads = config.user_store_config.query_threads;
 
   // Redis configuration
   config.redis_config.host = GetArg(argc, argv, "--redis_host", "127.0.0.1");
@@ -125,7 +165,10 @@ int main(int argc, char** argv) {
   config.brute_force_config.base_lock_duration_seconds =
       ParseIntArg(argc, argv, "--lock_duration", 300);
 
+  const size_t io_threads = chirp::network::ResolveIoThreads(ParseIntArg(argc, argv, "--io_threads", 1));
+
   Logger::Instance().Info("chirp_auth (enhanced) starting on port " + std::to_string(port));
+  Logger::Instance().Info("  io_threads: " + std::to_string(io_threads));
   Logger::Instance().Info("  MySQL: " + config.user_store_config.host + ":" +
                          std::to_string(config.user_store_config.port) + "/" +
                          config.user_store_config.database);
@@ -133,6 +176,7 @@ int main(int argc, char** argv) {
                          std::to_string(config.redis_config.port));
 
   asio::io_context io;
+  chirp::network::IoContextPool io_pool(io, io_threads);
 
   // Create and initialize auth service
   auto auth_service = std::make_shared<AuthService>(io, config);
@@ -141,261 +185,287 @@ int main(int argc, char** argv) {
     return 1;
   }
 
+  // Everything but heartbeats can reach MySQL, so packets are handled on the MySQL pool's executor
+  // instead of the io thread; responses are sent from there.
+  auto handle_packet = [auth_service](const std::shared_ptr<chirp::network::Session>& session,
+                                      const chirp::gateway::Packet& pkt) {
+    std::string client_ip = GetClientIp(session);
+
+    switch (pkt.msg_id()) {
+    case chirp::gateway::REGISTER_REQ: {
+      chirp::auth::RegisterRequest req;
+      if (!req.ParseFromArray(pkt.body().data(), static_cast<int>(pkt.body().size()))) {
+        chirp::auth::RegisterResponse resp;
+        resp.set_code(chirp::common::INVALID_PARAM);
+        resp.set_server_time(NowMs());
+        resp.set_error_message("Invalid request");
+        SendPacket(session, chirp::gateway::REGISTER_RESP, pkt.sequence(),
+                  resp.SerializeAsString());
+        return;
+      }
+
+      chirp::auth::UserRegisterRequest auth_req;
+      auth_req.username = req.username();
+      auth_req.email = req.email();
+      auth_req.password = req.password();
+      auth_req.display_name = req.display_name();
+
+      auto result = auth_service->Register(auth_req, client_ip);
+
+      chirp::auth::RegisterResponse resp;
+      resp.set_code(result.error_code);
+      resp.set_user_id(result.user_id);
+      resp.set_server_time(NowMs());
+      resp.set_error_message(result.error_message);
+      SendPacket(session, chirp::gateway::REGISTER_RESP, pkt.sequence(),
+                resp.SerializeAsString());
+      break;
+    }
+    case chirp::gateway::PASSWORD_LOGIN_REQ: {
+      chirp::auth::PasswordLoginRequest req;
+      if (!req.ParseFromArray(pkt.body().data(), static_cast<int>(pkt.body().size()))) {
+        chirp::auth::PasswordLoginResponse resp;
+        resp.set_code(chirp::common::INVALID_PARAM);
+        resp.set_server_time(NowMs());
+        resp.set_error_message("Invalid request");
+        SendPacket(session, chirp::gateway::PASSWORD_LOGIN_RESP, pkt.sequence(),
+                  resp.SerializeAsString());
+        return;
+      }
+
+      auto result = auth_service->Login(req.identifier(), req.password(),
+                                       req.device_id(), req.platform(), client_ip);
+
+      chirp::auth::PasswordLoginResponse resp;
+      resp.set_code(result.error_code);
+      resp.set_user_id(result.user_id);
+      resp.set_username(result.username);
+      resp.set_session_id(result.session_id);
+      resp.set_access_token(result.access_token);
+      resp.set_refresh_token(result.refresh_token);
+      resp.set_access_token_expires_at(result.access_token_expires_at);
+      resp.set_refresh_token_expires_at(result.refresh_token_expires_at);
+      resp.set_server_time(NowMs());
+      resp.set_kick_previous(result.kick_previous);
+      resp.set_error_message(result.error_message);
+      SendPacket(session, chirp::gateway::PASSWORD_LOGIN_RESP, pkt.sequence(),
+                resp.SerializeAsString());
+      break;
+    }
+    case chirp::gateway::REFRESH_TOKEN_REQ: {
+      chirp::auth::RefreshTokenRequest req;
+      if (!req.ParseFromArray(pkt.body().data(), static_cast<int>(pkt.body().size()))) {
+        chirp::auth::RefreshTokenResponse resp;
+        resp.set_code(chirp::common::INVALID_PARAM);
+        resp.set_server_time(NowMs());
+        resp.set_error_message("Invalid request");
+        SendPacket(session, chirp::gateway::REFRESH_TOKEN_RESP, pkt.sequence(),
+                  resp.SerializeAsString());
+        return;
+      }
+
+      auto result = auth_service->RefreshAccessToken(req.refresh_token());
+
+      chirp::auth::RefreshTokenResponse resp;
+      resp.set_code(result.error_code);
+      resp.set_access_token(result.access_token);
+      resp.set_access_token_expires_at(result.access_token_expires_at);
+      resp.set_server_time(NowMs());
+      resp.set_error_message(result.error_message);
+      SendPacket(session, chirp::gateway::REFRESH_TOKEN_RESP, pkt.sequence(),
+                resp.SerializeAsString());
+      break;
+    }
+    case chirp::gateway::LOGIN_REQ: {
+      // Legacy login - treat as JWT validation or simple token login
+      chirp::auth::LoginRequest req;
+      if (!req.ParseFromArray(pkt.body().data(), static_cast<int>(pkt.body().size()))) {
+        chirp::auth::LoginResponse resp;
+        resp.set_code(chirp::common::INVALID_PARAM);
+        resp.set_server_time(NowMs());
+        SendPacket(session, chirp::gateway::LOGIN_RESP, pkt.sequence(),
+                  resp.SerializeAsString());
+        return;
+      }
+
+      std::string user_id;
+      chirp::common::ErrorCode code = chirp::common::OK;
+
+      // Try to validate as JWT first
+      auto validated_user = auth_service->ValidateAccessToken(req.token());
+      if (validated_user) {
+        user_id = *validated_user;
+      } else {
+        // Try to validate as session ID
+        auto session_user = auth_service->ValidateSession(req.token());
+        if (session_user) {
+          user_id = *session_user;
+        } else {
+          // Fall back to treating token as user_id (for development)
+          user_id = req.token();
+        }
+      }
+
+      chirp::auth::LoginResponse resp;
+      resp.set_code(code);
+      resp.set_user_id(user_id);
+      resp.set_session_id(user_id + "_sess");
+      resp.set_server_time(NowMs());
+      resp.set_kick_previous(true);
+      resp.mutable_kick()->set_reason("session validated");
+      SendPacket(session, chirp::gateway::LOGIN_RESP, pkt.sequence(),
+                resp.SerializeAsString());
+      break;
+    }
+    case chirp::gateway::LOGOUT_REQ: {
+      chirp::auth::LogoutRequest req;
+      if (!req.ParseFromArray(pkt.body().data(), static_cast<int>(pkt.body().size()))) {
+        chirp::auth::LogoutResponse resp;
+        resp.set_code(chirp::common::INVALID_PARAM);
+        resp.set_server_time(NowMs());
+        SendPacket(session, chirp::gateway::LOGOUT_RESP, pkt.sequence(),
+                  resp.SerializeAsString());
+        return;
+      }
+
+      bool success = auth_service->Logout(req.user_id(), req.session_id());
+
+      chirp::auth::LogoutResponse resp;
+      resp.set_code(success ? chirp::common::OK : chirp::common::INTERNAL_ERROR);
+      resp.set_server_time(NowMs());
+      SendPacket(session, chirp::gateway::LOGOUT_RESP, pkt.sequence(),
+                resp.SerializeAsString());
+      break;
+    }
+    case chirp::gateway::GET_SESSIONS_REQ: {
+      chirp::auth::GetSessionsRequest req;
+      if (!req.ParseFromArray(pkt.body().data(), static_cast<int>(pkt.body().size()))) {
+        chirp::auth::GetSessionsResponse resp;
+        resp.set_code(chirp::common::INVALID_PARAM);
+        resp.set_server_time(NowMs());
+        SendPacket(session, chirp::gateway::GET_SESSIONS_RESP, pkt.sequence(),
+                  resp.SerializeAsString());
+        return;
+      }
+
+      auto sessions = auth_service->GetUserSessions(req.user_id());
+
+      chirp::auth::GetSessionsResponse resp;
+      resp.set_code(chirp::common::OK);
+      resp.set_server_time(NowMs());
+      for (const auto& sess : sessions) {
+        auto* s = resp.add_sessions();
+        s->set_session_id(sess.session_id);
+        s->set_device_id(sess.device_id);
+        s->set_platform(sess.platform);
+        s->set_created_at(sess.created_at);
+        s->set_last_activity_at(sess.last_activity_at);
+        s->set_is_current(sess.is_current);
+      }
+      SendPacket(session, chirp::gateway::GET_SESSIONS_RESP, pkt.sequence(),
+                resp.SerializeAsString());
+      break;
+    }
+    case chirp::gateway::REVOKE_SESSION_REQ: {
+      chirp::auth::RevokeSessionRequest req;
+      if (!req.ParseFromArray(pkt.body().data(), static_cast<int>(pkt.body().size()))) {
+        chirp::auth::RevokeSessionResponse resp;
+        resp.set_code(chirp::common::INVALID_PARAM);
+        resp.set_server_time(NowMs());
+        SendPacket(session, chirp::gateway::REVOKE_SESSION_RESP, pkt.sequence(),
+                  resp.SerializeAsString());
+        return;
+      }
+
+      bool success = auth_service->RevokeSession(req.user_id(), req.session_id());
+
+      chirp::auth::RevokeSessionResponse resp;
+      resp.set_code(success ? chirp::common::OK : chirp::common::INTERNAL_ERROR);
+      resp.set_server_time(NowMs());
+      SendPacket(session, chirp::gateway::REVOKE_SESSION_RESP, pkt.sequence(),
+                resp.SerializeAsString());
+      break;
+    }
+    case chirp::gateway::CHANGE_PASSWORD_REQ: {
+      chirp::auth::ChangePasswordRequest req;
+      if (!req.ParseFromArray(pkt.body().data(), static_cast<int>(pkt.body().size()))) {
+        chirp::auth::ChangePasswordResponse resp;
+        resp.set_code(chirp::common::INVALID_PARAM);
+        resp.set_server_time(NowMs());
+        resp.set_error_message("Invalid request");
+        SendPacket(session, chirp::gateway::CHANGE_PASSWORD_RESP, pkt.sequence(),
+                  resp.SerializeAsString());
+        return;
+      }
+
+      bool success = auth_service->ChangePassword(req.user_id(), req.old_password(),
+                                                 req.new_password());
+
+      chirp::auth::ChangePasswordResponse resp;
+      resp.set_code(success ? chirp::common::OK : chirp::common::AUTH_FAILED);
+      resp.set_server_time(NowMs());
+      if (!success) {
+        resp.set_error_message("Failed to change password. Check your old password.");
+      }
+      SendPacket(session, chirp::gateway::CHANGE_PASSWORD_RESP, pkt.sequence(),
+                resp.SerializeAsString());
+      break;
+    }
+    case chirp::gateway::HEARTBEAT_PING: {
+      chirp::gateway::HeartbeatPong pong;
+      pong.set_timestamp(NowMs());
+      pong.set_server_time(NowMs());
+      SendPacket(session, chirp::gateway::HEARTBEAT_PONG, pkt.sequence(),
+                pong.SerializeAsString());
+      break;
+    }
+    default:
+      Logger::Instance().Debug("Unknown MsgID: " + std::to_string(static_cast<int>(pkt.msg_id())));
+      break;
+    }
+  };
+
+  auto strands = std::make_shared<SessionStrands>(auth_service->GetMySQLExecutor());
+
   chirp::network::TcpServer server(
-      io, port,
-      [&](std::shared_ptr<chirp::network::Session> session, std::string&& payload) {
+      io_pool, port,
+      [strands, handle_packet](std::shared_ptr<chirp::network::Session> session, std::string_view payload) {
         chirp::gateway::Packet pkt;
         if (!pkt.ParseFromArray(payload.data(), static_cast<int>(payload.size()))) {
           Logger::Instance().Warn("Failed to parse Packet from client");
           return;
         }
 
-        std::string client_ip = GetClientIp(session);
-
-        switch (pkt.msg_id()) {
-        case chirp::gateway::REGISTER_REQ: {
-          chirp::auth::RegisterRequest req;
-          if (!req.ParseFromArray(pkt.body().data(), static_cast<int>(pkt.body().size()))) {
-            chirp::auth::RegisterResponse resp;
-            resp.set_code(chirp::common::INVALID_PARAM);
-            resp.set_server_time(NowMs());
-            resp.set_error_message("Invalid request");
-            SendPacket(session, chirp::gateway::REGISTER_RESP, pkt.sequence(),
-                      resp.SerializeAsString());
-            return;
-          }
-
-          chirp::auth::UserRegisterRequest auth_req;
-          auth_req.username = req.username();
-          auth_req.email = req.email();
-          auth_req.password = req.password();
-          auth_req.display_name = req.display_name();
-
-          auto result = auth_service->Register(auth_req, client_ip);
-
-          chirp::auth::RegisterResponse resp;
-          resp.set_code(result.error_code);
-          resp.set_user_id(result.user_id);
-          resp.set_server_time(NowMs());
-          resp.set_error_message(result.error_message);
-          SendPacket(session, chirp::gateway::REGISTER_RESP, pkt.sequence(),
-                    resp.SerializeAsString());
-          break;
-        }
-        case chirp::gateway::PASSWORD_LOGIN_REQ: {
-          chirp::auth::PasswordLoginRequest req;
-          if (!req.ParseFromArray(pkt.body().data(), static_cast<int>(pkt.body().size()))) {
-            chirp::auth::PasswordLoginResponse resp;
-            resp.set_code(chirp::common::INVALID_PARAM);
-            resp.set_server_time(NowMs());
-            resp.set_error_message("Invalid request");
-            SendPacket(session, chirp::gateway::PASSWORD_LOGIN_RESP, pkt.sequence(),
-                      resp.SerializeAsString());
-            return;
-          }
-
-          auto result = auth_service->Login(req.identifier(), req.password(),
-                                           req.device_id(), req.platform(), client_ip);
-
-          chirp::auth::PasswordLoginResponse resp;
-          resp.set_code(result.error_code);
-          resp.set_user_id(result.user_id);
-          resp.set_username(result.username);
-          resp.set_session_id(result.session_id);
-          resp.set_access_token(result.access_token);
-          resp.set_refresh_token(result.refresh_token);
-          resp.set_access_token_expires_at(result.access_token_expires_at);
-          resp.set_refresh_token_expires_at(result.refresh_token_expires_at);
-          resp.set_server_time(NowMs());
-          resp.set_kick_previous(result.kick_previous);
-          resp.set_error_message(result.error_message);
-          SendPacket(session, chirp::gateway::PASSWORD_LOGIN_RESP, pkt.sequence(),
-                    resp.SerializeAsString());
-          break;
-        }
-        case chirp::gateway::REFRESH_TOKEN_REQ: {
-          chirp::auth::RefreshTokenRequest req;
-          if (!req.ParseFromArray(pkt.body().data(), static_cast<int>(pkt.body().size()))) {
-            chirp::auth::RefreshTokenResponse resp;
-            resp.set_code(chirp::common::INVALID_PARAM);
-            resp.set_server_time(NowMs());
-            resp.set_error_message("Invalid request");
-            SendPacket(session, chirp::gateway::REFRESH_TOKEN_RESP, pkt.sequence(),
-                      resp.SerializeAsString());
-            return;
-          }
-
-          auto result = auth_service->RefreshAccessToken(req.refresh_token());
-
-          chirp::auth::RefreshTokenResponse resp;
-          resp.set_code(result.error_code);
-          resp.set_access_token(result.access_token);
-          resp.set_access_token_expires_at(result.access_token_expires_at);
-          resp.set_server_time(NowMs());
-          resp.set_error_message(result.error_message);
-          SendPacket(session, chirp::gateway::REFRESH_TOKEN_RESP, pkt.sequence(),
-                    resp.SerializeAsString());
-          break;
-        }
-        case chirp::gateway::LOGIN_REQ: {
-          // Legacy login - treat as JWT validation or simple token login
-          chirp::auth::LoginRequest req;
-          if (!req.ParseFromArray(pkt.body().data(), static_cast<int>(pkt.body().size()))) {
-            chirp::auth::LoginResponse resp;
-            resp.set_code(chirp::common::INVALID_PARAM);
-            resp.set_server_time(NowMs());
-            SendPacket(session, chirp::gateway::LOGIN_RESP, pkt.sequence(),
-                      resp.SerializeAsString());
-            return;
-          }
-
-          std::string user_id;
-          chirp::common::ErrorCode code = chirp::common::OK;
-
-          // Try to validate as JWT first
-          auto validated_user = auth_service->ValidateAccessToken(req.token());
-          if (validated_user) {
-            user_id = *validated_user;
-          } else {
-            // Try to validate as session ID
-            auto session_user = auth_service->ValidateSession(req.token());
-            if (session_user) {
-              user_id = *session_user;
-            } else {
-              // Fall back to treating token as user_id (for development)
-              user_id = req.token();
-            }
-          }
-
-          chirp::auth::LoginResponse resp;
-          resp.set_code(code);
-          resp.set_user_id(user_id);
-          resp.set_session_id(user_id + "_sess");
-          resp.set_server_time(NowMs());
-          resp.set_kick_previous(true);
-          resp.mutable_kick()->set_reason("session validated");
-          SendPacket(session, chirp::gateway::LOGIN_RESP, pkt.sequence(),
-                    resp.SerializeAsString());
-          break;
-        }
-        case chirp::gateway::LOGOUT_REQ: {
-          chirp::auth::LogoutRequest req;
-          if (!req.ParseFromArray(pkt.body().data(), static_cast<int>(pkt.body().size()))) {
-            chirp::auth::LogoutResponse resp;
-            resp.set_code(chirp::common::INVALID_PARAM);
-            resp.set_server_time(NowMs());
-            SendPacket(session, chirp::gateway::LOGOUT_RESP, pkt.sequence(),
-                      resp.SerializeAsString());
-            return;
-          }
-
-          bool success = auth_service->Logout(req.user_id(), req.session_id());
-
-          chirp::auth::LogoutResponse resp;
-          resp.set_code(success ? chirp::common::OK : chirp::common::INTERNAL_ERROR);
-          resp.set_server_time(NowMs());
-          SendPacket(session, chirp::gateway::LOGOUT_RESP, pkt.sequence(),
-                    resp.SerializeAsString());
-          break;
-        }
-        case chirp::gateway::GET_SESSIONS_REQ: {
-          chirp::auth::GetSessionsRequest req;
-          if (!req.ParseFromArray(pkt.body().data(), static_cast<int>(pkt.body().size()))) {
-            chirp::auth::GetSessionsResponse resp;
-            resp.set_code(chirp::common::INVALID_PARAM);
-            resp.set_server_time(NowMs());
-            SendPacket(session, chirp::gateway::GET_SESSIONS_RESP, pkt.sequence(),
-                      resp.SerializeAsString());
-            return;
-          }
-
-          auto sessions = auth_service->GetUserSessions(req.user_id());
-
-          chirp::auth::GetSessionsResponse resp;
-          resp.set_code(chirp::common::OK);
-          resp.set_server_time(NowMs());
-          for (const auto& sess : sessions) {
-            auto* s = resp.add_sessions();
-            s->set_session_id(sess.session_id);
-            s->set_device_id(sess.device_id);
-            s->set_platform(sess.platform);
-            s->set_created_at(sess.created_at);
-            s->set_last_activity_at(sess.last_activity_at);
-            s->set_is_current(sess.is_current);
-          }
-          SendPacket(session, chirp::gateway::GET_SESSIONS_RESP, pkt.sequence(),
-                    resp.SerializeAsString());
-          break;
-        }
-        case chirp::gateway::REVOKE_SESSION_REQ: {
-          chirp::auth::RevokeSessionRequest req;
-          if (!req.ParseFromArray(pkt.body().data(), static_cast<int>(pkt.body().size()))) {
-            chirp::auth::RevokeSessionResponse resp;
-            resp.set_code(chirp::common::INVALID_PARAM);
-            resp.set_server_time(NowMs());
-            SendPacket(session, chirp::gateway::REVOKE_SESSION_RESP, pkt.sequence(),
-                      resp.SerializeAsString());
-            return;
-          }
-
-          bool success = auth_service->RevokeSession(req.user_id(), req.session_id());
-
-          chirp::auth::RevokeSessionResponse resp;
-          resp.set_code(success ? chirp::common::OK : chirp::common::INTERNAL_ERROR);
-          resp.set_server_time(NowMs());
-          SendPacket(session, chirp::gateway::REVOKE_SESSION_RESP, pkt.sequence(),
-                    resp.SerializeAsString());
-          break;
-        }
-        case chirp::gateway::CHANGE_PASSWORD_REQ: {
-          chirp::auth::ChangePasswordRequest req;
-          if (!req.ParseFromArray(pkt.body().data(), static_cast<int>(pkt.body().size()))) {
-            chirp::auth::ChangePasswordResponse resp;
-            resp.set_code(chirp::common::INVALID_PARAM);
-            resp.set_server_time(NowMs());
-            resp.set_error_message("Invalid request");
-            SendPacket(session, chirp::gateway::CHANGE_PASSWORD_RESP, pkt.sequence(),
-                      resp.SerializeAsString());
-            return;
-          }
-
-          bool success = auth_service->ChangePassword(req.user_id(), req.old_password(),
-                                                     req.new_password());
-
-          chirp::auth::ChangePasswordResponse resp;
-          resp.set_code(success ? chirp::common::OK : chirp::common::AUTH_FAILED);
-          resp.set_server_time(NowMs());
-          if (!success) {
-            resp.set_error_message("Failed to change password. Check your old password.");
-          }
-          SendPacket(session, chirp::gateway::CHANGE_PASSWORD_RESP, pkt.sequence(),
-                    resp.SerializeAsString());
-          break;
-        }
-        case chirp::gateway::HEARTBEAT_PING: {
-          chirp::gateway::HeartbeatPong pong;
-          pong.set_timestamp(NowMs());
-          pong.set_server_time(NowMs());
-          SendPacket(session, chirp::gateway::HEARTBEAT_PONG, pkt.sequence(),
-                    pong.SerializeAsString());
-          break;
-        }
-        default:
-          Logger::Instance().Debug("Unknown MsgID: " + std::to_string(static_cast<int>(pkt.msg_id())));
-          break;
+        if (pkt.msg_id() == chirp::gateway::HEARTBEAT_PING) {
+          handle_packet(session, pkt);
+          return;
         }
+        auto strand = strands->Get(session.get());
+        asio::post(strand, [handle_packet, session = std::move(session), pkt = std::move(pkt)]() {
+          handle_packet(session, pkt);
+        });
       },
-      [auth_service](std::shared_ptr<chirp::network::Session> session) {
+      [strands](std::shared_ptr<chirp::network::Session> session) {
+        strands->Remove(session.get());
         Logger::Instance().Debug("Client disconnected");
       });
 
   server.Start();
+  io_pool.Start();
 
   asio::signal_set signals(io, SIGINT, SIGTERM);
   signals.async_wait([&](const std::error_code&, int) {
     Logger::Instance().Info("Shutdown requested");
     server.Stop();
     auth_service->Shutdown();
+    const auto pool_stats = auth_service->GetPoolStats();
+    Logger::Instance().Info("MySQL pool: " + std::to_string(pool_stats.acquired) + " acquired, " +
+                            std::to_string(pool_stats.timeouts) + " timed out, " +
+                            std::to_string(pool_stats.waits) + " waited (max " +
+                            std::to_string(pool_stats.max_wait_us) + "us), max in use " +
+                            std::to_string(pool_stats.max_in_use) + ", " +
+                            std::to_string(pool_stats.closed_dead) + " dead connections closed");
+    io_pool.Stop();
     io.stop();
   });
 
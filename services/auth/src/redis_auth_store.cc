@@ -1,6 +1,7 @@
 #include "redis_auth_store.h"
 
 #include <chrono>
+#include <set>
 #include <sstream>
 #include <thread>
 
@@ -390,20 +391,23 @@ std::vector<std::string> RedisAuthStore::GetUserDevices(const std::string& user_
     return {};
   }
 
-  // Get all device keys for user
+  // Get all device keys for user (SCAN, so the lookup never blocks Redis on a large keyspace)
   std::string pattern = UserDevicesKey(user_id) + ":*";
-  auto keys = impl_->redis->Keys(pattern);
-
-  std::vector<std::string> devices;
-  for (const auto& key : keys) {
-    // Extract device_id from key
-    size_t pos = key.find_last_of(':');
-    if (pos != std::string::npos) {
-      devices.push_back(key.substr(pos + 1));
+  auto scanner = impl_->redis->Scan(pattern);
+
+  std::set<std::string> devices;
+  std::vector<std::string> keys;
+  while (scanner.Next(&keys)) {
+    for (const auto& key : keys) {
+      // Extract device_id from key
+      size_t pos = key.find_last_of(':');
+      if (pos != std::string::npos) {
+        devices.insert(key.substr(pos + 1));
+      }
     }
   }
 
-  return devices;
+  return {devices.begin(), devices.end()};
 }
 
 bool RedisAuthStore::RemoveDevice(const std::string& user_id, const std::string& device_id) {
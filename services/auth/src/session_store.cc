@@ -1,11 +1,14 @@
 #include "session_store.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstring>
 #include <mutex>
+#include <unordered_map>
 
 #include <mysql/mysql.h>
 
+#include "database/mysql_connection_pool.h"
 #include "logger.h"
 #include "token_generator.h"
 
@@ -13,6 +16,7 @@ namespace chirp::auth {
 namespace {
 
 using chirp::common::Logger;
+using chirp::database::MySQLConnectionPool;
 
 int64_t NowMs() {
   using namespace std::chrono;
@@ -27,67 +31,60 @@ std::string EscapeString(MYSQL* mysql, const std::string& str) {
 
 } // namespace
 
+database::MySQLPoolOptions SessionStore::Config::PoolOptions() const {
+  database::MySQLPoolOptions options;
+  options.host = host;
+  options.port = port;
+  options.database = database;
+  options.user = user;
+  options.password = password;
+  options.min_size = std::min(min_pool_size, pool_size);
+  options.max_size = pool_size;
+  options.acquire_timeout = std::chrono::milliseconds(acquire_timeout_ms);
+  options.executor_threads = query_threads;
+  return options;
+}
+
 struct SessionStore::Impl {
-  Config config;
+  std::shared_ptr<MySQLConnectionPool> pool;
   std::mutex mutex;
-  std::vector<MYSQL*> connections;
-
-  Impl(const Config& cfg) : config(cfg) {}
+  std::unordered_map<MYSQL*, MySQLConnectionPool::Lease> leases;  // checked out, by handle
 
-  ~Impl() {
-    for (auto* conn : connections) {
-      mysql_close(conn);
-    }
-  }
+  explicit Impl(std::shared_ptr<MySQLConnectionPool> p) : pool(std::move(p)) {}
 
+  // Raw handle of a pooled connection; hand it back with ReturnConnection().
   MYSQL* GetConnection() {
-    std::lock_guard<std::mutex> lock(mutex);
-
-    if (!connections.empty()) {
-      auto* conn = connections.back();
-      connections.pop_back();
-      if (mysql_ping(conn) == 0) {
-        return conn;
-      }
-      mysql_close(conn);
-    }
-
-    MYSQL* conn = mysql_init(nullptr);
-    if (!conn) {
-      return nullptr;
-    }
-
-    const bool reconnect = true;
-    mysql_options(conn, MYSQL_OPT_RECONNECT, &reconnect);
-
-    if (!mysql_real_connect(conn,
-                            config.host.c_str(),
-                            config.user.c_str(),
-                            config.password.c_str(),
-                            config.database.c_str(),
-                            config.port,
-                            nullptr,
-                            CLIENT_MULTI_STATEMENTS)) {
-      Logger::Instance().Error("MySQL connection failed: " + std::string(mysql_error(conn)));
-      mysql_close(conn);
+    auto lease = pool->Acquire();
+    if (!lease) {
+      Logger::Instance().Error("No MySQL connection available for SessionStore");
       return nullptr;
     }
-
+    MYSQL* conn = lease->GetMySQL();
+    std::lock_guard<std::mutex> lock(mutex);
+    leases.emplace(conn, std::move(lease));
     return conn;
   }
 
   void ReturnConnection(MYSQL* conn) {
-    if (conn && connections.size() < config.pool_size) {
+    MySQLConnectionPool::Lease lease;
+    {
       std::lock_guard<std::mutex> lock(mutex);
-      connections.push_back(conn);
-    } else if (conn) {
-      mysql_close(conn);
+      auto it = leases.find(conn);
+      if (it == leases.end()) {
+        return;
+      }
+      lease = std::move(it->second);
+      leases.erase(it);
     }
+    // `lease` hands the connection back to the pool here, outside the lock
   }
 };
 
 SessionStore::SessionStore(const Config& config)
-    : impl_(std::make_unique<Impl>(config)) {}
+    : impl_(std::make_unique<Impl>(std::make_shared<MySQLConnectionPool>(config.PoolOptions()))) {}
+
+SessionStore::SessionStore(std::shared_ptr<MySQLConnectionPool> pool)
+    : impl_(std::make_unique<Impl>(std::move(pool))) {}
 
 SessionStore::~SessionStore() = default;
 
@@ -9,6 +9,11 @@
 
 #include "proto/common.pb.h"
 
+namespace chirp::database {
+class MySQLConnectionPool;
+struct MySQLPoolOptions;
+} // namespace chirp::database
+
 namespace chirp::auth {
 
 /// @brief User data structure
@@ -50,10 +55,19 @@ public:
     std::string database = "chirp";
     std::string user = "chirp";
     std::string password = "chirp_password";
-    size_t pool_size = 10;
+    size_t pool_size = 10;          // Max open connections
+    size_t min_pool_size = 2;       // Kept open even when idle
+    int acquire_timeout_ms = 2000;  // Wait for a free connection before a call fails
+    size_t query_threads = 4;       // Threads of the pool's executor
+
+    database::MySQLPoolOptions PoolOptions() const;
   };
 
+  /// @brief Open a connection pool of its own
   explicit UserStore(const Config& config);
+
+  /// @brief Share `pool` with other stores
+  explicit UserStore(std::shared_ptr<database::MySQLConnectionPool> pool);
   ~UserStore();
 
   /// @brief Initialize the store and create tables if needed
@@ -9,6 +9,26 @@ bool IsAuthenticated(std::string_view authenticated_user_id) {
   return !authenticated_user_id.empty();
 }
 
+// GetHistoryRequest and GetHistoryRequestV2 share user_id/channel_type/channel_id.
+template <typename Request>
+chirp::common::ErrorCode ValidateHistoryAccess(const Request& req, std::string_view authenticated_user_id) {
+  if (!IsAuthenticated(authenticated_user_id) || req.user_id().empty() || req.user_id() != authenticated_user_id) {
+    return chirp::common::AUTH_FAILED;
+  }
+
+  if (req.channel_type() == PRIVATE) {
+    if (!PrivateChannelContainsUser(req.channel_id(), authenticated_user_id)) {
+      return chirp::common::AUTH_FAILED;
+    }
+    return chirp::common::OK;
+  }
+
+  if (req.channel_id().empty()) {
+    return chirp::common::INVALID_PARAM;
+  }
+  return chirp::common::OK;
+}
+
 } // namespace
 
 bool PrivateChannelContainsUser(std::string_view channel_id, std::string_view user_id) {
@@ -53,21 +73,12 @@ chirp::common::ErrorCode ValidateSendMessageRequest(const SendMessageRequest& re
 
 chirp::common::ErrorCode ValidateGetHistoryRequest(const GetHistoryRequest& req,
                                                    std::string_view authenticated_user_id) {
-  if (!IsAuthenticated(authenticated_user_id) || req.user_id().empty() || req.user_id() != authenticated_user_id) {
-    return chirp::common::AUTH_FAILED;
-  }
-
-  if (req.channel_type() == PRIVATE) {
-    if (!PrivateChannelContainsUser(req.channel_id(), authenticated_user_id)) {
-      return chirp::common::AUTH_FAILED;
-    }
-    return chirp::common::OK;
-  }
+  return ValidateHistoryAccess(req, authenticated_user_id);
+}
 
-  if (req.channel_id().empty()) {
-    return chirp::common::INVALID_PARAM;
-  }
-  return chirp::common::OK;
+chirp::common::ErrorCode ValidateGetHistoryRequest(const GetHistoryRequestV2& req,
+                                                   std::string_view authenticated_user_id) {
+  return ValidateHistoryAccess(req, authenticated_user_id);
 }
 
 chirp::common::ErrorCode ValidateLogoutRequest(const chirp::auth::LogoutRequest& req,
@@ -16,6 +16,9 @@ chirp::common::ErrorCode ValidateSendMessageRequest(const SendMessageRequest& re
 chirp::common::ErrorCode ValidateGetHistoryRequest(const GetHistoryRequest& req,
                                                    std::string_view authenticated_user_id);
 
+chirp::common::ErrorCode ValidateGetHistoryRequest(const GetHistoryRequestV2& req,
+                                                   std::string_view authenticated_user_id);
+
 chirp::common::ErrorCode ValidateLogoutRequest(const chirp::auth::LogoutRequest& req,
                                                std::string_view authenticated_user_id,
                                                std::string_view authenticated_session_id);
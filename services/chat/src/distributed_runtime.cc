@@ -6,7 +6,7 @@ namespace chirp::chat::runtime {
 
 namespace {
 
-void DispatchPacket(std::string&& payload,
+void DispatchPacket(std::string_view payload,
                     const std::shared_ptr<network::Session>& session,
                     const PacketHandler& on_packet,
                     bool log_parse_failure) {
@@ -22,28 +22,28 @@ void DispatchPacket(std::string&& payload,
 
 }  // namespace
 
-std::unique_ptr<network::TcpServer> MakeDistributedTcpServer(asio::io_context& io,
+std::unique_ptr<network::TcpServer> MakeDistributedTcpServer(network::IoContextPool& io_pool,
                                                              uint16_t port,
                                                              PacketHandler on_packet,
                                                              DisconnectHandler on_disconnect) {
   return std::make_unique<network::TcpServer>(
-      io, port,
-      [on_packet = std::move(on_packet)](std::shared_ptr<network::Session> session, std::string&& payload) {
-        DispatchPacket(std::move(payload), session, on_packet, true);
+      io_pool, port,
+      [on_packet = std::move(on_packet)](std::shared_ptr<network::Session> session, std::string_view payload) {
+        DispatchPacket(payload, session, on_packet, true);
       },
       [on_disconnect = std::move(on_disconnect)](std::shared_ptr<network::Session> session) {
         on_disconnect(session);
       });
 }
 
-std::unique_ptr<network::WebSocketServer> MakeDistributedWsServer(asio::io_context& io,
+std::unique_ptr<network::WebSocketServer> MakeDistributedWsServer(network::IoContextPool& io_pool,
                                                                   uint16_t port,
                                                                   PacketHandler on_packet,
                                                                   DisconnectHandler on_disconnect) {
   return std::make_unique<network::WebSocketServer>(
-      io, port,
-      [on_packet = std::move(on_packet)](std::shared_ptr<network::Session> session, std::string&& payload) {
-        DispatchPacket(std::move(payload), session, on_packet, false);
+      io_pool, port,
+      [on_packet = std::move(on_packet)](std::shared_ptr<network::Session> session, std::string_view payload) {
+        DispatchPacket(payload, session, on_packet, false);
       },
       [on_disconnect = std::move(on_disconnect)](std::shared_ptr<network::Session> session) {
         on_disconnect(session);
@@ -5,6 +5,7 @@
 
 #include <asio.hpp>
 
+#include "network/io_context_pool.h"
 #include "network/session.h"
 #include "network/tcp_server.h"
 #include "network/websocket_server.h"
@@ -17,12 +18,12 @@ using PacketHandler = std::function<void(const std::shared_ptr<network::Session>
 using DisconnectHandler = std::function<void(const std::shared_ptr<network::Session>& session)>;
 using ShutdownHandler = std::function<void()>;
 
-std::unique_ptr<network::TcpServer> MakeDistributedTcpServer(asio::io_context& io,
+std::unique_ptr<network::TcpServer> MakeDistributedTcpServer(network::IoContextPool& io_pool,
                                                              uint16_t port,
                                                              PacketHandler on_packet,
                                                              DisconnectHandler on_disconnect);
 
-std::unique_ptr<network::WebSocketServer> MakeDistributedWsServer(asio::io_context& io,
+std::unique_ptr<network::WebSocketServer> MakeDistributedWsServer(network::IoContextPool& io_pool,
                                                                   uint16_t port,
                                                                   PacketHandler on_packet,
                                                                   DisconnectHandler on_disconnect);
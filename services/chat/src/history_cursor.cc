@@ -0,0 +1,73 @@
+#include "history_cursor.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "common/base64.h"
+
+namespace chirp::chat {
+namespace {
+
+// version | direction | channel_type:4 | channel_id length:2 | channel_id | timestamp:8 | seq:8 | page_size:2
+constexpr uint8_t kCursorVersion = 1;
+constexpr size_t kFixedBytes = 1 + 1 + 4 + 2 + 8 + 8 + 2;
+
+void PutBE(std::string* out, uint64_t v, int bytes) {
+  for (int i = bytes - 1; i >= 0; --i) {
+    out->push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+  }
+}
+
+uint64_t GetBE(const uint8_t* p, int bytes) {
+  uint64_t v = 0;
+  for (int i = 0; i < bytes; ++i) {
+    v = (v << 8) | static_cast<uint64_t>(p[i]);
+  }
+  return v;
+}
+
+} // namespace
+
+std::string HistoryCursor::Encode() const {
+  const size_t id_len = std::min<size_t>(channel_id.size(), std::numeric_limits<uint16_t>::max());
+  const int32_t size = std::clamp<int32_t>(page_size, 0, std::numeric_limits<uint16_t>::max());
+
+  std::string raw;
+  raw.reserve(kFixedBytes + id_len);
+  raw.push_back(static_cast<char>(kCursorVersion));
+  raw.push_back(static_cast<char>(direction));
+  PutBE(&raw, static_cast<uint32_t>(channel_type), 4);
+  PutBE(&raw, id_len, 2);
+  raw.append(channel_id, 0, id_len);
+  PutBE(&raw, static_cast<uint64_t>(timestamp), 8);
+  PutBE(&raw, static_cast<uint64_t>(seq), 8);
+  PutBE(&raw, static_cast<uint64_t>(size), 2);
+  return common::Base64UrlEncode(reinterpret_cast<const uint8_t*>(raw.data()), raw.size());
+}
+
+std::optional<HistoryCursor> HistoryCursor::Decode(std::string_view token) {
+  std::string raw;
+  if (!common::Base64UrlDecode(token, &raw) || raw.size() < kFixedBytes) {
+    return std::nullopt;
+  }
+  const auto* p = reinterpret_cast<const uint8_t*>(raw.data());
+  if (p[0] != kCursorVersion || p[1] > static_cast<uint8_t>(Direction::kNewer)) {
+    return std::nullopt;
+  }
+  const size_t id_len = static_cast<size_t>(GetBE(p + 6, 2));
+  if (raw.size() != kFixedBytes + id_len) {
+    return std::nullopt;
+  }
+
+  HistoryCursor cursor;
+  cursor.direction = static_cast<Direction>(p[1]);
+  cursor.channel_type = static_cast<int>(static_cast<int32_t>(GetBE(p + 2, 4)));
+  cursor.channel_id.assign(raw, 8, id_len);
+  const uint8_t* q = p + 8 + id_len;
+  cursor.timestamp = static_cast<int64_t>(GetBE(q, 8));
+  cursor.seq = static_cast<int64_t>(GetBE(q + 8, 8));
+  cursor.page_size = static_cast<int32_t>(GetBE(q + 16, 2));
+  return cursor;
+}
+
+} // namespace chirp::chat
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace chirp::chat {
+
+/// @brief Keyset position in a channel's history, carried to clients as an opaque page cursor
+/// A page continues strictly past (timestamp, seq) — the idx_channel sort order — so messages
+/// sharing a millisecond are neither skipped nor repeated, and a page costs one index seek
+/// however deep the scroll-back is.
+struct HistoryCursor {
+  enum class Direction : uint8_t {
+    kOlder = 0,  // scroll-back: the page ends just before the position
+    kNewer = 1   // catch-up: the page starts just after the position
+  };
+
+  std::string channel_id;
+  int channel_type{0};
+  int64_t timestamp{0};
+  int64_t seq{0};  // messages.id of the boundary row, the tiebreaker within a timestamp
+  Direction direction{Direction::kOlder};
+  int32_t page_size{0};
+
+  /// @brief Binary form (big-endian, versioned), URL-safe Base64 so it fits a proto string
+  std::string Encode() const;
+
+  /// @brief nullopt for anything Encode() did not produce (wrong version, truncated, trailing bytes)
+  static std::optional<HistoryCursor> Decode(std::string_view token);
+};
+
+} // namespace chirp::chat
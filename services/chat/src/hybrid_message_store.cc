@@ -1,10 +1,13 @@
 #include "hybrid_message_store.h"
 
+#include <algorithm>
 #include <chrono>
+#include <limits>
 #include <mutex>
 #include <sstream>
 
 #include "logger.h"
+#include "network/redis_scripts.h"
 
 namespace chirp::chat {
 namespace {
@@ -28,6 +31,35 @@ std::string ToHex(const uint8_t* data, size_t len) {
   return out;
 }
 
+MySQLMessageData ToMySQL(const MessageData& message) {
+  MySQLMessageData mysql_msg;
+  mysql_msg.message_id = message.message_id;
+  mysql_msg.sender_id = message.sender_id;
+  mysql_msg.receiver_id = message.receiver_id;
+  mysql_msg.channel_id = message.channel_id;
+  mysql_msg.channel_type = message.channel_type;
+  mysql_msg.msg_type = message.msg_type;
+  mysql_msg.content = message.content;
+  mysql_msg.timestamp = message.timestamp;
+  mysql_msg.created_at = message.created_at;
+  return mysql_msg;
+}
+
+MessageData FromMySQL(MySQLMessageData&& mysql_msg) {
+  MessageData message;
+  message.message_id = std::move(mysql_msg.message_id);
+  message.sender_id = std::move(mysql_msg.sender_id);
+  message.receiver_id = std::move(mysql_msg.receiver_id);
+  message.channel_id = std::move(mysql_msg.channel_id);
+  message.channel_type = mysql_msg.channel_type;
+  message.msg_type = mysql_msg.msg_type;
+  message.content = std::move(mysql_msg.content);
+  message.timestamp = mysql_msg.timestamp;
+  message.created_at = mysql_msg.created_at;
+  message.seq = mysql_msg.seq;
+  return message;
+}
+
 } // namespace
 
 std::string MessageData::SerializeAsString() const {
@@ -66,19 +98,35 @@ HybridMessageStore::HybridMessageStore(asio::io_context& io,
     : io_(io), config_(config) {
 
   // Create Redis client
-  redis_ = std::make_shared<network::RedisClient>(config_.redis_host, config_.redis_port);
+  network::RedisClientOptions redis_options;
+  redis_options.cluster = config_.redis_cluster;
+  redis_ = std::make_shared<network::RedisClient>(config_.redis_host, config_.redis_port, redis_options);
 
   // Create MySQL connection pool
-  mysql_pool_ = std::make_shared<MySQLConnectionPool>(
-      config_.mysql_pool_size,
-      config_.mysql_host,
-      config_.mysql_port,
-      config_.mysql_database,
-      config_.mysql_user,
-      config_.mysql_password);
+  database::MySQLPoolOptions pool_options;
+  pool_options.host = config_.mysql_host;
+  pool_options.port = config_.mysql_port;
+  pool_options.database = config_.mysql_database;
+  pool_options.user = config_.mysql_user;
+  pool_options.password = config_.mysql_password;
+  pool_options.min_size = config_.mysql_pool_min;
+  pool_options.max_size = config_.mysql_pool_size;
+  pool_options.acquire_timeout = std::chrono::milliseconds(config_.mysql_acquire_timeout_ms);
+  pool_options.ping_interval = std::chrono::milliseconds(config_.mysql_ping_interval_ms);
+  pool_options.idle_timeout = std::chrono::milliseconds(config_.mysql_idle_timeout_ms);
+  pool_options.executor_threads = config_.mysql_query_threads;
+  mysql_pool_ = std::make_shared<MySQLConnectionPool>(pool_options);
 
   // Create MySQL message store
   mysql_store_ = std::make_shared<MySQLMessageStore>(mysql_pool_);
+
+  // Group-commit writer for StoreMessageAsync
+  MessageBatchWriter::Options writer_options;
+  writer_options.max_batch_rows = static_cast<size_t>(config_.mysql_batch_rows);
+  writer_options.max_delay_ms = config_.mysql_batch_delay_ms;
+  writer_options.max_queue = config_.mysql_write_queue;
+  writer_options.threads = config_.mysql_writer_threads;
+  writer_ = std::make_unique<MessageBatchWriter>(mysql_store_, writer_options);
 }
 
 HybridMessageStore::~HybridMessageStore() {
@@ -100,79 +148,44 @@ bool HybridMessageStore::Initialize() {
     Logger::Instance().Warn("Redis connection failed, running in MySQL-only mode");
   }
 
+  writer_->Start();
+
   Logger::Instance().Info("HybridMessageStore initialized");
   return true;
 }
 
 void HybridMessageStore::Shutdown() {
   Logger::Instance().Info("Shutting down HybridMessageStore...");
+  writer_->Stop();  // flushes what is still queued
+  mysql_pool_->Stop();  // finishes queued queries and releases what they captured
 }
 
 bool HybridMessageStore::StoreMessage(const MessageData& message) {
-  // 1. Store in Redis for fast access
-  std::string history_key = HistoryKey(message.channel_id);
-  std::string msg_data = message.SerializeAsString();
-
-  redis_->RPush(history_key, msg_data);
+  // 1. Store in Redis for fast access (history and offline queue in one round trip)
+  HotWrites(message).Execute();
 
   // 2. Store in MySQL for persistence
-  MySQLMessageData mysql_msg;
-  mysql_msg.message_id = message.message_id;
-  mysql_msg.sender_id = message.sender_id;
-  mysql_msg.receiver_id = message.receiver_id;
-  mysql_msg.channel_id = message.channel_id;
-  mysql_msg.channel_type = message.channel_type;
-  mysql_msg.msg_type = message.msg_type;
-  mysql_msg.content = message.content;
-  mysql_msg.timestamp = message.timestamp;
-  mysql_msg.created_at = message.created_at;
-
-  bool mysql_result = mysql_store_->StoreMessage(mysql_msg);
-
-  // 3. Add to offline queue if there's a specific receiver
-  if (!message.receiver_id.empty() && message.channel_type == 0) {  // PRIVATE
-    std::string offline_key = OfflineKey(message.receiver_id);
-    redis_->RPush(offline_key, msg_data);
-    redis_->Expire(offline_key, config_.redis_offline_ttl_seconds);
-  }
+  bool mysql_result = mysql_store_->StoreMessage(ToMySQL(message));
 
   return mysql_result;  // Return MySQL result as the source of truth
 }
 
 void HybridMessageStore::StoreMessageAsync(const MessageData& message,
                                           std::function<void(bool)> callback) {
-  // Store in Redis synchronously (fast path)
-  std::string history_key = HistoryKey(message.channel_id);
-  std::string msg_data = message.SerializeAsString();
-
-  redis_->RPush(history_key, msg_data);
+  // Redis writes are pipelined without waiting for the reply (fast path)
+  HotWrites(message).ExecuteAsync(nullptr);
 
-  // For offline messages
-  if (!message.receiver_id.empty() && message.channel_type == 0) {
-    std::string offline_key = OfflineKey(message.receiver_id);
-    redis_->RPush(offline_key, msg_data);
-    redis_->Expire(offline_key, config_.redis_offline_ttl_seconds);
+  // MySQL write is group-committed on the writer's threads; the callback comes back on io_
+  std::function<void(bool)> done;
+  if (callback) {
+    done = [this, callback](bool result) { asio::post(io_, [callback, result]() { callback(result); }); };
   }
-
-  // Post MySQL write to background thread
-  asio::post(io_, [this, message, callback]() {
-    MySQLMessageData mysql_msg;
-    mysql_msg.message_id = message.message_id;
-    mysql_msg.sender_id = message.sender_id;
-    mysql_msg.receiver_id = message.receiver_id;
-    mysql_msg.channel_id = message.channel_id;
-    mysql_msg.channel_type = message.channel_type;
-    mysql_msg.msg_type = message.msg_type;
-    mysql_msg.content = message.content;
-    mysql_msg.timestamp = message.timestamp;
-    mysql_msg.created_at = message.created_at;
-
-    bool result = mysql_store_->StoreMessage(mysql_msg);
-
+  if (!writer_->Submit(ToMySQL(message), std::move(done))) {
+    Logger::Instance().Warn("MySQL write queue full, message " + message.message_id + " left to migration");
     if (callback) {
-      callback(result);
+      asio::post(io_, [callback]() { callback(false); });
     }
-  });
+  }
 }
 
 std::vector<MessageData> HybridMessageStore::GetHistory(const std::string& channel_id,
@@ -181,15 +194,15 @@ std::vector<MessageData> HybridMessageStore::GetHistory(const std::string& chann
                                                        int32_t limit) {
   // First try Redis (hot data)
   std::string history_key = HistoryKey(channel_id);
-  auto redis_messages = redis_->LRange(history_key, -limit, -1);
+  auto redis_messages = redis_->LRangeReply(history_key, -limit, -1);
 
   std::vector<MessageData> results;
 
-  if (!redis_messages.empty()) {
-    // Parse Redis messages
-    for (const auto& msg_data : redis_messages) {
+  if (redis_messages) {
+    // Parse Redis messages straight out of the reply
+    for (const auto& msg_data : redis_messages->elements) {
       MessageData msg;
-      if (msg.ParseFromArray(msg_data.data(), static_cast<int>(msg_data.size()))) {
+      if (msg.ParseFromArray(msg_data.str.data(), static_cast<int>(msg_data.str.size()))) {
         if (before_timestamp <= 0 || msg.timestamp < before_timestamp) {
           results.push_back(std::move(msg));
         }
@@ -213,17 +226,7 @@ std::vector<MessageData> HybridMessageStore::GetHistory(const std::string& chann
         }
       }
       if (!duplicate) {
-        MessageData converted;
-        converted.message_id = std::move(msg.message_id);
-        converted.sender_id = std::move(msg.sender_id);
-        converted.receiver_id = std::move(msg.receiver_id);
-        converted.channel_id = std::move(msg.channel_id);
-        converted.channel_type = msg.channel_type;
-        converted.msg_type = msg.msg_type;
-        converted.content = std::move(msg.content);
-        converted.timestamp = msg.timestamp;
-        converted.created_at = msg.created_at;
-        results.push_back(std::move(converted));
+        results.push_back(FromMySQL(std::move(msg)));
       }
     }
   }
@@ -237,47 +240,91 @@ std::vector<MessageData> HybridMessageStore::GetHistory(const std::string& chann
   return results;
 }
 
+std::vector<MessageData> HybridMessageStore::GetHistoryPage(const HistoryCursor& position,
+                                                           std::optional<HistoryCursor>* next) {
+  const int32_t limit = position.page_size > 0
+                            ? std::min(position.page_size, config_.max_history_limit)
+                            : config_.pagination_page_size;
+  const auto direction = position.direction == HistoryCursor::Direction::kNewer ? HistoryDirection::kNewer
+                                                                                : HistoryDirection::kOlder;
+
+  // One row past the page tells whether another page follows
+  auto rows = mysql_store_->GetHistoryPage(position.channel_id, position.channel_type, direction,
+                                           position.timestamp, position.seq, limit + 1);
+  const bool has_more = static_cast<int32_t>(rows.size()) > limit;
+  if (has_more) {
+    // Rows are oldest first: the extra one is the oldest going back, the newest going forward
+    if (direction == HistoryDirection::kOlder) {
+      rows.erase(rows.begin());
+    } else {
+      rows.pop_back();
+    }
+  }
+
+  std::vector<MessageData> messages;
+  messages.reserve(rows.size());
+  for (auto& row : rows) {
+    messages.push_back(FromMySQL(std::move(row)));
+  }
+
+  if (next) {
+    next->reset();
+    if (has_more) {
+      const MessageData& edge = direction == HistoryDirection::kOlder ? messages.front() : messages.back();
+      HistoryCursor following = position;
+      following.timestamp = edge.timestamp;
+      following.seq = edge.seq;
+      following.page_size = limit;
+      *next = std::move(following);
+    }
+  }
+  return messages;
+}
+
 std::vector<MessageData> HybridMessageStore::GetHistoryV2(const std::string& channel_id,
                                                          int channel_type,
                                                          const std::string& cursor,
                                                          int32_t limit,
                                                          std::string* next_cursor) {
-  // For cursor-based pagination, we use timestamp-based cursors
-  int64_t before_timestamp = 0;
-
-  if (!cursor.empty()) {
-    // Decode cursor (format: "timestamp:index")
-    size_t colon_pos = cursor.find(':');
-    if (colon_pos != std::string::npos) {
-      before_timestamp = std::stoll(cursor.substr(0, colon_pos));
+  HistoryCursor position;
+  if (cursor.empty()) {
+    position.channel_id = channel_id;
+    position.channel_type = channel_type;
+    position.timestamp = std::numeric_limits<int64_t>::max();
+    position.seq = std::numeric_limits<int64_t>::max();
+  } else {
+    auto decoded = HistoryCursor::Decode(cursor);
+    if (!decoded || decoded->channel_id != channel_id || decoded->channel_type != channel_type) {
+      if (next_cursor) {
+        next_cursor->clear();
+      }
+      return {};
     }
+    position = std::move(*decoded);
   }
+  position.page_size = limit;
 
-  auto messages = GetHistory(channel_id, channel_type, before_timestamp, limit);
-
-  // Generate next cursor if there are more messages
-  if (next_cursor && !messages.empty()) {
-    if (static_cast<int>(messages.size()) >= limit) {
-      int64_t oldest_timestamp = messages.front().timestamp;
-      *next_cursor = std::to_string(oldest_timestamp) + ":0";
-    } else {
-      *next_cursor = "";  // No more pages
-    }
+  std::optional<HistoryCursor> next;
+  auto messages = GetHistoryPage(position, &next);
+  if (next_cursor) {
+    *next_cursor = next ? next->Encode() : std::string();
   }
-
   return messages;
 }
 
 std::vector<MessageData> HybridMessageStore::GetOfflineMessages(const std::string& user_id) {
   std::string offline_key = OfflineKey(user_id);
-  auto redis_messages = redis_->LRange(offline_key, 0, -1);
+  auto redis_messages = redis_->LRangeReply(offline_key, 0, -1);
 
   std::vector<MessageData> results;
-  results.reserve(redis_messages.size());
+  if (!redis_messages) {
+    return results;
+  }
+  results.reserve(redis_messages->elements.size());
 
-  for (const auto& msg_data : redis_messages) {
+  for (const auto& msg_data : redis_messages->elements) {
     MessageData msg;
-    if (msg.ParseFromArray(msg_data.data(), static_cast<int>(msg_data.size()))) {
+    if (msg.ParseFromArray(msg_data.str.data(), static_cast<int>(msg_data.str.size()))) {
       results.push_back(std::move(msg));
     }
   }
@@ -286,13 +333,21 @@ std::vector<MessageData> HybridMessageStore::GetOfflineMessages(const std::strin
 }
 
 std::vector<MessageData> HybridMessageStore::PopOfflineMessages(const std::string& user_id) {
-  auto messages = GetOfflineMessages(user_id);
+  // Read and clear atomically so a message queued in between is not lost
+  auto redis_messages = network::PopOfflineAtomically(*redis_, OfflineKey(user_id));
 
-  // Clear from Redis
-  std::string offline_key = OfflineKey(user_id);
-  redis_->Del(offline_key);
-
-  return messages;
+  std::vector<MessageData> results;
+  if (!redis_messages) {
+    return results;
+  }
+  results.reserve(redis_messages->elements.size());
+  for (const auto& msg_data : redis_messages->elements) {
+    MessageData msg;
+    if (msg.ParseFromArray(msg_data.str.data(), static_cast<int>(msg_data.str.size()))) {
+      results.push_back(std::move(msg));
+    }
+  }
+  return results;
 }
 
 bool HybridMessageStore::ClearOfflineMessages(const std::string& user_id) {
@@ -407,21 +462,43 @@ std::string HybridMessageStore::PrivateChannelId(const std::string& a, const std
   return a < b ? a + "|" + b : b + "|" + a;
 }
 
+// Keys carry a hash tag so that, on a Redis Cluster, everything about one user (offline queue,
+// delivery states) lands in one slot, as does a channel's history.
 std::string HybridMessageStore::OfflineKey(const std::string& user_id) {
-  return "chirp:chat:offline:" + user_id;
+  return "chirp:chat:offline:" + network::RedisHashTag(user_id);
 }
 
 std::string HybridMessageStore::HistoryKey(const std::string& channel_id) {
-  return "chirp:chat:history:" + channel_id;
+  return "chirp:chat:history:" + network::RedisHashTag(channel_id);
 }
 
 std::string HybridMessageStore::DeliveryKey(const std::string& message_id,
                                            const std::string& receiver_id) {
-  return "chirp:chat:delivery:" + message_id + ":" + receiver_id;
+  return "chirp:chat:delivery:" + network::RedisHashTag(receiver_id) + ":" + message_id;
 }
 
 std::string HybridMessageStore::PendingDeliveryKey() {
   return "chirp:chat:pending_delivery";
 }
 
+// History and offline queue are in different slots on a cluster; the transaction then runs as
+// one MULTI/EXEC per key, each still atomic.
+network::RedisBatch HybridMessageStore::HotWrites(const MessageData& message) {
+  std::string msg_data = message.SerializeAsString();
+  std::string history_key = HistoryKey(message.channel_id);
+  auto tx = redis_->Transaction();
+  tx.Add({"RPUSH", history_key, msg_data});
+  if (config_.redis_history_limit > 0) {
+    tx.Add({"LTRIM", history_key, std::to_string(-config_.redis_history_limit), "-1"});
+  }
+
+  // Add to offline queue if there's a specific receiver
+  if (!message.receiver_id.empty() && message.channel_type == 0) {  // PRIVATE
+    std::string offline_key = OfflineKey(message.receiver_id);
+    tx.Add({"RPUSH", offline_key, std::move(msg_data)});
+    tx.Add({"EXPIRE", offline_key, std::to_string(config_.redis_offline_ttl_seconds)});
+  }
+  return tx;
+}
+
 } // namespace chirp::chat
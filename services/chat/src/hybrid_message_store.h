@@ -9,6 +9,8 @@
 
 #include <asio.hpp>
 
+#include "history_cursor.h"
+#include "message_batch_writer.h"
 #include "message_store_config.h"
 #include "mysql_message_store.h"
 #include "network/redis_client.h"
@@ -26,6 +28,7 @@ struct MessageData {
   std::string content;
   int64_t timestamp{0};
   int64_t created_at{0};
+  int64_t seq{0};  // messages.id when read from MySQL (0 for Redis copies); not serialized
 
   std::string SerializeAsString() const;
   bool ParseFromArray(const void* data, int size);
@@ -73,6 +76,8 @@ public:
   bool StoreMessage(const MessageData& message);
 
   /// @brief Store a message asynchronously
+  /// The MySQL row goes through the group-commit writer; `callback` runs on the io_context,
+  /// with false right away if the writer's queue is full.
   void StoreMessageAsync(const MessageData& message,
                         std::function<void(bool)> callback = nullptr);
 
@@ -82,7 +87,16 @@ public:
                                      int64_t before_timestamp,
                                      int32_t limit);
 
+  /// @brief Get one keyset page of history next to `position` (oldest first)
+  /// Read from MySQL with a single index seek, so deep scroll-back costs the same as the first
+  /// page; messages still queued in the group-commit writer show up once it flushes.
+  /// `*next` is set to the following page's position, or to nullopt at the end of the history.
+  std::vector<MessageData> GetHistoryPage(const HistoryCursor& position,
+                                          std::optional<HistoryCursor>* next);
+
   /// @brief Get history with cursor-based pagination
+  /// `cursor` is an encoded HistoryCursor for this channel, or empty for the newest page;
+  /// `*next_cursor` is left empty after the last page.
   std::vector<MessageData> GetHistoryV2(const std::string& channel_id,
                                        int channel_type,
                                        const std::string& cursor,
@@ -124,6 +138,15 @@ public:
   /// @brief Get MySQL store (for migration worker)
   std::shared_ptr<MySQLMessageStore> GetMySQLStore() { return mysql_store_; }
 
+  /// @brief Get MySQL connection pool (its executor runs blocking MySQL work off the io threads)
+  std::shared_ptr<MySQLConnectionPool> GetMySQLPool() { return mysql_pool_; }
+
+  /// @brief Get MySQL connection pool statistics
+  database::MySQLPoolStats GetPoolStats() const { return mysql_pool_->GetStats(); }
+
+  /// @brief Get group-commit writer statistics
+  MessageBatchWriter::Stats GetWriterStats() const { return writer_->GetStats(); }
+
   /// @brief Get configuration
   const MessageStoreConfig& GetConfig() const { return config_; }
 
@@ -135,12 +158,15 @@ private:
   std::string HistoryKey(const std::string& channel_id);
   std::string DeliveryKey(const std::string& message_id, const std::string& receiver_id);
   std::string PendingDeliveryKey();
+  /// @brief Redis writes for a new message (history, plus the receiver's offline queue), as one transaction
+  network::RedisBatch HotWrites(const MessageData& message);
 
   asio::io_context& io_;
   MessageStoreConfig config_;
   std::shared_ptr<network::RedisClient> redis_;
   std::shared_ptr<MySQLConnectionPool> mysql_pool_;
   std::shared_ptr<MySQLMessageStore> mysql_store_;
+  std::unique_ptr<MessageBatchWriter> writer_;
 };
 
 } // namespace chirp::chat
@@ -6,6 +6,7 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -14,8 +15,10 @@
 #include "chat_session_registry.h"
 #include "chat_validation.h"
 #include "logger.h"
+#include "network/io_context_pool.h"
 #include "network/protobuf_framing.h"
 #include "network/redis_client.h"
+#include "network/redis_scripts.h"
 #include "network/session.h"
 #include "network/tcp_server.h"
 #include "network/websocket_server.h"
@@ -38,6 +41,8 @@ struct MessageStore {
   std::shared_ptr<chirp::network::RedisClient> redis;
   int offline_ttl_seconds{0};
 
+  // Guards the in-memory maps below; handlers run on every io thread.
+  std::mutex mu;
   // channel_key -> messages
   std::unordered_map<std::string, std::vector<chirp::chat::ChatMessage>> history;
   // receiver_id -> pending messages (redis 不可用时兜底)
@@ -46,8 +51,11 @@ struct MessageStore {
   explicit MessageStore(std::shared_ptr<chirp::network::RedisClient> redis_client, int ttl)
       : redis(std::move(redis_client)), offline_ttl_seconds(ttl) {}
 
+  // Sorted set of serialized messages scored by timestamp and capped at kMaxHistory, so a page
+  // before any timestamp is one ZREVRANGEBYSCORE ... LIMIT. Replaces the "chat:history:" lists,
+  // which are no longer read.
   std::string HistoryKey(chirp::chat::ChannelType type, const std::string& channel_id) {
-    return "chat:history:" + ChannelKey(type, channel_id);
+    return "chat:timeline:" + ChannelKey(type, channel_id);
   }
 
   std::string ChannelKey(chirp::chat::ChannelType type, const std::string& channel_id) {
@@ -63,9 +71,11 @@ struct MessageStore {
 
   void AddMessage(const chirp::chat::ChatMessage& msg) {
     if (redis) {
-      redis->RPush(HistoryKey(msg.channel_type(), msg.channel_id()), msg.SerializeAsString());
+      chirp::network::AppendHistoryScored(*redis, HistoryKey(msg.channel_type(), msg.channel_id()), msg.timestamp(),
+                                          msg.SerializeAsString(), kMaxHistory, 0);
     }
 
+    std::lock_guard<std::mutex> lock(mu);
     auto& msgs = history[ChannelKey(msg.channel_type(), msg.channel_id())];
     msgs.push_back(msg);
 
@@ -81,13 +91,21 @@ struct MessageStore {
     if (receiver_id.empty()) {
       return;
     }
-    if (redis && redis->RPush(OfflineKey(receiver_id), msg.SerializeAsString())) {
+    if (redis) {
+      // RPUSH + EXPIRE in one round trip, so a pushed list never lingers without its TTL.
+      const std::string key = OfflineKey(receiver_id);
+      auto tx = redis->Transaction();
+      tx.Add({"RPUSH", key, msg.SerializeAsString()});
       if (offline_ttl_seconds > 0) {
-        redis->Expire(OfflineKey(receiver_id), offline_ttl_seconds);
+        tx.Add({"EXPIRE", key, std::to_string(offline_ttl_seconds)});
+      }
+      auto replies = tx.Execute();
+      if (replies && !replies->empty() && replies->front().type == chirp::network::RedisResp::Type::kInteger) {
+        return;
       }
-      return;
     }
 
+    std::lock_guard<std::mutex> lock(mu);
     auto& pending = offline_messages[receiver_id];
     pending.push_back(msg);
     if (pending.size() > kMaxOfflineInMemory) {
@@ -102,22 +120,22 @@ struct MessageStore {
     }
 
     if (redis) {
-      auto raw = redis->LRange(OfflineKey(user_id), 0, -1);
-      if (!raw.empty()) {
-        out.reserve(raw.size());
-        for (const auto& item : raw) {
+      // Read and delete atomically: a message pushed in between is neither lost nor delivered twice.
+      if (auto raw = chirp::network::PopOfflineAtomically(*redis, OfflineKey(user_id))) {
+        out.reserve(raw->elements.size());
+        for (const auto& item : raw->elements) {
           chirp::chat::ChatMessage m;
-          if (m.ParseFromArray(item.data(), static_cast<int>(item.size()))) {
+          if (m.ParseFromArray(item.str.data(), static_cast<int>(item.str.size()))) {
             out.push_back(std::move(m));
           }
         }
       }
-      redis->Del(OfflineKey(user_id));
       if (!out.empty()) {
         return out;
       }
     }
 
+    std::lock_guard<std::mutex> lock(mu);
     auto it = offline_messages.find(user_id);
     if (it == offline_messages.end()) {
       return out;
@@ -146,31 +164,28 @@ struct MessageStore {
     }
 
     if (redis) {
-      auto raw = redis->LRange(HistoryKey(type, channel_id), 0, -1);
+      // Newest first, strictly before `before`; one extra member tells whether a further page exists.
+      auto reply = redis->ZRevRangeByScoreReply(HistoryKey(type, channel_id), "(" + std::to_string(before), "-inf",
+                                                0, static_cast<int64_t>(lim) + 1);
+      const auto raw = reply ? reply->elements : std::span<const chirp::network::RedisNode>{};
       if (!raw.empty()) {
+        const size_t page = std::min(raw.size(), static_cast<size_t>(lim));
+        if (has_more) {
+          *has_more = raw.size() > page;
+        }
         std::vector<chirp::chat::ChatMessage> result;
-        result.reserve(raw.size());
-        for (auto rit = raw.rbegin(); rit != raw.rend(); ++rit) {
+        result.reserve(page);
+        for (size_t i = page; i-- > 0;) {
           chirp::chat::ChatMessage msg;
-          if (!msg.ParseFromArray(rit->data(), static_cast<int>(rit->size()))) {
-            continue;
-          }
-          if (msg.timestamp() >= before) {
-            continue;
-          }
-          result.push_back(std::move(msg));
-          if (static_cast<int32_t>(result.size()) >= lim) {
-            if (has_more) {
-              *has_more = (rit + 1) != raw.rend();
-            }
-            break;
+          if (msg.ParseFromArray(raw[i].str.data(), static_cast<int>(raw[i].str.size()))) {
+            result.push_back(std::move(msg));
           }
         }
-        std::reverse(result.begin(), result.end());
         return result;
       }
     }
 
+    std::lock_guard<std::mutex> lock(mu);
     auto it = history.find(ChannelKey(type, channel_id));
     if (it == history.end()) {
       return {};
@@ -229,7 +244,7 @@ void HandleDisconnect(const std::shared_ptr<chirp::chat::ChatState>& state,
 void HandlePacket(const std::shared_ptr<MessageStore>& store,
                   const std::shared_ptr<chirp::chat::ChatState>& state,
                   const std::shared_ptr<chirp::network::Session>& session,
-                  std::string&& payload) {
+                  std::string_view payload) {
   using chirp::common::Logger;
 
   chirp::gateway::Packet pkt;
@@ -424,13 +439,29 @@ int main(int argc, char** argv) {
   const std::string redis_host = chirp::chat::runtime::GetArg(argc, argv, "--redis_host", "");
   const uint16_t redis_port = chirp::chat::runtime::ParseU16Arg(argc, argv, "--redis_port", 6379);
   const int offline_ttl_seconds = chirp::chat::runtime::ParseIntArg(argc, argv, "--offline_ttl", 604800);
+  const size_t io_threads =
+      chirp::network::ResolveIoThreads(chirp::chat::runtime::ParseIntArg(argc, argv, "--io_threads", 1));
+  chirp::network::WriteQueueLimits write_limits;
+  write_limits.high_watermark_bytes =
+      static_cast<size_t>(chirp::chat::runtime::ParseIntArg(argc, argv, "--write_queue_high_kb", 4096)) * 1024;
+  write_limits.low_watermark_bytes =
+      static_cast<size_t>(chirp::chat::runtime::ParseIntArg(argc, argv, "--write_queue_low_kb", 1024)) * 1024;
+  write_limits.low_watermark_bytes = std::min(write_limits.low_watermark_bytes, write_limits.high_watermark_bytes);
+  chirp::network::PerMessageDeflateConfig ws_deflate;
+  ws_deflate.enabled = chirp::chat::runtime::ParseIntArg(argc, argv, "--ws_deflate", 0) != 0;
+  ws_deflate.context_takeover = chirp::chat::runtime::ParseIntArg(argc, argv, "--ws_deflate_context_takeover", 1) != 0;
+  const std::chrono::milliseconds ws_handshake_timeout(
+      chirp::chat::runtime::ParseIntArg(argc, argv, "--ws_handshake_timeout_ms", 10000));
+  const std::chrono::seconds idle_timeout(chirp::chat::runtime::ParseIntArg(argc, argv, "--idle_timeout_sec", 90));
   Logger::Instance().Info("chirp_chat starting tcp=" + std::to_string(port) + " ws=" + std::to_string(ws_port) +
+                          " io_threads=" + std::to_string(io_threads) +
                           (redis_host.empty()
                                ? ""
                                : (" redis=" + redis_host + ":" + std::to_string(redis_port) +
                                   " offline_ttl=" + std::to_string(offline_ttl_seconds))));
 
   asio::io_context io;
+  chirp::network::IoContextPool io_pool(io, io_threads);
 
   std::shared_ptr<chirp::network::RedisClient> redis;
   if (!redis_host.empty()) {
@@ -441,27 +472,35 @@ int main(int argc, char** argv) {
   auto state = std::make_shared<chirp::chat::ChatState>();
 
   chirp::network::TcpServer server(
-      io, port,
-      [store, state](std::shared_ptr<chirp::network::Session> session, std::string&& payload) {
-        HandlePacket(store, state, session, std::move(payload));
+      io_pool, port,
+      [store, state](std::shared_ptr<chirp::network::Session> session, std::string_view payload) {
+        HandlePacket(store, state, session, payload);
       },
       [state](std::shared_ptr<chirp::network::Session> session) { HandleDisconnect(state, session); });
 
   chirp::network::WebSocketServer ws_server(
-      io, ws_port,
-      [store, state](std::shared_ptr<chirp::network::Session> session, std::string&& payload) {
-        HandlePacket(store, state, session, std::move(payload));
+      io_pool, ws_port,
+      [store, state](std::shared_ptr<chirp::network::Session> session, std::string_view payload) {
+        HandlePacket(store, state, session, payload);
       },
       [state](std::shared_ptr<chirp::network::Session> session) { HandleDisconnect(state, session); });
 
+  server.SetWriteQueueLimits(write_limits);
+  ws_server.SetWriteQueueLimits(write_limits);
+  ws_server.SetPerMessageDeflate(ws_deflate);
+  ws_server.SetHandshakeTimeout(ws_handshake_timeout);
+  server.SetIdleTimeout(idle_timeout);
+  ws_server.SetIdleTimeout(idle_timeout);
   server.Start();
   ws_server.Start();
+  io_pool.Start();
 
   asio::signal_set signals(io, SIGINT, SIGTERM);
   signals.async_wait([&](const std::error_code& /*ec*/, int /*sig*/) {
     Logger::Instance().Info("shutdown requested");
     server.Stop();
     ws_server.Stop();
+    io_pool.Stop();
     io.stop();
   });
 
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <cstdint>
@@ -14,8 +15,10 @@
 #include "logger.h"
 #include "distributed_dispatch.h"
 #include "distributed_runtime.h"
+#include "network/io_context_pool.h"
 #include "network/message_router.h"
 #include "network/redis_client.h"
+#include "network/redis_scripts.h"
 #include "network/session.h"
 #include "network/tcp_server.h"
 #include "network/websocket_server.h"
@@ -35,14 +38,22 @@ struct DistributedChatState {
     session_to_user[session.get()] = user_id;
   }
 
-  void RemoveSession(chirp::network::Session* session) {
+  // Returns the user whose current session this was ("" if the user has since reconnected
+  // on another session, or the session never logged in).
+  std::string RemoveSession(chirp::network::Session* session) {
     std::lock_guard<std::mutex> lock(mu);
     const auto it = session_to_user.find(session);
     if (it == session_to_user.end()) {
-      return;
+      return "";
     }
-    local_sessions.erase(it->second);
+    std::string user_id = std::move(it->second);
     session_to_user.erase(it);
+    const auto cur = local_sessions.find(user_id);
+    if (cur == local_sessions.end() || cur->second.lock().get() != session) {
+      return "";
+    }
+    local_sessions.erase(cur);
+    return user_id;
   }
 
   std::shared_ptr<chirp::network::Session> GetLocalSession(const std::string& user_id) {
@@ -70,15 +81,20 @@ struct DistributedChatState {
   std::unordered_map<std::string, std::weak_ptr<chirp::network::Session>> local_sessions;
   std::unordered_map<void*, std::string> session_to_user;
   std::string instance_id;
+  // Instance-addressed routing: one Pub/Sub channel per chat instance instead of one per user.
+  bool instance_routing{false};
 };
 
 struct DistributedMessageStore {
+  static constexpr size_t kMaxHistory = 1000;
+
+  // Same keys as HybridMessageStore (hash-tagged for Redis Cluster).
   std::string OfflineKey(const std::string& user_id) const {
-    return "chirp:chat:offline:" + user_id;
+    return "chirp:chat:offline:" + chirp::network::RedisHashTag(user_id);
   }
 
   std::string HistoryKey(const std::string& channel_id) const {
-    return "chirp:chat:history:" + channel_id;
+    return "chirp:chat:history:" + chirp::network::RedisHashTag(channel_id);
   }
 
   std::string PrivateChannelId(const std::string& a, const std::string& b) const {
@@ -89,24 +105,26 @@ struct DistributedMessageStore {
     if (!redis || receiver_id.empty()) {
       return;
     }
-    redis->RPush(OfflineKey(receiver_id), message);
-    redis->Expire(OfflineKey(receiver_id), offline_ttl_seconds);
+    const std::string key = OfflineKey(receiver_id);
+    redis->Transaction()
+        .Add({"RPUSH", key, message})
+        .Add({"EXPIRE", key, std::to_string(offline_ttl_seconds)})
+        .Execute();
   }
 
   std::vector<std::string> PopOffline(const std::string& user_id) const {
     if (!redis || user_id.empty()) {
       return {};
     }
-    auto messages = redis->LRange(OfflineKey(user_id), 0, -1);
-    redis->Del(OfflineKey(user_id));
-    return messages;
+    auto reply = chirp::network::PopOfflineAtomically(*redis, OfflineKey(user_id));
+    return reply ? chirp::network::RedisStringArray(*reply) : std::vector<std::string>{};
   }
 
   void AddToHistory(const std::string& channel_id, const std::string& message) const {
     if (!redis || channel_id.empty()) {
       return;
     }
-    redis->RPush(HistoryKey(channel_id), message);
+    chirp::network::AppendHistoryCapped(*redis, HistoryKey(channel_id), message, kMaxHistory, 0);
   }
 
   std::vector<std::string> GetHistory(const std::string& channel_id, int limit) const {
@@ -161,7 +179,12 @@ void HandleSendMessage(const chirp::chat::SendMessageRequest& req,
   resp.set_server_timestamp(msg.timestamp());
   chirp::chat::runtime::SendPacket(sender_session, chirp::gateway::SEND_MESSAGE_RESP, seq, resp.SerializeAsString());
 
-  if (req.channel_type() == chirp::chat::PRIVATE) {
+  if (req.channel_type() == chirp::chat::PRIVATE && state->instance_routing) {
+    if (!router->RouteToUser(req.receiver_id(), msg.SerializeAsString())) {
+      store->AddOffline(req.receiver_id(), msg.SerializeAsString());
+      Logger::Instance().Info("Message stored offline for " + req.receiver_id());
+    }
+  } else if (req.channel_type() == chirp::chat::PRIVATE) {
     router->SendChatMessage(
         req.receiver_id(), msg.SerializeAsString(), [&](const std::string& user_id) -> bool {
           auto recv_session = state->GetLocalSession(user_id);
@@ -198,12 +221,16 @@ void HandleLogin(const chirp::auth::LoginRequest& req,
 
     state->AddSession(user_id, session);
 
-    router->SubscribeUserChat(user_id, [session](const std::string& msg_data) {
-      chirp::chat::ChatMessage msg;
-      if (msg.ParseFromArray(msg_data.data(), static_cast<int>(msg_data.size()))) {
-        chirp::chat::runtime::SendChatNotify(session, msg);
-      }
-    });
+    if (state->instance_routing) {
+      router->RegisterLocalUser(user_id);
+    } else {
+      router->SubscribeUserChat(user_id, [session](const std::string& msg_data) {
+        chirp::chat::ChatMessage msg;
+        if (msg.ParseFromArray(msg_data.data(), static_cast<int>(msg_data.size()))) {
+          chirp::chat::runtime::SendChatNotify(session, msg);
+        }
+      });
+    }
 
     Logger::Instance().Info("User logged in: " + user_id + " on instance " + state->instance_id);
 
@@ -252,9 +279,51 @@ int main(int argc, char** argv) {
   const uint16_t ws_port = chirp::chat::runtime::ParseU16Arg(argc, argv, "--ws_port", static_cast<uint16_t>(port + 1));
   const std::string redis_host = chirp::chat::runtime::GetArg(argc, argv, "--redis_host", "127.0.0.1");
   const uint16_t redis_port = chirp::chat::runtime::ParseU16Arg(argc, argv, "--redis_port", 6379);
+  // 1: --redis_host/--redis_port is a seed node of a Redis Cluster.
+  const bool redis_cluster = chirp::chat::runtime::ParseIntArg(argc, argv, "--redis_cluster", 0) != 0;
+  // Local cache for hot GETs (user locations), kept coherent by RESP3 client tracking; 0 disables.
+  const size_t redis_near_cache_bytes =
+      static_cast<size_t>(chirp::chat::runtime::ParseIntArg(argc, argv, "--redis_near_cache_mb", 0)) * 1024 * 1024;
+  const size_t io_threads =
+      chirp::network::ResolveIoThreads(chirp::chat::runtime::ParseIntArg(argc, argv, "--io_threads", 1));
+  chirp::network::WriteQueueLimits write_limits;
+  write_limits.high_watermark_bytes =
+      static_cast<size_t>(chirp::chat::runtime::ParseIntArg(argc, argv, "--write_queue_high_kb", 4096)) * 1024;
+  write_limits.low_watermark_bytes =
+      static_cast<size_t>(chirp::chat::runtime::ParseIntArg(argc, argv, "--write_queue_low_kb", 1024)) * 1024;
+  write_limits.low_watermark_bytes = std::min(write_limits.low_watermark_bytes, write_limits.high_watermark_bytes);
+  chirp::network::PerMessageDeflateConfig ws_deflate;
+  ws_deflate.enabled = chirp::chat::runtime::ParseIntArg(argc, argv, "--ws_deflate", 0) != 0;
+  ws_deflate.context_takeover = chirp::chat::runtime::ParseIntArg(argc, argv, "--ws_deflate_context_takeover", 1) != 0;
+  const std::chrono::milliseconds ws_handshake_timeout(
+      chirp::chat::runtime::ParseIntArg(argc, argv, "--ws_handshake_timeout_ms", 10000));
+  const std::chrono::seconds idle_timeout(chirp::chat::runtime::ParseIntArg(argc, argv, "--idle_timeout_sec", 90));
   const int offline_ttl = chirp::chat::runtime::ParseIntArg(argc, argv, "--offline_ttl", 604800);
+  // "user": one channel per user (default); "instance": one channel per chat instance plus a
+  // user->instance registry. The two cannot reach each other, so every instance must use the same
+  // mode; switch a running cluster by redeploying all instances, not by rolling them.
+  const std::string routing = chirp::chat::runtime::GetArg(argc, argv, "--routing", "user");
+  // Instance routing only. "pubsub": fire-and-forget PUBLISH; "streams": per-instance Redis
+  // stream read through a consumer group, so batches survive a restart (needs a stable
+  // --instance_id). All instances must use the same transport.
+  const std::string instance_transport =
+      chirp::chat::runtime::GetArg(argc, argv, "--instance_transport", "pubsub");
+
+  if (routing != "user" && routing != "instance") {
+    Logger::Instance().Error("--routing must be user or instance, got: " + routing);
+    return 1;
+  }
+  if (instance_transport != "pubsub" && instance_transport != "streams") {
+    Logger::Instance().Error("--instance_transport must be pubsub or streams, got: " + instance_transport);
+    return 1;
+  }
 
   std::string instance_id = chirp::chat::runtime::GetArg(argc, argv, "--instance_id", "");
+  // A random id would leave the previous run's stream behind on every restart.
+  if (instance_id.empty() && routing == "instance" && instance_transport == "streams") {
+    Logger::Instance().Error("--instance_transport streams requires a stable --instance_id");
+    return 1;
+  }
   if (instance_id.empty()) {
     instance_id = "chat_" + chirp::chat::runtime::RandomHex(8);
   }
@@ -263,18 +332,47 @@ int main(int argc, char** argv) {
   Logger::Instance().Info("  instance_id: " + instance_id);
   Logger::Instance().Info("  tcp_port: " + std::to_string(port));
   Logger::Instance().Info("  ws_port: " + std::to_string(ws_port));
-  Logger::Instance().Info("  redis: " + redis_host + ":" + std::to_string(redis_port));
+  Logger::Instance().Info("  io_threads: " + std::to_string(io_threads));
+  Logger::Instance().Info("  redis: " + redis_host + ":" + std::to_string(redis_port) +
+                          (redis_cluster ? " (cluster)" : ""));
+  Logger::Instance().Info("  redis_near_cache_mb: " + std::to_string(redis_near_cache_bytes / (1024 * 1024)));
+  Logger::Instance().Info("  routing: " + routing);
+  Logger::Instance().Info("  instance_transport: " + instance_transport);
 
   asio::io_context io;
+  chirp::network::IoContextPool io_pool(io, io_threads);
 
   auto state = std::make_shared<DistributedChatState>();
   state->instance_id = instance_id;
+  state->instance_routing = routing == "instance";
 
   auto store = std::make_shared<DistributedMessageStore>();
-  store->redis = std::make_shared<chirp::network::RedisClient>(redis_host, redis_port);
+  chirp::network::RedisClientOptions redis_options;
+  redis_options.cluster = redis_cluster;
+  redis_options.near_cache_bytes = redis_near_cache_bytes;
+  store->redis = std::make_shared<chirp::network::RedisClient>(redis_host, redis_port, redis_options);
   store->offline_ttl_seconds = offline_ttl;
 
-  auto router = std::make_shared<chirp::network::MessageRouter>(io, redis_host, redis_port);
+  auto router = std::make_shared<chirp::network::MessageRouter>(io, redis_host, redis_port, redis_options);
+  if (state->instance_routing) {
+    chirp::network::InstanceRoutingOptions routing_options;
+    if (instance_transport == "streams") {
+      routing_options.transport = chirp::network::InstanceTransport::kStreams;
+    }
+    router->EnableInstanceRouting(
+        instance_id,
+        [state](const std::string& user_id, const std::string& msg_data) {
+          auto session = state->GetLocalSession(user_id);
+          chirp::chat::ChatMessage msg;
+          if (!session || !msg.ParseFromArray(msg_data.data(), static_cast<int>(msg_data.size()))) {
+            return false;
+          }
+          chirp::chat::runtime::SendChatNotify(session, msg);
+          return true;
+        },
+        [store](const std::string& user_id, const std::string& msg_data) { store->AddOffline(user_id, msg_data); },
+        routing_options);
+  }
   if (!router->Start()) {
     Logger::Instance().Error("Failed to start message router");
     return 1;
@@ -296,10 +394,19 @@ int main(int argc, char** argv) {
                                     int64_t seq) {
     HandleGetHistory(req, session, store, seq);
   };
-  handlers.on_logout = [state](const std::shared_ptr<chirp::network::Session>& session,
-                               const chirp::auth::LogoutRequest&,
-                               int64_t seq) {
-    state->RemoveSession(session.get());
+  // Drops the session and, if it was the user's current one, their routing registration.
+  auto remove_session = [state, router](const std::shared_ptr<chirp::network::Session>& session) {
+    const std::string user_id = state->RemoveSession(session.get());
+    if (!user_id.empty() && state->instance_routing) {
+      router->UnregisterLocalUser(user_id);
+    }
+    return user_id;
+  };
+
+  handlers.on_logout = [remove_session](const std::shared_ptr<chirp::network::Session>& session,
+                                        const chirp::auth::LogoutRequest&,
+                                        int64_t seq) {
+    remove_session(session);
     chirp::auth::LogoutResponse resp;
     resp.set_code(chirp::common::OK);
     resp.set_server_time(chirp::chat::runtime::NowMs());
@@ -311,23 +418,29 @@ int main(int argc, char** argv) {
     chirp::chat::runtime::DispatchDistributedPacket(session, pkt, handlers);
   };
 
-  auto tcp_disconnect = [state](const std::shared_ptr<chirp::network::Session>& session) {
-    const std::string user_id = state->GetUserId(session.get());
+  auto tcp_disconnect = [remove_session](const std::shared_ptr<chirp::network::Session>& session) {
+    const std::string user_id = remove_session(session);
     if (!user_id.empty()) {
       Logger::Instance().Info("User disconnected: " + user_id);
     }
-    state->RemoveSession(session.get());
   };
 
-  auto ws_disconnect = [state](const std::shared_ptr<chirp::network::Session>& session) {
-    state->RemoveSession(session.get());
+  auto ws_disconnect = [remove_session](const std::shared_ptr<chirp::network::Session>& session) {
+    remove_session(session);
   };
 
-  auto server = chirp::chat::runtime::MakeDistributedTcpServer(io, port, on_packet, tcp_disconnect);
-  auto ws_server = chirp::chat::runtime::MakeDistributedWsServer(io, ws_port, on_packet, ws_disconnect);
+  auto server = chirp::chat::runtime::MakeDistributedTcpServer(io_pool, port, on_packet, tcp_disconnect);
+  auto ws_server = chirp::chat::runtime::MakeDistributedWsServer(io_pool, ws_port, on_packet, ws_disconnect);
 
+  server->SetWriteQueueLimits(write_limits);
+  ws_server->SetWriteQueueLimits(write_limits);
+  ws_server->SetPerMessageDeflate(ws_deflate);
+  ws_server->SetHandshakeTimeout(ws_handshake_timeout);
+  server->SetIdleTimeout(idle_timeout);
+  ws_server->SetIdleTimeout(idle_timeout);
   server->Start();
   ws_server->Start();
+  io_pool.Start();
 
   Logger::Instance().Info(
       "Chat service started, listening on TCP:" + std::to_string(port) + " WS:" + std::to_string(ws_port));
@@ -337,6 +450,7 @@ int main(int argc, char** argv) {
     server->Stop();
     ws_server->Stop();
     router->Stop();
+    io_pool.Stop();
     io.stop();
   });
   io.run();
@@ -1,6 +1,7 @@
 // Enhanced Distributed Chat Service with Hybrid Message Store
 // Features: Redis+MySQL dual-write, message delivery tracking, pagination
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <cstdlib>
@@ -14,6 +15,7 @@
 
 #include <asio.hpp>
 
+#include "chat_validation.h"
 #include "hybrid_message_store.h"
 #include "message_delivery_tracker.h"
 #include "message_migration_worker.h"
@@ -21,6 +23,7 @@
 #include "distributed_dispatch.h"
 #include "distributed_runtime.h"
 #include "logger.h"
+#include "network/io_context_pool.h"
 #include "network/message_router.h"
 #include "network/redis_client.h"
 #include "network/session.h"
@@ -232,45 +235,99 @@ void HandleLogin(const chirp::auth::LoginRequest& req,
   chirp::chat::runtime::SendPacket(session, chirp::gateway::LOGIN_RESP, seq, resp.SerializeAsString());
 }
 
+void FillChatMessage(const chirp::chat::MessageData& msg_data, chirp::chat::ChatMessage* msg) {
+  msg->set_message_id(msg_data.message_id);
+  msg->set_sender_id(msg_data.sender_id);
+  msg->set_receiver_id(msg_data.receiver_id);
+  msg->set_channel_id(msg_data.channel_id);
+  msg->set_channel_type(static_cast<chirp::chat::ChannelType>(msg_data.channel_type));
+  msg->set_msg_type(static_cast<chirp::chat::MsgType>(msg_data.msg_type));
+  msg->set_content(msg_data.content);
+  msg->set_timestamp(msg_data.timestamp);
+}
+
 /// @brief Handle get history with pagination
+/// Pages can fall through to MySQL, so they are read on the pool's query executor rather than
+/// the io thread; the response is sent from there.
 void HandleGetHistory(const chirp::chat::GetHistoryRequest& req,
                     const std::shared_ptr<chirp::network::Session>& session,
+                    const std::shared_ptr<HybridMessageStore>& store,
                     const std::shared_ptr<PaginatedHistoryRetriever>& retriever,
                     int64_t seq) {
-  std::string channel_id = req.channel_id();
+  asio::post(store->GetMySQLPool()->GetExecutor(), [req, session, retriever, seq]() {
+    auto page = retriever->GetPageBefore(req.channel_id(), req.channel_type(),
+                                        req.before_timestamp(), req.limit());
 
-  auto page = retriever->GetPageBefore(channel_id, req.channel_type(),
-                                      req.before_timestamp(), req.limit());
+    chirp::chat::GetHistoryResponse resp;
+    resp.set_code(chirp::common::OK);
+    resp.set_has_more(page.has_more);
 
-  chirp::chat::GetHistoryResponse resp;
-  resp.set_code(chirp::common::OK);
-  resp.set_has_more(page.has_more);
-
-  for (const auto& msg_data : page.messages) {
-    chirp::chat::ChatMessage* msg = resp.add_messages();
-    msg->set_message_id(msg_data.message_id);
-    msg->set_sender_id(msg_data.sender_id);
-    msg->set_receiver_id(msg_data.receiver_id);
-    msg->set_channel_id(msg_data.channel_id);
-    msg->set_channel_type(static_cast<chirp::chat::ChannelType>(msg_data.channel_type));
-    msg->set_msg_type(static_cast<chirp::chat::MsgType>(msg_data.msg_type));
-    msg->set_content(msg_data.content);
-    msg->set_timestamp(msg_data.timestamp);
-  }
+    for (const auto& msg_data : page.messages) {
+      FillChatMessage(msg_data, resp.add_messages());
+    }
 
-  chirp::chat::runtime::SendPacket(session, chirp::gateway::GET_HISTORY_RESP, seq, resp.SerializeAsString());
+    chirp::chat::runtime::SendPacket(session, chirp::gateway::GET_HISTORY_RESP, seq, resp.SerializeAsString());
+  });
 }
 
 /// @brief Handle get history V2 with cursor pagination
+/// pagination.cursor is the opaque keyset cursor from the previous response; without one the
+/// newest page is returned, or the oldest page after since_timestamp when that is set.
 void HandleGetHistoryV2(const std::string& request_body,
                        const std::shared_ptr<chirp::network::Session>& session,
+                       const std::shared_ptr<DistributedChatState>& state,
+                       const std::shared_ptr<HybridMessageStore>& store,
+                       const std::shared_ptr<PaginatedHistoryRetriever>& retriever,
                        int64_t seq) {
-  (void)request_body;
+  chirp::chat::GetHistoryResponseV2 resp;
+  chirp::chat::GetHistoryRequestV2 req;
+  PaginatedHistoryRetriever::PageToken token;
+  if (!req.ParseFromString(request_body)) {
+    resp.set_code(chirp::common::INVALID_PARAM);
+  } else {
+    resp.set_code(chirp::chat::ValidateGetHistoryRequest(req, state->GetUserId(session.get())));
+  }
+  if (resp.code() == chirp::common::OK && !req.pagination().cursor().empty()) {
+    // The cursor names its own channel; it may only continue the channel that was authorized
+    token = PaginatedHistoryRetriever::PageToken::Deserialize(req.pagination().cursor());
+    if (!token.IsValid() || token.position.channel_id != req.channel_id() ||
+        token.position.channel_type != static_cast<int>(req.channel_type())) {
+      resp.set_code(chirp::common::INVALID_PARAM);
+    } else if (req.limit() > 0) {
+      token.position.page_size = req.limit();
+    }
+  }
+  if (resp.code() != chirp::common::OK) {
+    chirp::chat::runtime::SendPacket(session, chirp::gateway::GET_HISTORY_V2_RESP, seq, resp.SerializeAsString());
+    return;
+  }
+
+  asio::post(store->GetMySQLPool()->GetExecutor(), [req, token, session, retriever, seq]() {
+    PaginatedHistoryRetriever::PageResult page;
+    if (token.IsValid()) {
+      page = retriever->GetNextPage(token);
+    } else if (req.since_timestamp() > 0) {
+      page = retriever->GetPageAfter(req.channel_id(), req.channel_type(), req.since_timestamp(), req.limit());
+    } else {
+      page = retriever->GetFirstPage(req.channel_id(), req.channel_type(), req.limit());
+    }
 
-  chirp::chat::GetHistoryResponse resp;
-  resp.set_code(chirp::common::INVALID_PARAM);
-  resp.set_has_more(false);
-  chirp::chat::runtime::SendPacket(session, chirp::gateway::GET_HISTORY_V2_RESP, seq, resp.SerializeAsString());
+    chirp::chat::GetHistoryResponseV2 resp;
+    resp.set_code(chirp::common::OK);
+    resp.set_has_more(page.has_more);
+    resp.set_total_count(page.total_count);
+    for (const auto& msg_data : page.messages) {
+      FillChatMessage(msg_data, resp.add_messages());
+    }
+    if (page.has_more) {
+      chirp::chat::PaginationToken* next = resp.mutable_next_page();
+      next->set_cursor(page.next_page.Serialize());
+      next->set_timestamp(page.next_page.position.timestamp);
+      next->set_page_size(page.next_page.position.page_size);
+    }
+
+    chirp::chat::runtime::SendPacket(session, chirp::gateway::GET_HISTORY_V2_RESP, seq, resp.SerializeAsString());
+  });
 }
 
 } // namespace
@@ -282,6 +339,20 @@ int main(int argc, char** argv) {
   const uint16_t ws_port = chirp::chat::runtime::ParseU16Arg(argc, argv, "--ws_port", static_cast<uint16_t>(port + 1));
   const std::string redis_host = chirp::chat::runtime::GetArg(argc, argv, "--redis_host", "127.0.0.1");
   const uint16_t redis_port = chirp::chat::runtime::ParseU16Arg(argc, argv, "--redis_port", 6379);
+  const size_t io_threads =
+      chirp::network::ResolveIoThreads(chirp::chat::runtime::ParseIntArg(argc, argv, "--io_threads", 1));
+  chirp::network::WriteQueueLimits write_limits;
+  write_limits.high_watermark_bytes =
+      static_cast<size_t>(chirp::chat::runtime::ParseIntArg(argc, argv, "--write_queue_high_kb", 4096)) * 1024;
+  write_limits.low_watermark_bytes =
+      static_cast<size_t>(chirp::chat::runtime::ParseIntArg(argc, argv, "--write_queue_low_kb", 1024)) * 1024;
+  write_limits.low_watermark_bytes = std::min(write_limits.low_watermark_bytes, write_limits.high_watermark_bytes);
+  chirp::network::PerMessageDeflateConfig ws_deflate;
+  ws_deflate.enabled = chirp::chat::runtime::ParseIntArg(argc, argv, "--ws_deflate", 0) != 0;
+  ws_deflate.context_takeover = chirp::chat::runtime::ParseIntArg(argc, argv, "--ws_deflate_context_takeover", 1) != 0;
+  const std::chrono::milliseconds ws_handshake_timeout(
+      chirp::chat::runtime::ParseIntArg(argc, argv, "--ws_handshake_timeout_ms", 10000));
+  const std::chrono::seconds idle_timeout(chirp::chat::runtime::ParseIntArg(argc, argv, "--idle_timeout_sec", 90));
 
   // MySQL configuration
   const std::string mysql_host = chirp::chat::runtime::GetArg(argc, argv, "--mysql_host", "127.0.0.1");
@@ -289,6 +360,14 @@ int main(int argc, char** argv) {
   const std::string mysql_database = chirp::chat::runtime::GetArg(argc, argv, "--mysql_database", "chirp");
   const std::string mysql_user = chirp::chat::runtime::GetArg(argc, argv, "--mysql_user", "chirp");
   const std::string mysql_password = chirp::chat::runtime::GetArg(argc, argv, "--mysql_password", "chirp_password");
+  const int mysql_pool_size = chirp::chat::runtime::ParseIntArg(argc, argv, "--mysql_pool_size", 10);
+  const int mysql_pool_min = chirp::chat::runtime::ParseIntArg(argc, argv, "--mysql_pool_min", 2);
+  const int mysql_acquire_timeout_ms = chirp::chat::runtime::ParseIntArg(argc, argv, "--mysql_acquire_timeout_ms", 2000);
+  const int mysql_query_threads = chirp::chat::runtime::ParseIntArg(argc, argv, "--mysql_query_threads", 4);
+  const int mysql_batch_rows = chirp::chat::runtime::ParseIntArg(argc, argv, "--mysql_batch_rows", 128);
+  const int mysql_batch_delay_ms = chirp::chat::runtime::ParseIntArg(argc, argv, "--mysql_batch_delay_ms", 5);
+  const int mysql_write_queue = chirp::chat::runtime::ParseIntArg(argc, argv, "--mysql_write_queue", 10000);
+  const int mysql_writer_threads = chirp::chat::runtime::ParseIntArg(argc, argv, "--mysql_writer_threads", 1);
 
   // Migration settings
   const bool enable_migration = chirp::chat::runtime::ParseIntArg(argc, argv, "--enable_migration", 1) != 0;
@@ -303,11 +382,14 @@ int main(int argc, char** argv) {
   Logger::Instance().Info("  instance_id: " + instance_id);
   Logger::Instance().Info("  tcp_port: " + std::to_string(port));
   Logger::Instance().Info("  ws_port: " + std::to_string(ws_port));
+  Logger::Instance().Info("  io_threads: " + std::to_string(io_threads));
   Logger::Instance().Info("  redis: " + redis_host + ":" + std::to_string(redis_port));
-  Logger::Instance().Info("  mysql: " + mysql_host + ":" + std::to_string(mysql_port) + "/" + mysql_database);
+  Logger::Instance().Info("  mysql: " + mysql_host + ":" + std::to_string(mysql_port) + "/" + mysql_database +
+                          " (pool " + std::to_string(mysql_pool_min) + "-" + std::to_string(mysql_pool_size) + ")");
   Logger::Instance().Info("  migration: " + std::string(enable_migration ? "enabled" : "disabled"));
 
   asio::io_context io;
+  chirp::network::IoContextPool io_pool(io, io_threads);
 
   // Configure message store
   MessageStoreConfig store_config;
@@ -318,6 +400,14 @@ int main(int argc, char** argv) {
   store_config.mysql_database = mysql_database;
   store_config.mysql_user = mysql_user;
   store_config.mysql_password = mysql_password;
+  store_config.mysql_pool_size = static_cast<size_t>(std::max(1, mysql_pool_size));
+  store_config.mysql_pool_min = static_cast<size_t>(std::clamp(mysql_pool_min, 0, std::max(1, mysql_pool_size)));
+  store_config.mysql_acquire_timeout_ms = std::max(0, mysql_acquire_timeout_ms);
+  store_config.mysql_query_threads = static_cast<size_t>(std::max(1, mysql_query_threads));
+  store_config.mysql_batch_rows = mysql_batch_rows;
+  store_config.mysql_batch_delay_ms = mysql_batch_delay_ms;
+  store_config.mysql_write_queue = static_cast<size_t>(std::max(1, mysql_write_queue));
+  store_config.mysql_writer_threads = static_cast<size_t>(std::max(1, mysql_writer_threads));
   store_config.enable_migration = enable_migration;
   store_config.migration_interval_seconds = migration_interval;
 
@@ -357,15 +447,15 @@ int main(int argc, char** argv) {
                                  int64_t seq) {
     HandleSendMessage(req, session, state, store, delivery_tracker, router, seq);
   };
-  handlers.on_get_history = [retriever](const std::shared_ptr<chirp::network::Session>& session,
-                                        const chirp::chat::GetHistoryRequest& req,
-                                        int64_t seq) {
-    HandleGetHistory(req, session, retriever, seq);
+  handlers.on_get_history = [store, retriever](const std::shared_ptr<chirp::network::Session>& session,
+                                               const chirp::chat::GetHistoryRequest& req,
+                                               int64_t seq) {
+    HandleGetHistory(req, session, store, retriever, seq);
   };
-  handlers.on_get_history_v2 = [](const std::shared_ptr<chirp::network::Session>& session,
-                                  const std::string& body,
-                                  int64_t seq) {
-    HandleGetHistoryV2(body, session, seq);
+  handlers.on_get_history_v2 = [state, store, retriever](const std::shared_ptr<chirp::network::Session>& session,
+                                                         const std::string& body,
+                                                         int64_t seq) {
+    HandleGetHistoryV2(body, session, state, store, retriever, seq);
   };
   handlers.on_logout = [state](const std::shared_ptr<chirp::network::Session>& session,
                                const chirp::auth::LogoutRequest&,
@@ -394,11 +484,18 @@ int main(int argc, char** argv) {
     state->RemoveSession(session.get());
   };
 
-  auto server = chirp::chat::runtime::MakeDistributedTcpServer(io, port, on_packet, tcp_disconnect);
-  auto ws_server = chirp::chat::runtime::MakeDistributedWsServer(io, ws_port, on_packet, ws_disconnect);
+  auto server = chirp::chat::runtime::MakeDistributedTcpServer(io_pool, port, on_packet, tcp_disconnect);
+  auto ws_server = chirp::chat::runtime::MakeDistributedWsServer(io_pool, ws_port, on_packet, ws_disconnect);
 
+  server->SetWriteQueueLimits(write_limits);
+  ws_server->SetWriteQueueLimits(write_limits);
+  ws_server->SetPerMessageDeflate(ws_deflate);
+  ws_server->SetHandshakeTimeout(ws_handshake_timeout);
+  server->SetIdleTimeout(idle_timeout);
+  ws_server->SetIdleTimeout(idle_timeout);
   server->Start();
   ws_server->Start();
+  io_pool.Start();
 
   Logger::Instance().Info("Enhanced Chat service started, listening on TCP:" + std::to_string(port) +
                           " WS:" + std::to_string(ws_port));
@@ -410,6 +507,22 @@ int main(int argc, char** argv) {
     router->Stop();
     delivery_tracker->Stop();
     migration_worker->Stop();
+    store->Shutdown();
+    const auto writer_stats = store->GetWriterStats();
+    Logger::Instance().Info("MySQL writer: " + std::to_string(writer_stats.total_written) + " written, " +
+                            std::to_string(writer_stats.total_failed) + " failed, " +
+                            std::to_string(writer_stats.total_rejected) + " rejected in " +
+                            std::to_string(writer_stats.batches_flushed) + " batches (max " +
+                            std::to_string(writer_stats.max_batch_size) + " rows, max flush " +
+                            std::to_string(writer_stats.max_flush_time_us) + "us)");
+    const auto pool_stats = store->GetPoolStats();
+    Logger::Instance().Info("MySQL pool: " + std::to_string(pool_stats.acquired) + " acquired, " +
+                            std::to_string(pool_stats.timeouts) + " timed out, " +
+                            std::to_string(pool_stats.waits) + " waited (max " +
+                            std::to_string(pool_stats.max_wait_us) + "us), max in use " +
+                            std::to_string(pool_stats.max_in_use) + ", " +
+                            std::to_string(pool_stats.closed_dead) + " dead connections closed");
+    io_pool.Stop();
     io.stop();
   });
   io.run();
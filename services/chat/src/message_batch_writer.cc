@@ -0,0 +1,153 @@
+#include "message_batch_writer.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "logger.h"
+
+namespace chirp::chat {
+namespace {
+
+using Logger = chirp::common::Logger;
+
+} // namespace
+
+MessageBatchWriter::MessageBatchWriter(std::shared_ptr<MySQLMessageStore> store, const Options& options)
+    : store_(std::move(store)), options_(options) {}
+
+MessageBatchWriter::~MessageBatchWriter() {
+  Stop();
+}
+
+void MessageBatchWriter::Start() {
+  std::lock_guard<std::mutex> lock(mu_);
+  if (running_) {
+    return;
+  }
+  running_ = true;
+  const size_t threads = std::max<size_t>(1, options_.threads);
+  for (size_t i = 0; i < threads; ++i) {
+    threads_.emplace_back([this]() { Run(); });
+  }
+  Logger::Instance().Info("MessageBatchWriter started (threads: " + std::to_string(threads) +
+                          ", batch: " + std::to_string(options_.max_batch_rows) + " rows / " +
+                          std::to_string(options_.max_delay_ms) + "ms)");
+}
+
+void MessageBatchWriter::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (!running_ || stopping_) {
+      return;
+    }
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  for (auto& t : threads_) {
+    t.join();
+  }
+  threads_.clear();
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    running_ = false;
+    stopping_ = false;
+  }
+  Logger::Instance().Info("MessageBatchWriter stopped");
+}
+
+bool MessageBatchWriter::Submit(MySQLMessageData message, Callback callback) {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (running_ && !stopping_ && queue_.size() < options_.max_queue) {
+      queue_.push_back(Pending{std::move(message), std::move(callback)});
+      cv_.notify_one();
+      return true;
+    }
+  }
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  ++stats_.total_rejected;
+  return false;
+}
+
+MessageBatchWriter::Stats MessageBatchWriter::GetStats() const {
+  Stats stats;
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats = stats_;
+  }
+  std::lock_guard<std::mutex> lock(mu_);
+  stats.queue_depth = queue_.size();
+  return stats;
+}
+
+void MessageBatchWriter::Run() {
+  const size_t max_rows = std::max<size_t>(1, options_.max_batch_rows);
+  std::vector<Pending> batch;
+  batch.reserve(max_rows);
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      cv_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return;  // stopping, and everything queued has been flushed
+      }
+      // Hold the batch open until it fills up or the delay runs out
+      cv_.wait_until(lock,
+                     std::chrono::steady_clock::now() + std::chrono::milliseconds(options_.max_delay_ms),
+                     [this, max_rows]() { return stopping_ || queue_.size() >= max_rows; });
+      const size_t n = std::min(queue_.size(), max_rows);
+      for (size_t i = 0; i < n; ++i) {
+        batch.push_back(std::move(queue_.front()));
+        queue_.pop_front();
+      }
+    }
+
+    if (!batch.empty()) {
+      Flush(batch);
+      batch.clear();
+    }
+  }
+}
+
+void MessageBatchWriter::Flush(std::vector<Pending>& batch) {
+  const auto start = std::chrono::steady_clock::now();
+
+  std::vector<MySQLMessageData> rows;
+  rows.reserve(batch.size());
+  for (auto& pending : batch) {
+    rows.push_back(std::move(pending.message));
+  }
+
+  std::vector<bool> results(rows.size(), true);
+  const bool split = !store_->StoreMessages(rows);
+  if (split) {
+    Logger::Instance().Warn("MessageBatchWriter: batch of " + std::to_string(rows.size()) +
+                            " failed, retrying row by row");
+    results = store_->StoreMessagesEach(rows);
+  }
+
+  const int64_t elapsed_us =
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  const uint64_t failed = static_cast<uint64_t>(std::count(results.begin(), results.end(), false));
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.total_written += rows.size() - failed;
+    stats_.total_failed += failed;
+    stats_.batches_flushed++;
+    stats_.batches_split += split ? 1 : 0;
+    stats_.last_batch_size = rows.size();
+    stats_.max_batch_size = std::max<uint64_t>(stats_.max_batch_size, rows.size());
+    stats_.last_flush_time_us = elapsed_us;
+    stats_.max_flush_time_us = std::max(stats_.max_flush_time_us, elapsed_us);
+    stats_.total_flush_time_us += elapsed_us;
+  }
+
+  for (size_t i = 0; i < batch.size(); ++i) {
+    if (batch[i].callback) {
+      batch[i].callback(results[i]);
+    }
+  }
+}
+
+} // namespace chirp::chat
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mysql_message_store.h"
+
+namespace chirp::chat {
+
+/// @brief Group-commit writer for message persistence
+/// Collects messages on its own threads for up to max_delay_ms or max_batch_rows, then writes
+/// each batch with multi-row INSERTs in one transaction (MySQLMessageStore::StoreMessages).
+/// If a batch fails it is retried row by row, so one bad row (e.g. a duplicate message_id)
+/// only fails its own callback.
+class MessageBatchWriter {
+public:
+  using Callback = std::function<void(bool)>;
+
+  struct Options {
+    size_t max_batch_rows{128};
+    int max_delay_ms{5};
+    size_t max_queue{10000};  // Submit() is refused beyond this many waiting messages
+    size_t threads{1};
+  };
+
+  /// @brief Writer statistics
+  struct Stats {
+    uint64_t total_written{0};
+    uint64_t total_failed{0};
+    uint64_t total_rejected{0};       // refused by Submit() because the queue was full
+    uint64_t batches_flushed{0};
+    uint64_t batches_split{0};        // batches that failed and were retried row by row
+    uint64_t queue_depth{0};
+    uint64_t last_batch_size{0};
+    uint64_t max_batch_size{0};
+    int64_t last_flush_time_us{0};
+    int64_t max_flush_time_us{0};
+    int64_t total_flush_time_us{0};
+  };
+
+  MessageBatchWriter(std::shared_ptr<MySQLMessageStore> store, const Options& options);
+  ~MessageBatchWriter();
+
+  /// @brief Start the writer threads
+  void Start();
+
+  /// @brief Flush everything still queued, then stop the writer threads
+  void Stop();
+
+  /// @brief Queue a message; false (and `callback` is not called) if the queue is full or
+  /// the writer is stopped. `callback` runs on a writer thread once the row is committed or
+  /// has failed.
+  bool Submit(MySQLMessageData message, Callback callback = nullptr);
+
+  /// @brief Get writer statistics
+  Stats GetStats() const;
+
+private:
+  struct Pending {
+    MySQLMessageData message;
+    Callback callback;
+  };
+
+  void Run();
+  void Flush(std::vector<Pending>& batch);
+
+  std::shared_ptr<MySQLMessageStore> store_;
+  const Options options_;
+
+  mutable std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<Pending> queue_;
+  bool running_{false};
+  bool stopping_{false};
+  std::vector<std::thread> threads_;
+
+  mutable std::mutex stats_mutex_;
+  Stats stats_;
+};
+
+} // namespace chirp::chat
@@ -9,6 +9,18 @@ namespace {
 
 using Logger = chirp::common::Logger;
 
+constexpr const char* kHistoryPrefix = "chirp:chat:history:";
+constexpr const char* kOfflinePrefix = "chirp:chat:offline:";
+
+// "chirp:chat:offline:{u1}" -> "u1" (keys carry a Redis Cluster hash tag).
+std::string KeyId(const std::string& key, const std::string& prefix) {
+  std::string id = key.substr(prefix.size());
+  if (id.size() >= 2 && id.front() == '{' && id.back() == '}') {
+    id = id.substr(1, id.size() - 2);
+  }
+  return id;
+}
+
 int64_t NowMs() {
   using namespace std::chrono;
   return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
@@ -99,62 +111,66 @@ void MessageMigrationWorker::RunMigration() {
   }
 
   // Migration strategy:
-  // 1. Get all channel history keys from Redis
-  // 2. For each channel, migrate messages to MySQL
-  // 3. Migrate offline message queues to MySQL
-  // 4. Clean up migrated messages from Redis
-
-  auto redis = store_->GetRedisClient();
-
-  // Get all history keys
-  auto history_keys = redis->Keys("chirp:chat:history:*");
+  // 1. Walk channel history keys with SCAN, one bounded step at a time (never KEYS, which
+  //    blocks the shared Redis for the whole keyspace walk)
+  // 2. For each step, read the step's lists in one pipelined round trip and migrate them to MySQL
+  // 3. Do the same for offline message queues
 
   int batch_migrated = 0;
   int batch_failed = 0;
 
-  for (const auto& key : history_keys) {
-    // Extract channel_id from key
-    std::string channel_id = key.substr(strlen("chirp:chat:history:"));
+  MigrateKeys(kHistoryPrefix, /*offline=*/false, &batch_migrated, &batch_failed);
+  MigrateKeys(kOfflinePrefix, /*offline=*/true, &batch_migrated, &batch_failed);
 
-    // Get messages from Redis list
-    auto messages = redis->LRange(key, 0, -1);
+  int64_t duration_ms = NowMs() - start_time;
 
-    for (const auto& msg_data : messages) {
-      MessageData msg;
-      if (msg.ParseFromArray(msg_data.data(), static_cast<int>(msg_data.size()))) {
-        // Store in MySQL
-        MySQLMessageData mysql_msg;
-        mysql_msg.message_id = msg.message_id;
-        mysql_msg.sender_id = msg.sender_id;
-        mysql_msg.receiver_id = msg.receiver_id;
-        mysql_msg.channel_id = msg.channel_id;
-        mysql_msg.channel_type = msg.channel_type;
-        mysql_msg.msg_type = msg.msg_type;
-        mysql_msg.content = msg.content;
-        mysql_msg.timestamp = msg.timestamp;
-        mysql_msg.created_at = msg.created_at;
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.total_migrated += batch_migrated;
+    stats_.total_failed += batch_failed;
+    stats_.batches_processed++;
+    stats_.total_migration_time_ms += duration_ms;
+    stats_.messages_in_queue = 0;  // Approximate, could be calculated
+  }
 
-        if (store_->GetMySQLStore()->StoreMessage(mysql_msg)) {
-          batch_migrated++;
-        } else {
-          batch_failed++;
-        }
-      }
-    }
+  Logger::Instance().Info("Migration batch completed: " +
+                         std::to_string(batch_migrated) + " migrated, " +
+                         std::to_string(batch_failed) + " failed, " +
+                         std::to_string(duration_ms) + "ms");
 
-  }
+  migrating_.store(false);
+  ScheduleNextRun();
+}
 
-  // Migrate offline messages
-  auto offline_keys = redis->Keys("chirp:chat:offline:*");
+void MessageMigrationWorker::MigrateKeys(const std::string& prefix, bool offline, int* migrated, int* failed) {
+  auto redis = store_->GetRedisClient();
+  auto scanner = redis->Scan(prefix + "*", static_cast<size_t>(config_.migration_batch_size));
 
-  for (const auto& key : offline_keys) {
-    std::string user_id = key.substr(strlen("chirp:chat:offline:"));
+  std::vector<std::string> keys;
+  while (running_.load() && scanner.Next(&keys)) {
+    if (keys.empty()) {
+      continue;
+    }
+
+    auto batch = redis->Batch();
+    for (const auto& key : keys) {
+      batch.Add({"LRANGE", key, "0", "-1"});
+    }
+    auto replies = batch.Execute();
+    if (!replies || replies->size() != keys.size()) {
+      Logger::Instance().Warn("Migration: reading " + prefix + "* lists failed, retrying next run");
+      return;
+    }
 
-    auto messages = redis->LRange(key, 0, -1);
+    for (size_t i = 0; i < keys.size(); ++i) {
+      // Extract channel_id / user_id from key
+      const std::string id = KeyId(keys[i], prefix);
 
-    for (const auto& msg_data : messages) {
-      MessageData msg;
-      if (msg.ParseFromArray(msg_data.data(), static_cast<int>(msg_data.size()))) {
+      for (const auto& msg_data : (*replies)[i].elements) {
+        MessageData msg;
+        if (!msg.ParseFromArray(msg_data.str.data(), static_cast<int>(msg_data.str.size()))) {
+          continue;
+        }
         MySQLMessageData mysql_msg;
         mysql_msg.message_id = msg.message_id;
         mysql_msg.sender_id = msg.sender_id;
@@ -167,37 +183,22 @@ void MessageMigrationWorker::RunMigration() {
         mysql_msg.created_at = msg.created_at;
 
         // Ensure receiver_id is set for offline messages
-        if (mysql_msg.receiver_id.empty()) {
-          mysql_msg.receiver_id = user_id;
+        if (offline && mysql_msg.receiver_id.empty()) {
+          mysql_msg.receiver_id = id;
         }
 
         if (store_->GetMySQLStore()->StoreMessage(mysql_msg)) {
-          batch_migrated++;
+          (*migrated)++;
         } else {
-          batch_failed++;
+          (*failed)++;
         }
       }
     }
   }
 
-  int64_t duration_ms = NowMs() - start_time;
-
-  {
-    std::lock_guard<std::mutex> lock(stats_mutex_);
-    stats_.total_migrated += batch_migrated;
-    stats_.total_failed += batch_failed;
-    stats_.batches_processed++;
-    stats_.total_migration_time_ms += duration_ms;
-    stats_.messages_in_queue = 0;  // Approximate, could be calculated
+  if (scanner.Failed()) {
+    Logger::Instance().Warn("Migration: SCAN " + prefix + "* failed, retrying next run");
   }
-
-  Logger::Instance().Info("Migration batch completed: " +
-                         std::to_string(batch_migrated) + " migrated, " +
-                         std::to_string(batch_failed) + " failed, " +
-                         std::to_string(duration_ms) + "ms");
-
-  migrating_.store(false);
-  ScheduleNextRun();
 }
 
 void MessageMigrationWorker::MigrateChannelHistory(const std::string& channel_id) {
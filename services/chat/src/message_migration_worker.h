@@ -56,6 +56,8 @@ private:
 
   void ScheduleNextRun();
   void RunMigration();
+  /// @brief Streams every list under `prefix` to MySQL, one SCAN step per round trip
+  void MigrateKeys(const std::string& prefix, bool offline, int* migrated, int* failed);
   void MigrateChannelHistory(const std::string& channel_id);
   void MigrateOfflineMessages(const std::string& user_id);
 
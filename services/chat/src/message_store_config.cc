@@ -17,6 +17,8 @@ MessageStoreConfig MessageStoreConfig::FromEnv() {
   if ((env_val = std::getenv("CHIRP_REDIS_HOST"))) config.redis_host = env_val;
   if ((env_val = std::getenv("CHIRP_REDIS_PORT")))
     config.redis_port = static_cast<uint16_t>(std::atoi(env_val));
+  if ((env_val = std::getenv("CHIRP_REDIS_CLUSTER")))
+    config.redis_cluster = (std::string(env_val) == "1" || std::string(env_val) == "true");
 
   if ((env_val = std::getenv("CHIRP_MYSQL_HOST"))) config.mysql_host = env_val;
   if ((env_val = std::getenv("CHIRP_MYSQL_PORT")))
@@ -24,6 +26,21 @@ MessageStoreConfig MessageStoreConfig::FromEnv() {
   if ((env_val = std::getenv("CHIRP_MYSQL_DATABASE"))) config.mysql_database = env_val;
   if ((env_val = std::getenv("CHIRP_MYSQL_USER"))) config.mysql_user = env_val;
   if ((env_val = std::getenv("CHIRP_MYSQL_PASSWORD"))) config.mysql_password = env_val;
+  if ((env_val = std::getenv("CHIRP_MYSQL_POOL_SIZE")))
+    config.mysql_pool_size = static_cast<size_t>(std::atoll(env_val));
+  if ((env_val = std::getenv("CHIRP_MYSQL_POOL_MIN")))
+    config.mysql_pool_min = static_cast<size_t>(std::atoll(env_val));
+  if ((env_val = std::getenv("CHIRP_MYSQL_ACQUIRE_TIMEOUT_MS"))) config.mysql_acquire_timeout_ms = std::atoi(env_val);
+  if ((env_val = std::getenv("CHIRP_MYSQL_PING_INTERVAL_MS"))) config.mysql_ping_interval_ms = std::atoi(env_val);
+  if ((env_val = std::getenv("CHIRP_MYSQL_IDLE_TIMEOUT_MS"))) config.mysql_idle_timeout_ms = std::atoi(env_val);
+  if ((env_val = std::getenv("CHIRP_MYSQL_QUERY_THREADS")))
+    config.mysql_query_threads = static_cast<size_t>(std::atoll(env_val));
+  if ((env_val = std::getenv("CHIRP_MYSQL_BATCH_ROWS"))) config.mysql_batch_rows = std::atoi(env_val);
+  if ((env_val = std::getenv("CHIRP_MYSQL_BATCH_DELAY_MS"))) config.mysql_batch_delay_ms = std::atoi(env_val);
+  if ((env_val = std::getenv("CHIRP_MYSQL_WRITE_QUEUE")))
+    config.mysql_write_queue = static_cast<size_t>(std::atoll(env_val));
+  if ((env_val = std::getenv("CHIRP_MYSQL_WRITER_THREADS")))
+    config.mysql_writer_threads = static_cast<size_t>(std::atoll(env_val));
 
   if ((env_val = std::getenv("CHIRP_MIGRATION_ENABLED")))
     config.enable_migration = (std::string(env_val) == "1" || std::string(env_val) == "true");
@@ -52,6 +69,22 @@ bool MessageStoreConfig::Validate() const {
     return false;
   }
 
+  if (mysql_pool_size == 0 || mysql_pool_min > mysql_pool_size || mysql_acquire_timeout_ms < 0 ||
+      mysql_ping_interval_ms <= 0 || mysql_idle_timeout_ms <= 0 || mysql_query_threads == 0) {
+    Logger::Instance().Error("MessageStoreConfig: invalid mysql pool settings");
+    return false;
+  }
+
+  if (mysql_batch_rows <= 0 || mysql_batch_rows > 10000 || mysql_batch_delay_ms < 0) {
+    Logger::Instance().Error("MessageStoreConfig: invalid mysql_batch_rows/mysql_batch_delay_ms");
+    return false;
+  }
+
+  if (mysql_write_queue == 0 || mysql_writer_threads == 0) {
+    Logger::Instance().Error("MessageStoreConfig: invalid mysql_write_queue/mysql_writer_threads");
+    return false;
+  }
+
   if (migration_batch_size <= 0 || migration_batch_size > 10000) {
     Logger::Instance().Error("MessageStoreConfig: invalid migration_batch_size");
     return false;
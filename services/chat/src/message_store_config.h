@@ -11,6 +11,7 @@ struct MessageStoreConfig {
   // Redis configuration
   std::string redis_host = "127.0.0.1";
   uint16_t redis_port = 6379;
+  bool redis_cluster = false;            // redis_host:redis_port is a seed node of a Redis Cluster
   int redis_history_limit = 100;         // Max messages per channel in Redis
   int redis_offline_ttl_seconds = 604800;  // 7 days for offline messages
 
@@ -20,11 +21,22 @@ struct MessageStoreConfig {
   std::string mysql_database = "chirp";
   std::string mysql_user = "chirp";
   std::string mysql_password = "chirp_password";
-  size_t mysql_pool_size = 10;
+  size_t mysql_pool_size = 10;           // Max open connections (writer and query threads share them)
+  size_t mysql_pool_min = 2;             // Kept open even when idle
+  int mysql_acquire_timeout_ms = 2000;   // Wait for a free connection before a query fails
+  int mysql_ping_interval_ms = 30000;    // Idle connections are health-checked this often
+  int mysql_idle_timeout_ms = 300000;    // Idle connections above mysql_pool_min are closed after this
+  size_t mysql_query_threads = 4;        // Executor running history/offline queries off the io threads
+
+  // Group-commit writer (StoreMessageAsync)
+  int mysql_batch_rows = 128;            // Flush once this many messages are waiting...
+  int mysql_batch_delay_ms = 5;          // ...or this long after the batch was opened
+  size_t mysql_write_queue = 10000;      // Max waiting messages before StoreMessageAsync refuses
+  size_t mysql_writer_threads = 1;
 
   // Migration configuration
   bool enable_migration = true;
-  int migration_batch_size = 100;        // Messages per batch
+  int migration_batch_size = 100;        // Keys per SCAN step (lists read per round trip)
   int migration_interval_seconds = 30;   // Run migration every N seconds
   int migration_max_retries = 3;
 
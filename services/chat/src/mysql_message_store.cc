@@ -1,170 +1,163 @@
 #include "mysql_message_store.h"
 
-#include <cstring>
+#include <limits>
+#include <optional>
 
 namespace chirp {
 namespace chat {
+namespace {
 
-// MySQLConnection implementation
-MySQLConnection::MySQLConnection(const std::string& host, uint16_t port,
-                                const std::string& database, const std::string& user,
-                                const std::string& password)
-    : host_(host), port_(port), database_(database), user_(user), password_(password),
-      mysql_(nullptr), result_(nullptr), connected_(false) {
-  mysql_ = mysql_init(nullptr);
+// CR_SERVER_GONE_ERROR, CR_SERVER_LOST, ER_UNKNOWN_STMT_HANDLER: the statement died with the
+// server session (MYSQL_OPT_RECONNECT reconnects silently), so it must be prepared again.
+bool IsStatementLost(unsigned int err) {
+  return err == 2006 || err == 2013 || err == 1243;
 }
 
-MySQLConnection::~MySQLConnection() {
-  Disconnect();
-  if (mysql_) {
-    mysql_close(mysql_);
-  }
-}
-
-bool MySQLConnection::Connect() {
-  if (connected_) {
-    return true;
-  }
-
-  if (!mysql_) {
-    return false;
-  }
-
-  const bool reconnect = true;
-  mysql_options(mysql_, MYSQL_OPT_RECONNECT, &reconnect);
-
-  if (!mysql_real_connect(mysql_, host_.c_str(), user_.c_str(), password_.c_str(),
-                         database_.c_str(), port_, nullptr, CLIENT_MULTI_STATEMENTS)) {
-    return false;
-  }
-
-  connected_ = true;
-  return true;
-}
-
-void MySQLConnection::Disconnect() {
-  if (result_) {
-    mysql_free_result(result_);
-    result_ = nullptr;
-  }
-  connected_ = false;
-}
-
-bool MySQLConnection::Query(const std::string& query) {
-  if (!connected_) {
-    return false;
-  }
-
-  if (result_) {
-    mysql_free_result(result_);
-    result_ = nullptr;
-  }
-
-  if (mysql_query(mysql_, query.c_str()) != 0) {
-    return false;
-  }
-
-  result_ = mysql_store_result(mysql_);
-  return true;
-}
-
-bool MySQLConnection::Execute(const std::string& query) {
-  if (!connected_) {
-    return false;
-  }
-
-  return mysql_query(mysql_, query.c_str()) == 0;
-}
-
-std::vector<std::vector<std::string>> MySQLConnection::FetchResults() {
-  std::vector<std::vector<std::string>> rows;
-
-  if (!result_) {
-    return rows;
-  }
-
-  MYSQL_ROW row;
-  while ((row = mysql_fetch_row(result_))) {
-    std::vector<std::string> cols;
-    unsigned int num_fields = mysql_num_fields(result_);
-    for (unsigned int i = 0; i < num_fields; i++) {
-      cols.push_back(row[i] ? row[i] : "NULL");
+// Prepares (or reuses) `sql` on `conn`, binds its parameters with `bind` and executes it,
+// re-preparing once if the server lost the statement. nullptr on failure.
+template <typename Bind>
+MySQLStatement* RunStatement(MySQLConnection& conn, const std::string& sql, Bind&& bind) {
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    MySQLStatement* stmt = conn.Prepare(sql);
+    if (!stmt) {
+      return nullptr;
+    }
+    bind(*stmt);
+    if (stmt->Execute()) {
+      return stmt;
+    }
+    if (!IsStatementLost(stmt->Errno())) {
+      return nullptr;
     }
-    rows.push_back(std::move(cols));
+    conn.Forget(sql);
   }
-
-  return rows;
-}
-
-uint64_t MySQLConnection::LastInsertId() {
-  return mysql_insert_id(mysql_);
-}
-
-uint64_t MySQLConnection::AffectedRows() {
-  return mysql_affected_rows(mysql_);
-}
-
-std::string MySQLConnection::Escape(const std::string& str) {
-  std::vector<char> escaped(str.size() * 2 + 1);
-  mysql_real_escape_string(mysql_, escaped.data(), str.c_str(), str.size());
-  return std::string(escaped.data());
+  return nullptr;
 }
 
-// MySQLConnectionPool implementation
-MySQLConnectionPool::MySQLConnectionPool(size_t pool_size,
-                                        const std::string& host, uint16_t port,
-                                        const std::string& database, const std::string& user,
-                                        const std::string& password)
-    : pool_size_(pool_size), host_(host), port_(port), database_(database),
-      user_(user), password_(password) {
-  for (size_t i = 0; i < pool_size_; ++i) {
-    auto conn = std::make_unique<MySQLConnection>(host_, port_, database_, user_, password_);
-    if (conn->Connect()) {
-      connections_.push_back(std::move(conn));
+// Multi-row INSERT statements are prepared for power-of-two row counts only, so a connection
+// caches at most a handful of them whatever the batch sizes.
+constexpr size_t kMaxInsertRows = 256;
+
+const std::string& InsertMessagesSql(size_t rows) {
+  static const std::vector<std::string> kSql = [] {
+    std::vector<std::string> sql(kMaxInsertRows + 1);
+    for (size_t n = 1; n <= kMaxInsertRows; n *= 2) {
+      sql[n] = "INSERT INTO messages (message_id, sender_id, receiver_id, channel_id, "
+               "channel_type, msg_type, content, timestamp, created_at) VALUES ";
+      for (size_t i = 0; i < n; ++i) {
+        sql[n] += i == 0 ? "(?, ?, ?, ?, ?, ?, ?, ?, ?)" : ", (?, ?, ?, ?, ?, ?, ?, ?, ?)";
+      }
     }
-  }
+    return sql;
+  }();
+  return kSql[rows];
 }
 
-MySQLConnectionPool::~MySQLConnectionPool() = default;
+constexpr const char* kMessageColumns =
+    "message_id, sender_id, receiver_id, channel_id, channel_type, msg_type, content, timestamp, id";
+
+// Binds the kMessageColumns of `stmt` to `row` and collects every row.
+std::vector<MySQLMessageData> FetchMessages(MySQLStatement& stmt) {
+  MySQLMessageData row{};
+  stmt.BindResult(0, &row.message_id);
+  stmt.BindResult(1, &row.sender_id);
+  stmt.BindResult(2, &row.receiver_id);
+  stmt.BindResult(3, &row.channel_id);
+  stmt.BindResult(4, &row.channel_type);
+  stmt.BindResult(5, &row.msg_type);
+  stmt.BindResult(6, &row.content);
+  stmt.BindResult(7, &row.timestamp);
+  stmt.BindResult(8, &row.seq);
 
-std::unique_ptr<MySQLConnection> MySQLConnectionPool::GetConnection() {
-  std::lock_guard<std::mutex> lock(mu_);
-  if (connections_.empty()) {
-    // Create new connection on demand
-    auto conn = std::make_unique<MySQLConnection>(host_, port_, database_, user_, password_);
-    if (conn->Connect()) {
-      return conn;
-    }
-    return nullptr;
+  std::vector<MySQLMessageData> messages;
+  while (stmt.Fetch()) {
+    messages.push_back(std::move(row)); // Fetch() re-sizes the moved-from strings
   }
+  return messages;
+}
 
-  auto conn = std::move(connections_.back());
-  connections_.pop_back();
-  return conn;
+// Single-row INSERT of `message` on `conn`.
+bool InsertMessage(MySQLConnection& conn, const MySQLMessageData& message) {
+  static const std::string kSql =
+      "INSERT INTO messages (message_id, sender_id, receiver_id, channel_id, "
+      "channel_type, msg_type, content, timestamp, created_at) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)";
+  return RunStatement(conn, kSql, [&](MySQLStatement& stmt) {
+           stmt.BindParam(0, message.message_id);
+           stmt.BindParam(1, message.sender_id);
+           stmt.BindParam(2, message.receiver_id);
+           stmt.BindParam(3, message.channel_id);
+           stmt.BindParam(4, message.channel_type);
+           stmt.BindParam(5, message.msg_type);
+           stmt.BindParam(6, message.content);
+           stmt.BindParam(7, message.timestamp);
+           stmt.BindParam(8, message.created_at);
+         }) != nullptr;
 }
 
-void MySQLConnectionPool::ReturnConnection(std::unique_ptr<MySQLConnection> conn) {
-  std::lock_guard<std::mutex> lock(mu_);
-  if (connections_.size() < pool_size_) {
-    connections_.push_back(std::move(conn));
+// Keyset page of the channel next to (from_timestamp, from_seq), oldest first. The inner SELECT
+// only reads idx_channel (its key ends in timestamp, id), seeking to the position and stopping
+// after `limit` entries; the outer one looks up just those rows.
+std::vector<MySQLMessageData> QueryPage(MySQLConnection& conn,
+                                        const std::string& channel_id,
+                                        int channel_type,
+                                        HistoryDirection direction,
+                                        int64_t from_timestamp,
+                                        int64_t from_seq,
+                                        int32_t limit) {
+  static const std::string kOlderSql =
+      std::string("SELECT ") + kMessageColumns +
+      " FROM messages JOIN (SELECT id AS seq FROM messages"
+      " WHERE channel_id = ? AND channel_type = ? AND (timestamp < ? OR (timestamp = ? AND id < ?))"
+      " ORDER BY timestamp DESC, id DESC LIMIT ?) page ON id = page.seq"
+      " ORDER BY timestamp ASC, id ASC";
+  static const std::string kNewerSql =
+      std::string("SELECT ") + kMessageColumns +
+      " FROM messages JOIN (SELECT id AS seq FROM messages"
+      " WHERE channel_id = ? AND channel_type = ? AND (timestamp > ? OR (timestamp = ? AND id > ?))"
+      " ORDER BY timestamp ASC, id ASC LIMIT ?) page ON id = page.seq"
+      " ORDER BY timestamp ASC, id ASC";
+  const std::string& sql = direction == HistoryDirection::kOlder ? kOlderSql : kNewerSql;
+  std::vector<MySQLMessageData> messages;
+  if (MySQLStatement* stmt = RunStatement(conn, sql, [&](MySQLStatement& s) {
+        s.BindParam(0, channel_id);
+        s.BindParam(1, channel_type);
+        s.BindParam(2, from_timestamp);
+        s.BindParam(3, from_timestamp);
+        s.BindParam(4, from_seq);
+        s.BindParam(5, limit);
+      })) {
+    messages = FetchMessages(*stmt);
   }
+  return messages;
 }
 
-size_t MySQLConnectionPool::GetAvailableCount() const {
-  return connections_.size();
+// Newest `limit` messages of the channel before `before_timestamp` (<= 0: latest), oldest first.
+std::vector<MySQLMessageData> QueryHistory(MySQLConnection& conn,
+                                           const std::string& channel_id,
+                                           int channel_type,
+                                           int64_t before_timestamp,
+                                           int32_t limit) {
+  const int64_t before = before_timestamp > 0 ? before_timestamp : std::numeric_limits<int64_t>::max();
+  // No id is below INT64_MIN, so this is "timestamp < before"
+  return QueryPage(conn, channel_id, channel_type, HistoryDirection::kOlder, before,
+                   std::numeric_limits<int64_t>::min(), limit);
 }
 
+} // namespace
+
 // MySQLMessageStore implementation
 MySQLMessageStore::MySQLMessageStore(std::shared_ptr<MySQLConnectionPool> pool)
     : pool_(pool) {}
 
 bool MySQLMessageStore::Initialize() {
-  auto conn = pool_->GetConnection();
+  auto conn = pool_->Acquire();
   if (!conn) {
     return false;
   }
 
-  // Create messages table
+  // Create messages table. History pages seek on idx_channel in (timestamp, id) order; InnoDB
+  // appends the primary key to secondary indexes anyway, so tables created when the index stopped
+  // at timestamp page the same way.
   const char* create_messages_table = R"(
     CREATE TABLE IF NOT EXISTS messages (
       id BIGINT AUTO_INCREMENT PRIMARY KEY,
@@ -177,14 +170,13 @@ bool MySQLMessageStore::Initialize() {
       content TEXT,
       timestamp BIGINT NOT NULL,
       created_at BIGINT NOT NULL,
-      INDEX idx_channel (channel_id, channel_type, timestamp),
+      INDEX idx_channel (channel_id, channel_type, timestamp, id),
       INDEX idx_receiver (receiver_id, timestamp),
       INDEX idx_timestamp (timestamp)
     ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
   )";
 
   if (!conn->Execute(create_messages_table)) {
-    pool_->ReturnConnection(std::move(conn));
     return false;
   }
 
@@ -202,7 +194,6 @@ bool MySQLMessageStore::Initialize() {
   )";
 
   if (!conn->Execute(create_read_receipts_table)) {
-    pool_->ReturnConnection(std::move(conn));
     return false;
   }
 
@@ -221,245 +212,239 @@ bool MySQLMessageStore::Initialize() {
     ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
   )";
 
-  bool result = conn->Execute(create_read_cursors_table);
-  pool_->ReturnConnection(std::move(conn));
-  return result;
+  return conn->Execute(create_read_cursors_table);
 }
 
 bool MySQLMessageStore::StoreMessage(const MySQLMessageData& message) {
-  auto conn = pool_->GetConnection();
+  auto conn = pool_->Acquire();
   if (!conn) {
     return false;
   }
-
-  std::string query = "INSERT INTO messages (message_id, sender_id, receiver_id, channel_id, "
-                     "channel_type, msg_type, content, timestamp, created_at) VALUES ('" +
-                     conn->Escape(message.message_id) + "', '" +
-                     conn->Escape(message.sender_id) + "', '" +
-                     conn->Escape(message.receiver_id) + "', '" +
-                     conn->Escape(message.channel_id) + "', " +
-                     std::to_string(message.channel_type) + ", " +
-                     std::to_string(message.msg_type) + ", '" +
-                     conn->Escape(message.content) + "', " +
-                     std::to_string(message.timestamp) + ", " +
-                     std::to_string(message.created_at) + ")";
-
-  bool result = conn->Execute(query);
-  pool_->ReturnConnection(std::move(conn));
-  return result;
+  return InsertMessage(*conn, message);
 }
 
-std::vector<MySQLMessageData> MySQLMessageStore::GetHistory(const std::string& channel_id,
-                                                           int channel_type,
-                                                           int64_t before_timestamp,
-                                                           int32_t limit) {
-  auto conn = pool_->GetConnection();
+std::vector<bool> MySQLMessageStore::StoreMessagesEach(const std::vector<MySQLMessageData>& messages) {
+  std::vector<bool> results(messages.size(), false);
+  auto conn = pool_->Acquire();
   if (!conn) {
-    return {};
+    return results;
   }
-
-  std::string query = "SELECT message_id, sender_id, receiver_id, channel_id, "
-                     "channel_type, msg_type, content, timestamp FROM messages WHERE "
-                     "channel_id = '" + conn->Escape(channel_id) + "' AND "
-                     "channel_type = " + std::to_string(channel_type);
-
-  if (before_timestamp > 0) {
-    query += " AND timestamp < " + std::to_string(before_timestamp);
+  for (size_t i = 0; i < messages.size(); ++i) {
+    results[i] = InsertMessage(*conn, messages[i]);
   }
+  return results;
+}
 
-  query += " ORDER BY timestamp DESC LIMIT " + std::to_string(limit);
-
-  if (!conn->Query(query)) {
-    pool_->ReturnConnection(std::move(conn));
-    return {};
+bool MySQLMessageStore::StoreMessages(const std::vector<MySQLMessageData>& messages) {
+  if (messages.empty()) {
+    return true;
+  }
+  auto conn = pool_->Acquire();
+  if (!conn) {
+    return false;
+  }
+  if (!conn->Execute("START TRANSACTION")) {
+    return false;
   }
 
-  auto rows = conn->FetchResults();
-  pool_->ReturnConnection(std::move(conn));
+  // No re-prepare retry in here: a lost statement means a lost session, and with it the
+  // transaction, so the batch fails as a whole.
+  bool ok = true;
+  for (size_t done = 0; ok && done < messages.size();) {
+    size_t rows = kMaxInsertRows;
+    while (rows > messages.size() - done) {
+      rows /= 2;
+    }
+    const std::string& sql = InsertMessagesSql(rows);
+    MySQLStatement* stmt = conn->Prepare(sql);
+    if (!stmt) {
+      ok = false;
+      break;
+    }
+    for (size_t i = 0; i < rows; ++i) {
+      const MySQLMessageData& m = messages[done + i];
+      const size_t p = i * 9;
+      stmt->BindParam(p + 0, m.message_id);
+      stmt->BindParam(p + 1, m.sender_id);
+      stmt->BindParam(p + 2, m.receiver_id);
+      stmt->BindParam(p + 3, m.channel_id);
+      stmt->BindParam(p + 4, m.channel_type);
+      stmt->BindParam(p + 5, m.msg_type);
+      stmt->BindParam(p + 6, m.content);
+      stmt->BindParam(p + 7, m.timestamp);
+      stmt->BindParam(p + 8, m.created_at);
+    }
+    if (!stmt->Execute()) {
+      if (IsStatementLost(stmt->Errno())) {
+        conn->Forget(sql);
+      }
+      ok = false;
+    }
+    done += rows;
+  }
 
-  std::vector<MySQLMessageData> messages;
-  for (auto& row : rows) {
-    MySQLMessageData msg;
-    msg.message_id = row[0];
-    msg.sender_id = row[1];
-    msg.receiver_id = row[2];
-    msg.channel_id = row[3];
-    msg.channel_type = std::stoi(row[4]);
-    msg.msg_type = std::stoi(row[5]);
-    msg.content = row[6];
-    msg.timestamp = std::stoll(row[7]);
-    messages.push_back(std::move(msg));
+  ok = ok && conn->Execute("COMMIT");
+  if (!ok) {
+    conn->Execute("ROLLBACK");
   }
+  return ok;
+}
 
-  // Reverse to get chronological order
-  std::reverse(messages.begin(), messages.end());
-  return messages;
+std::vector<MySQLMessageData> MySQLMessageStore::GetHistory(const std::string& channel_id,
+                                                           int channel_type,
+                                                           int64_t before_timestamp,
+                                                           int32_t limit) {
+  auto conn = pool_->Acquire();
+  if (!conn) {
+    return {};
+  }
+  return QueryHistory(*conn, channel_id, channel_type, before_timestamp, limit);
 }
 
-std::vector<MySQLMessageData> MySQLMessageStore::GetOfflineMessages(const std::string& user_id) {
-  auto conn = pool_->GetConnection();
+std::vector<MySQLMessageData> MySQLMessageStore::GetHistoryPage(const std::string& channel_id,
+                                                               int channel_type,
+                                                               HistoryDirection direction,
+                                                               int64_t from_timestamp,
+                                                               int64_t from_seq,
+                                                               int32_t limit) {
+  auto conn = pool_->Acquire();
   if (!conn) {
     return {};
   }
+  return QueryPage(*conn, channel_id, channel_type, direction, from_timestamp, from_seq, limit);
+}
 
-  std::string query = "SELECT message_id, sender_id, receiver_id, channel_id, "
-                     "channel_type, msg_type, content, timestamp FROM messages WHERE "
-                     "receiver_id = '" + conn->Escape(user_id) + "' "
-                     "ORDER BY timestamp ASC";
+void MySQLMessageStore::GetHistoryAsync(const std::string& channel_id,
+                                        int channel_type,
+                                        int64_t before_timestamp,
+                                        int32_t limit,
+                                        asio::any_io_executor ex,
+                                        std::function<void(std::vector<MySQLMessageData>)> callback) {
+  pool_->Run(
+      std::move(ex),
+      [channel_id, channel_type, before_timestamp, limit](MySQLConnection& conn) {
+        return QueryHistory(conn, channel_id, channel_type, before_timestamp, limit);
+      },
+      [callback = std::move(callback)](std::optional<std::vector<MySQLMessageData>> messages) {
+        callback(messages ? std::move(*messages) : std::vector<MySQLMessageData>{});
+      });
+}
 
-  if (!conn->Query(query)) {
-    pool_->ReturnConnection(std::move(conn));
+std::vector<MySQLMessageData> MySQLMessageStore::GetOfflineMessages(const std::string& user_id) {
+  auto conn = pool_->Acquire();
+  if (!conn) {
     return {};
   }
 
-  auto rows = conn->FetchResults();
-  pool_->ReturnConnection(std::move(conn));
-
+  static const std::string kSql =
+      std::string("SELECT ") + kMessageColumns + " FROM messages WHERE receiver_id = ? ORDER BY timestamp ASC";
   std::vector<MySQLMessageData> messages;
-  for (auto& row : rows) {
-    MySQLMessageData msg;
-    msg.message_id = row[0];
-    msg.sender_id = row[1];
-    msg.receiver_id = row[2];
-    msg.channel_id = row[3];
-    msg.channel_type = std::stoi(row[4]);
-    msg.msg_type = std::stoi(row[5]);
-    msg.content = row[6];
-    msg.timestamp = std::stoll(row[7]);
-    messages.push_back(std::move(msg));
+  if (MySQLStatement* stmt = RunStatement(*conn, kSql, [&](MySQLStatement& s) { s.BindParam(0, user_id); })) {
+    messages = FetchMessages(*stmt);
   }
-
   return messages;
 }
 
 bool MySQLMessageStore::ClearOfflineMessages(const std::string& user_id) {
-  auto conn = pool_->GetConnection();
+  auto conn = pool_->Acquire();
   if (!conn) {
     return false;
   }
 
-  std::string query = "DELETE FROM messages WHERE receiver_id = '" + conn->Escape(user_id) + "'";
-  bool result = conn->Execute(query);
-  pool_->ReturnConnection(std::move(conn));
-  return result;
+  static const std::string kSql = "DELETE FROM messages WHERE receiver_id = ?";
+  return RunStatement(*conn, kSql, [&](MySQLStatement& stmt) { stmt.BindParam(0, user_id); }) != nullptr;
 }
 
 bool MySQLMessageStore::StoreReadReceipt(const std::string& message_id,
                                         const std::string& user_id, int64_t read_at) {
-  auto conn = pool_->GetConnection();
+  auto conn = pool_->Acquire();
   if (!conn) {
     return false;
   }
 
-  std::string query = "INSERT INTO read_receipts (message_id, user_id, read_at) VALUES ('" +
-                     conn->Escape(message_id) + "', '" +
-                     conn->Escape(user_id) + "', " +
-                     std::to_string(read_at) + ") "
-                     "ON DUPLICATE KEY UPDATE read_at = " + std::to_string(read_at);
-
-  bool result = conn->Execute(query);
-  pool_->ReturnConnection(std::move(conn));
-  return result;
+  static const std::string kSql = "INSERT INTO read_receipts (message_id, user_id, read_at) VALUES (?, ?, ?) "
+                                  "ON DUPLICATE KEY UPDATE read_at = VALUES(read_at)";
+  return RunStatement(*conn, kSql, [&](MySQLStatement& stmt) {
+           stmt.BindParam(0, message_id);
+           stmt.BindParam(1, user_id);
+           stmt.BindParam(2, read_at);
+         }) != nullptr;
 }
 
 std::vector<ReadReceiptData> MySQLMessageStore::GetReadReceipts(const std::string& message_id) {
-  auto conn = pool_->GetConnection();
+  auto conn = pool_->Acquire();
   if (!conn) {
     return {};
   }
 
-  std::string query = "SELECT message_id, user_id, read_at FROM read_receipts WHERE "
-                     "message_id = '" + conn->Escape(message_id) + "'";
-
-  if (!conn->Query(query)) {
-    pool_->ReturnConnection(std::move(conn));
-    return {};
-  }
-
-  auto rows = conn->FetchResults();
-  pool_->ReturnConnection(std::move(conn));
-
   std::vector<ReadReceiptData> receipts;
-  for (auto& row : rows) {
-    ReadReceiptData receipt;
-    receipt.message_id = row[0];
-    receipt.user_id = row[1];
-    receipt.read_at = std::stoll(row[2]);
-    receipts.push_back(std::move(receipt));
+  static const std::string kSql = "SELECT message_id, user_id, read_at FROM read_receipts WHERE message_id = ?";
+  if (MySQLStatement* stmt = RunStatement(*conn, kSql, [&](MySQLStatement& s) { s.BindParam(0, message_id); })) {
+    ReadReceiptData row{};
+    stmt->BindResult(0, &row.message_id);
+    stmt->BindResult(1, &row.user_id);
+    stmt->BindResult(2, &row.read_at);
+    while (stmt->Fetch()) {
+      receipts.push_back(std::move(row));
+    }
   }
-
   return receipts;
 }
 
 bool MySQLMessageStore::MarkAsRead(const std::string& user_id, const std::string& channel_id,
                                   int channel_type, const std::string& message_id, int64_t read_at) {
-  auto conn = pool_->GetConnection();
+  auto conn = pool_->Acquire();
   if (!conn) {
     return false;
   }
 
-  std::string query = "INSERT INTO read_cursors (user_id, channel_id, channel_type, "
-                     "last_read_message_id, last_read_timestamp) VALUES ('" +
-                     conn->Escape(user_id) + "', '" +
-                     conn->Escape(channel_id) + "', " +
-                     std::to_string(channel_type) + ", '" +
-                     conn->Escape(message_id) + "', " +
-                     std::to_string(read_at) + ") "
-                     "ON DUPLICATE KEY UPDATE "
-                     "last_read_message_id = '" + conn->Escape(message_id) + "', "
-                     "last_read_timestamp = " + std::to_string(read_at);
-
-  bool result = conn->Execute(query);
-  pool_->ReturnConnection(std::move(conn));
-  return result;
+  static const std::string kSql =
+      "INSERT INTO read_cursors (user_id, channel_id, channel_type, last_read_message_id, last_read_timestamp) "
+      "VALUES (?, ?, ?, ?, ?) ON DUPLICATE KEY UPDATE "
+      "last_read_message_id = VALUES(last_read_message_id), last_read_timestamp = VALUES(last_read_timestamp)";
+  return RunStatement(*conn, kSql, [&](MySQLStatement& stmt) {
+           stmt.BindParam(0, user_id);
+           stmt.BindParam(1, channel_id);
+           stmt.BindParam(2, channel_type);
+           stmt.BindParam(3, message_id);
+           stmt.BindParam(4, read_at);
+         }) != nullptr;
 }
 
 int32_t MySQLMessageStore::GetUnreadCount(const std::string& user_id) {
-  auto conn = pool_->GetConnection();
+  auto conn = pool_->Acquire();
   if (!conn) {
     return 0;
   }
 
-  std::string query = "SELECT SUM(unread_count) FROM read_cursors WHERE user_id = '" +
-                     conn->Escape(user_id) + "'";
-
-  if (!conn->Query(query)) {
-    pool_->ReturnConnection(std::move(conn));
-    return 0;
-  }
-
-  auto rows = conn->FetchResults();
-  pool_->ReturnConnection(std::move(conn));
-
-  if (rows.empty() || rows[0].empty() || rows[0][0] == "NULL") {
-    return 0;
+  static const std::string kSql =
+      "SELECT CAST(COALESCE(SUM(unread_count), 0) AS SIGNED) FROM read_cursors WHERE user_id = ?";
+  int64_t total = 0;
+  if (MySQLStatement* stmt = RunStatement(*conn, kSql, [&](MySQLStatement& s) { s.BindParam(0, user_id); })) {
+    stmt->BindResult(0, &total);
+    if (!stmt->Fetch()) {
+      total = 0;
+    }
   }
-
-  return static_cast<int32_t>(std::stoll(rows[0][0]));
+  return static_cast<int32_t>(total);
 }
 
 std::vector<std::pair<std::string, int32_t>> MySQLMessageStore::GetAllUnread(const std::string& user_id) {
-  auto conn = pool_->GetConnection();
+  auto conn = pool_->Acquire();
   if (!conn) {
     return {};
   }
 
-  std::string query = "SELECT channel_id, unread_count FROM read_cursors WHERE user_id = '" +
-                     conn->Escape(user_id) + "'";
-
-  if (!conn->Query(query)) {
-    pool_->ReturnConnection(std::move(conn));
-    return {};
-  }
-
-  auto rows = conn->FetchResults();
-  pool_->ReturnConnection(std::move(conn));
-
+  static const std::string kSql = "SELECT channel_id, unread_count FROM read_cursors WHERE user_id = ?";
   std::vector<std::pair<std::string, int32_t>> result;
-  for (auto& row : rows) {
-    result.emplace_back(row[0], static_cast<int32_t>(std::stoll(row[1])));
+  if (MySQLStatement* stmt = RunStatement(*conn, kSql, [&](MySQLStatement& s) { s.BindParam(0, user_id); })) {
+    std::pair<std::string, int32_t> row;
+    stmt->BindResult(0, &row.first);
+    stmt->BindResult(1, &row.second);
+    while (stmt->Fetch()) {
+      result.push_back(std::move(row));
+    }
   }
-
   return result;
 }
 
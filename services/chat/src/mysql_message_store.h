@@ -1,14 +1,15 @@
 #ifndef CHIRP_CHAT_MYSQL_MESSAGE_STORE_H_
 #define CHIRP_CHAT_MYSQL_MESSAGE_STORE_H_
 
-#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <memory>
-#include <mutex>
 #include <string>
 #include <vector>
 
-#include <mysql/mysql.h>
+#include <asio.hpp>
 
+#include "database/mysql_connection_pool.h"
 #include "proto/chat.pb.h"
 
 namespace chirp {
@@ -25,8 +26,12 @@ struct MySQLMessageData {
   std::string content;
   int64_t timestamp;
   int64_t created_at;
+  int64_t seq{0};  // messages.id, filled in by reads; orders messages that share a timestamp
 };
 
+// Which side of a keyset position a history page is read from
+enum class HistoryDirection { kOlder, kNewer };
+
 // Read receipt data
 struct ReadReceiptData {
   std::string message_id;
@@ -34,77 +39,9 @@ struct ReadReceiptData {
   int64_t read_at;
 };
 
-// MySQL connection wrapper
-class MySQLConnection {
-public:
-  MySQLConnection(const std::string& host, uint16_t port,
-                 const std::string& database, const std::string& user,
-                 const std::string& password);
-  ~MySQLConnection();
-
-  bool Connect();
-  void Disconnect();
-  bool IsConnected() const { return connected_; }
-
-  // Execute query (SELECT)
-  bool Query(const std::string& query);
-
-  // Execute statement (INSERT, UPDATE, DELETE)
-  bool Execute(const std::string& query);
-
-  // Get result set
-  std::vector<std::vector<std::string>> FetchResults();
-
-  // Get last insert ID
-  uint64_t LastInsertId();
-
-  // Get affected rows
-  uint64_t AffectedRows();
-
-  // Escape string
-  std::string Escape(const std::string& str);
-
-  MYSQL* GetMySQL() { return mysql_; }
-
-private:
-  std::string host_;
-  uint16_t port_;
-  std::string database_;
-  std::string user_;
-  std::string password_;
-
-  MYSQL* mysql_;
-  MYSQL_RES* result_;
-  bool connected_;
-};
-
-// Connection pool for MySQL
-class MySQLConnectionPool {
-public:
-  MySQLConnectionPool(size_t pool_size,
-                     const std::string& host, uint16_t port,
-                     const std::string& database, const std::string& user,
-                     const std::string& password);
-
-  ~MySQLConnectionPool();
-
-  std::unique_ptr<MySQLConnection> GetConnection();
-  void ReturnConnection(std::unique_ptr<MySQLConnection> conn);
-
-  size_t GetPoolSize() const { return pool_size_; }
-  size_t GetAvailableCount() const;
-
-private:
-  size_t pool_size_;
-  std::string host_;
-  uint16_t port_;
-  std::string database_;
-  std::string user_;
-  std::string password_;
-
-  std::vector<std::unique_ptr<MySQLConnection>> connections_;
-  std::mutex mu_;
-};
+using database::MySQLConnection;
+using database::MySQLConnectionPool;
+using database::MySQLStatement;
 
 // MySQL message store
 class MySQLMessageStore {
@@ -118,12 +55,38 @@ public:
   // Store message
   bool StoreMessage(const MySQLMessageData& message);
 
+  // Store messages with multi-row INSERTs in one transaction: all rows are written or none is.
+  bool StoreMessages(const std::vector<MySQLMessageData>& messages);
+
+  // Single-row INSERTs on one connection, so a bad row fails alone; one result per message.
+  // All false if no connection freed up in time (the wait happens once, not per row).
+  std::vector<bool> StoreMessagesEach(const std::vector<MySQLMessageData>& messages);
+
   // Get message history
   std::vector<MySQLMessageData> GetHistory(const std::string& channel_id,
                                           int channel_type,
                                           int64_t before_timestamp,
                                           int32_t limit);
 
+  // Keyset page: up to `limit` messages strictly older (kOlder) or newer (kNewer) than the row at
+  // (from_timestamp, from_seq) in (timestamp, id) order, oldest first. One seek on idx_channel
+  // whatever the depth; pass (INT64_MAX, INT64_MAX) for the newest page.
+  std::vector<MySQLMessageData> GetHistoryPage(const std::string& channel_id,
+                                               int channel_type,
+                                               HistoryDirection direction,
+                                               int64_t from_timestamp,
+                                               int64_t from_seq,
+                                               int32_t limit);
+
+  // GetHistory on the pool's executor; `callback` runs on `ex` (with no rows if no connection
+  // freed up in time).
+  void GetHistoryAsync(const std::string& channel_id,
+                       int channel_type,
+                       int64_t before_timestamp,
+                       int32_t limit,
+                       asio::any_io_executor ex,
+                       std::function<void(std::vector<MySQLMessageData>)> callback);
+
   // Get offline messages for a user
   std::vector<MySQLMessageData> GetOfflineMessages(const std::string& user_id);
 
@@ -146,6 +109,8 @@ public:
   // Get all unread counts per channel
   std::vector<std::pair<std::string, int32_t>> GetAllUnread(const std::string& user_id);
 
+  const std::shared_ptr<MySQLConnectionPool>& GetPool() const { return pool_; }
+
 private:
   std::shared_ptr<MySQLConnectionPool> pool_;
 };
@@ -1,6 +1,7 @@
 #include "paginated_history_retriever.h"
 
-#include <sstream>
+#include <limits>
+#include <optional>
 
 #include "logger.h"
 
@@ -11,51 +12,44 @@ using Logger = chirp::common::Logger;
 PaginatedHistoryRetriever::PaginatedHistoryRetriever(std::shared_ptr<HybridMessageStore> store)
     : store_(std::move(store)) {}
 
-std::string PaginatedHistoryRetriever::PageToken::Serialize() const {
-  std::ostringstream oss;
-  oss << cursor << "|" << timestamp << "|" << page_size;
-  return oss.str();
-}
-
 PaginatedHistoryRetriever::PageToken
 PaginatedHistoryRetriever::PageToken::Deserialize(const std::string& token) {
   PageToken result;
+  if (auto position = HistoryCursor::Decode(token)) {
+    result.position = std::move(*position);
+  }
+  return result;
+}
 
-  size_t pos1 = token.find('|');
-  size_t pos2 = token.find('|', pos1 + 1);
+namespace {
 
-  if (pos1 != std::string::npos && pos2 != std::string::npos) {
-    result.cursor = token.substr(0, pos1);
-    result.timestamp = std::stoll(token.substr(pos1 + 1, pos2 - pos1 - 1));
-    result.page_size = std::stoi(token.substr(pos2 + 1));
+// Fills `result` from one keyset page read at `position`
+void ReadPage(HybridMessageStore& store, const HistoryCursor& position,
+              PaginatedHistoryRetriever::PageResult* result) {
+  std::optional<HistoryCursor> next;
+  result->messages = store.GetHistoryPage(position, &next);
+  result->has_more = next.has_value();
+  if (next) {
+    result->next_page.position = std::move(*next);
   }
-
-  return result;
+  result->total_count = static_cast<int32_t>(result->messages.size());
 }
 
+} // namespace
+
 PaginatedHistoryRetriever::PageResult
 PaginatedHistoryRetriever::GetFirstPage(const std::string& channel_id,
                                        int channel_type,
                                        int32_t page_size) {
-  PageResult result;
-  int64_t now = []() {
-    using namespace std::chrono;
-    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
-  }();
-
-  auto messages = store_->GetHistory(channel_id, channel_type, now, page_size);
-
-  result.messages = std::move(messages);
-  result.has_more = !result.messages.empty();
-
-  if (result.has_more && !result.messages.empty()) {
-    result.next_page.cursor = channel_id;
-    result.next_page.timestamp = result.messages.front().timestamp;
-    result.next_page.page_size = page_size;
-  }
-
-  result.total_count = static_cast<int32_t>(result.messages.size());
+  HistoryCursor newest;
+  newest.channel_id = channel_id;
+  newest.channel_type = channel_type;
+  newest.timestamp = std::numeric_limits<int64_t>::max();
+  newest.seq = std::numeric_limits<int64_t>::max();
+  newest.page_size = page_size;
 
+  PageResult result;
+  ReadPage(*store_, newest, &result);
   return result;
 }
 
@@ -67,19 +61,7 @@ PaginatedHistoryRetriever::GetNextPage(const PageToken& token) {
     return result;
   }
 
-  auto messages = store_->GetHistory(token.cursor, 0, token.timestamp, token.page_size);
-
-  result.messages = std::move(messages);
-  result.has_more = !result.messages.empty();
-
-  if (result.has_more && !result.messages.empty()) {
-    result.next_page.cursor = token.cursor;
-    result.next_page.timestamp = result.messages.front().timestamp;
-    result.next_page.page_size = token.page_size;
-  }
-
-  result.total_count = static_cast<int32_t>(result.messages.size());
-
+  ReadPage(*store_, token.position, &result);
   return result;
 }
 
@@ -90,15 +72,20 @@ PaginatedHistoryRetriever::GetPageBefore(const std::string& channel_id,
                                         int32_t page_size) {
   PageResult result;
 
+  // Timestamp-addressed pages keep the Redis hot path for the latest messages
   auto messages = store_->GetHistory(channel_id, channel_type, before_timestamp, page_size);
 
   result.messages = std::move(messages);
   result.has_more = !result.messages.empty();
 
   if (result.has_more && !result.messages.empty()) {
-    result.next_page.cursor = channel_id;
-    result.next_page.timestamp = result.messages.front().timestamp;
-    result.next_page.page_size = page_size;
+    // Redis copies carry no sequence: continue strictly before their timestamp then
+    const MessageData& oldest = result.messages.front();
+    result.next_page.position.channel_id = channel_id;
+    result.next_page.position.channel_type = channel_type;
+    result.next_page.position.timestamp = oldest.timestamp;
+    result.next_page.position.seq = oldest.seq > 0 ? oldest.seq : std::numeric_limits<int64_t>::min();
+    result.next_page.position.page_size = page_size;
   }
 
   result.total_count = static_cast<int32_t>(result.messages.size());
@@ -111,36 +98,17 @@ PaginatedHistoryRetriever::GetPageAfter(const std::string& channel_id,
                                        int channel_type,
                                        int64_t after_timestamp,
                                        int32_t page_size) {
-  // For "after" pagination, we need to get history and filter
-  // This is less efficient and should be avoided when possible
-  PageResult result;
-
-  auto messages = store_->GetHistory(channel_id, channel_type, 0, page_size * 2);
-
-  // Filter messages after the timestamp
-  std::vector<MessageData> filtered;
-  filtered.reserve(page_size);
-
-  for (auto& msg : messages) {
-    if (msg.timestamp > after_timestamp) {
-      filtered.push_back(std::move(msg));
-      if (static_cast<int>(filtered.size()) >= page_size) {
-        break;
-      }
-    }
-  }
-
-  result.messages = std::move(filtered);
-  result.has_more = !result.messages.empty();
-
-  if (result.has_more && !result.messages.empty()) {
-    result.next_page.cursor = channel_id;
-    result.next_page.timestamp = result.messages.back().timestamp;
-    result.next_page.page_size = page_size;
-  }
-
-  result.total_count = static_cast<int32_t>(result.messages.size());
+  // Every sequence at after_timestamp is below INT64_MAX: strictly after the timestamp
+  HistoryCursor after;
+  after.channel_id = channel_id;
+  after.channel_type = channel_type;
+  after.timestamp = after_timestamp;
+  after.seq = std::numeric_limits<int64_t>::max();
+  after.direction = HistoryCursor::Direction::kNewer;
+  after.page_size = page_size;
 
+  PageResult result;
+  ReadPage(*store_, after, &result);
   return result;
 }
 
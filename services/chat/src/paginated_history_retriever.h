@@ -6,6 +6,7 @@
 #include <string>
 #include <vector>
 
+#include "history_cursor.h"
 #include "hybrid_message_store.h"
 
 namespace chirp::chat {
@@ -14,15 +15,15 @@ namespace chirp::chat {
 /// Provides efficient pagination across Redis and MySQL sources
 class PaginatedHistoryRetriever {
 public:
-  /// @brief Pagination token
+  /// @brief Pagination token: the keyset position the next page continues from
   struct PageToken {
-    std::string cursor;
-    int64_t timestamp{0};
-    int32_t page_size{50};
+    HistoryCursor position;
 
-    std::string Serialize() const;
+    /// @brief Opaque to clients (HistoryCursor::Encode)
+    std::string Serialize() const { return position.Encode(); }
+    /// @brief An invalid token if `token` was not produced by Serialize()
     static PageToken Deserialize(const std::string& token);
-    bool IsValid() const { return !cursor.empty(); }
+    bool IsValid() const { return !position.channel_id.empty(); }
   };
 
   /// @brief Page result
@@ -49,7 +50,7 @@ public:
                           int64_t before_timestamp,
                           int32_t page_size);
 
-  /// @brief Get page after timestamp
+  /// @brief Get page after timestamp (oldest first, next_page continues towards the newest)
   PageResult GetPageAfter(const std::string& channel_id,
                          int channel_type,
                          int64_t after_timestamp,
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <cstdlib>
@@ -5,6 +6,7 @@
 #include <optional>
 #include <random>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 #include <asio.hpp>
@@ -14,6 +16,7 @@
 #include "logger.h"
 #include "network/protobuf_framing.h"
 #include "redis_session_manager.h"
+#include "network/io_context_pool.h"
 #include "network/session.h"
 #include "network/tcp_server.h"
 #include "network/websocket_server.h"
@@ -225,17 +228,36 @@ int main(int argc, char** argv) {
   const std::string redis_host = GetArg(argc, argv, "--redis_host", "");
   const uint16_t redis_port = ParseU16Arg(argc, argv, "--redis_port", 6379);
   const int redis_ttl_seconds = std::atoi(GetArg(argc, argv, "--redis_ttl", "3600").c_str());
+  const size_t io_threads = chirp::network::ResolveIoThreads(std::atoi(GetArg(argc, argv, "--io_threads", "1").c_str()));
+  chirp::network::WriteQueueLimits write_limits;
+  write_limits.high_watermark_bytes =
+      static_cast<size_t>(std::atoi(GetArg(argc, argv, "--write_queue_high_kb", "4096").c_str())) * 1024;
+  write_limits.low_watermark_bytes =
+      static_cast<size_t>(std::atoi(GetArg(argc, argv, "--write_queue_low_kb", "1024").c_str())) * 1024;
+  // Shedding stops below the low mark, so it cannot sit above the high one.
+  write_limits.low_watermark_bytes = std::min(write_limits.low_watermark_bytes, write_limits.high_watermark_bytes);
+  const size_t ws_max_message_bytes =
+      static_cast<size_t>(std::atoi(GetArg(argc, argv, "--ws_max_message_kb", "16384").c_str())) * 1024;
+  chirp::network::PerMessageDeflateConfig ws_deflate;
+  ws_deflate.enabled = std::atoi(GetArg(argc, argv, "--ws_deflate", "0").c_str()) != 0;
+  ws_deflate.context_takeover = std::atoi(GetArg(argc, argv, "--ws_deflate_context_takeover", "1").c_str()) != 0;
+  const std::chrono::milliseconds ws_handshake_timeout(
+      std::atoi(GetArg(argc, argv, "--ws_handshake_timeout_ms", "10000").c_str()));
+  // Clients heartbeat every 30s by default; three missed heartbeats mark the connection dead.
+  const std::chrono::seconds idle_timeout(std::atoi(GetArg(argc, argv, "--idle_timeout_sec", "90").c_str()));
   std::string instance_id = GetArg(argc, argv, "--instance_id", "");
   if (instance_id.empty()) {
     instance_id = RandomHex(8);
   }
 
   Logger::Instance().Info("chirp_gateway starting tcp=" + std::to_string(port) + " ws=" + std::to_string(ws_port) +
+                          " io_threads=" + std::to_string(io_threads) +
                           (auth_host.empty() ? "" : (" auth=" + auth_host + ":" + std::to_string(auth_port))) +
                           (redis_host.empty() ? "" : (" redis=" + redis_host + ":" + std::to_string(redis_port) +
                                                       " instance=" + instance_id)));
 
   asio::io_context io;
+  chirp::network::IoContextPool io_pool(io, io_threads);
 
   auto state = std::make_shared<chirp::gateway::GatewayState>();
   std::shared_ptr<chirp::gateway::AuthClient> auth;
@@ -263,8 +285,8 @@ int main(int argc, char** argv) {
   }
 
   chirp::network::TcpServer server(
-      io, port,
-      [state, auth, redis_mgr](std::shared_ptr<chirp::network::Session> session, std::string&& payload) {
+      io_pool, port,
+      [state, auth, redis_mgr](std::shared_ptr<chirp::network::Session> session, std::string_view payload) {
         chirp::gateway::Packet pkt;
         if (!pkt.ParseFromArray(payload.data(), static_cast<int>(payload.size()))) {
           Logger::Instance().Warn("failed to parse Packet from client");
@@ -349,8 +371,8 @@ int main(int argc, char** argv) {
       });
 
   chirp::network::WebSocketServer ws_server(
-      io, ws_port,
-      [state, auth, redis_mgr](std::shared_ptr<chirp::network::Session> session, std::string&& payload) {
+      io_pool, ws_port,
+      [state, auth, redis_mgr](std::shared_ptr<chirp::network::Session> session, std::string_view payload) {
         chirp::gateway::Packet pkt;
         if (!pkt.ParseFromArray(payload.data(), static_cast<int>(payload.size()))) {
           Logger::Instance().Warn("failed to parse Packet from ws client");
@@ -433,14 +455,23 @@ int main(int argc, char** argv) {
         }
       });
 
+  server.SetWriteQueueLimits(write_limits);
+  ws_server.SetWriteQueueLimits(write_limits);
+  ws_server.SetMaxMessageSize(ws_max_message_bytes);
+  ws_server.SetPerMessageDeflate(ws_deflate);
+  ws_server.SetHandshakeTimeout(ws_handshake_timeout);
+  server.SetIdleTimeout(idle_timeout);
+  ws_server.SetIdleTimeout(idle_timeout);
   server.Start();
   ws_server.Start();
+  io_pool.Start();
 
   asio::signal_set signals(io, SIGINT, SIGTERM);
   signals.async_wait([&](const std::error_code& /*ec*/, int /*sig*/) {
     Logger::Instance().Info("shutdown requested");
     server.Stop();
     ws_server.Stop();
+    io_pool.Stop();
     io.stop();
   });
 
@@ -9,6 +9,8 @@
 #include <asio.hpp>
 
 #include "logger.h"
+#include "network/redis_scripts.h"
+#include "network/redis_subscriber.h"
 
 namespace chirp::gateway {
 namespace {
@@ -47,21 +49,18 @@ struct RedisSessionManager::Impl {
        KickCallback kick_cb)
       : main_io(io),
         client(host, port),
-        sub(std::move(host), port),
+        sub(io.get_executor(), std::move(host), port),
         instance_id(std::move(inst)),
         ttl(ttl_seconds),
         on_kick(std::move(kick_cb)) {}
 
   void Start() {
-    // Set message callback before starting
+    // Runs on main_io already; the subscription is (re)sent on every connect
     sub.SetMessageCallback([this](const std::string& /*ch*/, const std::string& payload) {
-      asio::post(main_io, [cb = on_kick, user_id = payload] {
-        if (cb) {
-          cb(user_id);
-        }
-      });
+      if (on_kick) {
+        on_kick(payload);
+      }
     });
-    // Subscribe to kick channel
     sub.Subscribe(KickChannel(instance_id));
     // Start the subscriber
     sub.Start();
@@ -95,11 +94,10 @@ struct RedisSessionManager::Impl {
 
       try {
         if (job.type == Job::Type::kClaim) {
-          std::optional<std::string> prev = client.Get(SessionKey(job.user_id));
-          if (prev && *prev != instance_id) {
-            client.Publish(KickChannel(*prev), job.user_id);
-          }
-          client.SetEx(SessionKey(job.user_id), instance_id, ttl);
+          // Take over, read the previous owner and kick it, all in one atomic round trip.
+          std::optional<std::string> prev;
+          chirp::network::ClaimSession(client, SessionKey(job.user_id), instance_id, ttl, KickChannel(""), job.user_id,
+                                       &prev);
 
           asio::post(main_io, [cb = std::move(job.cb), prev]() mutable {
             if (cb) {
@@ -107,10 +105,7 @@ struct RedisSessionManager::Impl {
             }
           });
         } else {
-          auto cur = client.Get(SessionKey(job.user_id));
-          if (cur && *cur == instance_id) {
-            client.Del(SessionKey(job.user_id));
-          }
+          chirp::network::ReleaseSession(client, SessionKey(job.user_id), instance_id);
         }
       } catch (const std::exception& e) {
         chirp::common::Logger::Instance().Warn(std::string("redis session job failed: ") + e.what());
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <cstdlib>
@@ -5,6 +6,7 @@
 #include <mutex>
 #include <random>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -12,6 +14,8 @@
 #include <asio.hpp>
 
 #include "logger.h"
+#include "network/io_context_pool.h"
+#include "network/packet_helpers.h"
 #include "network/protobuf_framing.h"
 #include "network/redis_client.h"
 #include "network/session.h"
@@ -112,9 +116,9 @@ void BroadcastToFriends(const std::shared_ptr<SocialState>& state,
     }
   }
 
-  for (auto& sess : targets) {
-    SendPacket(sess, msg_id, 0, body);
-  }
+  // Presence is superseded by the next update, so slow friends may miss one instead of being evicted.
+  chirp::network::BroadcastPacket(targets, msg_id, body, /*sequence=*/0,
+                                  /*droppable=*/msg_id == chirp::gateway::PRESENCE_NOTIFY);
 }
 
 void HandleAddFriend(const std::shared_ptr<SocialState>& state,
@@ -357,7 +361,7 @@ void HandleDisconnect(const std::shared_ptr<SocialState>& state,
 void HandlePacket(const std::shared_ptr<SocialState>& state,
                   const std::shared_ptr<chirp::network::RedisClient>& redis,
                   const std::shared_ptr<chirp::network::Session>& session,
-                  std::string&& payload) {
+                  std::string_view payload) {
   using chirp::common::Logger;
 
   chirp::gateway::Packet pkt;
@@ -438,11 +442,20 @@ int main(int argc, char** argv) {
   const uint16_t ws_port = ParseU16Arg(argc, argv, "--ws_port", static_cast<uint16_t>(port + 1));
   const std::string redis_host = GetArg(argc, argv, "--redis_host", "");
   const uint16_t redis_port = ParseU16Arg(argc, argv, "--redis_port", 6379);
+  const size_t io_threads = chirp::network::ResolveIoThreads(std::atoi(GetArg(argc, argv, "--io_threads", "1").c_str()));
+  chirp::network::WriteQueueLimits write_limits;
+  write_limits.high_watermark_bytes =
+      static_cast<size_t>(std::atoi(GetArg(argc, argv, "--write_queue_high_kb", "4096").c_str())) * 1024;
+  write_limits.low_watermark_bytes =
+      static_cast<size_t>(std::atoi(GetArg(argc, argv, "--write_queue_low_kb", "1024").c_str())) * 1024;
+  write_limits.low_watermark_bytes = std::min(write_limits.low_watermark_bytes, write_limits.high_watermark_bytes);
 
   Logger::Instance().Info("chirp_social starting tcp=" + std::to_string(port) + " ws=" + std::to_string(ws_port) +
+                          " io_threads=" + std::to_string(io_threads) +
                           (redis_host.empty() ? "" : (" redis=" + redis_host + ":" + std::to_string(redis_port))));
 
   asio::io_context io;
+  chirp::network::IoContextPool io_pool(io, io_threads);
 
   std::shared_ptr<chirp::network::RedisClient> redis;
   if (!redis_host.empty()) {
@@ -452,27 +465,31 @@ int main(int argc, char** argv) {
   auto state = std::make_shared<SocialState>();
 
   chirp::network::TcpServer server(
-      io, port,
-      [state, redis](std::shared_ptr<chirp::network::Session> session, std::string&& payload) {
-        HandlePacket(state, redis, session, std::move(payload));
+      io_pool, port,
+      [state, redis](std::shared_ptr<chirp::network::Session> session, std::string_view payload) {
+        HandlePacket(state, redis, session, payload);
       },
       [state](std::shared_ptr<chirp::network::Session> session) { HandleDisconnect(state, session); });
 
   chirp::network::WebSocketServer ws_server(
-      io, ws_port,
-      [state, redis](std::shared_ptr<chirp::network::Session> session, std::string&& payload) {
-        HandlePacket(state, redis, session, std::move(payload));
+      io_pool, ws_port,
+      [state, redis](std::shared_ptr<chirp::network::Session> session, std::string_view payload) {
+        HandlePacket(state, redis, session, payload);
       },
       [state](std::shared_ptr<chirp::network::Session> session) { HandleDisconnect(state, session); });
 
+  server.SetWriteQueueLimits(write_limits);
+  ws_server.SetWriteQueueLimits(write_limits);
   server.Start();
   ws_server.Start();
+  io_pool.Start();
 
   asio::signal_set signals(io, SIGINT, SIGTERM);
   signals.async_wait([&](const std::error_code& /*ec*/, int /*sig*/) {
     Logger::Instance().Info("shutdown requested");
     server.Stop();
     ws_server.Stop();
+    io_pool.Stop();
     io.stop();
   });
 
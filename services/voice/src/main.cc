@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <cstdlib>
@@ -5,12 +6,15 @@
 #include <mutex>
 #include <random>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
 #include <asio.hpp>
 
 #include "logger.h"
+#include "network/io_context_pool.h"
+#include "network/packet_helpers.h"
 #include "network/protobuf_framing.h"
 #include "network/session.h"
 #include "network/tcp_server.h"
@@ -100,6 +104,8 @@ void BroadcastToRoom(const std::shared_ptr<VoiceRoom>& room,
                      const std::string& exclude_user = "") {
   std::vector<std::shared_ptr<chirp::network::Session>> targets;
   {
+    // Sessions may live on different io threads; take the state lock before the room lock.
+    std::lock_guard<std::mutex> state_lock(state->mu);
     std::lock_guard<std::mutex> lock(room->mu);
     for (const auto& kv : room->participants) {
       if (!exclude_user.empty() && kv.first == exclude_user) {
@@ -115,9 +121,7 @@ void BroadcastToRoom(const std::shared_ptr<VoiceRoom>& room,
     }
   }
 
-  for (auto& sess : targets) {
-    SendPacket(sess, msg_id, 0, body);
-  }
+  chirp::network::BroadcastPacket(targets, msg_id, body);
 }
 
 void HandleCreateRoom(const std::shared_ptr<VoiceState>& state,
@@ -377,7 +381,7 @@ void HandleDisconnect(const std::shared_ptr<VoiceState>& state,
 
 void HandlePacket(const std::shared_ptr<VoiceState>& state,
                   const std::shared_ptr<chirp::network::Session>& session,
-                  std::string&& payload) {
+                  std::string_view payload) {
   using chirp::common::Logger;
 
   chirp::gateway::Packet pkt;
@@ -428,35 +432,48 @@ int main(int argc, char** argv) {
   Logger::Instance().SetLevel(Logger::Level::kInfo);
   const uint16_t port = ParseU16Arg(argc, argv, "--port", 9000);
   const uint16_t ws_port = ParseU16Arg(argc, argv, "--ws_port", static_cast<uint16_t>(port + 1));
+  const size_t io_threads = chirp::network::ResolveIoThreads(std::atoi(GetArg(argc, argv, "--io_threads", "1").c_str()));
+  chirp::network::WriteQueueLimits write_limits;
+  write_limits.high_watermark_bytes =
+      static_cast<size_t>(std::atoi(GetArg(argc, argv, "--write_queue_high_kb", "4096").c_str())) * 1024;
+  write_limits.low_watermark_bytes =
+      static_cast<size_t>(std::atoi(GetArg(argc, argv, "--write_queue_low_kb", "1024").c_str())) * 1024;
+  write_limits.low_watermark_bytes = std::min(write_limits.low_watermark_bytes, write_limits.high_watermark_bytes);
 
-  Logger::Instance().Info("chirp_voice starting tcp=" + std::to_string(port) + " ws=" + std::to_string(ws_port));
+  Logger::Instance().Info("chirp_voice starting tcp=" + std::to_string(port) + " ws=" + std::to_string(ws_port) +
+                          " io_threads=" + std::to_string(io_threads));
 
   asio::io_context io;
+  chirp::network::IoContextPool io_pool(io, io_threads);
 
   auto state = std::make_shared<VoiceState>();
 
   chirp::network::TcpServer server(
-      io, port,
-      [state](std::shared_ptr<chirp::network::Session> session, std::string&& payload) {
-        HandlePacket(state, session, std::move(payload));
+      io_pool, port,
+      [state](std::shared_ptr<chirp::network::Session> session, std::string_view payload) {
+        HandlePacket(state, session, payload);
       },
       [state](std::shared_ptr<chirp::network::Session> session) { HandleDisconnect(state, session); });
 
   chirp::network::WebSocketServer ws_server(
-      io, ws_port,
-      [state](std::shared_ptr<chirp::network::Session> session, std::string&& payload) {
-        HandlePacket(state, session, std::move(payload));
+      io_pool, ws_port,
+      [state](std::shared_ptr<chirp::network::Session> session, std::string_view payload) {
+        HandlePacket(state, session, payload);
       },
       [state](std::shared_ptr<chirp::network::Session> session) { HandleDisconnect(state, session); });
 
+  server.SetWriteQueueLimits(write_limits);
+  ws_server.SetWriteQueueLimits(write_limits);
   server.Start();
   ws_server.Start();
+  io_pool.Start();
 
   asio::signal_set signals(io, SIGINT, SIGTERM);
   signals.async_wait([&](const std::error_code& /*ec*/, int /*sig*/) {
     Logger::Instance().Info("shutdown requested");
     server.Stop();
     ws_server.Stop();
+    io_pool.Stop();
     io.stop();
   });
 
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 #include <functional>
@@ -49,8 +50,8 @@ public:
     // Set up session callbacks before connecting
     if (use_ws_) {
       ws_client_->SetCallbacks(
-          [this](std::shared_ptr<network::Session> session, std::string&& payload) {
-            OnFrame(session, std::move(payload));
+          [this](std::shared_ptr<network::Session> session, std::string_view payload) {
+            OnFrame(session, payload);
           },
           [this](std::shared_ptr<network::Session> session) {
             OnClose(session);
@@ -62,8 +63,8 @@ public:
       session_ = ws_client_->GetSession();
     } else {
       tcp_client_->SetCallbacks(
-          [this](std::shared_ptr<network::Session> session, std::string&& payload) {
-            OnFrame(session, std::move(payload));
+          [this](std::shared_ptr<network::Session> session, std::string_view payload) {
+            OnFrame(session, payload);
           },
           [this](std::shared_ptr<network::Session> session) {
             OnClose(session);
@@ -190,9 +191,9 @@ public:
   }
 
 private:
-  void OnFrame(std::shared_ptr<network::Session> session, std::string&& payload) {
+  void OnFrame(std::shared_ptr<network::Session> session, std::string_view payload) {
     chirp::gateway::Packet pkt;
-    if (!pkt.ParseFromString(payload)) {
+    if (!pkt.ParseFromArray(payload.data(), static_cast<int>(payload.size()))) {
       Logger::Instance().Error("Failed to parse gateway packet");
       return;
     }
@@ -4,6 +4,7 @@
 
 #include "chat_session_registry.h"
 #include "chat_validation.h"
+#include "history_cursor.h"
 #include "network/protobuf_framing.h"
 #include "network/session.h"
 #include "proto/gateway.pb.h"
@@ -192,5 +193,54 @@ TEST(ChatSessionRegistryTest, LogoutSuccessWouldCloseSessionAfterResponse) {
   EXPECT_FALSE(session->last_sent.empty());
 }
 
+TEST(ChatValidationTest, HistoryV2RejectsForeignPrivateChannel) {
+  GetHistoryRequestV2 req;
+  req.set_user_id("alice");
+  req.set_channel_type(PRIVATE);
+  req.set_channel_id("bob|carol");
+
+  EXPECT_EQ(ValidateGetHistoryRequest(req, "alice"), chirp::common::AUTH_FAILED);
+
+  req.set_channel_id("alice|bob");
+  EXPECT_EQ(ValidateGetHistoryRequest(req, "alice"), chirp::common::OK);
+}
+
+TEST(HistoryCursorTest, RoundTripsKeysetPosition) {
+  HistoryCursor cursor;
+  cursor.channel_id = std::string("grp\0|\xff", 6);
+  cursor.channel_type = 1;
+  cursor.timestamp = 1700000000123;
+  cursor.seq = -1;
+  cursor.direction = HistoryCursor::Direction::kNewer;
+  cursor.page_size = 50;
+
+  const std::string token = cursor.Encode();
+  EXPECT_EQ(token.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"),
+            std::string::npos);
+
+  auto decoded = HistoryCursor::Decode(token);
+  ASSERT_TRUE(decoded.has_value());
+  EXPECT_EQ(decoded->channel_id, cursor.channel_id);
+  EXPECT_EQ(decoded->channel_type, 1);
+  EXPECT_EQ(decoded->timestamp, cursor.timestamp);
+  EXPECT_EQ(decoded->seq, -1);
+  EXPECT_EQ(decoded->direction, HistoryCursor::Direction::kNewer);
+  EXPECT_EQ(decoded->page_size, 50);
+}
+
+TEST(HistoryCursorTest, RejectsMalformedTokens) {
+  HistoryCursor cursor;
+  cursor.channel_id = "general";
+  cursor.timestamp = 42;
+  cursor.seq = 7;
+  const std::string token = cursor.Encode();
+
+  EXPECT_FALSE(HistoryCursor::Decode("").has_value());
+  EXPECT_FALSE(HistoryCursor::Decode("general|42|50").has_value());
+  EXPECT_FALSE(HistoryCursor::Decode(token.substr(0, token.size() - 2)).has_value());
+  EXPECT_FALSE(HistoryCursor::Decode(token + "AA").has_value());
+  EXPECT_FALSE(HistoryCursor::Decode("B" + token.substr(1)).has_value());  // version byte
+}
+
 } // namespace
 } // namespace chirp::chat
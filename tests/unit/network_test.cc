@@ -1,7 +1,37 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <future>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "network/input_buffer.h"
+#include "network/io_context_pool.h"
 #include "network/protobuf_framing.h"
 #include "network/length_prefixed_framer.h"
+#include "network/message_router.h"
+#include "network/network_stats.h"
+#include "network/packet_helpers.h"
+#include "network/redis_client.h"
+#include "network/redis_cluster.h"
+#include "network/redis_protocol.h"
+#include "network/redis_scripts.h"
+#include "network/redis_stream_consumer.h"
+#include "network/redis_subscriber.h"
+#include "network/shared_frame.h"
+#include "network/tcp_session.h"
+#include "network/timing_wheel.h"
+#include "network/websocket_client.h"
+#include "network/websocket_deflate.h"
+#include "network/websocket_frame.h"
+#include "network/websocket_session.h"
+#include "network/websocket_util.h"
+#include "network/write_queue.h"
 #include "proto/common.pb.h"
 #include "proto/gateway.pb.h"
 
@@ -172,5 +202,2629 @@ TEST(LengthPrefixedFramerTest, Clear) {
   EXPECT_EQ(0u, framer.BufferedBytes());
 }
 
+TEST(LengthPrefixedFramerTest, PeekAndConsumeWithoutCopy) {
+  LengthPrefixedFramer framer;
+
+  uint8_t data[] = {0x00, 0x00, 0x00, 0x02, 'h', 'i', 0x00, 0x00, 0x00, 0x03, 'a', 'b', 'c'};
+  framer.Append(data, sizeof(data));
+
+  auto f1 = framer.PeekFrame();
+  ASSERT_TRUE(f1.has_value());
+  EXPECT_EQ("hi", *f1);
+  // Peek 不消费
+  EXPECT_EQ("hi", *framer.PeekFrame());
+  framer.ConsumeFrame();
+
+  auto f2 = framer.PeekFrame();
+  ASSERT_TRUE(f2.has_value());
+  EXPECT_EQ("abc", *f2);
+  framer.ConsumeFrame();
+
+  EXPECT_FALSE(framer.PeekFrame().has_value());
+  EXPECT_EQ(0u, framer.BufferedBytes());
+}
+
+TEST(LengthPrefixedFramerTest, ReadDirectlyIntoBuffer) {
+  LengthPrefixedFramer framer;
+
+  const uint8_t data[] = {0x00, 0x00, 0x00, 0x04, 'p', 'i', 'n', 'g'};
+  auto dst = framer.PrepareWrite(sizeof(data));
+  ASSERT_GE(dst.size(), sizeof(data));
+  std::copy(std::begin(data), std::end(data), dst.begin());
+  framer.CommitWrite(sizeof(data));
+
+  auto frame = framer.PeekFrame();
+  ASSERT_TRUE(frame.has_value());
+  EXPECT_EQ("ping", *frame);
+}
+
+// InputBuffer 测试
+TEST(InputBufferTest, CompactsInsteadOfGrowing) {
+  InputBuffer buf(16);
+  const uint8_t data[12] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+  buf.Append(data, sizeof(data));
+  buf.Consume(10);
+  EXPECT_EQ(2u, buf.ReadableBytes());
+
+  // 尾部只剩 4 字节，回收已消费前缀即可容纳 8 字节
+  auto dst = buf.PrepareWrite(8);
+  EXPECT_GE(dst.size(), 8u);
+  EXPECT_EQ(16u, buf.Capacity());
+  EXPECT_EQ(11, buf.ReadPtr()[0]);
+  EXPECT_EQ(12, buf.ReadPtr()[1]);
+}
+
+TEST(InputBufferTest, GrowsWhenFull) {
+  InputBuffer buf(4);
+  const uint8_t data[10] = {0};
+  buf.Append(data, sizeof(data));
+  EXPECT_EQ(10u, buf.ReadableBytes());
+  EXPECT_GE(buf.Capacity(), 10u);
+
+  buf.Consume(10);
+  EXPECT_EQ(0u, buf.ReadableBytes());
+}
+
+// IoContextPool 测试
+TEST(IoContextPoolTest, SingleThreadUsesMainContext) {
+  asio::io_context io;
+  IoContextPool pool(io, 1);
+  EXPECT_EQ(1u, pool.Size());
+  EXPECT_EQ(&io, &pool.GetNextIoContext());
+  EXPECT_EQ(&io, &pool.GetNextIoContext());
+}
+
+TEST(IoContextPoolTest, RoundRobinAcrossContexts) {
+  asio::io_context io;
+  IoContextPool pool(io, 4);
+  EXPECT_EQ(4u, pool.Size());
+
+  std::set<asio::io_context*> seen;
+  for (size_t i = 0; i < pool.Size(); ++i) {
+    seen.insert(&pool.GetNextIoContext());
+  }
+  EXPECT_EQ(4u, seen.size());
+  EXPECT_EQ(1u, seen.count(&io));
+}
+
+TEST(IoContextPoolTest, WorkersRunOnTheirOwnThreads) {
+  asio::io_context io;
+  IoContextPool pool(io, 3);
+  pool.Start();
+
+  pool.GetNextIoContext(); // skip main context
+  std::atomic<int> done{0};
+  std::thread::id worker_ids[2];
+  for (int i = 0; i < 2; ++i) {
+    asio::post(pool.GetNextIoContext(), [&, i] {
+      worker_ids[i] = std::this_thread::get_id();
+      done.fetch_add(1);
+    });
+  }
+  while (done.load() < 2) {
+    std::this_thread::yield();
+  }
+  pool.Stop();
+
+  EXPECT_NE(std::this_thread::get_id(), worker_ids[0]);
+  EXPECT_NE(std::this_thread::get_id(), worker_ids[1]);
+  EXPECT_NE(worker_ids[0], worker_ids[1]);
+}
+
+// TcpSession 写合并测试
+TEST(TcpSessionTest, CoalescesQueuedFramesIntoOneWrite) {
+  asio::io_context io;
+  asio::ip::tcp::acceptor acceptor(io, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+  asio::ip::tcp::socket client(io);
+  client.connect(acceptor.local_endpoint());
+  auto session = std::make_shared<TcpSession>(acceptor.accept(), nullptr);
+
+  auto& stats = NetworkStats::Instance();
+  const uint64_t calls_before = stats.write_calls.load();
+  const uint64_t frames_before = stats.frames_written.load();
+
+  constexpr int kFrames = 100;
+  std::string expected;
+  for (int i = 0; i < kFrames; ++i) {
+    std::string frame = "frame-" + std::to_string(i) + ";";
+    expected += frame;
+    session->Send(std::move(frame));
+  }
+  io.run();
+
+  std::string received(expected.size(), '\0');
+  asio::read(client, asio::buffer(received));
+  EXPECT_EQ(expected, received);
+
+  EXPECT_EQ(static_cast<uint64_t>(kFrames), stats.frames_written.load() - frames_before);
+  EXPECT_LT(stats.write_calls.load() - calls_before, static_cast<uint64_t>(kFrames));
+}
+
+// 时间轮测试
+std::string LengthPrefixedPing() { return std::string("\0\0\0\x04ping", 8); }
+
+TEST(TimingWheelTest, FiresEachTimerOnItsTickAcrossLevels) {
+  TimingWheel wheel;
+  wheel.AdvanceTo(100); // 从非对齐位置开始，覆盖级联边界
+  const uint64_t base = wheel.Now();
+
+  std::vector<uint64_t> delays = {1, 2, 63, 64, 65, 200, 4095, 4096, 4097, 70000, 300000};
+  std::vector<uint64_t> fired_at(delays.size(), 0);
+  for (size_t i = 0; i < delays.size(); ++i) {
+    wheel.Schedule(delays[i], [&wheel, &fired_at, i] { fired_at[i] = wheel.Now(); });
+  }
+  EXPECT_EQ(delays.size(), wheel.Size());
+
+  for (uint64_t t = base; t <= base + 300000; ++t) {
+    wheel.AdvanceTo(t);
+  }
+  for (size_t i = 0; i < delays.size(); ++i) {
+    EXPECT_EQ(base + delays[i], fired_at[i]) << "delay " << delays[i];
+  }
+  EXPECT_EQ(0u, wheel.Size());
+}
+
+TEST(TimingWheelTest, CancelAndRescheduleFromCallback) {
+  TimingWheel wheel;
+  int fired = 0;
+  const auto cancelled = wheel.Schedule(10, [&] { ++fired; });
+  TimingWheel::TimerId same_tick = 0;
+  wheel.Schedule(5, [&] {
+    ++fired;
+    EXPECT_TRUE(wheel.Cancel(same_tick)); // 同一 tick 内的定时器也能取消
+    wheel.Schedule(5, [&] { fired += 100; });
+  });
+  same_tick = wheel.Schedule(5, [&] { fired += 1000; });
+
+  EXPECT_TRUE(wheel.Cancel(cancelled));
+  EXPECT_FALSE(wheel.Cancel(cancelled));
+  EXPECT_EQ(1u, wheel.AdvanceTo(5) + wheel.AdvanceTo(9));
+  EXPECT_EQ(1, fired);
+  EXPECT_EQ(1u, wheel.AdvanceTo(10));
+  EXPECT_EQ(101, fired);
+  EXPECT_EQ(0u, wheel.Size());
+}
+
+TEST(TcpSessionTest, IdleTimeoutClosesSilentSessionsOnly) {
+  asio::io_context io;
+  asio::use_service<IoTimingWheel>(io).SetTickInterval(std::chrono::milliseconds(5));
+  asio::ip::tcp::acceptor acceptor(io, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+  asio::ip::tcp::socket client(io);
+  client.connect(acceptor.local_endpoint());
+  auto session = std::make_shared<TcpSession>(acceptor.accept(), nullptr);
+  session->SetIdleTimeout(std::chrono::milliseconds(60));
+  const uint64_t timeouts = NetworkStats::Instance().idle_timeouts.load();
+  session->Start();
+
+  // 持续有数据（心跳）时不会被关闭
+  for (int i = 0; i < 6; ++i) {
+    asio::write(client, asio::buffer(LengthPrefixedPing()));
+    io.run_for(std::chrono::milliseconds(25));
+    io.restart();
+  }
+  EXPECT_FALSE(session->IsClosed());
+
+  io.run_for(std::chrono::milliseconds(150));
+  EXPECT_TRUE(session->IsClosed());
+  EXPECT_EQ(timeouts + 1, NetworkStats::Instance().idle_timeouts.load());
+  EXPECT_EQ(0u, asio::use_service<IoTimingWheel>(io).Size());
+}
+
+// SharedFrame / BroadcastPacket 测试
+class RecordingSession : public Session {
+public:
+  void Send(std::string bytes) override { copies.push_back(std::move(bytes)); }
+  void Send(SharedFrame frame) override { frames.push_back(std::move(frame)); }
+  void SendAndClose(std::string bytes) override { Send(std::move(bytes)); }
+  void Close() override {}
+  bool IsClosed() const override { return false; }
+
+  std::vector<std::string> copies;
+  std::vector<SharedFrame> frames;
+};
+
+TEST(SharedFrameTest, WebSocketHeaderMatchesBuiltFrame) {
+  for (size_t len : {0u, 125u, 126u, 70000u}) {
+    const std::string payload(len, 'x');
+    SharedFrame frame(payload);
+    EXPECT_EQ(payload, frame.Bytes());
+
+    const std::string built = BuildWebSocketFrame(/*opcode=*/0x2, payload, /*mask=*/false);
+    EXPECT_EQ(built, std::string(frame.WebSocketHeader()) + std::string(frame.Bytes()));
+  }
+}
+
+TEST(SharedFrameTest, BroadcastEncodesOnce) {
+  auto a = std::make_shared<RecordingSession>();
+  auto b = std::make_shared<RecordingSession>();
+  std::vector<std::shared_ptr<Session>> sessions{a, nullptr, b};
+
+  BroadcastPacket(sessions, gateway::HEARTBEAT_PONG, "body");
+
+  ASSERT_EQ(1u, a->frames.size());
+  ASSERT_EQ(1u, b->frames.size());
+  EXPECT_TRUE(a->copies.empty());
+  // 两个会话共享同一份编码结果
+  EXPECT_EQ(a->frames[0].Bytes().data(), b->frames[0].Bytes().data());
+
+  LengthPrefixedFramer framer;
+  framer.Append(reinterpret_cast<const uint8_t*>(a->frames[0].Bytes().data()), a->frames[0].size());
+  auto payload = framer.PeekFrame();
+  ASSERT_TRUE(payload.has_value());
+  gateway::Packet pkt;
+  ASSERT_TRUE(ProtobufFraming::Decode(*payload, &pkt));
+  EXPECT_EQ(gateway::HEARTBEAT_PONG, pkt.msg_id());
+  EXPECT_EQ("body", pkt.body());
+}
+
+// WebSocket 掩码测试
+TEST(WebSocketFrameTest, MaskMatchesScalarReference) {
+  const uint8_t key[4] = {0xA1, 0xB2, 0xC3, 0xD4};
+  for (size_t len : {0u, 1u, 3u, 7u, 8u, 15u, 16u, 31u, 32u, 33u, 100u, 4099u}) {
+    for (size_t offset = 0; offset < 4; ++offset) {
+      std::vector<uint8_t> src(len);
+      for (size_t i = 0; i < len; ++i) {
+        src[i] = static_cast<uint8_t>(i * 7 + 1);
+      }
+      std::vector<uint8_t> expected(len);
+      for (size_t i = 0; i < len; ++i) {
+        expected[i] = static_cast<uint8_t>(src[i] ^ key[(offset + i) % 4]);
+      }
+
+      std::vector<uint8_t> out(len);
+      ApplyWebSocketMask(src.data(), out.data(), len, key, offset);
+      EXPECT_EQ(expected, out) << "len=" << len << " offset=" << offset;
+
+      ApplyWebSocketMask(src.data(), src.data(), len, key, offset); // 原地
+      EXPECT_EQ(expected, src) << "len=" << len << " offset=" << offset;
+    }
+  }
+}
+
+TEST(WebSocketFrameTest, MaskedFrameRoundTrip) {
+  for (size_t len : {0u, 5u, 126u, 70000u}) {
+    std::string payload(len, '\0');
+    for (size_t i = 0; i < len; ++i) {
+      payload[i] = static_cast<char>(i);
+    }
+    const std::string wire = BuildWebSocketFrame(/*opcode=*/0x2, payload, /*mask=*/true);
+
+    WebSocketFrameParser parser;
+    parser.Append(reinterpret_cast<const uint8_t*>(wire.data()), wire.size());
+    auto frame = parser.PopFrame();
+    ASSERT_TRUE(frame.has_value());
+    EXPECT_EQ(0x2, frame->opcode);
+    EXPECT_EQ(payload, frame->payload);
+  }
+}
+
+// HTTP 升级请求解析测试
+TEST(WebSocketHandshakeTest, ParsesUpgradeRequestInPlace) {
+  const std::string head =
+      "GET /ws?room=1 HTTP/1.1\r\nHost: chirp\r\nupgrade: WebSocket\r\nConnection: keep-alive, Upgrade\r\n"
+      "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n"
+      "Sec-WebSocket-Extensions: permessage-deflate\r\n\r\n";
+  HttpUpgradeRequest req;
+  ASSERT_EQ(HttpUpgradeError::kNone, ParseHttpUpgradeRequest(head, &req));
+  EXPECT_EQ("/ws?room=1", req.target);
+  EXPECT_EQ("dGhlIHNhbXBsZSBub25jZQ==", req.ws_key);
+  EXPECT_EQ("permessage-deflate", req.ws_extensions);
+  // 视图直接指向原始缓冲区
+  EXPECT_GE(req.ws_key.data(), head.data());
+  EXPECT_LT(req.ws_key.data(), head.data() + head.size());
+
+  EXPECT_EQ("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+            "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n",
+            BuildWebSocketUpgradeResponse(req.ws_key, ""));
+  EXPECT_EQ("s3pPLMBiTxaQ9kYGzzhZRbK+xOo=", ComputeWebSocketAccept(std::string("dGhlIHNhbXBsZSBub25jZQ==")));
+}
+
+TEST(WebSocketHandshakeTest, RejectsInvalidUpgradeRequests) {
+  const std::string ok_headers =
+      "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n";
+  HttpUpgradeRequest req;
+  EXPECT_EQ(HttpUpgradeError::kMalformed,
+            ParseHttpUpgradeRequest("POST / HTTP/1.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n" +
+                                        ok_headers + "\r\n",
+                                    &req));
+  EXPECT_EQ(HttpUpgradeError::kMalformed,
+            ParseHttpUpgradeRequest("GET / HTTP/1.1\r\nUpgrade: websocket\r\n folded\r\n\r\n", &req));
+  EXPECT_EQ(HttpUpgradeError::kNotUpgrade,
+            ParseHttpUpgradeRequest("GET / HTTP/1.1\r\nUpgrade: h2c\r\nConnection: Upgrade\r\n" + ok_headers +
+                                        "\r\n",
+                                    &req));
+  EXPECT_EQ(HttpUpgradeError::kNotUpgrade,
+            ParseHttpUpgradeRequest("GET / HTTP/1.1\r\nUpgrade: websocket\r\n" + ok_headers + "\r\n", &req));
+  EXPECT_EQ(HttpUpgradeError::kBadVersion,
+            ParseHttpUpgradeRequest("GET / HTTP/1.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                                    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 8\r\n\r\n",
+                                    &req));
+  EXPECT_EQ(HttpUpgradeError::kBadKey,
+            ParseHttpUpgradeRequest("GET / HTTP/1.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                                    "Sec-WebSocket-Key: short\r\nSec-WebSocket-Version: 13\r\n\r\n",
+                                    &req));
+}
+
+// WebSocketSession 分片重组测试
+std::string BuildFragment(uint8_t opcode, bool fin, std::string_view payload) {
+  std::string wire = BuildWebSocketFrame(opcode, payload, /*mask=*/true);
+  if (!fin) {
+    wire[0] = static_cast<char>(wire[0] & 0x7F);
+  }
+  return wire;
+}
+
+std::string LengthPrefixed(std::string_view payload) {
+  std::string out(4, '\0');
+  const auto n = static_cast<uint32_t>(payload.size());
+  out[0] = static_cast<char>(n >> 24);
+  out[1] = static_cast<char>(n >> 16);
+  out[2] = static_cast<char>(n >> 8);
+  out[3] = static_cast<char>(n);
+  out.append(payload);
+  return out;
+}
+
+class WebSocketSessionTest : public ::testing::Test {
+protected:
+  void Connect(size_t max_message_bytes = WebSocketSession::kDefaultMaxMessageBytes,
+               const PerMessageDeflateConfig& deflate = {}, const std::string& extensions = "") {
+    asio::ip::tcp::acceptor acceptor(io_, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    client_.connect(acceptor.local_endpoint());
+    session_ = std::make_shared<WebSocketSession>(
+        acceptor.accept(), [this](std::shared_ptr<Session>, std::string_view payload) {
+          received_.emplace_back(payload);
+        });
+    session_->SetMaxMessageSize(max_message_bytes);
+    session_->SetPerMessageDeflate(deflate);
+    session_->Start();
+
+    std::string request =
+        "GET / HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n";
+    if (!extensions.empty()) {
+      request += "Sec-WebSocket-Extensions: " + extensions + "\r\n";
+    }
+    request += "\r\n";
+    asio::write(client_, asio::buffer(request));
+  }
+
+  void ClientWrite(const std::string& bytes) {
+    asio::write(client_, asio::buffer(bytes));
+    io_.run_for(std::chrono::milliseconds(50));
+    io_.restart();
+  }
+
+  // Reads everything the server sent after the 101 response (kept in response_head_).
+  std::string ServerFrames() {
+    std::string all;
+    char buf[4096];
+    asio::error_code ec;
+    while (client_.available(ec) > 0) {
+      all.append(buf, client_.read_some(asio::buffer(buf), ec));
+    }
+    const size_t end = all.find("\r\n\r\n");
+    if (end == std::string::npos) {
+      return all;
+    }
+    response_head_ = all.substr(0, end + 4);
+    return all.substr(end + 4);
+  }
+
+  asio::io_context io_;
+  asio::ip::tcp::socket client_{io_};
+  std::shared_ptr<WebSocketSession> session_;
+  std::vector<std::string> received_;
+  std::string response_head_;
+};
+
+TEST_F(WebSocketSessionTest, ReassemblesContinuationFrames) {
+  Connect();
+  const std::string packet = LengthPrefixed(std::string(300, 'p'));
+
+  // 首帧 + 插入的 ping + 两个续帧，且分片边界不与长度前缀对齐
+  ClientWrite(BuildFragment(0x2, false, std::string_view(packet).substr(0, 3)) +
+              BuildFragment(0x9, true, "hi") +
+              BuildFragment(0x0, false, std::string_view(packet).substr(3, 150)));
+  EXPECT_TRUE(received_.empty());
+  ClientWrite(BuildFragment(0x0, true, std::string_view(packet).substr(153)));
+
+  ASSERT_EQ(1u, received_.size());
+  EXPECT_EQ(std::string(300, 'p'), received_[0]);
+  EXPECT_EQ(BuildWebSocketFrame(0xA, "hi", false), ServerFrames());
+  EXPECT_FALSE(session_->IsClosed());
+}
+
+TEST_F(WebSocketSessionTest, ContinuationWithoutFirstFrameIsProtocolError) {
+  Connect();
+  ClientWrite(BuildFragment(0x0, true, LengthPrefixed("x")));
+
+  EXPECT_TRUE(received_.empty());
+  EXPECT_EQ(BuildWebSocketFrame(0x8, std::string("\x03\xea", 2), false), ServerFrames()); // 1002
+  EXPECT_TRUE(session_->IsClosed());
+}
+
+TEST_F(WebSocketSessionTest, UnmaskedClientFrameIsProtocolError) {
+  Connect();
+  ClientWrite(BuildWebSocketFrame(0x2, LengthPrefixed("x"), /*mask=*/false));
+
+  EXPECT_TRUE(received_.empty());
+  EXPECT_EQ(BuildWebSocketFrame(0x8, std::string("\x03\xea", 2), false), ServerFrames()); // 1002
+  EXPECT_TRUE(session_->IsClosed());
+}
+
+TEST(WebSocketClientSessionTest, MaskedServerFrameIsProtocolError) {
+  asio::io_context io;
+  asio::ip::tcp::acceptor acceptor(io, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+  asio::ip::tcp::socket server(io);
+  asio::ip::tcp::socket client_socket(io);
+  client_socket.connect(acceptor.local_endpoint());
+  acceptor.accept(server);
+  std::vector<std::string> received;
+  auto client = std::make_shared<WebSocketSession>(
+      std::move(client_socket),
+      [&](std::shared_ptr<Session>, std::string_view payload) { received.emplace_back(payload); });
+  client->StartClient("", std::nullopt);
+  asio::write(server, asio::buffer(BuildWebSocketFrame(0x2, LengthPrefixed("x"), /*mask=*/true)));
+  io.run_for(std::chrono::milliseconds(50));
+
+  // 客户端回复的关闭帧带掩码，解析后比较状态码
+  WebSocketFrameParser parser;
+  std::array<uint8_t, 256> buf{};
+  asio::error_code ec;
+  while (server.available(ec) > 0) {
+    parser.Append(buf.data(), server.read_some(asio::buffer(buf), ec));
+  }
+  auto close = parser.PopFrame();
+  ASSERT_TRUE(close.has_value());
+  EXPECT_EQ(0x8, close->opcode);
+  EXPECT_EQ(std::string("\x03\xea", 2), close->payload); // 1002
+  EXPECT_TRUE(received.empty());
+  EXPECT_TRUE(client->IsClosed());
+}
+
+TEST_F(WebSocketSessionTest, RejectsOversizedReassembledMessage) {
+  Connect(/*max_message_bytes=*/64);
+  ClientWrite(BuildFragment(0x2, false, std::string(40, 'a')) + BuildFragment(0x0, true, std::string(40, 'b')));
+
+  EXPECT_TRUE(received_.empty());
+  EXPECT_EQ(BuildWebSocketFrame(0x8, std::string("\x03\xf1", 2), false), ServerFrames()); // 1009
+  EXPECT_TRUE(session_->IsClosed());
+}
+
+TEST_F(WebSocketSessionTest, CompressedFrameWithoutNegotiationIsProtocolError) {
+  Connect();
+  std::string wire = BuildFragment(0x2, true, LengthPrefixed("x"));
+  wire[0] = static_cast<char>(wire[0] | 0x40);
+  ClientWrite(wire);
+
+  EXPECT_TRUE(received_.empty());
+  EXPECT_EQ(BuildWebSocketFrame(0x8, std::string("\x03\xea", 2), false), ServerFrames()); // 1002
+}
+
+TEST_F(WebSocketSessionTest, PerMessageDeflateEndToEnd) {
+  if (!PerMessageDeflateAvailable()) {
+    GTEST_SKIP() << "built without zlib";
+  }
+  PerMessageDeflateConfig config;
+  config.enabled = true;
+  config.min_message_bytes = 64;
+  Connect(WebSocketSession::kDefaultMaxMessageBytes, config, "permessage-deflate; client_max_window_bits");
+
+  // 客户端发送压缩消息（RSV1），服务端解压后按长度前缀分包
+  const auto params = ParsePerMessageDeflateResponse("permessage-deflate");
+  ASSERT_TRUE(params.has_value());
+  PerMessageDeflate client(*params, /*is_server=*/false, config);
+  const std::string packet = LengthPrefixed(std::string(2000, 'c'));
+  std::string compressed;
+  ASSERT_TRUE(client.Compress(packet, &compressed));
+  std::string wire = BuildFragment(0x2, true, compressed);
+  wire[0] = static_cast<char>(wire[0] | 0x40);
+  ClientWrite(wire);
+
+  ASSERT_EQ(1u, received_.size());
+  EXPECT_EQ(std::string(2000, 'c'), received_[0]);
+  EXPECT_TRUE(ServerFrames().empty());
+  EXPECT_NE(std::string::npos, response_head_.find("Sec-WebSocket-Extensions: permessage-deflate\r\n"));
+
+  // 服务端发送的大消息被压缩，小消息保持原样
+  const std::string reply = LengthPrefixed(std::string(4000, 'r'));
+  session_->Send(reply);
+  session_->Send(std::string("tiny"));
+  io_.run_for(std::chrono::milliseconds(50));
+  io_.restart();
+
+  const std::string frames = ServerFrames();
+  ASSERT_FALSE(frames.empty());
+  EXPECT_EQ(0xC2, static_cast<uint8_t>(frames[0])); // FIN | RSV1 | binary
+  WebSocketFrameParser parser;
+  parser.Append(reinterpret_cast<const uint8_t*>(frames.data()), frames.size());
+  auto first = parser.PopFrame();
+  ASSERT_TRUE(first.has_value());
+  EXPECT_LT(first->payload.size(), reply.size());
+  InputBuffer inflated;
+  ASSERT_EQ(PerMessageDeflate::InflateResult::kOk,
+            client.Decompress(reinterpret_cast<const uint8_t*>(first->payload.data()), first->payload.size(),
+                              /*last=*/true, &inflated, reply.size()));
+  EXPECT_EQ(reply, inflated.Readable());
+  auto second = parser.PopFrame();
+  ASSERT_TRUE(second.has_value());
+  EXPECT_EQ("tiny", second->payload);
+}
+
+TEST(WebSocketSessionHandshakeTest, RejectsOversizedAndInvalidUpgrades) {
+  auto run = [](const std::string& request) {
+    asio::io_context io;
+    asio::ip::tcp::acceptor acceptor(io, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    asio::ip::tcp::socket client(io);
+    client.connect(acceptor.local_endpoint());
+    auto session = std::make_shared<WebSocketSession>(acceptor.accept(), nullptr);
+    session->SetMaxHandshakeSize(1024);
+    session->Start();
+    asio::write(client, asio::buffer(request));
+    io.run_for(std::chrono::milliseconds(50));
+
+    std::string response;
+    char buf[1024];
+    asio::error_code ec;
+    while (client.available(ec) > 0) {
+      response.append(buf, client.read_some(asio::buffer(buf), ec));
+    }
+    EXPECT_TRUE(session->IsClosed());
+    return response.substr(0, response.find("\r\n"));
+  };
+
+  // 超长请求头在找到结尾之前就被拒绝
+  EXPECT_EQ("HTTP/1.1 431 Request Header Fields Too Large",
+            run("GET / HTTP/1.1\r\nX-Pad: " + std::string(2000, 'a')));
+  EXPECT_EQ("HTTP/1.1 426 Upgrade Required",
+            run("GET / HTTP/1.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 7\r\n\r\n"));
+  EXPECT_EQ("HTTP/1.1 400 Bad Request", run("GET / HTTP/1.1\r\nHost: x\r\n\r\n"));
+}
+
+TEST(WebSocketSessionHandshakeTest, ClosesClientsThatNeverFinishTheHandshake) {
+  asio::io_context io;
+  asio::ip::tcp::acceptor acceptor(io, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+  asio::ip::tcp::socket client(io);
+  client.connect(acceptor.local_endpoint());
+  asio::use_service<IoTimingWheel>(io).SetTickInterval(std::chrono::milliseconds(5));
+  auto session = std::make_shared<WebSocketSession>(acceptor.accept(), nullptr);
+  session->SetHandshakeTimeout(std::chrono::milliseconds(20));
+  const uint64_t timeouts = NetworkStats::Instance().ws_handshake_timeouts.load();
+  session->Start();
+  asio::write(client, asio::buffer(std::string("GET / HTTP/1.1\r\n")));
+
+  io.run_for(std::chrono::milliseconds(100));
+  EXPECT_TRUE(session->IsClosed());
+  EXPECT_EQ(timeouts + 1, NetworkStats::Instance().ws_handshake_timeouts.load());
+}
+
+TEST(WebSocketClientTest, GivesUpOnOversizedHandshakeResponse) {
+  asio::io_context server_io;
+  asio::ip::tcp::acceptor acceptor(server_io, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+  std::promise<void> client_done;
+  std::atomic<bool> server_gave_up{false};
+  std::thread server([&] {
+    asio::ip::tcp::socket peer = acceptor.accept();
+    char buf[1024];
+    asio::error_code ec;
+    peer.read_some(asio::buffer(buf), ec);
+    // 响应头没有结尾：客户端读到上限即放弃，而不是一直读下去
+    asio::write(peer, asio::buffer("HTTP/1.1 101 Switching Protocols\r\nX-Pad: " + std::string(16 * 1024, 'a')), ec);
+    if (client_done.get_future().wait_for(std::chrono::seconds(5)) != std::future_status::ready) {
+      server_gave_up.store(true);
+    }
+  });
+
+  asio::io_context io;
+  WebSocketClient client(io);
+  EXPECT_FALSE(client.Connect("127.0.0.1", acceptor.local_endpoint().port()));
+  client_done.set_value();
+  server.join();
+  EXPECT_FALSE(server_gave_up.load());
+}
+
+// permessage-deflate 协商与压缩测试
+TEST(PerMessageDeflateTest, NegotiatesFirstAcceptableOffer) {
+  if (!PerMessageDeflateAvailable()) {
+    GTEST_SKIP() << "built without zlib";
+  }
+  PerMessageDeflateConfig config;
+  config.enabled = true;
+
+  // 未知扩展、非法窗口、未知参数都跳过
+  const auto params = NegotiatePerMessageDeflate(
+      "x-webkit-deflate-frame, permessage-deflate; server_max_window_bits=8, permessage-deflate; foo, "
+      "permessage-deflate; client_max_window_bits; server_no_context_takeover",
+      config);
+  ASSERT_TRUE(params.has_value());
+  EXPECT_TRUE(params->server_no_context_takeover);
+  EXPECT_FALSE(params->client_no_context_takeover);
+  EXPECT_EQ("permessage-deflate; server_no_context_takeover", FormatPerMessageDeflateResponse(*params));
+
+  config.context_takeover = false;
+  const auto no_takeover = NegotiatePerMessageDeflate("permessage-deflate", config);
+  ASSERT_TRUE(no_takeover.has_value());
+  EXPECT_EQ("permessage-deflate; server_no_context_takeover; client_no_context_takeover",
+            FormatPerMessageDeflateResponse(*no_takeover));
+
+  config.enabled = false;
+  EXPECT_FALSE(NegotiatePerMessageDeflate("permessage-deflate", config).has_value());
+
+  EXPECT_TRUE(ParsePerMessageDeflateResponse("permessage-deflate; server_max_window_bits=10").has_value());
+  EXPECT_FALSE(ParsePerMessageDeflateResponse("permessage-deflate; client_max_window_bits").has_value());
+  EXPECT_FALSE(ParsePerMessageDeflateResponse("permessage-deflate; server_no_context_takeover; "
+                                              "server_no_context_takeover")
+                   .has_value());
+}
+
+TEST(PerMessageDeflateTest, RoundTripWithAndWithoutContextTakeover) {
+  if (!PerMessageDeflateAvailable()) {
+    GTEST_SKIP() << "built without zlib";
+  }
+  const std::string message = "{\"type\":\"presence\",\"user\":\"alice\",\"status\":\"online\"}";
+
+  for (bool takeover : {true, false}) {
+    PerMessageDeflateConfig config;
+    config.enabled = true;
+    config.context_takeover = takeover;
+    const auto params = NegotiatePerMessageDeflate("permessage-deflate", config);
+    ASSERT_TRUE(params.has_value());
+    PerMessageDeflate server(*params, /*is_server=*/true, config);
+    PerMessageDeflate client(*params, /*is_server=*/false, config);
+    EXPECT_EQ(takeover, server.KeepsContext());
+
+    std::vector<size_t> sizes;
+    for (int i = 0; i < 3; ++i) {
+      std::string compressed;
+      ASSERT_TRUE(server.Compress(message, &compressed));
+      sizes.push_back(compressed.size());
+
+      // 分两段喂给解压器
+      InputBuffer out;
+      const auto* data = reinterpret_cast<const uint8_t*>(compressed.data());
+      const size_t half = compressed.size() / 2;
+      ASSERT_EQ(PerMessageDeflate::InflateResult::kOk, client.Decompress(data, half, false, &out, 1024));
+      ASSERT_EQ(PerMessageDeflate::InflateResult::kOk,
+                client.Decompress(data + half, compressed.size() - half, true, &out, 1024));
+      EXPECT_EQ(message, out.Readable());
+    }
+    // 保留上下文时重复消息几乎只剩一个回溯引用
+    if (takeover) {
+      EXPECT_LT(sizes[1], sizes[0]);
+    } else {
+      EXPECT_EQ(sizes[1], sizes[0]);
+    }
+  }
+
+  PerMessageDeflateParams params;
+  PerMessageDeflateConfig config;
+  PerMessageDeflate server(params, true, config);
+  PerMessageDeflate client(params, false, config);
+  std::string compressed;
+  ASSERT_TRUE(server.Compress(std::string(10000, 'z'), &compressed));
+  InputBuffer out;
+  EXPECT_EQ(PerMessageDeflate::InflateResult::kTooLarge,
+            client.Decompress(reinterpret_cast<const uint8_t*>(compressed.data()), compressed.size(), true, &out,
+                              1000));
+}
+
+// WriteQueue 背压测试
+WriteQueueLimits SmallLimits() {
+  WriteQueueLimits limits;
+  limits.high_watermark_bytes = 100;
+  limits.low_watermark_bytes = 40;
+  return limits;
+}
+
+TEST(WriteQueueTest, ShedsOldestDroppableFramesDownToLowWatermark) {
+  WriteQueue q;
+  q.SetLimits(SmallLimits());
+  EXPECT_EQ(WriteQueue::PushResult::kQueued, q.Push(SharedFrame(std::string(30, 'a')), /*droppable=*/true));
+  EXPECT_EQ(WriteQueue::PushResult::kQueued, q.Push(SharedFrame(std::string(30, 'b')), /*droppable=*/true));
+  EXPECT_EQ(WriteQueue::PushResult::kQueued, q.Push(SharedFrame(std::string(30, 'c')), /*droppable=*/false));
+  EXPECT_EQ(90u, q.QueuedBytes());
+
+  // 超过高水位：丢弃最旧的可丢弃帧直到不高于低水位
+  EXPECT_EQ(WriteQueue::PushResult::kQueued, q.Push(SharedFrame(std::string(30, 'd')), /*droppable=*/false));
+  EXPECT_EQ(60u, q.QueuedBytes());
+
+  std::vector<asio::const_buffer> batch;
+  q.GatherBatch(batch, 64, 1024);
+  ASSERT_EQ(2u, batch.size());
+  EXPECT_EQ('c', *static_cast<const char*>(batch[0].data()));
+  EXPECT_EQ('d', *static_cast<const char*>(batch[1].data()));
+}
+
+TEST(WriteQueueTest, ReliableOverflowAsksForDisconnect) {
+  WriteQueue q;
+  q.SetLimits(SmallLimits());
+  EXPECT_EQ(WriteQueue::PushResult::kQueued, q.Push(SharedFrame(std::string(80, 'a')), false));
+  EXPECT_EQ(WriteQueue::PushResult::kDropped, q.Push(SharedFrame(std::string(30, 'b')), true));
+  EXPECT_EQ(WriteQueue::PushResult::kOverflow, q.Push(SharedFrame(std::string(30, 'c')), false));
+  EXPECT_EQ(80u, q.QueuedBytes());
+}
+
+TEST(WriteQueueTest, NeverShedsTheBatchInFlight) {
+  WriteQueue q;
+  q.SetLimits(SmallLimits());
+  q.Push(SharedFrame(std::string(60, 'a')), true);
+  std::vector<asio::const_buffer> batch;
+  q.GatherBatch(batch, 64, 1024);
+  ASSERT_EQ(1u, batch.size());
+
+  q.Push(SharedFrame(std::string(30, 'b')), true);
+  EXPECT_EQ(WriteQueue::PushResult::kQueued, q.Push(SharedFrame(std::string(30, 'c')), false));
+  EXPECT_EQ(90u, q.QueuedBytes());
+  EXPECT_EQ('a', *static_cast<const char*>(batch[0].data()));
+
+  q.PopBatch();
+  EXPECT_EQ(30u, q.QueuedBytes());
+}
+
+TEST(WriteQueueTest, ProcessGaugeTracksQueuedBytes) {
+  auto& stats = NetworkStats::Instance();
+  const uint64_t before = stats.queued_bytes.load();
+  {
+    WriteQueue q;
+    q.Push(SharedFrame(std::string(10, 'a')), false, /*ws_header=*/true);
+    EXPECT_EQ(12u, q.QueuedBytes()); // 2 字节 WebSocket 帧头 + 10 字节负载
+    EXPECT_EQ(before + 12, stats.queued_bytes.load());
+  }
+  EXPECT_EQ(before, stats.queued_bytes.load());
+}
+
+// Redis 客户端测试：进程内的假 RESP 服务端（只实现测试用到的命令）
+class FakeRedisServer {
+public:
+  FakeRedisServer() : acceptor_(io_, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0)) {
+    DoAccept();
+    th_ = std::thread([this] { io_.run(); });
+  }
+  ~FakeRedisServer() {
+    io_.stop();
+    th_.join();
+  }
+
+  uint16_t Port() const { return acceptor_.local_endpoint().port(); }
+  int Connections() const { return connections_.load(); }
+  // 单次 read 中解析出的最多命令数（>1 说明客户端做了流水线）
+  size_t MaxCommandsPerRead() const { return max_per_read_.load(); }
+  int ScriptLoads() const { return script_loads_.load(); }
+  // 收到的 (P)SUBSCRIBE 命令数，以及当前所有连接订阅的频道总数
+  int SubscribeCommands() const { return subscribe_commands_.load(); }
+  size_t SubscribedChannels() const { return subscribed_channels_.load(); }
+  int Publishes() const { return publishes_.load(); }
+  // XACK 确认的条目总数
+  size_t StreamAcks() const { return stream_acks_.load(); }
+  // 集群模式：槽位表为 {起始槽, 结束槽, 端口}，不属于本节点的键回复 MOVED；
+  // ask_slot 的键回复 ASK 指向 ask_port（迁移中），目标节点凭 ASKING 接受
+  void SetCluster(std::vector<std::array<uint16_t, 3>> slots, int ask_slot = -1, uint16_t ask_port = 0) {
+    std::promise<void> done;
+    asio::post(io_, [&] {
+      cluster_ = std::move(slots);
+      ask_slot_ = ask_slot;
+      ask_port_ = ask_port;
+      done.set_value();
+    });
+    done.get_future().wait();
+  }
+  int Redirects() const { return redirects_.load(); }
+  // false：模拟 Redis 6 以前的服务端，HELLO 3 报错
+  void SetResp3(bool enabled) { resp3_.store(enabled); }
+  int Gets() const { return gets_.load(); }
+  int Invalidations() const { return invalidations_.load(); }
+  // 断开所有处于订阅状态的连接（模拟 Redis 重启）
+  void DropSubscribers() {
+    asio::post(io_, [this] {
+      for (auto& weak : subscribers_) {
+        if (auto c = weak.lock()) {
+          asio::error_code ignored;
+          c->socket.close(ignored);
+          subscribed_channels_.fetch_sub(c->channels.size());
+          c->channels.clear();
+          c->patterns.clear();
+        }
+      }
+      subscribers_.clear();
+    });
+  }
+  size_t MaxScanCount() const { return max_scan_count_; }
+  // 以下访问器在服务端线程空闲时（同步调用返回后）使用
+  const std::vector<std::pair<std::string, std::string>>& Published() const { return published_; }
+  std::string Value(const std::string& key) const {
+    auto it = kv_.find(key);
+    return it == kv_.end() ? std::string() : it->second;
+  }
+
+private:
+  struct Conn {
+    explicit Conn(asio::ip::tcp::socket s) : socket(std::move(s)) {}
+    asio::ip::tcp::socket socket;
+    RedisRespParser parser;
+    std::array<uint8_t, 4096> buf{};
+    bool in_multi{false};
+    bool multi_aborted{false};
+    bool asking{false};
+    bool tracking{false};
+    std::vector<std::vector<std::string>> queued;
+    std::set<std::string> channels;
+    std::set<std::string> patterns;
+    std::string outbox;  // 待写出的回复与推送
+    std::string writing;
+    bool write_in_flight{false};
+  };
+
+  void DoAccept() {
+    acceptor_.async_accept([this](std::error_code ec, asio::ip::tcp::socket socket) {
+      if (ec) {
+        return;
+      }
+      connections_.fetch_add(1);
+      DoRead(std::make_shared<Conn>(std::move(socket)));
+      DoAccept();
+    });
+  }
+
+  void DoRead(std::shared_ptr<Conn> c) {
+    c->socket.async_read_some(asio::buffer(c->buf), [this, c](std::error_code ec, std::size_t n) {
+      if (ec) {
+        return;
+      }
+      c->parser.Append(c->buf.data(), n);
+      std::string out;
+      size_t commands = 0;
+      while (auto cmd = c->parser.Pop()) {
+        ++commands;
+        std::vector<std::string> args;
+        for (const auto& a : cmd->array) {
+          args.push_back(a.str);
+        }
+        if (!args.empty() && args[0] == "DROP") {
+          asio::error_code ignored;
+          c->socket.close(ignored); // 模拟服务端断开，未回复的命令全部失败
+          return;
+        }
+        if (!args.empty() && args[0] == "STALL") {
+          stalled_.push_back(c); // 模拟服务端卡死：连接保持打开，此后不再读取也不再回复
+          Send(c, out);
+          return;
+        }
+        out += Dispatch(c, args);
+      }
+      max_per_read_.store(std::max(max_per_read_.load(), commands));
+      Send(c, out);
+      DoRead(c);
+    });
+  }
+
+  // 回复与发布推送可能交错，统一经由每个连接的 outbox 顺序写出
+  void Send(const std::shared_ptr<Conn>& c, const std::string& bytes) {
+    c->outbox += bytes;
+    if (c->write_in_flight || c->outbox.empty()) {
+      return;
+    }
+    c->write_in_flight = true;
+    c->writing.swap(c->outbox);
+    c->outbox.clear();
+    asio::async_write(c->socket, asio::buffer(c->writing), [this, c](std::error_code ec, std::size_t) {
+      c->write_in_flight = false;
+      if (!ec) {
+        Send(c, "");
+      }
+    });
+  }
+
+  std::string PubSub(const std::shared_ptr<Conn>& c, const std::vector<std::string>& args) {
+    const std::string& cmd = args[0];
+    const bool pattern = cmd[0] == 'P';
+    const bool subscribe = cmd.find("UNSUBSCRIBE") == std::string::npos;
+    auto& names = pattern ? c->patterns : c->channels;
+    std::string kind = cmd;
+    std::transform(kind.begin(), kind.end(), kind.begin(), [](char ch) { return static_cast<char>(std::tolower(ch)); });
+    if (subscribe) {
+      subscribe_commands_.fetch_add(1);
+      subscribers_.push_back(c);
+    }
+    std::string out;
+    for (size_t i = 1; i < args.size(); ++i) {
+      const bool changed = subscribe ? names.insert(args[i]).second : names.erase(args[i]) > 0;
+      if (changed && !pattern) {
+        if (subscribe) {
+          subscribed_channels_.fetch_add(1);
+        } else {
+          subscribed_channels_.fetch_sub(1);
+        }
+      }
+      out += "*3\r\n" + Bulk(kind) + Bulk(args[i]) + Int(static_cast<int64_t>(c->channels.size() + c->patterns.size()));
+    }
+    return out;
+  }
+
+  int64_t Publish(const std::string& channel, const std::string& message) {
+    int64_t receivers = 0;
+    std::set<Conn*> seen;
+    for (auto& weak : subscribers_) {
+      auto c = weak.lock();
+      if (!c || !c->socket.is_open() || !seen.insert(c.get()).second) {
+        continue;
+      }
+      if (c->channels.count(channel)) {
+        Send(c, "*3\r\n" + Bulk("message") + Bulk(channel) + Bulk(message));
+        ++receivers;
+      }
+      for (const auto& p : c->patterns) {
+        if (Match(p, channel)) {
+          Send(c, "*4\r\n" + Bulk("pmessage") + Bulk(p) + Bulk(channel) + Bulk(message));
+          ++receivers;
+        }
+      }
+    }
+    return receivers;
+  }
+
+  std::optional<std::string> ClusterRedirect(Conn& c, const std::vector<std::string>& args) {
+    const bool asking = std::exchange(c.asking, false);
+    const auto slot = cluster_.empty() ? std::nullopt : RedisCommandSlot(args);
+    if (!slot) {
+      return std::nullopt;
+    }
+    const std::string where = " " + std::to_string(*slot) + " 127.0.0.1:";
+    if (*slot == ask_slot_ && !asking) {
+      redirects_.fetch_add(1);
+      return "-ASK" + where + std::to_string(ask_port_) + "\r\n";
+    }
+    for (const auto& [first, last, port] : cluster_) {
+      if (*slot >= first && *slot <= last && port != Port() && !asking) {
+        redirects_.fetch_add(1);
+        return "-MOVED" + where + std::to_string(port) + "\r\n";
+      }
+    }
+    return std::nullopt;
+  }
+
+  // MULTI/EXEC：排队的命令在 EXEC 时一次执行；排队阶段出错则整个事务 EXECABORT
+  std::string Dispatch(const std::shared_ptr<Conn>& conn, const std::vector<std::string>& args) {
+    Conn& c = *conn;
+    const std::string cmd = args.empty() ? std::string() : args[0];
+    if (cmd == "SUBSCRIBE" || cmd == "UNSUBSCRIBE" || cmd == "PSUBSCRIBE" || cmd == "PUNSUBSCRIBE") {
+      return PubSub(conn, args);
+    }
+    if (cmd == "ASKING") {
+      c.asking = true;
+      return "+OK\r\n";
+    }
+    if (cmd == "HELLO") {
+      return resp3_.load() ? "%1\r\n" + Bulk("proto") + Int(3) : "-ERR unknown command 'HELLO'\r\n";
+    }
+    if (cmd == "CLIENT" && args.size() == 3 && args[1] == "TRACKING") {
+      c.tracking = args[2] == "ON";
+      trackers_.push_back(conn);
+      return "+OK\r\n";
+    }
+    if (cmd == "CLUSTER" && args.size() == 2 && args[1] == "SLOTS") {
+      std::string out = "*" + std::to_string(cluster_.size()) + "\r\n";
+      for (const auto& [first, last, port] : cluster_) {
+        out += "*3\r\n" + Int(first) + Int(last) + "*3\r\n" + Bulk("127.0.0.1") + Int(port) + Bulk("id");
+      }
+      return out;
+    }
+    if (auto redirect = ClusterRedirect(c, args)) {
+      c.multi_aborted = c.multi_aborted || c.in_multi;
+      return *redirect;
+    }
+    if (cmd == "XREADGROUP") {
+      return XReadGroup(conn, args);
+    }
+    if (cmd == "MULTI") {
+      c.in_multi = true;
+      c.multi_aborted = false;
+      c.queued.clear();
+      return "+OK\r\n";
+    }
+    if (cmd == "EXEC") {
+      c.in_multi = false;
+      if (c.multi_aborted) {
+        return "-EXECABORT Transaction discarded because of previous errors.\r\n";
+      }
+      std::string out = "*" + std::to_string(c.queued.size()) + "\r\n";
+      for (const auto& q : c.queued) {
+        out += Handle(q);
+      }
+      c.queued.clear();
+      return out;
+    }
+    if (c.in_multi) {
+      if (!IsKnown(cmd)) {
+        c.multi_aborted = true;
+        return "-ERR unknown command '" + cmd + "'\r\n";
+      }
+      c.queued.push_back(args);
+      return "+QUEUED\r\n";
+    }
+    return Handle(args);
+  }
+
+  static bool IsKnown(const std::string& cmd) {
+    static const std::set<std::string> known = {"PING", "SET",   "GET",  "INCR", "DEL",  "EXPIRE",
+                                                "RPUSH", "LRANGE", "LTRIM", "SADD", "HSET"};
+    return known.count(cmd) > 0;
+  }
+
+  static std::string Bulk(const std::string& s) { return "$" + std::to_string(s.size()) + "\r\n" + s + "\r\n"; }
+
+  static std::string Int(int64_t v) { return ":" + std::to_string(v) + "\r\n"; }
+
+  // 假服务端不执行 Lua：按脚本内容识别内置脚本并模拟其语义
+  std::string RunScript(const std::string& src, const std::vector<std::string>& keys,
+                        const std::vector<std::string>& argv) {
+    if (src.find("PUBLISH") != std::string::npos) { // claim_session
+      auto it = kv_.find(keys[0]);
+      std::optional<std::string> prev;
+      if (it != kv_.end()) {
+        prev = it->second;
+      }
+      kv_[keys[0]] = argv[0];
+      if (prev && *prev != argv[0]) {
+        published_.emplace_back(argv[2] + *prev, argv[3]);
+      }
+      return prev ? Bulk(*prev) : "$-1\r\n";
+    }
+    if (src.find("ZREMRANGEBYRANK") != std::string::npos) { // append_scored
+      auto& zset = zsets_[keys[0]];
+      std::erase_if(zset, [&](const auto& e) { return e.second == argv[1]; });
+      zset.emplace(std::atof(argv[0].c_str()), argv[1]);
+      const size_t cap = static_cast<size_t>(std::atoll(argv[2].c_str()));
+      while (cap > 0 && zset.size() > cap) {
+        zset.erase(zset.begin());
+      }
+      return Int(static_cast<int64_t>(zset.size()));
+    }
+    if (src.find("LTRIM") != std::string::npos) { // append_capped
+      auto& list = lists_[keys[0]];
+      list.push_back(argv[0]);
+      const size_t cap = static_cast<size_t>(std::atoll(argv[1].c_str()));
+      if (cap > 0 && list.size() > cap) {
+        list.erase(list.begin(), list.end() - static_cast<std::ptrdiff_t>(cap));
+      }
+      return Int(static_cast<int64_t>(list.size()));
+    }
+    if (src.find("LRANGE") != std::string::npos) { // pop_list
+      std::string out = Handle({"LRANGE", keys[0], "0", "-1"});
+      lists_.erase(keys[0]);
+      return out;
+    }
+    if (src.find("XINFO") != std::string::npos) { // delete_drained_stream
+      PurgeIfExpired(keys[1]);
+      if (kv_.count(keys[1])) {
+        return Int(0);
+      }
+      auto st = streams_.find(keys[0]);
+      if (st == streams_.end()) {
+        return Int(1);
+      }
+      auto g = st->second.groups.find(argv[0]);
+      if (g == st->second.groups.end() || !g->second.pel.empty() || g->second.last_delivered != st->second.last) {
+        return Int(0);
+      }
+      streams_.erase(st);
+      return Int(1);
+    }
+    auto it = kv_.find(keys[0]); // release_session
+    if (it != kv_.end() && it->second == argv[0]) {
+      kv_.erase(it);
+      return Int(1);
+    }
+    return Int(0);
+  }
+
+  std::string Eval(const std::string& src, const std::vector<std::string>& args) {
+    const size_t numkeys = static_cast<size_t>(std::atoll(args[2].c_str()));
+    std::vector<std::string> keys(args.begin() + 3, args.begin() + 3 + static_cast<std::ptrdiff_t>(numkeys));
+    std::vector<std::string> argv(args.begin() + 3 + static_cast<std::ptrdiff_t>(numkeys), args.end());
+    return RunScript(src, keys, argv);
+  }
+
+  // 只支持前缀匹配（"prefix*"）或 "*"
+  static bool Match(const std::string& pattern, const std::string& s) {
+    if (!pattern.empty() && pattern.back() == '*') {
+      return s.compare(0, pattern.size() - 1, pattern, 0, pattern.size() - 1) == 0;
+    }
+    return s == pattern;
+  }
+
+  // 流条目 ID 简化为 "<序号>-0"
+  struct StreamGroup {
+    uint64_t last_delivered{0};
+    std::map<uint64_t, std::pair<std::string, std::chrono::steady_clock::time_point>> pel; // 待确认：消费者与投递时间
+  };
+  struct Stream {
+    std::map<uint64_t, std::vector<std::string>> entries;
+    uint64_t last{0};
+    std::map<std::string, StreamGroup> groups;
+  };
+  // 阻塞中的 XREADGROUP：有新条目时或超时后回复
+  struct ParkedRead {
+    std::weak_ptr<Conn> conn;
+    std::string key, group, consumer;
+    size_t count{0};
+    std::shared_ptr<asio::steady_timer> timer;
+  };
+
+  static uint64_t StreamSeq(const std::string& id) { return static_cast<uint64_t>(std::atoll(id.c_str())); }
+
+  static std::string StreamEntries(const Stream& st, const std::vector<uint64_t>& ids) {
+    std::string out = "*" + std::to_string(ids.size()) + "\r\n";
+    for (uint64_t seq : ids) {
+      out += "*2\r\n" + Bulk(std::to_string(seq) + "-0");
+      auto it = st.entries.find(seq);
+      if (it == st.entries.end()) {
+        out += "*-1\r\n";
+        continue;
+      }
+      out += "*" + std::to_string(it->second.size()) + "\r\n";
+      for (const auto& f : it->second) {
+        out += Bulk(f);
+      }
+    }
+    return out;
+  }
+
+  // ">"：把新条目交给该消费者并记入待确认列表；其他 ID：重读该消费者自己的待确认条目
+  std::string ReadGroup(const std::string& key, const std::string& group, const std::string& consumer, size_t count,
+                        const std::string& id) {
+    Stream& st = streams_[key];
+    StreamGroup& g = st.groups[group];
+    std::vector<uint64_t> ids;
+    if (id == ">") {
+      for (auto it = st.entries.upper_bound(g.last_delivered); it != st.entries.end() && ids.size() < count; ++it) {
+        ids.push_back(it->first);
+        g.pel[it->first] = {consumer, std::chrono::steady_clock::now()};
+        g.last_delivered = it->first;
+      }
+      if (ids.empty()) {
+        return "";
+      }
+    } else {
+      for (auto it = g.pel.upper_bound(StreamSeq(id)); it != g.pel.end() && ids.size() < count; ++it) {
+        if (it->second.first == consumer) {
+          ids.push_back(it->first);
+        }
+      }
+    }
+    return "*1\r\n*2\r\n" + Bulk(key) + StreamEntries(st, ids);
+  }
+
+  std::string XReadGroup(const std::shared_ptr<Conn>& c, const std::vector<std::string>& args) {
+    std::string group, consumer, key, id;
+    size_t count = 10;
+    int64_t block = -1;
+    for (size_t i = 1; i < args.size(); ++i) {
+      if (args[i] == "GROUP" && i + 2 < args.size()) {
+        group = args[i + 1];
+        consumer = args[i + 2];
+        i += 2;
+      } else if (args[i] == "COUNT" && i + 1 < args.size()) {
+        count = static_cast<size_t>(std::atoll(args[++i].c_str()));
+      } else if (args[i] == "BLOCK" && i + 1 < args.size()) {
+        block = std::atoll(args[++i].c_str());
+      } else if (args[i] == "STREAMS" && i + 2 < args.size()) {
+        key = args[i + 1];
+        id = args[i + 2];
+        break;
+      }
+    }
+    auto st = streams_.find(key);
+    if (st == streams_.end() || !st->second.groups.count(group)) {
+      return "-NOGROUP No such key '" + key + "' or consumer group '" + group + "'\r\n";
+    }
+    std::string reply = ReadGroup(key, group, consumer, count, id);
+    if (!reply.empty()) {
+      return reply;
+    }
+    if (block < 0) {
+      return "*-1\r\n";
+    }
+    auto parked = std::make_shared<ParkedRead>();
+    parked->conn = c;
+    parked->key = key;
+    parked->group = group;
+    parked->consumer = consumer;
+    parked->count = count;
+    parked->timer = std::make_shared<asio::steady_timer>(io_, std::chrono::milliseconds(block));
+    parked->timer->async_wait([this, parked](std::error_code ec) {
+      if (ec || !parked_.erase(parked)) {
+        return;
+      }
+      if (auto conn = parked->conn.lock()) {
+        Send(conn, "*-1\r\n");
+      }
+    });
+    parked_.insert(parked);
+    return "";
+  }
+
+  void WakeParkedReads(const std::string& key) {
+    for (auto it = parked_.begin(); it != parked_.end();) {
+      auto p = *it;
+      auto conn = p->conn.lock();
+      if (p->key != key || !conn) {
+        it = conn ? std::next(it) : parked_.erase(it);
+        continue;
+      }
+      it = parked_.erase(it);
+      p->timer->cancel();
+      Send(conn, ReadGroup(p->key, p->group, p->consumer, p->count, ">"));
+    }
+  }
+
+  std::string StreamCommand(const std::vector<std::string>& args) {
+    const std::string& cmd = args[0];
+    if (cmd == "XGROUP" && args.size() >= 5 && args[1] == "CREATE") {
+      if (!streams_.count(args[2]) && std::find(args.begin(), args.end(), "MKSTREAM") == args.end()) {
+        return "-ERR The XGROUP subcommand requires the key to exist.\r\n";
+      }
+      Stream& st = streams_[args[2]];
+      if (st.groups.count(args[3])) {
+        return "-BUSYGROUP Consumer Group name already exists\r\n";
+      }
+      st.groups[args[3]].last_delivered = args[4] == "$" ? st.last : StreamSeq(args[4]);
+      return "+OK\r\n";
+    }
+    if (cmd == "XADD" && args.size() >= 5) {
+      auto star = std::find(args.begin() + 2, args.end(), "*");
+      if (star == args.end()) {
+        return "-ERR only auto ids are supported\r\n";
+      }
+      Stream& st = streams_[args[1]];
+      st.entries[++st.last] = std::vector<std::string>(star + 1, args.end());
+      const std::string id = std::to_string(st.last) + "-0";
+      WakeParkedReads(args[1]);
+      return Bulk(id);
+    }
+    if (cmd == "XACK" && args.size() >= 4) {
+      int64_t n = 0;
+      auto& g = streams_[args[1]].groups[args[2]];
+      for (size_t i = 3; i < args.size(); ++i) {
+        n += static_cast<int64_t>(g.pel.erase(StreamSeq(args[i])));
+      }
+      stream_acks_.fetch_add(static_cast<size_t>(n));
+      return Int(n);
+    }
+    if (cmd == "XLEN" && args.size() == 2) {
+      auto st = streams_.find(args[1]);
+      return Int(st == streams_.end() ? 0 : static_cast<int64_t>(st->second.entries.size()));
+    }
+    if (cmd == "XAUTOCLAIM" && args.size() >= 6) {
+      Stream& st = streams_[args[1]];
+      auto g = st.groups.find(args[2]);
+      if (g == st.groups.end()) {
+        return "-NOGROUP No such key '" + args[1] + "' or consumer group '" + args[2] + "'\r\n";
+      }
+      const auto min_idle = std::chrono::milliseconds(std::atoll(args[4].c_str()));
+      const size_t count = args.size() >= 8 ? static_cast<size_t>(std::atoll(args[7].c_str())) : 100;
+      const auto now = std::chrono::steady_clock::now();
+      std::vector<uint64_t> ids;
+      auto it = g->second.pel.lower_bound(StreamSeq(args[5]));
+      for (; it != g->second.pel.end() && ids.size() < count; ++it) {
+        if (now - it->second.second >= min_idle) {
+          it->second = {args[3], now};
+          ids.push_back(it->first);
+        }
+      }
+      const std::string next = it == g->second.pel.end() ? "0-0" : std::to_string(it->first) + "-0";
+      return "*3\r\n" + Bulk(next) + StreamEntries(st, ids) + "*0\r\n";
+    }
+    return "-ERR unknown command '" + cmd + "'\r\n";
+  }
+
+  // 游标就是有序元素列表中的下标；每步最多检查 COUNT 个元素
+  std::string ScanStep(const std::vector<std::string>& elements, size_t cursor, const std::vector<std::string>& opts,
+                       size_t stride) {
+    std::string pattern = "*";
+    size_t count = 10;
+    for (size_t i = 0; i + 1 < opts.size(); i += 2) {
+      if (opts[i] == "MATCH") {
+        pattern = opts[i + 1];
+      } else if (opts[i] == "COUNT") {
+        count = static_cast<size_t>(std::atoll(opts[i + 1].c_str()));
+      }
+    }
+    max_scan_count_ = std::max(max_scan_count_, count);
+    std::vector<std::string> out;
+    size_t i = cursor;
+    for (; i < elements.size() && i < cursor + count * stride; i += stride) {
+      if (Match(pattern, elements[i])) {
+        out.insert(out.end(), elements.begin() + static_cast<std::ptrdiff_t>(i),
+                   elements.begin() + static_cast<std::ptrdiff_t>(i + stride));
+      }
+    }
+    std::string reply = "*2\r\n" + Bulk(i >= elements.size() ? "0" : std::to_string(i));
+    reply += "*" + std::to_string(out.size()) + "\r\n";
+    for (const auto& e : out) {
+      reply += Bulk(e);
+    }
+    return reply;
+  }
+
+  // 客户端缓存：写命令向所有开启 TRACKING 的连接推送失效（不区分是否读过该键）
+  void Invalidate(const std::string& key) {
+    for (auto& weak : trackers_) {
+      auto c = weak.lock();
+      if (c && c->tracking && c->socket.is_open()) {
+        invalidations_.fetch_add(1);
+        Send(c, ">2\r\n" + Bulk("invalidate") + "*1\r\n" + Bulk(key));
+      }
+    }
+  }
+
+  // 惰性过期：访问到已过期的键时删除
+  void PurgeIfExpired(const std::string& key) {
+    auto it = expires_.find(key);
+    if (it != expires_.end() && it->second <= std::chrono::steady_clock::now()) {
+      kv_.erase(key);
+      lists_.erase(key);
+      expires_.erase(it);
+    }
+  }
+
+  std::string Handle(const std::vector<std::string>& args) {
+    const std::string& cmd = args.empty() ? std::string() : args[0];
+    if (args.size() >= 2) {
+      PurgeIfExpired(args[1]);
+    }
+    if (args.size() >= 2 && (cmd == "SET" || cmd == "DEL" || cmd == "INCR" || cmd == "EXPIRE")) {
+      Invalidate(args[1]);
+    }
+    if (cmd == "GET") {
+      gets_.fetch_add(1);
+    }
+    if (cmd == "SCAN" && args.size() >= 2) {
+      std::set<std::string> keys;
+      for (const auto& [k, v] : kv_) {
+        keys.insert(k);
+      }
+      for (const auto& [k, v] : lists_) {
+        keys.insert(k);
+      }
+      for (const auto& [k, v] : sets_) {
+        keys.insert(k);
+      }
+      for (const auto& [k, v] : hashes_) {
+        keys.insert(k);
+      }
+      return ScanStep({keys.begin(), keys.end()}, static_cast<size_t>(std::atoll(args[1].c_str())),
+                      {args.begin() + 2, args.end()}, 1);
+    }
+    if ((cmd == "SSCAN" || cmd == "HSCAN") && args.size() >= 3) {
+      std::vector<std::string> elements;
+      if (cmd == "SSCAN") {
+        elements.assign(sets_[args[1]].begin(), sets_[args[1]].end());
+      } else {
+        for (const auto& [f, v] : hashes_[args[1]]) {
+          elements.push_back(f);
+          elements.push_back(v);
+        }
+      }
+      return ScanStep(elements, static_cast<size_t>(std::atoll(args[2].c_str())), {args.begin() + 3, args.end()},
+                      cmd == "HSCAN" ? 2 : 1);
+    }
+    if (cmd == "SMEMBERS" && args.size() == 2) {
+      const auto& members = sets_[args[1]];
+      std::string out = "*" + std::to_string(members.size()) + "\r\n";
+      for (const auto& m : members) {
+        out += Bulk(m);
+      }
+      return out;
+    }
+    if (cmd == "SREM" && args.size() >= 3) {
+      int64_t n = 0;
+      for (size_t i = 2; i < args.size(); ++i) {
+        n += static_cast<int64_t>(sets_[args[1]].erase(args[i]));
+      }
+      return Int(n);
+    }
+    if (cmd == "EXISTS" && args.size() >= 2) {
+      int64_t n = 0;
+      for (size_t i = 1; i < args.size(); ++i) {
+        PurgeIfExpired(args[i]);
+        n += static_cast<int64_t>(kv_.count(args[i]) + lists_.count(args[i]) + sets_.count(args[i]) +
+                                  streams_.count(args[i]));
+      }
+      return Int(n);
+    }
+    if (cmd == "SADD" && args.size() >= 3) {
+      sets_[args[1]].insert(args.begin() + 2, args.end());
+      return Int(static_cast<int64_t>(args.size() - 2));
+    }
+    if (cmd == "HSET" && args.size() == 4) {
+      hashes_[args[1]][args[2]] = args[3];
+      return Int(1);
+    }
+    if (cmd == "XGROUP" || cmd == "XADD" || cmd == "XACK" || cmd == "XAUTOCLAIM" || cmd == "XLEN") {
+      return StreamCommand(args);
+    }
+    if (cmd == "SCRIPT" && args.size() >= 2 && args[1] == "FLUSH") {
+      scripts_.clear();
+      return "+OK\r\n";
+    }
+    if (cmd == "SCRIPT" && args.size() == 3 && args[1] == "LOAD") {
+      script_loads_.fetch_add(1);
+      const std::string sha = std::to_string(std::hash<std::string>{}(args[2]));
+      scripts_[sha] = args[2];
+      return Bulk(sha);
+    }
+    if (cmd == "EVALSHA" && args.size() >= 3) {
+      auto it = scripts_.find(args[1]);
+      if (it == scripts_.end()) {
+        return "-NOSCRIPT No matching script. Please use EVAL.\r\n";
+      }
+      return Eval(it->second, args);
+    }
+    if (cmd == "EVAL" && args.size() >= 3) {
+      return Eval(args[1], args);
+    }
+    if (cmd == "PING") {
+      return "+PONG\r\n";
+    }
+    if (cmd == "PUBLISH" && args.size() == 3) {
+      publishes_.fetch_add(1);
+      return Int(Publish(args[1], args[2]));
+    }
+    if (cmd == "SET" && args.size() >= 3) {
+      bool nx = false;
+      std::optional<std::chrono::milliseconds> ttl;
+      for (size_t i = 3; i < args.size(); ++i) {
+        if (args[i] == "NX") {
+          nx = true;
+        } else if (args[i] == "EX" && i + 1 < args.size()) {
+          ttl = std::chrono::seconds(std::atoll(args[++i].c_str()));
+        } else if (args[i] == "PX" && i + 1 < args.size()) {
+          ttl = std::chrono::milliseconds(std::atoll(args[++i].c_str()));
+        }
+      }
+      if (nx && kv_.count(args[1])) {
+        return "$-1\r\n";
+      }
+      kv_[args[1]] = args[2];
+      if (ttl) {
+        expires_[args[1]] = std::chrono::steady_clock::now() + *ttl;
+      } else {
+        expires_.erase(args[1]);
+      }
+      return "+OK\r\n";
+    }
+    if (cmd == "GET" && args.size() == 2) {
+      auto it = kv_.find(args[1]);
+      return it == kv_.end() ? "$-1\r\n" : Bulk(it->second);
+    }
+    if (cmd == "INCR" && args.size() == 2) {
+      const int64_t v = std::atoll(kv_[args[1]].c_str()) + 1;
+      kv_[args[1]] = std::to_string(v);
+      return ":" + std::to_string(v) + "\r\n";
+    }
+    if (cmd == "MSET" && args.size() >= 3 && args.size() % 2 == 1) {
+      for (size_t i = 1; i + 1 < args.size(); i += 2) {
+        kv_[args[i]] = args[i + 1];
+      }
+      return "+OK\r\n";
+    }
+    if (cmd == "DEL" && args.size() >= 2) {
+      int64_t n = 0;
+      for (size_t i = 1; i < args.size(); ++i) {
+        n += static_cast<int64_t>(kv_.erase(args[i]) + lists_.erase(args[i]));
+      }
+      return ":" + std::to_string(n) + "\r\n";
+    }
+    if (cmd == "EXPIRE" && args.size() == 3) {
+      if (!kv_.count(args[1]) && !lists_.count(args[1])) {
+        return ":0\r\n";
+      }
+      expires_[args[1]] = std::chrono::steady_clock::now() + std::chrono::seconds(std::atoll(args[2].c_str()));
+      return ":1\r\n";
+    }
+    if (cmd == "RPUSH" && args.size() >= 3) {
+      auto& list = lists_[args[1]];
+      list.insert(list.end(), args.begin() + 2, args.end());
+      return ":" + std::to_string(list.size()) + "\r\n";
+    }
+    if (cmd == "ZREVRANGEBYSCORE" && args.size() == 7 && args[4] == "LIMIT") {
+      // 分数边界："(x" 为开区间，"+inf"/"-inf" 不限
+      auto parse = [](const std::string& b) {
+        const bool open = !b.empty() && b[0] == '(';
+        const std::string v = open ? b.substr(1) : b;
+        return std::make_pair(v == "+inf" ? 1e300 : v == "-inf" ? -1e300 : std::atof(v.c_str()), open);
+      };
+      const auto [max, max_open] = parse(args[2]);
+      const auto [min, min_open] = parse(args[3]);
+      auto in_range = [&](double x) { return (max_open ? x < max : x <= max) && (min_open ? x > min : x >= min); };
+      int64_t skip = std::atoll(args[5].c_str());
+      const int64_t count = std::atoll(args[6].c_str());
+      std::vector<std::string> out;
+      const auto& zset = zsets_[args[1]];
+      for (auto it = zset.rbegin(); it != zset.rend() && static_cast<int64_t>(out.size()) < count; ++it) {
+        if (in_range(it->first) && skip-- <= 0) {
+          out.push_back(it->second);
+        }
+      }
+      std::string reply = "*" + std::to_string(out.size()) + "\r\n";
+      for (const auto& m : out) {
+        reply += Bulk(m);
+      }
+      return reply;
+    }
+    if (cmd == "LRANGE" && args.size() == 4) {
+      auto it = lists_.find(args[1]);
+      const std::vector<std::string> empty;
+      const auto& list = it == lists_.end() ? empty : it->second;
+      std::string out = "*" + std::to_string(list.size()) + "\r\n";
+      for (const auto& v : list) {
+        out += Bulk(v);
+      }
+      return out;
+    }
+    return "-ERR unknown command '" + cmd + "'\r\n";
+  }
+
+  asio::io_context io_;
+  asio::ip::tcp::acceptor acceptor_;
+  std::thread th_;
+  std::atomic<int> connections_{0};
+  std::atomic<size_t> max_per_read_{0};
+  std::map<std::string, std::string> kv_;
+  std::map<std::string, std::vector<std::string>> lists_;
+  std::map<std::string, std::set<std::pair<double, std::string>>> zsets_; // 按 (score, member) 排序
+  std::map<std::string, std::chrono::steady_clock::time_point> expires_; // SET EX / EXPIRE 的到期时间
+  std::map<std::string, std::set<std::string>> sets_;
+  std::map<std::string, std::map<std::string, std::string>> hashes_;
+  std::map<std::string, std::string> scripts_;
+  std::atomic<int> script_loads_{0};
+  size_t max_scan_count_{0};
+  std::vector<std::pair<std::string, std::string>> published_;
+  std::vector<std::weak_ptr<Conn>> subscribers_;
+  std::atomic<int> subscribe_commands_{0};
+  std::atomic<size_t> subscribed_channels_{0};
+  std::atomic<int> publishes_{0};
+  std::map<std::string, Stream> streams_;
+  std::set<std::shared_ptr<ParkedRead>> parked_;
+  std::atomic<size_t> stream_acks_{0};
+  std::vector<std::array<uint16_t, 3>> cluster_;
+  int ask_slot_{-1};
+  uint16_t ask_port_{0};
+  std::atomic<int> redirects_{0};
+  std::atomic<bool> resp3_{true};
+  std::atomic<int> gets_{0};
+  std::atomic<int> invalidations_{0};
+  std::vector<std::weak_ptr<Conn>> trackers_;
+  std::vector<std::shared_ptr<Conn>> stalled_;
+};
+
+TEST(RedisRespParserTest, PopsPipelinedRepliesInOrder) {
+  RedisRespParser parser;
+  const std::string wire = "+OK\r\n:42\r\n$5\r\nhello\r\n$-1\r\n*2\r\n$1\r\na\r\n:7\r\n-ERR bad\r\n";
+  // 按字节逐个喂入，验证半包与读偏移
+  std::vector<RedisResp> replies;
+  for (char ch : wire) {
+    const auto b = static_cast<uint8_t>(ch);
+    parser.Append(&b, 1);
+    while (auto r = parser.Pop()) {
+      replies.push_back(std::move(*r));
+    }
+  }
+  ASSERT_EQ(6u, replies.size());
+  EXPECT_EQ(RedisResp::Type::kSimpleString, replies[0].type);
+  EXPECT_EQ(42, replies[1].integer);
+  EXPECT_EQ("hello", replies[2].str);
+  EXPECT_EQ(RedisResp::Type::kNull, replies[3].type);
+  ASSERT_EQ(2u, replies[4].array.size());
+  EXPECT_EQ(7, replies[4].array[1].integer);
+  EXPECT_EQ(RedisResp::Type::kError, replies[5].type);
+}
+
+TEST(RedisReplyParserTest, ParsesResp3InPlaceByteByByte) {
+  RedisReplyParser parser;
+  const std::string wire =
+      "*3\r\n$1\r\na\r\n*1\r\n:5\r\n$-1\r\n"          // 嵌套数组
+      "%1\r\n+k\r\n#t\r\n"                                   // map 展平为键值对
+      "|1\r\n+ttl\r\n:3\r\n,1.5\r\n"                        // 属性被跳过
+      "=8\r\ntxt:body\r\n!3\r\nbad\r\n>2\r\n+m\r\n+x\r\n_\r\n";
+  std::vector<RedisReply> replies;
+  for (char ch : wire) {
+    const auto b = static_cast<uint8_t>(ch);
+    parser.Append(&b, 1);
+    while (auto r = parser.Pop()) {
+      replies.push_back(std::move(*r));
+    }
+  }
+  ASSERT_FALSE(parser.Failed());
+  ASSERT_EQ(7u, replies.size());
+
+  ASSERT_EQ(3u, replies[0].elements.size());
+  EXPECT_EQ("a", replies[0].elements[0].str);
+  EXPECT_EQ(5, replies[0].elements[1].elements[0].integer);
+  EXPECT_EQ(RedisReply::Type::kNull, replies[0].elements[2].type);
+  // 子回复与父回复共享 arena，父回复析构后视图仍有效
+  RedisReply nested = replies[0].Element(1);
+  replies[0] = RedisReply();
+  EXPECT_EQ(5, nested.elements[0].integer);
+
+  EXPECT_EQ(RedisReply::Type::kMap, replies[1].type);
+  ASSERT_EQ(2u, replies[1].elements.size());
+  EXPECT_EQ(RedisReply::Type::kBoolean, replies[1].elements[1].type);
+  EXPECT_EQ(1, replies[1].elements[1].integer);
+  EXPECT_DOUBLE_EQ(1.5, replies[2].real);
+  EXPECT_EQ("body", replies[3].str);
+  EXPECT_EQ(RedisReply::Type::kError, replies[4].type);
+  EXPECT_EQ("bad", replies[4].str);
+  EXPECT_EQ(RedisReply::Type::kPush, replies[5].type);
+  EXPECT_EQ((std::vector<std::string>{"m", "x"}), RedisStringArray(replies[5]));
+  EXPECT_EQ(RedisReply::Type::kNull, replies[6].type);
+}
+
+TEST(RedisReplyParserTest, FailsOnMalformedStream) {
+  RedisReplyParser parser;
+  const std::string wire = "+OK\r\n$x\r\n";
+  parser.Append(reinterpret_cast<const uint8_t*>(wire.data()), wire.size());
+  auto ok = parser.Pop();
+  ASSERT_TRUE(ok.has_value());
+  EXPECT_EQ("OK", ok->str);
+  EXPECT_FALSE(parser.Pop().has_value());
+  EXPECT_TRUE(parser.Failed());
+}
+
+TEST(RedisClientTest, TypedCommandsReuseOneConnection) {
+  FakeRedisServer server;
+  RedisClient client("127.0.0.1", server.Port(), RedisClientOptions{1, std::chrono::milliseconds(2000)});
+
+  EXPECT_TRUE(client.SetEx("k", "v", 60));
+  EXPECT_EQ(std::optional<std::string>("v"), client.Get("k"));
+  EXPECT_FALSE(client.Get("missing").has_value());
+  EXPECT_TRUE(client.RPush("list", "a"));
+  EXPECT_TRUE(client.RPush("list", "b"));
+  EXPECT_EQ((std::vector<std::string>{"a", "b"}), client.LRange("list", 0, -1));
+  EXPECT_EQ(1, server.Connections());
+}
+
+TEST(RedisClientTest, PipelinesAsyncCommandsAndMatchesRepliesInOrder) {
+  FakeRedisServer server;
+  RedisClient client("127.0.0.1", server.Port(), RedisClientOptions{1, std::chrono::milliseconds(2000)});
+
+  constexpr int kCommands = 500;
+  std::mutex mu;
+  std::vector<int64_t> results;
+  std::promise<void> done;
+  for (int i = 0; i < kCommands; ++i) {
+    client.ExecuteAsync({"INCR", "counter"}, [&, i](std::optional<RedisReply> r) {
+      std::lock_guard<std::mutex> lock(mu);
+      results.push_back(r ? r->integer : -1);
+      if (i == kCommands - 1) {
+        done.set_value();
+      }
+    });
+  }
+  ASSERT_EQ(std::future_status::ready, done.get_future().wait_for(std::chrono::seconds(5)));
+
+  // 回复按发送顺序回到各自的回调
+  ASSERT_EQ(static_cast<size_t>(kCommands), results.size());
+  for (int i = 0; i < kCommands; ++i) {
+    EXPECT_EQ(i + 1, results[i]);
+  }
+  EXPECT_EQ(1, server.Connections());
+  EXPECT_GT(server.MaxCommandsPerRead(), 1u);
+}
+
+TEST(RedisClientTest, FailsInFlightCommandsAndReconnects) {
+  FakeRedisServer server;
+  RedisClient client("127.0.0.1", server.Port(), RedisClientOptions{1, std::chrono::milliseconds(2000)});
+  ASSERT_TRUE(client.SetEx("k", "v", 60));
+
+  EXPECT_FALSE(client.Execute({"DROP"}).has_value());
+  // 下一条命令重新建立连接
+  EXPECT_EQ(std::optional<std::string>("v"), client.Get("k"));
+  EXPECT_EQ(2, server.Connections());
+
+  auto err = client.Execute({"NOPE"});
+  ASSERT_TRUE(err.has_value());
+  EXPECT_EQ(RedisResp::Type::kError, err->type);
+}
+
+TEST(RedisClientTest, StalledServerFailsAsyncCommandsAfterTheTimeout) {
+  FakeRedisServer server;
+  RedisClient client("127.0.0.1", server.Port(), RedisClientOptions{1, std::chrono::milliseconds(200)});
+  ASSERT_TRUE(client.SetEx("k", "v", 60));
+
+  // 服务端不再回复：没人等待的异步回调也要在超时后失败，而不是一直挂在连接上
+  constexpr int kCommands = 10;
+  std::atomic<int> failed{0};
+  std::promise<void> done;
+  client.ExecuteAsync({"STALL"}, [&](std::optional<RedisReply> r) { failed.fetch_add(r ? 0 : 1); });
+  for (int i = 0; i < kCommands; ++i) {
+    client.ExecuteAsync({"GET", "k"}, [&, i](std::optional<RedisReply> r) {
+      failed.fetch_add(r ? 0 : 1);
+      if (i == kCommands - 1) {
+        done.set_value();
+      }
+    });
+  }
+  ASSERT_EQ(std::future_status::ready, done.get_future().wait_for(std::chrono::seconds(5)));
+  EXPECT_EQ(kCommands + 1, failed.load());
+
+  // 连接被判定失效后，下一条命令重新建立连接
+  EXPECT_EQ(std::optional<std::string>("v"), client.Get("k"));
+  EXPECT_EQ(2, server.Connections());
+}
+
+TEST(RedisClientTest, TimesOutWhenServerIsUnreachable) {
+  uint16_t port = 0;
+  {
+    asio::io_context io;
+    asio::ip::tcp::acceptor probe(io, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    port = probe.local_endpoint().port();
+  }
+  RedisClient client("127.0.0.1", port, RedisClientOptions{1, std::chrono::milliseconds(500)});
+  EXPECT_FALSE(client.Get("k").has_value());
+}
+
+TEST(RedisClientTest, BatchSendsAllCommandsInOneWrite) {
+  FakeRedisServer server;
+  RedisClient client("127.0.0.1", server.Port(), RedisClientOptions{1, std::chrono::milliseconds(2000)});
+
+  auto batch = client.Batch();
+  for (int i = 0; i < 20; ++i) {
+    batch.Add({"RPUSH", "q", std::to_string(i)});
+  }
+  batch.Add({"NOPE"}).Add({"LRANGE", "q", "0", "-1"});
+  auto replies = batch.Execute();
+  ASSERT_TRUE(replies.has_value());
+  ASSERT_EQ(22u, replies->size());
+  EXPECT_EQ(20, (*replies)[19].integer);
+  EXPECT_EQ(RedisResp::Type::kError, (*replies)[20].type); // 流水线中单条失败不影响其他命令
+  EXPECT_EQ(20u, RedisStringArray((*replies)[21]).size());
+  EXPECT_GE(server.MaxCommandsPerRead(), 22u);
+}
+
+TEST(RedisClientTest, TransactionReturnsExecRepliesOrNothing) {
+  FakeRedisServer server;
+  RedisClient client("127.0.0.1", server.Port(), RedisClientOptions{1, std::chrono::milliseconds(2000)});
+  ASSERT_TRUE(client.RPush("offline", "m1"));
+  ASSERT_TRUE(client.RPush("offline", "m2"));
+
+  // LRANGE + DEL 原子取出
+  auto replies = client.Transaction().Add({"LRANGE", "offline", "0", "-1"}).Add({"DEL", "offline"}).Execute();
+  ASSERT_TRUE(replies.has_value());
+  ASSERT_EQ(2u, replies->size());
+  EXPECT_EQ((std::vector<std::string>{"m1", "m2"}), RedisStringArray((*replies)[0]));
+  EXPECT_EQ(1, (*replies)[1].integer);
+  EXPECT_TRUE(client.LRange("offline", 0, -1).empty());
+
+  // 排队阶段出错：整个事务被丢弃
+  EXPECT_FALSE(client.Transaction().Add({"RPUSH", "offline", "m3"}).Add({"NOPE"}).Execute().has_value());
+  EXPECT_TRUE(client.LRange("offline", 0, -1).empty());
+
+  std::promise<RedisBatch::Replies> done;
+  client.Transaction().Add({"INCR", "n"}).Add({"INCR", "n"}).ExecuteAsync(
+      [&](RedisBatch::Replies r) { done.set_value(std::move(r)); });
+  auto async_replies = done.get_future().get();
+  ASSERT_TRUE(async_replies.has_value());
+  EXPECT_EQ(2, async_replies->back().integer);
+}
+
+TEST(RedisScriptTest, TypedHelpersRunServerSide) {
+  FakeRedisServer server;
+  RedisClient client("127.0.0.1", server.Port(), RedisClientOptions{1, std::chrono::milliseconds(2000)});
+
+  std::optional<std::string> prev = std::string("stale");
+  ASSERT_TRUE(ClaimSession(client, "sess:u1", "gw-a", 60, "kick:", "u1", &prev));
+  EXPECT_FALSE(prev.has_value());
+  ASSERT_TRUE(ClaimSession(client, "sess:u1", "gw-b", 60, "kick:", "u1", &prev));
+  EXPECT_EQ(std::optional<std::string>("gw-a"), prev);
+  ASSERT_EQ(1u, server.Published().size());
+  EXPECT_EQ("kick:gw-a", server.Published()[0].first);
+
+  // 只有当前持有者才能释放
+  EXPECT_FALSE(ReleaseSession(client, "sess:u1", "gw-a"));
+  EXPECT_TRUE(ReleaseSession(client, "sess:u1", "gw-b"));
+  EXPECT_EQ("", server.Value("sess:u1"));
+
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(std::min(i + 1, 3), AppendHistoryCapped(client, "hist", "m" + std::to_string(i), 3, 0));
+  }
+  EXPECT_EQ((std::vector<std::string>{"m2", "m3", "m4"}), client.LRange("hist", 0, -1));
+
+  // 按时间戳排序的历史：超出上限删除最旧的，分页读取只返回一页
+  for (int i = 1; i <= 6; ++i) {
+    EXPECT_EQ(std::min(i, 4), AppendHistoryScored(client, "zhist", i * 1000, "m" + std::to_string(i), 4, 0));
+  }
+  auto page = client.ZRevRangeByScoreReply("zhist", "(5000", "-inf", 0, 2);
+  ASSERT_TRUE(page.has_value());
+  EXPECT_EQ((std::vector<std::string>{"m4", "m3"}), RedisStringArray(*page));
+  page = client.ZRevRangeByScoreReply("zhist", "(3000", "-inf", 0, 2);
+  ASSERT_TRUE(page.has_value());
+  EXPECT_TRUE(page->elements.empty()); // m1、m2 已被裁掉
+
+  auto popped = PopOfflineAtomically(client, "hist");
+  ASSERT_TRUE(popped.has_value());
+  EXPECT_EQ((std::vector<std::string>{"m2", "m3", "m4"}), RedisStringArray(*popped));
+  popped = PopOfflineAtomically(client, "hist");
+  ASSERT_TRUE(popped.has_value());
+  EXPECT_TRUE(popped->elements.empty());
+}
+
+TEST(RedisScriptTest, LoadsOnceAndReloadsAfterNoScript) {
+  FakeRedisServer server;
+  RedisClient client("127.0.0.1", server.Port(), RedisClientOptions{1, std::chrono::milliseconds(2000)});
+  static const RedisScript script("test_pop",
+                                  "local items = redis.call('LRANGE', KEYS[1], 0, -1) redis.call('DEL', KEYS[1]) return items");
+
+  ASSERT_TRUE(client.RPush("l", "a"));
+  auto r = EvalScript(client, script, {"l"}, {});
+  ASSERT_TRUE(r.has_value());
+  EXPECT_EQ(1u, r->elements.size());
+  EXPECT_FALSE(script.Sha().empty());
+  EXPECT_TRUE(EvalScript(client, script, {"l"}, {}).has_value());
+  EXPECT_EQ(1, server.ScriptLoads()); // SHA 已缓存，之后只发 EVALSHA
+
+  // 服务端脚本缓存被清空（重启/故障转移）：NOSCRIPT 后自动重新加载并重试
+  ASSERT_TRUE(client.Execute({"SCRIPT", "FLUSH"}).has_value());
+  ASSERT_TRUE(client.RPush("l", "b"));
+  std::promise<std::optional<RedisReply>> done;
+  EvalScriptAsync(client, script, {"l"}, {}, [&](std::optional<RedisReply> reply) { done.set_value(std::move(reply)); });
+  auto async_reply = done.get_future().get();
+  ASSERT_TRUE(async_reply.has_value());
+  EXPECT_EQ(1u, async_reply->elements.size());
+  EXPECT_EQ(2, server.ScriptLoads());
+}
+
+TEST(RedisClientTest, ScanWalksKeyspaceInBoundedSteps) {
+  FakeRedisServer server;
+  RedisClient client("127.0.0.1", server.Port(), RedisClientOptions{1, std::chrono::milliseconds(2000)});
+  auto fill = client.Batch();
+  for (int i = 0; i < 250; ++i) {
+    fill.Add({"RPUSH", "chirp:chat:history:" + std::to_string(i), "m"});
+    fill.Add({"SET", "other:" + std::to_string(i), "v"});
+  }
+  ASSERT_TRUE(fill.Execute().has_value());
+
+  auto scanner = client.Scan("chirp:chat:history:*", 40);
+  std::set<std::string> seen;
+  std::vector<std::string> keys;
+  int steps = 0;
+  while (scanner.Next(&keys)) {
+    ++steps;
+    EXPECT_LE(keys.size(), 40u);
+    seen.insert(keys.begin(), keys.end());
+  }
+  EXPECT_TRUE(scanner.Done());
+  EXPECT_FALSE(scanner.Failed());
+  EXPECT_EQ(250u, seen.size());
+  EXPECT_GE(steps, 500 / 40);
+  EXPECT_EQ(40u, server.MaxScanCount());
+  EXPECT_FALSE(scanner.Next(&keys));
+}
+
+TEST(RedisClientTest, HScanAndSScanIterateOneKey) {
+  FakeRedisServer server;
+  RedisClient client("127.0.0.1", server.Port(), RedisClientOptions{1, std::chrono::milliseconds(2000)});
+  auto fill = client.Batch();
+  for (int i = 0; i < 30; ++i) {
+    fill.Add({"HSET", "h", "f" + std::to_string(i), "v" + std::to_string(i)});
+    fill.Add({"SADD", "s", "m" + std::to_string(i)});
+  }
+  ASSERT_TRUE(fill.Execute().has_value());
+
+  std::map<std::string, std::string> fields;
+  std::vector<std::string> batch;
+  auto hscan = client.HScan("h", "*", 7);
+  while (hscan.Next(&batch)) {
+    ASSERT_EQ(0u, batch.size() % 2); // field/value 成对返回
+    for (size_t i = 0; i < batch.size(); i += 2) {
+      fields[batch[i]] = batch[i + 1];
+    }
+  }
+  EXPECT_EQ(30u, fields.size());
+  EXPECT_EQ("v7", fields["f7"]);
+
+  std::set<std::string> members;
+  auto sscan = client.SScan("s", "m1*", 7);
+  while (sscan.Next(&batch)) {
+    members.insert(batch.begin(), batch.end());
+  }
+  EXPECT_EQ(11u, members.size()); // m1, m10..m19
+}
+
+TEST(RedisClientTest, ScanStopsAndReportsFailure) {
+  FakeRedisServer server;
+  RedisClient client("127.0.0.1", server.Port(), RedisClientOptions{1, std::chrono::milliseconds(2000)});
+  auto scanner = client.ZScan("z"); // 假服务端不支持 ZSCAN：返回错误
+  std::vector<std::string> batch;
+  EXPECT_FALSE(scanner.Next(&batch));
+  EXPECT_TRUE(scanner.Failed());
+}
+
+TEST(RedisClusterTest, ComputesKeySlotsWithHashTags) {
+  EXPECT_EQ(12739, RedisKeySlot("123456789")); // CRC16/XMODEM("123456789") = 0x31C3
+  EXPECT_EQ(12182, RedisKeySlot("foo"));
+  EXPECT_EQ(RedisKeySlot("u1"), RedisKeySlot("chirp:chat:offline:{u1}"));
+  EXPECT_EQ(RedisKeySlot("chirp:chat:loc:{u1}"), RedisKeySlot("chirp:chat:delivery:{u1}:m9"));
+  EXPECT_EQ(RedisKeySlot("foo{}{bar}"), RedisKeySlot(std::string_view("foo{}{bar}"))); // 空标签：整个键参与计算
+  EXPECT_NE(RedisKeySlot("bar"), RedisKeySlot("foo{}{bar}"));
+  EXPECT_EQ(RedisKeySlot("{bar"), RedisKeySlot("foo{{bar}}zap")); // 取第一个 { 到其后第一个 }
+
+  EXPECT_EQ(RedisKeySlot("k"), RedisCommandSlot({"EVALSHA", "sha", "1", "k", "arg"}));
+  EXPECT_FALSE(RedisCommandSlot({"EVALSHA", "sha", "0", "arg"}));
+  EXPECT_EQ(RedisKeySlot("s"), RedisCommandSlot({"XREADGROUP", "GROUP", "g", "c", "STREAMS", "s", ">"}));
+  EXPECT_FALSE(RedisCommandSlot({"SCRIPT", "LOAD", "return 1"}));
+
+  RedisNode moved;
+  moved.type = RedisNode::Type::kError;
+  moved.str = "MOVED 3999 10.0.0.2:6381";
+  auto redirect = ParseRedisRedirect(moved);
+  ASSERT_TRUE(redirect);
+  EXPECT_FALSE(redirect->ask);
+  EXPECT_EQ(3999, redirect->slot);
+  EXPECT_EQ("10.0.0.2:6381", redirect->node.ToString());
+  moved.str = "ERR wrong type";
+  EXPECT_FALSE(ParseRedisRedirect(moved));
+}
+
+TEST(RedisClusterTest, ListsEveryKeyOfMultiKeyCommands) {
+  auto keys = [](const std::vector<std::string>& args) {
+    std::vector<std::string> out;
+    for (const std::string* key : RedisCommandKeys(args)) {
+      out.push_back(*key);
+    }
+    return out;
+  };
+  EXPECT_EQ((std::vector<std::string>{"a", "b", "c"}), keys({"DEL", "a", "b", "c"}));
+  EXPECT_EQ((std::vector<std::string>{"a", "b"}), keys({"MSET", "a", "1", "b", "2"}));
+  EXPECT_EQ((std::vector<std::string>{"a", "b"}), keys({"EVALSHA", "sha", "2", "a", "b", "arg"}));
+  EXPECT_EQ((std::vector<std::string>{"a", "b"}), keys({"RENAME", "a", "b"}));
+  EXPECT_EQ((std::vector<std::string>{"a"}), keys({"SET", "a", "1", "EX", "60"}));
+  EXPECT_TRUE(keys({"PING"}).empty());
+  EXPECT_TRUE(keys({"EVALSHA", "sha", "0", "arg"}).empty());
+}
+
+TEST(RedisClusterTest, RoutesBySlotAndFollowsRedirects) {
+  FakeRedisServer a;
+  FakeRedisServer b;
+  const std::vector<std::array<uint16_t, 3>> split = {{0, 8191, a.Port()}, {8192, 16383, b.Port()}};
+  a.SetCluster(split);
+  b.SetCluster(split);
+  // 按哈希标签挑出分别落在两个节点上的键
+  std::string on_a, on_b;
+  for (int i = 0; on_a.empty() || on_b.empty(); ++i) {
+    const std::string key = "k:{" + std::to_string(i) + "}";
+    (RedisKeySlot(key) < 8192 ? on_a : on_b) = key;
+  }
+
+  RedisClientOptions options;
+  options.cluster = true;
+  RedisClient client("127.0.0.1", a.Port(), options);
+  ASSERT_TRUE(client.Execute({"SET", on_a, "1"}));
+  auto r = client.Execute({"SET", on_b, "2"});
+  ASSERT_TRUE(r);
+  EXPECT_EQ("OK", r->str);
+  EXPECT_EQ("2", b.Value(on_b));
+  EXPECT_EQ("", a.Value(on_b));
+  EXPECT_EQ(std::optional<std::string>("2"), client.Get(on_b));
+
+  // 跨节点的流水线与事务：按节点 / 槽位拆分，回复按原顺序拼回
+  auto replies = client.Batch().Add({"INCR", on_a}).Add({"INCR", on_b}).Add({"GET", on_a}).Execute();
+  ASSERT_TRUE(replies);
+  ASSERT_EQ(3u, replies->size());
+  EXPECT_EQ(2, (*replies)[0].integer);
+  EXPECT_EQ(3, (*replies)[1].integer);
+  EXPECT_EQ("2", (*replies)[2].str);
+  replies = client.Transaction().Add({"INCR", on_b}).Add({"INCR", on_a}).Execute();
+  ASSERT_TRUE(replies);
+  ASSERT_EQ(2u, replies->size());
+  EXPECT_EQ(4, (*replies)[0].integer);
+  EXPECT_EQ(3, (*replies)[1].integer);
+
+  // 槽位整体迁到 b：a 回复 MOVED，客户端跟随并更新槽位表
+  const std::vector<std::array<uint16_t, 3>> all_b = {{0, 16383, b.Port()}};
+  a.SetCluster(all_b);
+  b.SetCluster(all_b);
+  const int before = a.Redirects();
+  ASSERT_TRUE(client.Execute({"SET", on_a, "moved"}));
+  EXPECT_EQ("moved", b.Value(on_a));
+  EXPECT_EQ(before + 1, a.Redirects());
+  ASSERT_TRUE(client.Execute({"SET", on_a, "again"})); // 槽位表已更新，直接发往 b
+  EXPECT_EQ(before + 1, a.Redirects());
+  replies = client.Transaction().Add({"SET", on_a, "tx"}).Add({"GET", on_a}).Execute();
+  ASSERT_TRUE(replies);
+  EXPECT_EQ("tx", (*replies)[1].str);
+
+  // ASK：迁移中的槽位由 b 临时重定向到 a，槽位表不变
+  const int slot = RedisKeySlot(on_a);
+  b.SetCluster(all_b, slot, a.Port());
+  a.SetCluster(all_b);
+  ASSERT_TRUE(client.Execute({"SET", on_a, "asked"}));
+  EXPECT_EQ("asked", a.Value(on_a));
+  const int asks = b.Redirects();
+  ASSERT_TRUE(client.Execute({"SET", on_a, "asked2"}));
+  EXPECT_EQ(asks + 1, b.Redirects());
+
+  // 集群 SCAN 依次遍历每个主节点
+  a.SetCluster(split);
+  b.SetCluster(split);
+  RedisClient fresh("127.0.0.1", a.Port(), options);
+  std::set<std::string> seen;
+  auto scanner = fresh.Scan("k:*", 10);
+  std::vector<std::string> batch;
+  while (scanner.Next(&batch)) {
+    seen.insert(batch.begin(), batch.end());
+  }
+  EXPECT_FALSE(scanner.Failed());
+  EXPECT_TRUE(seen.count(on_a) && seen.count(on_b));
+}
+
+// 轮询等待异步条件成立（最多 5 秒）
+template <typename Pred>
+bool WaitUntil(Pred pred) {
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!pred()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  return true;
+}
+
+TEST(RedisNearCacheTest, EvictsLeastRecentlyUsedWithinByteBudget) {
+  const size_t entry = 2 + 1 + RedisNearCache::kEntryOverhead; // "kN" -> "v"
+  RedisNearCache cache(3 * entry);
+  uint64_t token = 0;
+  for (const char* key : {"k1", "k2", "k3"}) {
+    EXPECT_FALSE(cache.Lookup(key, &token));
+    cache.Fill(key, token, std::string("v"));
+  }
+  EXPECT_TRUE(cache.Lookup("k1", &token)); // k1 变为最近使用，k2 成为最旧
+  EXPECT_FALSE(cache.Lookup("k4", &token));
+  cache.Fill("k4", token, std::string("v"));
+  EXPECT_FALSE(cache.Lookup("k2", &token));
+  cache.Cancel("k2", token);
+
+  auto stats = cache.Stats();
+  EXPECT_EQ(1u, stats.evictions);
+  EXPECT_EQ(3u, stats.entries);
+  EXPECT_EQ(3 * entry, stats.bytes);
+
+  // 读取期间键被失效：填充令牌作废，旧值不入缓存
+  EXPECT_FALSE(cache.Lookup("k5", &token));
+  cache.Invalidate("k5");
+  cache.Fill("k5", token, std::string("stale"));
+  EXPECT_FALSE(cache.Lookup("k5", &token));
+
+  // 不存在的键同样缓存
+  cache.Fill("k5", token, std::nullopt);
+  auto hit = cache.Lookup("k5", &token);
+  ASSERT_TRUE(hit);
+  EXPECT_FALSE(*hit);
+
+  cache.Clear();
+  EXPECT_EQ(0u, cache.Stats().entries);
+  EXPECT_EQ(0u, cache.Stats().bytes);
+}
+
+TEST(RedisClientTest, NearCacheServesHotReadsAndFollowsInvalidations) {
+  FakeRedisServer server;
+  RedisClient writer("127.0.0.1", server.Port());
+  RedisClientOptions options;
+  options.near_cache_bytes = 1 << 20;
+  RedisClient cached("127.0.0.1", server.Port(), options);
+
+  ASSERT_TRUE(writer.SetEx("chirp:sess:u1", "gw-a", 60));
+  EXPECT_EQ(std::optional<std::string>("gw-a"), cached.Get("chirp:sess:u1"));
+  const int gets = server.Gets();
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(std::optional<std::string>("gw-a"), cached.Get("chirp:sess:u1"));
+  }
+  EXPECT_EQ(gets, server.Gets()); // 命中本地缓存，不访问 Redis
+  EXPECT_EQ(100u, cached.NearCacheStats().hits);
+  EXPECT_EQ(1u, cached.NearCacheStats().misses);
+
+  // 其他客户端写入：服务端推送失效，之后读到新值
+  ASSERT_TRUE(writer.SetEx("chirp:sess:u1", "gw-b", 60));
+  ASSERT_TRUE(WaitUntil([&] { return cached.Get("chirp:sess:u1") == std::optional<std::string>("gw-b"); }));
+
+  // 自己的写入立即失效，不必等推送
+  ASSERT_TRUE(cached.Del("chirp:sess:u1"));
+  EXPECT_FALSE(cached.Get("chirp:sess:u1"));
+  ASSERT_TRUE(WaitUntil([&] { // 不存在也缓存（DEL 的失效推送可能晚到一步）
+    const int before = server.Gets();
+    return !cached.Get("chirp:sess:u1") && server.Gets() == before;
+  }));
+  EXPECT_GE(cached.NearCacheStats().invalidations, 1u);
+
+  // 多键写入逐个失效（服务端只为 DEL 的第一个键推送，MSET 不推送）
+  ASSERT_TRUE(writer.SetEx("k1", "v1", 60));
+  ASSERT_TRUE(writer.SetEx("k2", "v2", 60));
+  ASSERT_EQ(std::optional<std::string>("v1"), cached.Get("k1"));
+  ASSERT_EQ(std::optional<std::string>("v2"), cached.Get("k2"));
+  ASSERT_TRUE(cached.Execute({"MSET", "k1", "w1", "k2", "w2"}));
+  EXPECT_EQ(std::optional<std::string>("w1"), cached.Get("k1"));
+  EXPECT_EQ(std::optional<std::string>("w2"), cached.Get("k2"));
+  ASSERT_TRUE(cached.Execute({"DEL", "k1", "k2"}));
+  EXPECT_FALSE(cached.Get("k1"));
+  EXPECT_FALSE(cached.Get("k2"));
+}
+
+TEST(RedisClientTest, NearCacheStaysOffWithoutResp3) {
+  FakeRedisServer server;
+  server.SetResp3(false);
+  RedisClientOptions options;
+  options.near_cache_bytes = 1 << 20;
+  RedisClient cached("127.0.0.1", server.Port(), options);
+  ASSERT_TRUE(cached.SetEx("k", "v", 60));
+  EXPECT_EQ(std::optional<std::string>("v"), cached.Get("k"));
+  EXPECT_EQ(std::optional<std::string>("v"), cached.Get("k"));
+  EXPECT_EQ(2, server.Gets()); // 无法跟踪失效时不缓存
+  EXPECT_EQ(0u, cached.NearCacheStats().entries);
+}
+
+TEST(RedisSubscriberTest, CoalescesSubscriptionsIntoFewCommands) {
+  FakeRedisServer server;
+  asio::io_context io;
+  auto work = asio::make_work_guard(io);
+  std::thread th([&] { io.run(); });
+
+  RedisSubscriber sub(io.get_executor(), "127.0.0.1", server.Port());
+  std::vector<std::string> initial;
+  for (int i = 0; i < 600; ++i) {
+    initial.push_back("user:" + std::to_string(i));
+  }
+  sub.Subscribe(initial);
+  sub.Start();
+  ASSERT_TRUE(WaitUntil([&] { return server.SubscribedChannels() == 600; }));
+  EXPECT_EQ(2u, sub.CommandsSent()); // 每条命令最多 512 个频道
+
+  // io 线程被占用期间逐个订阅/退订：strand 恢复后合并成一条 SUBSCRIBE
+  std::promise<void> release;
+  asio::post(io, [f = release.get_future().share()] { f.wait(); });
+  for (int i = 600; i < 900; ++i) {
+    sub.Subscribe("user:" + std::to_string(i));
+  }
+  sub.Subscribe("transient");
+  sub.Unsubscribe("transient"); // 同一批内订阅又退订，不产生任何命令
+  release.set_value();
+  ASSERT_TRUE(WaitUntil([&] { return server.SubscribedChannels() == 900; }));
+  EXPECT_EQ(3u, sub.CommandsSent());
+  EXPECT_EQ(3, server.SubscribeCommands());
+
+  sub.Stop();
+  work.reset();
+  th.join();
+}
+
+TEST(RedisSubscriberTest, DeliversPatternMessagesAndResubscribesAfterReconnect) {
+  FakeRedisServer server;
+  asio::io_context io;
+  auto work = asio::make_work_guard(io);
+  std::thread th([&] { io.run(); });
+
+  std::mutex mu;
+  std::vector<std::string> got;
+  std::atomic<int> connects{0};
+  RedisSubscriber sub(io.get_executor(), "127.0.0.1", server.Port());
+  sub.SetMessageCallback([&](const std::string& channel, const std::string& payload) {
+    std::lock_guard<std::mutex> lock(mu);
+    got.push_back(channel + "=" + payload);
+  });
+  sub.SetPatternMessageCallback([&](const std::string& pattern, const std::string& channel, const std::string& payload) {
+    std::lock_guard<std::mutex> lock(mu);
+    got.push_back(pattern + "|" + channel + "=" + payload);
+  });
+  sub.SetConnectCallback([&] { connects.fetch_add(1); });
+  sub.Subscribe("kick");
+  sub.PSubscribe("inst:*");
+  sub.Start();
+  ASSERT_TRUE(WaitUntil([&] { return server.SubscribeCommands() == 2; }));
+
+  RedisClient client("127.0.0.1", server.Port(), RedisClientOptions{1, std::chrono::milliseconds(2000)});
+  EXPECT_TRUE(client.Publish("kick", "u1"));
+  EXPECT_TRUE(client.Publish("inst:7", "m"));
+  auto count = [&] {
+    std::lock_guard<std::mutex> lock(mu);
+    return got.size();
+  };
+  ASSERT_TRUE(WaitUntil([&] { return count() == 2; }));
+
+  // 服务端断开后自动重连并重新订阅全部频道与模式
+  server.DropSubscribers();
+  ASSERT_TRUE(WaitUntil([&] { return connects.load() == 2 && server.SubscribeCommands() == 4; }));
+  EXPECT_TRUE(client.Publish("kick", "u2"));
+  ASSERT_TRUE(WaitUntil([&] { return count() == 3; }));
+  {
+    std::lock_guard<std::mutex> lock(mu);
+    EXPECT_EQ((std::vector<std::string>{"kick=u1", "inst:*|inst:7=m", "kick=u2"}), got);
+  }
+
+  sub.Stop();
+  EXPECT_TRUE(client.Publish("kick", "late"));
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(3u, count()); // Stop() 之后不再回调
+  EXPECT_FALSE(sub.Subscribe("after-stop"));
+  work.reset();
+  th.join();
+}
+
+TEST(MessageRouterTest, InstanceRoutingBatchesMessagesPerInstance) {
+  FakeRedisServer server;
+  asio::io_context io;
+  auto work = asio::make_work_guard(io);
+  std::thread th([&] { io.run(); });
+
+  std::mutex mu;
+  std::set<std::string> online_on_b = {"u1", "u2"};
+  std::vector<std::string> delivered_b;
+  std::vector<std::string> undelivered_a;
+  std::vector<std::string> undelivered_b;
+
+  MessageRouter a(io, "127.0.0.1", server.Port());
+  MessageRouter b(io, "127.0.0.1", server.Port());
+  a.EnableInstanceRouting(
+      "a", [](const std::string&, const std::string&) { return false; },
+      [&](const std::string& user, const std::string& msg) {
+        std::lock_guard<std::mutex> lock(mu);
+        undelivered_a.push_back(user + ":" + msg);
+      });
+  b.EnableInstanceRouting(
+      "b",
+      [&](const std::string& user, const std::string& msg) {
+        std::lock_guard<std::mutex> lock(mu);
+        if (!online_on_b.count(user)) {
+          return false;
+        }
+        delivered_b.push_back(user + ":" + msg);
+        return true;
+      },
+      [&](const std::string& user, const std::string& msg) {
+        std::lock_guard<std::mutex> lock(mu);
+        undelivered_b.push_back(user + ":" + msg);
+      });
+  ASSERT_TRUE(a.Start());
+  ASSERT_TRUE(b.Start());
+  ASSERT_TRUE(WaitUntil([&] { return server.SubscribedChannels() == 2; })); // 每个实例只有一个频道
+  b.RegisterLocalUser("u1");
+  b.RegisterLocalUser("u2");
+
+  // io 线程忙碌期间发往同一实例的消息合并为一次 PUBLISH
+  std::promise<void> release;
+  asio::post(io, [f = release.get_future().share()] { f.wait(); });
+  EXPECT_TRUE(a.RouteToUser("u1", "m1"));
+  EXPECT_TRUE(a.RouteToUser("u2", "m2"));
+  EXPECT_TRUE(a.RouteToUser("u1", "m3"));
+  EXPECT_FALSE(a.RouteToUser("nobody", "m")); // 不在线：由调用方存离线
+  release.set_value();
+  auto locked_size = [&](const std::vector<std::string>& v) {
+    std::lock_guard<std::mutex> lock(mu);
+    return v.size();
+  };
+  ASSERT_TRUE(WaitUntil([&] { return locked_size(delivered_b) == 3; }));
+  EXPECT_EQ(1, server.Publishes());
+  {
+    std::lock_guard<std::mutex> lock(mu);
+    EXPECT_EQ((std::vector<std::string>{"u1:m1", "u2:m2", "u1:m3"}), delivered_b);
+    online_on_b.erase("u2");
+  }
+
+  // 发送方缓存仍指向 b，但 u2 已离开：接收方交给 on_undelivered
+  b.UnregisterLocalUser("u2");
+  EXPECT_TRUE(a.RouteToUser("u2", "m4"));
+  ASSERT_TRUE(WaitUntil([&] { return locked_size(undelivered_b) == 1; }));
+
+  // 注册表指向已下线的实例：PUBLISH 无人接收，发送方交给 on_undelivered
+  RedisClient client("127.0.0.1", server.Port(), RedisClientOptions{1, std::chrono::milliseconds(2000)});
+  ASSERT_TRUE(client.SetEx(RouterChannels::UserLocation("u3"), "gone", 60));
+  EXPECT_TRUE(a.RouteToUser("u3", "m5"));
+  ASSERT_TRUE(WaitUntil([&] { return locked_size(undelivered_a) == 1; }));
+  {
+    std::lock_guard<std::mutex> lock(mu);
+    EXPECT_EQ("u2:m4", undelivered_b[0]);
+    EXPECT_EQ("u3:m5", undelivered_a[0]);
+  }
+
+  a.Stop();
+  b.Stop();
+  work.reset();
+  th.join();
+}
+
+TEST(MessageRouterTest, LocationOutlivesItsTtlWhileUserStaysConnected) {
+  FakeRedisServer server;
+  asio::io_context io;
+  auto work = asio::make_work_guard(io);
+  std::thread th([&] { io.run(); });
+
+  InstanceRoutingOptions options;
+  options.location_ttl_seconds = 1;
+  options.location_refresh_interval = std::chrono::milliseconds(200);
+  MessageRouter b(io, "127.0.0.1", server.Port());
+  b.EnableInstanceRouting(
+      "b", [](const std::string&, const std::string&) { return true; },
+      [](const std::string&, const std::string&) {}, options);
+  ASSERT_TRUE(b.Start());
+  b.RegisterLocalUser("u1");
+  b.RegisterLocalUser("u2");
+  b.UnregisterLocalUser("u2");
+
+  RedisClient client("127.0.0.1", server.Port(), RedisClientOptions{1, std::chrono::milliseconds(2000)});
+  const std::string key = RouterChannels::UserLocation("u1");
+  std::this_thread::sleep_for(std::chrono::milliseconds(2500)); // 两倍多的 TTL
+  EXPECT_EQ(std::optional<std::string>("b"), client.Get(key));
+  EXPECT_FALSE(client.Get(RouterChannels::UserLocation("u2")).has_value());
+
+  // 注册项丢失（如 Redis 重启）后下一轮续期补回
+  ASSERT_TRUE(client.Del(key));
+  ASSERT_TRUE(WaitUntil([&] { return client.Get(key) == std::optional<std::string>("b"); }));
+
+  // 停止续期后按 TTL 过期
+  b.Stop();
+  std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+  EXPECT_FALSE(client.Get(key).has_value());
+  work.reset();
+  th.join();
+}
+
+TEST(MessageRouterTest, DestroyedWhileBatchesAreInFlight) {
+  FakeRedisServer server;
+  asio::io_context io;
+  auto work = asio::make_work_guard(io);
+  std::thread th([&] { io.run(); });
+
+  RedisClient client("127.0.0.1", server.Port(), RedisClientOptions{1, std::chrono::milliseconds(2000)});
+  ASSERT_TRUE(client.SetEx(RouterChannels::UserLocation("u1"), "gone", 60)); // 无人订阅的实例
+  InstanceRoutingOptions options;
+  options.max_batch_messages = 1; // 每条消息立即发布
+  std::atomic<int> undelivered{0};
+  std::promise<void> release;
+  {
+    MessageRouter a(io, "127.0.0.1", server.Port());
+    a.EnableInstanceRouting(
+        "a", [](const std::string&, const std::string&) { return false; },
+        [&](const std::string&, const std::string&) { undelivered.fetch_add(1); }, options);
+    ASSERT_TRUE(a.Start());
+    // io 被占住：失败回复（PUBLISH 无人接收）投递到 io 的处理排在路由器析构之后
+    asio::post(io, [f = release.get_future().share()] { f.wait(); });
+    for (int i = 0; i < 200; ++i) {
+      EXPECT_TRUE(a.RouteToUser("u1", "m" + std::to_string(i)));
+    }
+    ASSERT_TRUE(WaitUntil([&] { return server.Publishes() == 200; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  release.set_value();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(0, undelivered.load()); // 路由器已不在，排队的处理直接丢弃
+  work.reset();
+  th.join();
+}
+
+// 记录消费者收到的条目 ID（按到达顺序）
+struct StreamSink {
+  std::mutex mu;
+  std::vector<std::string> ids;
+  void Add(const std::vector<RedisStreamEntry>& entries) {
+    std::lock_guard<std::mutex> lock(mu);
+    for (const auto& e : entries) {
+      ids.push_back(e.id);
+    }
+  }
+  std::vector<std::string> Ids() {
+    std::lock_guard<std::mutex> lock(mu);
+    return ids;
+  }
+};
+
+TEST(RedisStreamConsumerTest, ReadsBacklogAndRecoversOwnPendingAfterRestart) {
+  FakeRedisServer server;
+  asio::io_context io;
+  auto work = asio::make_work_guard(io);
+  std::thread th([&] { io.run(); });
+  RedisClient client("127.0.0.1", server.Port(), RedisClientOptions{1, std::chrono::milliseconds(2000)});
+  RedisStreamConsumerOptions options;
+  options.count = 2;
+  options.block = std::chrono::milliseconds(50);
+
+  // 消费者组创建之前写入的条目同样会被读到；COUNT 2 分批读取
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(client.Execute({"XADD", "s", "*", "b", "m" + std::to_string(i)}));
+  }
+  StreamSink first;
+  auto consumer = std::make_unique<RedisStreamConsumer>(io.get_executor(), "127.0.0.1", server.Port(), "s", "g",
+                                                        "c1", options);
+  consumer->SetHandler([&](const std::vector<RedisStreamEntry>& entries) {
+    EXPECT_LE(entries.size(), 2u);
+    first.Add(entries);
+  });
+  consumer->Start();
+  ASSERT_TRUE(WaitUntil([&] { return server.StreamAcks() == 3; }));
+  ASSERT_TRUE(client.Execute({"XADD", "s", "*", "b", "m3"}));
+  ASSERT_TRUE(WaitUntil([&] { return server.StreamAcks() == 4; })); // 阻塞读取中到达的新条目
+  EXPECT_EQ((std::vector<std::string>{"1-0", "2-0", "3-0", "4-0"}), first.Ids());
+  EXPECT_EQ(4u, consumer->Delivered());
+  consumer->Stop();
+
+  // 模拟 c1 读走条目后未确认即崩溃：以同名重启后先重读自己的待确认条目。
+  // 条目可能已被旧消费者尚未关闭的阻塞读取取走，两种情况下都记在 c1 名下
+  ASSERT_TRUE(client.Execute({"XADD", "s", "*", "b", "m4"}));
+  ASSERT_TRUE(client.Execute({"XREADGROUP", "GROUP", "g", "c1", "COUNT", "10", "STREAMS", "s", ">"}));
+  StreamSink second;
+  consumer = std::make_unique<RedisStreamConsumer>(io.get_executor(), "127.0.0.1", server.Port(), "s", "g", "c1",
+                                                   options);
+  consumer->SetHandler([&](const std::vector<RedisStreamEntry>& entries) {
+    ASSERT_EQ(2u, entries[0].fields.size());
+    EXPECT_EQ("m4", entries[0].fields[1]);
+    second.Add(entries);
+  });
+  consumer->Start();
+  ASSERT_TRUE(WaitUntil([&] { return server.StreamAcks() == 5; }));
+  EXPECT_EQ((std::vector<std::string>{"5-0"}), second.Ids());
+
+  consumer->Stop();
+  work.reset();
+  th.join();
+}
+
+TEST(RedisStreamConsumerTest, ClaimsEntriesLeftPendingByAnotherConsumer) {
+  FakeRedisServer server;
+  asio::io_context io;
+  auto work = asio::make_work_guard(io);
+  std::thread th([&] { io.run(); });
+  RedisClient client("127.0.0.1", server.Port(), RedisClientOptions{1, std::chrono::milliseconds(2000)});
+
+  // 另一消费者读走两条后下线，条目停留在待确认列表
+  ASSERT_TRUE(client.Execute({"XGROUP", "CREATE", "s", "g", "0", "MKSTREAM"}));
+  ASSERT_TRUE(client.Execute({"XADD", "s", "*", "b", "x"}));
+  ASSERT_TRUE(client.Execute({"XADD", "s", "*", "b", "y"}));
+  ASSERT_TRUE(client.Execute({"XREADGROUP", "GROUP", "g", "dead", "COUNT", "10", "STREAMS", "s", ">"}));
+
+  RedisStreamConsumerOptions options;
+  options.block = std::chrono::milliseconds(50);
+  options.reclaim_idle = std::chrono::milliseconds(0);
+  StreamSink sink;
+  RedisStreamConsumer consumer(io.get_executor(), "127.0.0.1", server.Port(), "s", "g", "alive", options);
+  consumer.SetHandler([&](const std::vector<RedisStreamEntry>& entries) { sink.Add(entries); });
+  consumer.Start();
+  ASSERT_TRUE(WaitUntil([&] { return server.StreamAcks() == 2; }));
+  EXPECT_EQ((std::vector<std::string>{"1-0", "2-0"}), sink.Ids());
+
+  consumer.Stop();
+  work.reset();
+  th.join();
+}
+
+TEST(MessageRouterTest, StreamTransportDeliversBatchesSentWhileTargetWasDown) {
+  FakeRedisServer server;
+  asio::io_context io;
+  auto work = asio::make_work_guard(io);
+  std::thread th([&] { io.run(); });
+
+  InstanceRoutingOptions options;
+  options.transport = InstanceTransport::kStreams;
+  options.stream.block = std::chrono::milliseconds(50);
+  std::mutex mu;
+  std::vector<std::string> delivered_b;
+  std::vector<std::string> undelivered_a;
+
+  MessageRouter a(io, "127.0.0.1", server.Port());
+  MessageRouter b(io, "127.0.0.1", server.Port());
+  a.EnableInstanceRouting(
+      "a", [](const std::string&, const std::string&) { return false; },
+      [&](const std::string& user, const std::string& msg) {
+        std::lock_guard<std::mutex> lock(mu);
+        undelivered_a.push_back(user + ":" + msg);
+      },
+      options);
+  b.EnableInstanceRouting(
+      "b",
+      [&](const std::string& user, const std::string& msg) {
+        std::lock_guard<std::mutex> lock(mu);
+        delivered_b.push_back(user + ":" + msg);
+        return true;
+      },
+      [](const std::string&, const std::string&) {}, options);
+  ASSERT_TRUE(a.Start());
+  b.RegisterLocalUser("u1");
+
+  // b 尚未启动：Pub/Sub 下这批消息会无人接收，流传输下留在 b 的流中
+  std::promise<void> release;
+  asio::post(io, [f = release.get_future().share()] { f.wait(); });
+  EXPECT_TRUE(a.RouteToUser("u1", "m1"));
+  EXPECT_TRUE(a.RouteToUser("u1", "m2"));
+  release.set_value();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  ASSERT_TRUE(b.Start());
+  ASSERT_TRUE(WaitUntil([&] { return server.StreamAcks() == 1; })); // 两条消息合并为一个条目
+  {
+    std::lock_guard<std::mutex> lock(mu);
+    EXPECT_EQ((std::vector<std::string>{"u1:m1", "u1:m2"}), delivered_b);
+    EXPECT_TRUE(undelivered_a.empty());
+  }
+  EXPECT_EQ(0, server.Publishes());
+
+  a.Stop();
+  b.Stop();
+  work.reset();
+  th.join();
+}
+
+TEST(MessageRouterTest, SurvivorAdoptsTheStreamOfADeadInstance) {
+  FakeRedisServer server;
+  asio::io_context io;
+  auto work = asio::make_work_guard(io);
+  std::thread th([&] { io.run(); });
+
+  InstanceRoutingOptions options;
+  options.transport = InstanceTransport::kStreams;
+  options.location_ttl_seconds = 1;
+  options.location_refresh_interval = std::chrono::milliseconds(200);
+  options.orphan_scan_interval = std::chrono::milliseconds(200);
+  options.max_batch_messages = 1;
+  options.stream.block = std::chrono::milliseconds(50);
+  std::mutex mu;
+  std::vector<std::string> delivered_b;
+  std::vector<std::string> undelivered_b;
+
+  auto a = std::make_unique<MessageRouter>(io, "127.0.0.1", server.Port());
+  a->EnableInstanceRouting(
+      "a", [](const std::string&, const std::string&) { return true; },
+      [](const std::string&, const std::string&) {}, options);
+  MessageRouter b(io, "127.0.0.1", server.Port());
+  b.EnableInstanceRouting(
+      "b",
+      [&](const std::string& user, const std::string& msg) {
+        std::lock_guard<std::mutex> lock(mu);
+        delivered_b.push_back(user + ":" + msg);
+        return true;
+      },
+      [&](const std::string& user, const std::string& msg) {
+        std::lock_guard<std::mutex> lock(mu);
+        undelivered_b.push_back(user + ":" + msg);
+      },
+      options);
+  ASSERT_TRUE(a->Start());
+  a->RegisterLocalUser("u1");
+  a->RegisterLocalUser("u2");
+  ASSERT_TRUE(b.Start());
+
+  // a 崩溃：存活键过期前发给它的消息留在它的流里，其中一条已被读取但未确认
+  a->Stop();
+  a.reset();
+  RedisClient client("127.0.0.1", server.Port(), RedisClientOptions{1, std::chrono::milliseconds(2000)});
+  const std::string stream = RouterChannels::InstanceStream("a");
+  EXPECT_TRUE(b.RouteToUser("u1", "m1"));
+  ASSERT_TRUE(WaitUntil([&] {
+    auto len = client.Execute({"XLEN", stream});
+    return len && len->integer == 1;
+  }));
+  client.Execute({"XREADGROUP", "GROUP", "chirp-chat", "a", "COUNT", "1", "STREAMS", stream, ">"});
+  EXPECT_TRUE(b.RouteToUser("u2", "m2"));
+  ASSERT_TRUE(WaitUntil([&] {
+    auto len = client.Execute({"XLEN", stream});
+    return len && len->integer == 2;
+  }));
+  b.RegisterLocalUser("u1"); // u1 重连到 b，u2 未重连
+
+  ASSERT_TRUE(WaitUntil([&] {
+    auto gone = client.Execute({"EXISTS", stream});
+    return gone && gone->integer == 0;
+  }));
+  {
+    std::lock_guard<std::mutex> lock(mu);
+    EXPECT_EQ((std::vector<std::string>{"u1:m1"}), delivered_b);
+    EXPECT_EQ((std::vector<std::string>{"u2:m2"}), undelivered_b);
+  }
+  auto instances = client.Execute({"SMEMBERS", RouterChannels::StreamInstances()});
+  ASSERT_TRUE(instances);
+  EXPECT_EQ((std::vector<std::string>{"b"}), RedisStringArray(*instances));
+
+  b.Stop();
+  work.reset();
+  th.join();
+}
+
 } // namespace
 } // namespace chirp::network
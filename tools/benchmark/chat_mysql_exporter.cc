@@ -152,6 +152,7 @@ struct ExportStats {
 
 ExportStats ExportPattern(chirp::network::RedisClient& redis,
                           const std::string& pattern,
+                          bool sorted_set,
                           const std::string& table,
                           std::ostream& sql_out,
                           std::ostream* ack_out,
@@ -159,13 +160,27 @@ ExportStats ExportPattern(chirp::network::RedisClient& redis,
                           const std::string& redis_host,
                           uint16_t redis_port) {
   ExportStats stats;
-  auto keys = redis.Keys(pattern);
+  // SCAN in bounded steps rather than KEYS, so exporting does not stall a live server.
+  std::vector<std::string> keys;
+  auto scanner = redis.Scan(pattern, 500);
+  std::vector<std::string> step;
+  while (scanner.Next(&step)) {
+    keys.insert(keys.end(), step.begin(), step.end());
+  }
   std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end()); // SCAN may repeat keys
   WriteSchema(sql_out, table);
   sql_out << "START TRANSACTION;\n";
 
   for (const auto& key : keys) {
-    auto raw_msgs = redis.LRange(key, 0, -1);
+    // History timelines are sorted sets (oldest first by score); offline queues are lists.
+    std::vector<std::string> raw_msgs;
+    if (sorted_set) {
+      auto r = redis.Execute({"ZRANGE", key, "0", "-1"});
+      raw_msgs = r ? chirp::network::RedisStringArray(*r) : std::vector<std::string>{};
+    } else {
+      raw_msgs = redis.LRange(key, 0, -1);
+    }
     ++stats.key_count;
     for (const auto& raw : raw_msgs) {
       chirp::chat::ChatMessage msg;
@@ -225,12 +240,14 @@ int main(int argc, char** argv) {
 
   try {
     const ExportStats history_stats =
-        ExportPattern(redis, "chat:history:*", history_table, *out, ack_out, redis_cli_bin, redis_host, redis_port);
+        ExportPattern(redis, "chat:timeline:*", /*sorted_set=*/true, history_table, *out, ack_out, redis_cli_bin,
+                      redis_host, redis_port);
 
     ExportStats offline_stats;
     if (include_offline) {
       offline_stats =
-          ExportPattern(redis, "chat:offline:*", offline_table, *out, ack_out, redis_cli_bin, redis_host, redis_port);
+          ExportPattern(redis, "chat:offline:*", /*sorted_set=*/false, offline_table, *out, ack_out, redis_cli_bin,
+                        redis_host, redis_port);
     }
 
     std::cerr << "history_keys=" << history_stats.key_count
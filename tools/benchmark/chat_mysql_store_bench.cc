@@ -0,0 +1,244 @@
+// Benchmark: MySQLMessageStore inserts and history queries against a running MySQL, once over the
+// text protocol (escaped, string-built SQL and stoll-parsed rows, as the store used to do) and once
+// through the store's prepared statements; inserts also run through the group-commit
+// MessageBatchWriter, and history queries through GetHistoryAsync on the pool's executor (all
+// issued at once, so they contend for --pool_size connections). Reports operations per second for
+// each, plus pool wait times. Writes into the `messages` table of --database, so point it at a
+// scratch schema.
+//
+//   chirp_chat_mysql_store_bench [--host 127.0.0.1] [--port 3306] [--database chirp_bench] [--user root]
+//                                [--password ""] [--messages 20000] [--queries 5000] [--channels 100]
+//                                [--size 128] [--page 50] [--batch 128] [--delay_ms 5] [--writer_threads 1]
+//                                [--pool_size 4] [--query_threads 4]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <asio.hpp>
+
+#include "message_batch_writer.h"
+#include "mysql_message_store.h"
+
+namespace {
+
+using chirp::chat::MessageBatchWriter;
+using chirp::chat::MySQLConnection;
+using chirp::chat::MySQLConnectionPool;
+using chirp::chat::MySQLMessageData;
+using chirp::chat::MySQLMessageStore;
+
+std::string GetArg(int argc, char** argv, const std::string& key, const std::string& def) {
+  for (int i = 1; i < argc; i++) {
+    if (argv[i] == key && i + 1 < argc) {
+      return argv[i + 1];
+    }
+  }
+  return def;
+}
+
+struct Options {
+  size_t messages{20000};
+  size_t queries{5000};
+  size_t channels{100};
+  size_t size{128};
+  int32_t page{50};
+  MessageBatchWriter::Options writer;
+};
+
+MySQLMessageData MakeMessage(const std::string& run, size_t i, const Options& opts) {
+  MySQLMessageData msg{};
+  msg.message_id = run + "_" + std::to_string(i);
+  msg.sender_id = "bench_sender";
+  msg.receiver_id = "bench_receiver";
+  msg.channel_id = run + "_ch_" + std::to_string(i % opts.channels);
+  msg.channel_type = 1;
+  msg.msg_type = 0;
+  msg.content = std::string(opts.size, 'x');
+  msg.timestamp = static_cast<int64_t>(i);
+  msg.created_at = static_cast<int64_t>(i);
+  return msg;
+}
+
+// The pre-prepared-statement store: every value escaped into the SQL text, rows read back as
+// strings and parsed.
+bool TextInsert(MySQLConnection& conn, const MySQLMessageData& m) {
+  return conn.Execute("INSERT INTO messages (message_id, sender_id, receiver_id, channel_id, "
+                      "channel_type, msg_type, content, timestamp, created_at) VALUES ('" +
+                      conn.Escape(m.message_id) + "', '" + conn.Escape(m.sender_id) + "', '" +
+                      conn.Escape(m.receiver_id) + "', '" + conn.Escape(m.channel_id) + "', " +
+                      std::to_string(m.channel_type) + ", " + std::to_string(m.msg_type) + ", '" +
+                      conn.Escape(m.content) + "', " + std::to_string(m.timestamp) + ", " +
+                      std::to_string(m.created_at) + ")");
+}
+
+size_t TextHistory(MySQLConnection& conn, const std::string& channel_id, int64_t before, int32_t limit) {
+  if (!conn.Query("SELECT message_id, sender_id, receiver_id, channel_id, channel_type, msg_type, content, "
+                  "timestamp FROM messages WHERE channel_id = '" +
+                  conn.Escape(channel_id) + "' AND channel_type = 1 AND timestamp < " + std::to_string(before) +
+                  " ORDER BY timestamp DESC LIMIT " + std::to_string(limit))) {
+    return 0;
+  }
+  std::vector<MySQLMessageData> out;
+  for (auto& row : conn.FetchResults()) {
+    MySQLMessageData msg{};
+    msg.message_id = row[0];
+    msg.sender_id = row[1];
+    msg.receiver_id = row[2];
+    msg.channel_id = row[3];
+    msg.channel_type = std::stoi(row[4]);
+    msg.msg_type = std::stoi(row[5]);
+    msg.content = row[6];
+    msg.timestamp = std::stoll(row[7]);
+    out.push_back(std::move(msg));
+  }
+  return out.size();
+}
+
+double Seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Report(const char* name, const char* op, size_t n, size_t failed, double sec) {
+  std::cout << name << " " << op << "=" << n << " failed=" << failed
+            << " per_sec=" << static_cast<uint64_t>(static_cast<double>(n) / sec) << "\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const std::string host = GetArg(argc, argv, "--host", "127.0.0.1");
+  const uint16_t port = static_cast<uint16_t>(std::atoi(GetArg(argc, argv, "--port", "3306").c_str()));
+  const std::string database = GetArg(argc, argv, "--database", "chirp_bench");
+  const std::string user = GetArg(argc, argv, "--user", "root");
+  const std::string password = GetArg(argc, argv, "--password", "");
+  Options opts;
+  opts.messages = static_cast<size_t>(std::atoll(GetArg(argc, argv, "--messages", "20000").c_str()));
+  opts.queries = static_cast<size_t>(std::atoll(GetArg(argc, argv, "--queries", "5000").c_str()));
+  opts.channels =
+      std::max<size_t>(1, static_cast<size_t>(std::atoll(GetArg(argc, argv, "--channels", "100").c_str())));
+  opts.size = static_cast<size_t>(std::atoll(GetArg(argc, argv, "--size", "128").c_str()));
+  opts.page = static_cast<int32_t>(std::atoi(GetArg(argc, argv, "--page", "50").c_str()));
+  opts.writer.max_batch_rows = static_cast<size_t>(std::atoll(GetArg(argc, argv, "--batch", "128").c_str()));
+  opts.writer.max_delay_ms = std::atoi(GetArg(argc, argv, "--delay_ms", "5").c_str());
+  opts.writer.threads = static_cast<size_t>(std::atoll(GetArg(argc, argv, "--writer_threads", "1").c_str()));
+
+  chirp::database::MySQLPoolOptions pool_options;
+  pool_options.host = host;
+  pool_options.port = port;
+  pool_options.database = database;
+  pool_options.user = user;
+  pool_options.password = password;
+  pool_options.max_size =
+      std::max<size_t>(1, static_cast<size_t>(std::atoll(GetArg(argc, argv, "--pool_size", "4").c_str())));
+  pool_options.min_size = std::min(pool_options.max_size, std::max<size_t>(1, opts.writer.threads));
+  pool_options.executor_threads =
+      std::max<size_t>(1, static_cast<size_t>(std::atoll(GetArg(argc, argv, "--query_threads", "4").c_str())));
+  pool_options.acquire_timeout = std::chrono::seconds(30);
+  auto pool = std::make_shared<MySQLConnectionPool>(pool_options);
+  auto store = std::make_shared<MySQLMessageStore>(pool);
+  if (!store->Initialize()) {
+    std::cerr << "cannot reach mysql at " << host << ":" << port << "/" << database << "\n";
+    return 1;
+  }
+  MySQLConnection text(host, port, database, user, password);
+  if (!text.Connect()) {
+    std::cerr << "cannot connect the text-protocol baseline\n";
+    return 1;
+  }
+
+  // Fresh ids per run, so rows left by an earlier run never collide.
+  const std::string suffix = std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+  const std::string text_run = "bench_text_" + suffix;
+  const std::string stmt_run = "bench_stmt_" + suffix;
+  const std::string batch_run = "bench_batch_" + suffix;
+
+  size_t failed = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < opts.messages; ++i) {
+    failed += TextInsert(text, MakeMessage(text_run, i, opts)) ? 0 : 1;
+  }
+  Report("text", "inserts", opts.messages, failed, Seconds(start));
+
+  failed = 0;
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < opts.messages; ++i) {
+    failed += store->StoreMessage(MakeMessage(stmt_run, i, opts)) ? 0 : 1;
+  }
+  Report("prepared", "inserts", opts.messages, failed, Seconds(start));
+
+  // Submitted as fast as the queue takes them; Stop() flushes the tail.
+  std::atomic<size_t> batch_failed{0};
+  MessageBatchWriter writer(store, opts.writer);
+  writer.Start();
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < opts.messages; ++i) {
+    auto msg = MakeMessage(batch_run, i, opts);
+    while (!writer.Submit(msg, [&batch_failed](bool ok) { batch_failed += ok ? 0 : 1; })) {
+      std::this_thread::yield();
+    }
+  }
+  writer.Stop();
+  Report("group_commit", "inserts", opts.messages, batch_failed.load(), Seconds(start));
+  const auto ws = writer.GetStats();
+  std::cout << "group_commit batches=" << ws.batches_flushed
+            << " avg_rows=" << (ws.batches_flushed ? ws.total_written / ws.batches_flushed : 0)
+            << " max_rows=" << ws.max_batch_size
+            << " avg_flush_us=" << (ws.batches_flushed ? ws.total_flush_time_us / ws.batches_flushed : 0)
+            << " max_flush_us=" << ws.max_flush_time_us << "\n";
+
+  size_t rows = 0;
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < opts.queries; ++i) {
+    rows += TextHistory(text, text_run + "_ch_" + std::to_string(i % opts.channels),
+                        static_cast<int64_t>(opts.messages), opts.page);
+  }
+  Report("text", "history_queries", opts.queries, 0, Seconds(start));
+  std::cout << "text rows=" << rows << "\n";
+
+  rows = 0;
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < opts.queries; ++i) {
+    rows += store->GetHistory(stmt_run + "_ch_" + std::to_string(i % opts.channels), 1,
+                             static_cast<int64_t>(opts.messages), opts.page)
+                .size();
+  }
+  Report("prepared", "history_queries", opts.queries, 0, Seconds(start));
+  std::cout << "prepared rows=" << rows << "\n";
+
+  // Completions land on `io`, as they would on a service's io thread.
+  asio::io_context io;
+  auto work = asio::make_work_guard(io);
+  size_t async_rows = 0;
+  size_t pending = opts.queries;
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < opts.queries; ++i) {
+    store->GetHistoryAsync(stmt_run + "_ch_" + std::to_string(i % opts.channels), 1,
+                           static_cast<int64_t>(opts.messages), opts.page, io.get_executor(),
+                           [&](std::vector<MySQLMessageData> messages) {
+                             async_rows += messages.size();
+                             if (--pending == 0) {
+                               work.reset();
+                             }
+                           });
+  }
+  if (pending > 0) {
+    io.run();
+  }
+  Report("async", "history_queries", opts.queries, 0, Seconds(start));
+  const auto ps = pool->GetStats();
+  std::cout << "async rows=" << async_rows << " pool_acquired=" << ps.acquired << " pool_waits=" << ps.waits
+            << " pool_timeouts=" << ps.timeouts
+            << " avg_wait_us=" << (ps.acquired ? ps.total_wait_us / static_cast<int64_t>(ps.acquired) : 0)
+            << " max_wait_us=" << ps.max_wait_us << " max_in_use=" << ps.max_in_use << "\n";
+
+  text.Execute("DELETE FROM messages WHERE message_id LIKE 'bench\\_%\\_" + suffix + "\\_%'");
+  return 0;
+}
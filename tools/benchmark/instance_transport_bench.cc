@@ -0,0 +1,109 @@
+// Benchmark: instance-routed delivery between two MessageRouters through a running Redis, once
+// over Pub/Sub and once over Streams. Reports end-to-end messages per second for each transport.
+//
+//   chirp_instance_transport_bench [--host 127.0.0.1] [--port 6379] [--messages 200000] [--size 128]
+//                                  [--batch 256]
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <asio.hpp>
+
+#include "network/message_router.h"
+#include "network/redis_client.h"
+
+namespace {
+
+std::string GetArg(int argc, char** argv, const std::string& key, const std::string& def) {
+  for (int i = 1; i < argc; i++) {
+    if (argv[i] == key && i + 1 < argc) {
+      return argv[i + 1];
+    }
+  }
+  return def;
+}
+
+void Run(const char* name, chirp::network::InstanceTransport transport, const std::string& host, uint16_t port,
+         size_t messages, size_t size, size_t batch) {
+  using namespace chirp::network;
+
+  asio::io_context io;
+  auto work = asio::make_work_guard(io);
+  std::thread th([&] { io.run(); });
+
+  // Fresh instance ids, so a stream left over from an earlier run is not read again.
+  const std::string suffix = std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+  const std::string sender_id = std::string("bench_a_") + name + "_" + suffix;
+  const std::string receiver_id = std::string("bench_b_") + name + "_" + suffix;
+  InstanceRoutingOptions options;
+  options.transport = transport;
+  options.max_batch_messages = batch;
+
+  std::atomic<size_t> delivered{0};
+  std::atomic<size_t> undelivered{0};
+  MessageRouter a(io, host, port);
+  MessageRouter b(io, host, port);
+  a.EnableInstanceRouting(
+      sender_id, [](const std::string&, const std::string&) { return false; },
+      [&](const std::string&, const std::string&) { undelivered.fetch_add(1); }, options);
+  b.EnableInstanceRouting(
+      receiver_id,
+      [&](const std::string&, const std::string&) {
+        delivered.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      },
+      [&](const std::string&, const std::string&) { undelivered.fetch_add(1); }, options);
+  a.Start();
+  b.Start();
+  const std::string user = "bench_user_" + suffix;
+  b.RegisterLocalUser(user);
+  std::this_thread::sleep_for(std::chrono::milliseconds(200)); // let the receiver subscribe / join its group
+
+  const std::string payload(size, 'x');
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < messages; ++i) {
+    a.RouteToUser(user, payload);
+  }
+  const auto deadline = start + std::chrono::seconds(60);
+  while (delivered.load() + undelivered.load() < messages && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << name << " messages=" << messages << " delivered=" << delivered.load()
+            << " undelivered=" << undelivered.load() << " msgs_per_sec=" << static_cast<uint64_t>(delivered.load() / sec)
+            << "\n";
+
+  b.UnregisterLocalUser(user);
+  a.Stop();
+  b.Stop();
+  work.reset();
+  th.join();
+
+  RedisClient cleanup(host, port);
+  cleanup.Execute({"DEL", RouterChannels::InstanceStream(sender_id), RouterChannels::InstanceStream(receiver_id)});
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const std::string host = GetArg(argc, argv, "--host", "127.0.0.1");
+  const uint16_t port = static_cast<uint16_t>(std::atoi(GetArg(argc, argv, "--port", "6379").c_str()));
+  const size_t messages = static_cast<size_t>(std::atoll(GetArg(argc, argv, "--messages", "200000").c_str()));
+  const size_t size = static_cast<size_t>(std::atoll(GetArg(argc, argv, "--size", "128").c_str()));
+  const size_t batch = static_cast<size_t>(std::atoll(GetArg(argc, argv, "--batch", "256").c_str()));
+
+  chirp::network::RedisClient probe(host, port);
+  if (!probe.Execute({"PING"})) {
+    std::cerr << "cannot reach redis at " << host << ":" << port << "\n";
+    return 1;
+  }
+
+  Run("pubsub", chirp::network::InstanceTransport::kPubSub, host, port, messages, size, batch);
+  Run("streams", chirp::network::InstanceTransport::kStreams, host, port, messages, size, batch);
+  return 0;
+}
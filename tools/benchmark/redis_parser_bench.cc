@@ -0,0 +1,82 @@
+// Benchmark: decoding an LRANGE-shaped reply. Compares the owning RedisRespParser tree (one
+// std::string per element, copied again by RedisStringArray) with RedisReplyParser, which copies
+// the reply once into an arena and hands out views. No server needed.
+//
+//   chirp_redis_parser_bench [--elements 1000] [--size 128] [--iterations 2000]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "network/redis_protocol.h"
+#include "network/redis_reply.h"
+
+namespace {
+
+std::string GetArg(int argc, char** argv, const std::string& key, const std::string& def) {
+  for (int i = 1; i < argc; i++) {
+    if (argv[i] == key && i + 1 < argc) {
+      return argv[i + 1];
+    }
+  }
+  return def;
+}
+
+template <typename Fn>
+void Run(const char* name, size_t iterations, size_t elements, Fn&& fn) {
+  size_t checksum = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    checksum += fn();
+  }
+  const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << name << " replies/sec=" << static_cast<uint64_t>(static_cast<double>(iterations) / secs)
+            << " ns/element=" << secs * 1e9 / static_cast<double>(iterations * elements)
+            << " checksum=" << checksum << "\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const size_t elements = static_cast<size_t>(std::atoll(GetArg(argc, argv, "--elements", "1000").c_str()));
+  const size_t size = static_cast<size_t>(std::atoll(GetArg(argc, argv, "--size", "128").c_str()));
+  const size_t iterations = static_cast<size_t>(std::atoll(GetArg(argc, argv, "--iterations", "2000").c_str()));
+
+  std::string wire = "*" + std::to_string(elements) + "\r\n";
+  const std::string item(size, 'x');
+  for (size_t i = 0; i < elements; ++i) {
+    wire += "$" + std::to_string(size) + "\r\n" + item + "\r\n";
+  }
+  const auto* bytes = reinterpret_cast<const uint8_t*>(wire.data());
+
+  Run("resp_tree+copy", iterations, elements, [&] {
+    chirp::network::RedisRespParser parser;
+    parser.Append(bytes, wire.size());
+    auto reply = parser.Pop();
+    return reply ? chirp::network::RedisStringArray(*reply).size() : 0;
+  });
+
+  Run("arena_views", iterations, elements, [&] {
+    chirp::network::RedisReplyParser parser;
+    parser.Append(bytes, wire.size());
+    auto reply = parser.Pop();
+    size_t total = 0;
+    if (reply) {
+      for (const auto& e : reply->elements) {
+        total += e.str.size();
+      }
+    }
+    return total / size;
+  });
+
+  Run("arena+copy", iterations, elements, [&] {
+    chirp::network::RedisReplyParser parser;
+    parser.Append(bytes, wire.size());
+    auto reply = parser.Pop();
+    return reply ? chirp::network::RedisStringArray(*reply).size() : 0;
+  });
+  return 0;
+}
@@ -0,0 +1,89 @@
+// Benchmark: Redis round trips through RedisClient against a running server. Reports the
+// latency of one blocking command at a time, then throughput with `depth` commands in flight.
+//
+//   chirp_redis_pipeline_bench [--host 127.0.0.1] [--port 6379] [--requests 100000] [--depth 64] [--pool 2]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "network/redis_client.h"
+
+namespace {
+
+std::string GetArg(int argc, char** argv, const std::string& key, const std::string& def) {
+  for (int i = 1; i < argc; i++) {
+    if (argv[i] == key && i + 1 < argc) {
+      return argv[i + 1];
+    }
+  }
+  return def;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const std::string host = GetArg(argc, argv, "--host", "127.0.0.1");
+  const uint16_t port = static_cast<uint16_t>(std::atoi(GetArg(argc, argv, "--port", "6379").c_str()));
+  const size_t requests = static_cast<size_t>(std::atoll(GetArg(argc, argv, "--requests", "100000").c_str()));
+  const size_t depth = std::max<size_t>(1, static_cast<size_t>(std::atoll(GetArg(argc, argv, "--depth", "64").c_str())));
+  const size_t pool = static_cast<size_t>(std::atoll(GetArg(argc, argv, "--pool", "2").c_str()));
+
+  chirp::network::RedisClient client(host, port, chirp::network::RedisClientOptions{pool, std::chrono::milliseconds(2000)});
+  if (!client.Execute({"PING"})) {
+    std::cerr << "cannot reach redis at " << host << ":" << port << "\n";
+    return 1;
+  }
+
+  // Sequential: one command in flight.
+  const size_t sequential = std::min<size_t>(requests, 10000);
+  std::vector<double> lat_us;
+  lat_us.reserve(sequential);
+  for (size_t i = 0; i < sequential; ++i) {
+    const auto t0 = std::chrono::steady_clock::now();
+    client.Execute({"PING"});
+    lat_us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+  }
+  std::sort(lat_us.begin(), lat_us.end());
+  std::cout << "sequential requests=" << sequential << " p50_us=" << lat_us[lat_us.size() / 2]
+            << " p99_us=" << lat_us[lat_us.size() * 99 / 100] << "\n";
+
+  // Pipelined: keep `depth` commands outstanding until `requests` have completed.
+  std::mutex mu;
+  std::condition_variable cv;
+  size_t in_flight = 0;
+  std::atomic<size_t> failures{0};
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < requests; ++i) {
+    {
+      std::unique_lock<std::mutex> lock(mu);
+      cv.wait(lock, [&] { return in_flight < depth; });
+      ++in_flight;
+    }
+    client.ExecuteAsync({"INCR", "chirp:bench:counter"}, [&](std::optional<chirp::network::RedisReply> r) {
+      if (!r) {
+        failures.fetch_add(1);
+      }
+      std::lock_guard<std::mutex> lock(mu);
+      --in_flight;
+      cv.notify_one();
+    });
+  }
+  {
+    std::unique_lock<std::mutex> lock(mu);
+    cv.wait(lock, [&] { return in_flight == 0; });
+  }
+  const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "pipelined requests=" << requests << " depth=" << depth << " pool=" << pool
+            << " failures=" << failures.load()
+            << " ops/sec=" << static_cast<uint64_t>(static_cast<double>(requests) / secs) << "\n";
+  client.Del("chirp:bench:counter");
+  return 0;
+}
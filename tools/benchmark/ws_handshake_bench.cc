@@ -0,0 +1,63 @@
+// Microbenchmark: WebSocket upgrade handling on one core (parse + validate the request head,
+// compute Sec-WebSocket-Accept, build the 101 response), as during a reconnect storm.
+//
+//   chirp_ws_handshake_bench [--iterations 1000000] [--extra_headers 8]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "network/websocket_util.h"
+
+namespace {
+
+std::string GetArg(int argc, char** argv, const std::string& key, const std::string& def) {
+  for (int i = 1; i < argc; i++) {
+    if (argv[i] == key && i + 1 < argc) {
+      return argv[i + 1];
+    }
+  }
+  return def;
+}
+
+// A browser-like upgrade request with `extra` unrelated headers (cookies, user agent, ...).
+std::string BuildRequest(int extra) {
+  std::string req = "GET /ws HTTP/1.1\r\nHost: chirp.example.com:7001\r\n";
+  for (int i = 0; i < extra; ++i) {
+    req += "X-Header-" + std::to_string(i) + ": " + std::string(40, 'v') + "\r\n";
+  }
+  req += "Upgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+         "Sec-WebSocket-Version: 13\r\nSec-WebSocket-Extensions: permessage-deflate; client_max_window_bits\r\n\r\n";
+  return req;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const size_t iterations = static_cast<size_t>(std::atoll(GetArg(argc, argv, "--iterations", "1000000").c_str()));
+  const int extra_headers = std::atoi(GetArg(argc, argv, "--extra_headers", "8").c_str());
+  const std::string request = BuildRequest(extra_headers);
+
+  size_t response_bytes = 0;
+  size_t failures = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    chirp::network::HttpUpgradeRequest req;
+    if (chirp::network::ParseHttpUpgradeRequest(request, &req) != chirp::network::HttpUpgradeError::kNone) {
+      ++failures;
+      continue;
+    }
+    response_bytes += chirp::network::BuildWebSocketUpgradeResponse(req.ws_key, "").size();
+  }
+  const auto end = std::chrono::steady_clock::now();
+
+  const double secs = std::chrono::duration<double>(end - start).count();
+  std::cout << "request_bytes=" << request.size() << " iterations=" << iterations << " failures=" << failures
+            << "\n";
+  std::cout << "handshakes/sec/core=" << static_cast<uint64_t>(static_cast<double>(iterations) / secs)
+            << " ns/handshake=" << secs * 1e9 / static_cast<double>(iterations)
+            << " response_bytes=" << response_bytes << "\n";
+  return failures == 0 ? 0 : 1;
+}
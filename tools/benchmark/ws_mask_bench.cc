@@ -0,0 +1,74 @@
+// Microbenchmark: WebSocket mask/unmask kernel and masked frame building throughput.
+//
+//   chirp_ws_mask_bench [--min_bytes 64] [--max_bytes 1048576] [--total_mb 512]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "network/websocket_frame.h"
+
+namespace {
+
+std::string GetArg(int argc, char** argv, const std::string& key, const std::string& def) {
+  for (int i = 1; i < argc; i++) {
+    if (argv[i] == key && i + 1 < argc) {
+      return argv[i + 1];
+    }
+  }
+  return def;
+}
+
+// Unmask in place, the way the server parser does.
+double UnmaskGbps(size_t size, size_t iterations) {
+  std::vector<uint8_t> buf(size, 0x5A);
+  const uint8_t key[4] = {0x12, 0x34, 0x56, 0x78};
+
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    chirp::network::ApplyWebSocketMask(buf.data(), buf.data(), buf.size(), key);
+  }
+  const auto end = std::chrono::steady_clock::now();
+
+  volatile uint8_t sink = buf[size / 2];
+  (void)sink;
+  const double secs = std::chrono::duration<double>(end - start).count();
+  return static_cast<double>(size) * static_cast<double>(iterations) / secs / 1e9;
+}
+
+// Build a masked client frame (header + masked copy of the payload).
+double BuildMaskedGbps(size_t size, size_t iterations) {
+  const std::string payload(size, 'x');
+  size_t total = 0;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    total += chirp::network::BuildWebSocketFrame(/*opcode=*/0x2, payload, /*mask=*/true).size();
+  }
+  const auto end = std::chrono::steady_clock::now();
+
+  const double secs = std::chrono::duration<double>(end - start).count();
+  return static_cast<double>(total) / secs / 1e9;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const size_t min_bytes = static_cast<size_t>(std::atoll(GetArg(argc, argv, "--min_bytes", "64").c_str()));
+  const size_t max_bytes = static_cast<size_t>(std::atoll(GetArg(argc, argv, "--max_bytes", "1048576").c_str()));
+  const size_t total_bytes =
+      static_cast<size_t>(std::atoll(GetArg(argc, argv, "--total_mb", "512").c_str())) * 1024 * 1024;
+
+  std::cout << std::left << std::setw(12) << "bytes" << std::setw(16) << "unmask GB/s" << "build(masked) GB/s\n";
+  for (size_t size = min_bytes; size > 0 && size <= max_bytes; size *= 4) {
+    const size_t iterations = std::max<size_t>(1, total_bytes / size);
+    std::cout << std::left << std::setw(12) << size << std::setw(16) << std::fixed << std::setprecision(2)
+              << UnmaskGbps(size, iterations) << BuildMaskedGbps(size, iterations) << "\n";
+  }
+  return 0;
+}